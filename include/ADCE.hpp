@@ -0,0 +1,33 @@
+#pragma once
+
+#include "PassManager.hpp"
+
+#include <string>
+
+namespace mina
+{
+
+/**
+ * @brief Aggressive dead code elimination.
+ *
+ * Mark and sweep over the SSA def-use chains, as described by Cytron et al.
+ * Everything starts out dead except the instructions with effects outside of
+ * the function: put, get, calls, returns and array updates. Marking an
+ * instruction live marks the definitions of its operands, and the branches
+ * its block is control dependent on, taken from the post-dominance
+ * frontier. A live phi also needs the branches deciding which edge reaches
+ * it.
+ *
+ * Unmarked instructions are deleted. A conditional branch that stayed dead
+ * becomes a jump to its immediate post-dominator, which cuts off the dead
+ * blocks in between. Branches leaving a loop are always kept live, so loops
+ * that may not terminate are never removed.
+ */
+class ADCEPass : public FunctionPass
+{
+public:
+    std::string getName() const override;
+    bool run(SSA& ssa) override;
+};
+
+}  // namespace mina
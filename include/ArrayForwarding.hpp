@@ -0,0 +1,36 @@
+#pragma once
+
+#include "PassManager.hpp"
+
+#include <string>
+
+namespace mina
+{
+
+/**
+ * @brief Store-to-load forwarding, redundant load elimination and dead store
+ * elimination for arrays.
+ *
+ * Arrays never alias each other, and every store defines a new SSA version
+ * of its array, so the stores a load may see are found by walking back from
+ * the version it reads. Stores to an index known to differ are skipped, a
+ * store to the same index gives the value of the load, and so does an
+ * earlier load of the same index that dominates it. At a phi of the array
+ * the walk continues into every predecessor, and a new phi merges the values
+ * found when they differ. Indices are equal or different when they are the
+ * same value plus different constants.
+ *
+ * A store is dead when no path from it reads its index before another store
+ * to the same index overwrites it or the function ends. Past a phi of the
+ * array a name may hold the value of another trip around a loop, so only
+ * constant indices are compared there.
+ */
+class ArrayForwardingPass : public FunctionPass
+{
+public:
+    std::string getName() const override;
+    bool run(SSA& ssa) override;
+    bool preservesCFG() const override { return true; }
+};
+
+}  // namespace mina
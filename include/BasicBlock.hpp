@@ -37,6 +37,21 @@ public:
     void pushPredecessor(const std::shared_ptr<BasicBlock>& predecessor);
     void pushSuccessor(const std::shared_ptr<BasicBlock>& successor);
 
+    // Jump, BRT or BRF ending the block, nullptr if there is none
+    std::shared_ptr<Inst> getTerminator();
+
+    // Redirects the edge to oldSucc, including the targets of the terminator.
+    // The predecessor lists of both successors are left for the caller.
+    void replaceSuccessor(const std::shared_ptr<BasicBlock>& oldSucc,
+                          const std::shared_ptr<BasicBlock>& newSucc);
+    void removeSuccessor(const std::shared_ptr<BasicBlock>& successor);
+
+    // Both keep the incoming blocks of the phis in sync with the predecessor
+    // list. Removing a predecessor drops the phi operands coming from it.
+    void replacePredecessor(const std::shared_ptr<BasicBlock>& oldPred,
+                            const std::shared_ptr<BasicBlock>& newPred);
+    void removePredecessor(const std::shared_ptr<BasicBlock>& predecessor);
+
     virtual ~BasicBlock() = default;
     BasicBlock(const BasicBlock&) = delete;
     BasicBlock(BasicBlock&&) noexcept = default;
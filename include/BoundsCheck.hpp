@@ -0,0 +1,33 @@
+#pragma once
+
+#include "PassManager.hpp"
+
+#include <string>
+
+namespace mina
+{
+
+/**
+ * @brief Drops the bounds checks that can't fail, for -fbounds-check.
+ *
+ * CodeGen checks the index of every load and store against the size of the
+ * array unless the instruction says it doesn't need to. This pass clears
+ * that for indices the value ranges prove to be within the array, induction
+ * variables of loops bounded by the size and the byte offsets strength
+ * reduction steps along with them included, and for indices already
+ * checked against the same or a smaller size by an access dominating this
+ * one. A failed check never returns, so the index is known to be in range
+ * wherever the earlier access dominates.
+ *
+ * It only runs with -fbounds-check, which also turns the checks
+ * on in CodeGen.
+ */
+class BoundsCheckPass : public FunctionPass
+{
+public:
+    std::string getName() const override;
+    bool run(SSA& ssa) override;
+    bool preservesCFG() const override { return true; }
+};
+
+}  // namespace mina
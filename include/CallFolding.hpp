@@ -0,0 +1,32 @@
+#pragma once
+
+#include "PassManager.hpp"
+
+#include <map>
+#include <string>
+
+namespace mina
+{
+
+/**
+ * @brief Evaluates calls to pure routines with constant arguments at compile
+ * time.
+ *
+ * The call graph tells which routines neither do input or output nor halt.
+ * A call to one of them whose arguments are all constants is run by the
+ * IREvaluator, and a function call is replaced with the value it returns,
+ * while a procedure call, which can have no effect, is dropped. Calls that
+ * don't finish within the step and depth limits, fault, or return a value
+ * that doesn't fit a 32-bit constant are left alone.
+ *
+ * A boolean result becomes a boolean constant, except as the operand of a
+ * put, which prints the variable it replaces as a number.
+ */
+class CallFoldingPass : public ModulePass
+{
+public:
+    std::string getName() const override;
+    bool run(SSA& mainSSA, std::map<std::string, SSA>& functions) override;
+};
+
+}  // namespace mina
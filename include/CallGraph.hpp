@@ -0,0 +1,87 @@
+#pragma once
+
+#include "SSA.hpp"
+
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+namespace mina
+{
+
+// What a call to a routine may do besides computing its result, including
+// what the routines it calls do
+struct FunctionSummary
+{
+    bool readsInput = false;
+    bool writesOutput = false;
+
+    // Calls itself, directly or through other routines
+    bool isRecursive = false;
+
+    // Neither does input or output nor halts, so a call only computes its
+    // result. It may still never return.
+    bool isPure = false;
+
+    // Physical registers a call may change. Every caller-saved register
+    // until CodeGen records the ones the allocated body writes.
+    std::set<int> clobberedRegs;
+    bool hasClobberInfo = false;
+};
+
+/**
+ * @brief Calls between main and the procedures and functions of a program.
+ *
+ * Built from the FuncCall and ProcCall instructions reachable in every
+ * routine. The strongly connected components are found with Tarjan's
+ * algorithm and kept bottom-up, so the callees of a routine come before it
+ * unless they call it back. The summaries are computed in the same order,
+ * a component sharing the effects of all its members.
+ *
+ * Main is the node named "main". Routines main can't reach are never called
+ * and are not emitted.
+ */
+class CallGraph
+{
+public:
+    CallGraph(SSA& mainSSA, std::map<std::string, SSA>& functions);
+
+    static constexpr const char* MainName = "main";
+
+    // Routines called by name, each listed once in the order first called
+    const std::vector<std::string>& getCallees(const std::string& name) const;
+
+    // Number of calls to the routine in the whole program
+    size_t getNumCallSites(const std::string& name) const;
+
+    // Strongly connected components, callees first
+    const std::vector<std::vector<std::string>>& getSCCs() const;
+
+    bool isReachable(const std::string& name) const;
+
+    // Functions main can't reach, in name order
+    std::vector<std::string> getUnreachable() const;
+
+    const FunctionSummary& getSummary(const std::string& name) const;
+    void setClobberedRegs(const std::string& name, std::set<int> regs);
+
+private:
+    struct Node
+    {
+        std::vector<std::string> callees;
+        size_t numCallSites = 0;
+        bool hasSideEffects = false;
+        FunctionSummary summary;
+    };
+
+    std::map<std::string, Node> m_nodes;
+    std::vector<std::vector<std::string>> m_sccs;
+    std::set<std::string> m_reachable;
+
+    void addRoutine(const std::string& name, SSA& ssa);
+    void findSCCs();
+    void summarize();
+};
+
+}  // namespace mina
@@ -3,6 +3,7 @@
 #include "SSA.hpp"
 #include "BasicBlock.hpp"
 #include "MachineIR.hpp"
+#include "CallGraph.hpp"
 
 #include <map>
 #include <set>
@@ -24,12 +25,47 @@ class CodeGen
 	std::map<std::string, SSA> m_functionSSAMap;
 	std::map<std::string, std::shared_ptr<Register>> m_vregMap;
 
+	// Calls in tail position jump to the callee instead, set by optimize()
+	bool m_tailCalls = false;
+
+	// Calls clobber only the registers the callee writes, set by optimize()
+	bool m_callClobbers = false;
+
+	// Routines left after optimization, built by optimize()
+	std::shared_ptr<CallGraph> m_callGraph;
+
+	// Pure recursive integer functions are called through a memo table, set
+	// by optimize()
+	bool m_memoize = false;
+
+	// Functions given a memo table, in the order they were generated
+	std::vector<std::string> m_memoized;
+
+	// Array indices are checked against the size of the array, set by
+	// optimize()
+	bool m_boundsCheck = false;
+
+	// Drops the functions main can't reach
+	void removeUnreachableFunctions();
+
+	// Whether the function can be called through a memo table: pure,
+	// recursive, and taking up to two integers to return an integer
+	bool isMemoizable(const std::string& funcName);
+
+	// Prints the entry point looking the arguments up in the memo table of
+	// the function before running its body
+	void printMemoWrapper(const std::string& funcName);
+
 public:
 	CodeGen(SSA ssa);
 	void setSSA(SSA& SSA);
 
 	void generateMIR(bool isMain = false);
 	void addSSA(std::string funcName, SSA& ssa);
+
+	// Runs the optimization pipeline selected by the compiler options over
+	// main and every function, callees before their callers
+	void optimize();
 	void generateAllFunctionsMIR();
 	void printMIR();
 };
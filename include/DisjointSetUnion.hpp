@@ -1,20 +1,42 @@
 #pragma once
 
-#include <unordered_map>
-#include <string>
+#include <vector>
 
 namespace mina
 {
 
+/**
+ * @brief Disjoint sets over dense integer ids, with union by rank and path
+ * compression.
+ *
+ * Ids are handed out by make_set() from 0 up, so callers number their values
+ * once and keep the names on their side. reset() forgets every set but keeps
+ * the storage for the next routine.
+ */
 class DisjointSetUnion
 {
 private:
-    std::unordered_map<std::string, std::string> parent;
+    std::vector<int> parent;
+    std::vector<unsigned char> rank;
 
 public:
-    void make_set(const std::string& v);
-    std::string find(const std::string& v);
-    void unite(const std::string& u, const std::string& v);
+    DisjointSetUnion() = default;
+
+    // Starts out with the ids 0 to size - 1, each in its own set
+    explicit DisjointSetUnion(int size);
+
+    void reset(int size = 0);
+    int size() const;
+
+    // Adds a new id in its own set and returns it
+    int make_set();
+
+    // Representative of the set containing v
+    int find(int v);
+
+    // Merges the sets containing u and v. Returns false if they already were
+    // the same set.
+    bool unite(int u, int v);
 };
 
 }  // namespace mina
@@ -0,0 +1,108 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+#include <unordered_map>
+
+namespace mina
+{
+
+class BasicBlock;
+class BasicBlockMIR;
+
+// Reverse post-order of every block reachable from entry. Unlike getRPONodes
+// this is iterative and works for both BasicBlock and BasicBlockMIR.
+template <typename BlockT>
+std::vector<std::shared_ptr<BlockT>> computeRPO(
+    const std::shared_ptr<BlockT>& entry);
+
+/**
+ * @brief Dominator (or post-dominator) tree of a control flow graph.
+ *
+ * The tree is built with the iterative algorithm from Cooper, Harvey and
+ * Kennedy, "A Simple, Fast Dominance Algorithm": blocks are numbered in
+ * reverse post-order and the immediate dominators are refined with the
+ * two-finger intersection until nothing changes.
+ *
+ * Post-dominators are computed on the reversed CFG, rooted at a virtual exit
+ * that has an edge to every block without successors. Blocks that can never
+ * reach an exit (infinite loops) are attached to the virtual exit as well, so
+ * every block reachable from the entry is part of the tree.
+ *
+ * Once built, the tree is numbered with a DFS so that dominates() is an O(1)
+ * check of the entry/exit interval of the two blocks.
+ */
+template <typename BlockT>
+class DominatorTreeBase
+{
+public:
+    using BlockPtr = std::shared_ptr<BlockT>;
+
+    DominatorTreeBase(BlockPtr entry, bool isPostDominator = false);
+
+    bool isPostDominator() const;
+
+    // Blocks covered by the tree, in reverse post-order of the analysed graph
+    const std::vector<BlockPtr>& getBlocks() const;
+    bool contains(const BlockPtr& block) const;
+
+    // Immediate dominator. Returns nullptr for the entry block, and in a
+    // post-dominator tree for blocks immediately post-dominated by the
+    // virtual exit.
+    BlockPtr getIDom(const BlockPtr& block) const;
+    const std::vector<BlockPtr>& getChildren(const BlockPtr& block) const;
+
+    // Children of the root: the entry block, or every block hanging off the
+    // virtual exit of a post-dominator tree
+    const std::vector<BlockPtr>& getRoots() const;
+
+    // Depth of the block in the tree, roots have level 0
+    unsigned int getLevel(const BlockPtr& block) const;
+
+    // Both queries return false if either block is not part of the tree
+    bool dominates(const BlockPtr& a, const BlockPtr& b) const;
+    bool strictlyDominates(const BlockPtr& a, const BlockPtr& b) const;
+
+    // Returns nullptr if the only common dominator is the virtual exit
+    BlockPtr findNearestCommonDominator(const BlockPtr& a,
+                                        const BlockPtr& b) const;
+
+    // Dominance frontier, or post-dominance frontier for a post-dominator
+    // tree (which is what control dependence is made of)
+    const std::vector<BlockPtr>& getDominanceFrontier(
+        const BlockPtr& block) const;
+
+    // Blocks in dominator tree pre-order, every block is visited after its
+    // immediate dominator
+    std::vector<BlockPtr> getPreOrder() const;
+
+    void print() const;
+
+private:
+    // Node 0 is the root. For post-dominators the root is the virtual exit
+    // and has no block attached to it.
+    static constexpr int Root = 0;
+    static constexpr int None = -1;
+
+    bool m_isPostDominator;
+    std::vector<BlockPtr> m_nodes;
+    std::vector<BlockPtr> m_blocks;
+    std::vector<BlockPtr> m_roots;
+    std::unordered_map<BlockT*, int> m_index;
+
+    std::vector<int> m_idom;
+    std::vector<unsigned int> m_level;
+    std::vector<unsigned int> m_dfsIn, m_dfsOut;
+    std::vector<std::vector<BlockPtr>> m_children;
+    std::vector<std::vector<BlockPtr>> m_frontier;
+
+    int indexOf(const BlockPtr& block) const;
+    int intersect(int a, int b, const std::vector<int>& rpoNumber) const;
+    void build(const std::vector<std::vector<int>>& succs,
+               const std::vector<std::vector<int>>& preds);
+};
+
+using DominatorTree = DominatorTreeBase<BasicBlock>;
+using DominatorTreeMIR = DominatorTreeBase<BasicBlockMIR>;
+
+}  // namespace mina
@@ -0,0 +1,32 @@
+#pragma once
+
+#include "PassManager.hpp"
+
+#include <string>
+
+namespace mina
+{
+
+/**
+ * @brief Dominator-scoped global value numbering.
+ *
+ * The dominator tree is walked in pre-order with a scoped hash table, so an
+ * expression is only reused while the block computing it dominates the
+ * current one. Expressions are keyed by opcode and the value numbers of their
+ * operands, with the operands of commutative operations sorted and x > y
+ * rewritten as y < x. Copies and constants get the value number of their
+ * source, which also propagates them into their uses.
+ *
+ * Array loads are keyed by the SSA version of the array they read. Every
+ * store defines a new version, so a store kills the loads of the array made
+ * before it and a load is only reused when no store can run in between.
+ */
+class GVNPass : public FunctionPass
+{
+public:
+    std::string getName() const override;
+    bool run(SSA& ssa) override;
+    bool preservesCFG() const override { return true; }
+};
+
+}  // namespace mina
@@ -0,0 +1,37 @@
+#pragma once
+
+#include "PassManager.hpp"
+
+#include <map>
+#include <string>
+
+namespace mina
+{
+
+/**
+ * @brief Interprocedural constant propagation and function specialization.
+ *
+ * Every call of a Mina program is known, so a parameter that receives the
+ * same constant at every call site is replaced with that constant in the
+ * callee and dropped from the signature and the calls. A recursive call
+ * passing the parameter through unchanged doesn't count against it.
+ *
+ * When only some calls pass constants, the callee is cloned into a version
+ * specialized for them, named <callee>_spec<N>, and those calls are
+ * redirected to it. A clone is made when the instructions folding away in
+ * it, counted once per call site it serves, pay for its size, and a routine
+ * gets at most a few of them. Recursive calls inside a clone that pass the
+ * same constants are redirected to the clone itself.
+ *
+ * The pass runs after the function passes, which have already folded the
+ * arguments, and the function passes run again over the result so SCCP and
+ * ADCE clean up the callees.
+ */
+class IPConstantPropagationPass : public ModulePass
+{
+public:
+    std::string getName() const override;
+    bool run(SSA& mainSSA, std::map<std::string, SSA>& functions) override;
+};
+
+}  // namespace mina
@@ -0,0 +1,86 @@
+#pragma once
+
+#include "SSA.hpp"
+
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+#include <optional>
+#include <unordered_map>
+
+namespace mina
+{
+
+/**
+ * @brief Interpreter for the SSA form, to run code at compile time.
+ *
+ * Integers are 64-bit and wrap around, like the registers holding them at
+ * run time. Arrays are shared by all their SSA versions, as they are by the
+ * stack slot CodeGen gives them.
+ *
+ * Evaluation gives up on anything whose outcome is only known at run time:
+ * input and output, reading an array element never written, indexing out of
+ * bounds, dividing by zero, halting, or going past the step or call depth
+ * limits. The caller then leaves the code as it is.
+ *
+ * A whole program can be run as well, which records its output and stops
+ * at a halt. Only input is unknown then.
+ */
+class IREvaluator
+{
+public:
+    struct Value
+    {
+        long long value = 0;
+        bool isBool = false;
+    };
+
+    IREvaluator(std::map<std::string, SSA>& functions, long long maxSteps,
+                int maxDepth);
+
+    // Result of calling the routine, an empty Value for a procedure.
+    // std::nullopt if the evaluation gave up.
+    std::optional<Value> call(const std::string& funcName,
+                              const std::vector<Value>& args);
+
+    // Text main prints until it ends or halts, as printf writes it.
+    // std::nullopt if the evaluation gave up or printed more than maxOutput
+    // characters.
+    std::optional<std::string> runProgram(SSA& mainSSA, size_t maxOutput);
+
+    // Instructions executed by every call so far
+    long long getSteps() const;
+
+private:
+    using Array = std::vector<std::optional<long long>>;
+
+    struct Slot
+    {
+        Value scalar;
+        std::shared_ptr<Array> array;
+    };
+
+    using Frame = std::unordered_map<std::string, Slot>;
+
+    std::map<std::string, SSA>& m_functions;
+    long long m_maxSteps;
+    int m_maxDepth;
+    long long m_steps = 0;
+    int m_depth = 0;
+
+    // Set while running a whole program, which may print and halt
+    bool m_isProgram = false;
+    bool m_isHalted = false;
+    size_t m_maxOutput = 0;
+    std::string m_output;
+
+    std::optional<Slot> run(SSA& ssa, const std::vector<Slot>& args);
+    std::optional<Slot> getOperand(Frame& frame,
+                                   const std::shared_ptr<Inst>& operand);
+    std::optional<Slot> evaluate(Frame& frame,
+                                 const std::shared_ptr<Inst>& inst);
+    bool print(Frame& frame, const std::shared_ptr<Inst>& operand);
+};
+
+}  // namespace mina
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace mina
+{
+
+class Inst;
+class BasicBlock;
+class SSA;
+
+// Helpers shared by the optimization passes.
+//
+// Values are identified by their SSA name. An operand is either the
+// instruction defining the value or an IdentInst carrying the same name, so
+// passes compare names instead of pointers.
+
+// True for integer and boolean constants
+bool isConstant(const std::shared_ptr<Inst>& operand);
+
+// Name of the value an operand refers to, empty for constants and strings
+std::string getValueName(const std::shared_ptr<Inst>& operand);
+
+// Name of the value defined by the instruction, empty if it defines none
+std::string getDefinedName(const std::shared_ptr<Inst>& inst);
+
+// True if the instruction only computes its result, so it can be deleted
+// once nothing uses it
+bool isRemovableIfUnused(const std::shared_ptr<Inst>& inst);
+
+// Name of the routine a FuncCall or ProcCall calls, empty for other
+// instructions
+std::string getCalleeName(const std::shared_ptr<Inst>& inst);
+
+// Operand referring to the value with the given name
+std::shared_ptr<Inst> makeValueRef(const std::string& name,
+                                   const std::shared_ptr<BasicBlock>& block);
+
+// Copy of the instruction placed in block. The copy defines name instead of
+// the original value, its named operands are new references to the same
+// values and its branch targets and phi blocks are the original ones, so the
+// caller only remaps what changes. Throws std::runtime_error for instructions
+// that can't be copied.
+std::shared_ptr<Inst> cloneInst(const std::shared_ptr<Inst>& inst,
+                                const std::string& name,
+                                const std::shared_ptr<BasicBlock>& block);
+
+// Copy of a routine under another name. The entry block takes the name and
+// the other blocks get it as a suffix, so the labels stay unique, while the
+// values keep their names.
+SSA cloneFunction(SSA& function, const std::string& name);
+
+// Replaces the conditional branch ending the block with a jump to target.
+// The edge to the other successor is removed along with the phi operands
+// flowing over it.
+void replaceBranchWithJump(const std::shared_ptr<BasicBlock>& block,
+                           const std::shared_ptr<BasicBlock>& target);
+
+// Moves the edges from preds to block over to a new block that jumps to
+// block. Phi operands flowing in from preds move along, merged by a new phi
+// in the new block when they differ. Returns the new block.
+std::shared_ptr<BasicBlock> splitPredecessors(
+    SSA& ssa, const std::shared_ptr<BasicBlock>& block,
+    const std::vector<std::shared_ptr<BasicBlock>>& preds,
+    const std::string& name);
+
+// Removes the edges from the given blocks that can no longer be reached from
+// the entry into the blocks that still can, including their phi operands.
+// Returns true if any block was cut off.
+bool detachUnreachableBlocks(
+    SSA& ssa, const std::vector<std::shared_ptr<BasicBlock>>& blocks);
+
+}  // namespace mina
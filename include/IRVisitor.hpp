@@ -32,8 +32,17 @@ private:
     CodeGen m_cg;
 
     std::shared_ptr<BasicBlock> m_currentBB; // current basic block
+    std::shared_ptr<BasicBlock> m_entryBB;   // entry of the current routine
     std::unordered_map<std::string, std::shared_ptr<Func>> m_funcBB;
 
+    // Blocks following the enclosing loop ... end loop statements, innermost
+    // last, where exit jumps to
+    std::vector<std::shared_ptr<BasicBlock>> m_loopExits;
+
+    // True once control can't reach the current block, after an exit, a
+    // return or when every path into it has left
+    bool isUnreachable() const;
+
 public:
     IRVisitor();
     void visit(StatementsAST& v) override;
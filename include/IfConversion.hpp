@@ -0,0 +1,30 @@
+#pragma once
+
+#include "PassManager.hpp"
+
+#include <string>
+
+namespace mina
+{
+
+/**
+ * @brief Turns small if-then-else diamonds into selects.
+ *
+ * A conditional branch whose two arms are single blocks meeting again at a
+ * join, or one arm and the edge straight to the join, is replaced by the
+ * arms run one after the other and a select for every phi of the join.
+ * CodeGen lowers a select to cmov, so a data-dependent condition no longer
+ * costs mispredicted branches.
+ *
+ * Both arms then always run, so they may only compute values: no memory,
+ * input, output, calls or divisions, which may fault. Arms of more than a
+ * few instructions, or joins merging many values, keep their branch.
+ */
+class IfConversionPass : public FunctionPass
+{
+public:
+    std::string getName() const override;
+    bool run(SSA& ssa) override;
+};
+
+}  // namespace mina
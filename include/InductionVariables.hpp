@@ -0,0 +1,69 @@
+#pragma once
+
+#include "LoopInfo.hpp"
+
+#include <memory>
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+namespace mina
+{
+
+class Inst;
+
+// A phi of the loop header that starts at init when the loop is entered and
+// grows by a constant step on every trip around the loop
+struct BasicInductionVariable
+{
+    std::string name;
+    std::shared_ptr<Inst> init;
+
+    // The value flowing back into the phi from the latch
+    std::string next;
+    long long step;
+};
+
+// The value base * scale + offset, where base is the value a basic induction
+// variable has in the current iteration
+struct AffineValue
+{
+    std::string base;
+    long long scale;
+    long long offset;
+};
+
+/**
+ * @brief Induction variables of a loop, in the style of scalar evolution.
+ *
+ * Every phi of the header is first assumed to be a basic induction variable.
+ * The values computed in the loop are then expressed as affine functions of
+ * those phis, through copies and additions, subtractions and multiplications
+ * by constants. A phi whose latch operand doesn't turn out to be the phi plus
+ * a constant is dropped and the forms are recomputed without it.
+ *
+ * Only loops with a preheader and a single latch are analysed, other loops
+ * have no induction variables. Scales, offsets and steps always fit in an
+ * integer.
+ */
+class InductionVariables
+{
+public:
+    InductionVariables(const Loop& loop);
+
+    const std::vector<BasicInductionVariable>& getBasicIVs() const;
+
+    // nullptr if the name is not a basic induction variable of the loop
+    const BasicInductionVariable* getBasicIV(const std::string& name) const;
+
+    // Affine form of a value computed in the loop, nullptr if it has none
+    const AffineValue* getAffine(const std::string& name) const;
+
+private:
+    std::vector<BasicInductionVariable> m_basicIVs;
+    std::unordered_map<std::string, AffineValue> m_affine;
+
+    void computeAffineForms(const Loop& loop);
+};
+
+}  // namespace mina
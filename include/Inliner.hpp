@@ -0,0 +1,43 @@
+#pragma once
+
+#include "PassManager.hpp"
+
+#include <map>
+#include <string>
+
+namespace mina
+{
+
+/**
+ * @brief Inlining of small procedures and functions.
+ *
+ * A call is replaced with a copy of the body of the callee, taken from the
+ * SSA graphs of the other routines. The block holding the call is split
+ * after it: the first half jumps to the copied entry, and every copied
+ * block that returned jumps to the second half instead. The parameters are
+ * replaced with the arguments, every value of the copy gets a fresh SSA
+ * name, and the result of the call becomes the returned value, merged by a
+ * phi when the callee returns from several places.
+ *
+ * A callee is inlined when its size stays under a threshold, which grows
+ * with every constant argument since the branches on it fold afterwards.
+ * Recursive callees are never inlined, and a caller stops taking bodies once
+ * it has grown past a limit.
+ *
+ * Calls within an inlined body are not inlined again by the same run.
+ * Callees are optimized before their callers, so their size is the one after
+ * their own calls were inlined.
+ */
+class InlinerPass : public FunctionPass
+{
+public:
+    InlinerPass(std::map<std::string, SSA>& functions);
+
+    std::string getName() const override;
+    bool run(SSA& ssa) override;
+
+private:
+    std::map<std::string, SSA>& m_functions;
+};
+
+}  // namespace mina
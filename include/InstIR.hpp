@@ -47,6 +47,7 @@ enum class InstType
     ProcCall,
     FuncCall,
     Phi,
+    Select,
     Halt,
     Undef,
     Noop,
@@ -266,12 +267,23 @@ public:
     virtual InstType getInstType() const override;
 };
 
+// How CodeGen divides. The unsigned forms skip the sign extension of the
+// dividend and are only valid once both operands are known to be
+// non-negative, the 32-bit one also needs them below 2^31.
+enum class DivKind
+{
+    Signed,
+    Unsigned,
+    Unsigned32
+};
+
 class DivInst: public Inst
 {
 private:
     std::shared_ptr<Inst> m_target, m_operand1, m_operand2;
     std::vector<std::shared_ptr<Inst>> m_users, m_operands;
     std::shared_ptr<BasicBlock> m_block;
+    DivKind m_kind = DivKind::Signed;
 
 public:
     DivInst(std::shared_ptr<Inst> target, std::shared_ptr<Inst> operand1,
@@ -287,6 +299,9 @@ public:
     std::shared_ptr<Inst> getOperand1();
     std::shared_ptr<Inst> getOperand2();
 
+    DivKind getKind() const { return m_kind; }
+    void setKind(DivKind kind) { m_kind = kind; }
+
     virtual std::string getString() override;
     virtual void push_user(std::shared_ptr<Inst> user) override;
     virtual void setup_def_use();
@@ -424,6 +439,8 @@ private:
     std::vector<std::shared_ptr<Inst>> m_users, m_operands;
     std::shared_ptr<BasicBlock> m_block;
     Type m_type;
+    bool m_isIndexScaled = false;
+    bool m_needsBoundsCheck = true;
 
 public:
     ArrAccessInst(std::shared_ptr<Inst> target, std::shared_ptr<Inst> source,
@@ -439,6 +456,15 @@ public:
     std::shared_ptr<Inst> getSource();
     std::shared_ptr<Inst> getIndex();
     Type getType() { return m_type; }
+
+    // A scaled index is already a byte offset into the array
+    bool isIndexScaled() const { return m_isIndexScaled; }
+    void setIndexScaled(bool isIndexScaled) { m_isIndexScaled = isIndexScaled; }
+
+    // Checked against the size of the array under -fbounds-check, unless
+    // the index is known to be within it
+    bool needsBoundsCheck() const { return m_needsBoundsCheck; }
+    void setNeedsBoundsCheck(bool needsCheck) { m_needsBoundsCheck = needsCheck; }
     
     virtual std::string getString() override;
     virtual void push_user(std::shared_ptr<Inst> user) override;
@@ -456,6 +482,8 @@ private:
     std::vector<std::shared_ptr<Inst>> m_users, m_operands;
     std::shared_ptr<BasicBlock> m_block;
     Type m_type;
+    bool m_isIndexScaled = false;
+    bool m_needsBoundsCheck = true;
 
 public:
     ArrUpdateInst(std::shared_ptr<Inst> target, std::shared_ptr<Inst> source,
@@ -472,6 +500,15 @@ public:
     std::shared_ptr<Inst> getIndex();
     std::shared_ptr<Inst> getVal();
     Type getType() const { return m_type; }
+
+    // A scaled index is already a byte offset into the array
+    bool isIndexScaled() const { return m_isIndexScaled; }
+    void setIndexScaled(bool isIndexScaled) { m_isIndexScaled = isIndexScaled; }
+
+    // Checked against the size of the array under -fbounds-check, unless
+    // the index is known to be within it
+    bool needsBoundsCheck() const { return m_needsBoundsCheck; }
+    void setNeedsBoundsCheck(bool needsCheck) { m_needsBoundsCheck = needsCheck; }
     
     virtual std::string getString() override;
     virtual void push_user(std::shared_ptr<Inst> user) override;
@@ -880,6 +917,7 @@ public:
 
     std::string getFuncName();
     FType getFType() const;
+    Type getRetType() const;
 
     virtual std::string getString() override;
     virtual void push_user(std::shared_ptr<Inst> user) override;
@@ -995,6 +1033,8 @@ public:
     void appendOperand(std::shared_ptr<Inst> operand,
                        std::shared_ptr<BasicBlock> operandBB);
     std::shared_ptr<BasicBlock> getOperandBB(unsigned index);
+    void setOperandBB(unsigned index, std::shared_ptr<BasicBlock> operandBB);
+    void removeOperand(unsigned index);
 
     virtual std::shared_ptr<Inst> getTarget() override;
     virtual std::shared_ptr<BasicBlock> getBlock();
@@ -1008,6 +1048,39 @@ public:
     virtual InstType getInstType() const override;
 };
 
+// cond ? trueValue : falseValue, computed without branching
+class SelectInst : public Inst
+{
+private:
+    std::shared_ptr<Inst> m_target, m_cond, m_trueValue, m_falseValue;
+    std::vector<std::shared_ptr<Inst>> m_users, m_operands;
+    std::shared_ptr<BasicBlock> m_block;
+
+public:
+    SelectInst(std::shared_ptr<Inst> target, std::shared_ptr<Inst> cond,
+               std::shared_ptr<Inst> trueValue, std::shared_ptr<Inst> falseValue,
+               std::shared_ptr<BasicBlock> block);
+
+    virtual ~SelectInst() = default;
+    SelectInst(const SelectInst&) = delete;
+    SelectInst(SelectInst&&) noexcept = default;
+    SelectInst& operator=(const SelectInst&) = delete;
+    SelectInst& operator=(SelectInst&&) noexcept = default;
+
+    std::shared_ptr<Inst> getTarget() override;
+    std::shared_ptr<Inst> getCond();
+    std::shared_ptr<Inst> getTrueValue();
+    std::shared_ptr<Inst> getFalseValue();
+
+    virtual std::string getString() override;
+    virtual void push_user(std::shared_ptr<Inst> user) override;
+    virtual void setup_def_use();
+    virtual std::vector<std::shared_ptr<Inst>>& getOperands() override;
+    virtual void setTarget(std::shared_ptr<Inst> target);
+    virtual std::shared_ptr<BasicBlock> getBlock() override;
+    virtual InstType getInstType() const override;
+};
+
 class HaltInst : public Inst
 {
 private:
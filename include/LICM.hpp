@@ -0,0 +1,34 @@
+#pragma once
+
+#include "PassManager.hpp"
+
+#include <string>
+
+namespace mina
+{
+
+/**
+ * @brief Loop-invariant code motion.
+ *
+ * An instruction is invariant when each of its operands is a constant, is
+ * defined outside of the loop or is itself invariant. Invariant pure
+ * instructions are moved to the preheader of the loop, which is created when
+ * the loop doesn't have one. Loops are handled innermost first, so code
+ * hoisted into the preheader of an inner loop can leave the outer loop as
+ * well.
+ *
+ * Arithmetic, logic, comparisons and copies can't fail and are always
+ * hoisted. Divisions and array loads are only hoisted from blocks that run
+ * on every iteration, so they never execute when the original program
+ * wouldn't have executed them. A load is only invariant if it reads an array
+ * version defined outside the loop, which means the loop doesn't store to
+ * that array.
+ */
+class LICMPass : public FunctionPass
+{
+public:
+    std::string getName() const override;
+    bool run(SSA& ssa) override;
+};
+
+}  // namespace mina
@@ -0,0 +1,125 @@
+#pragma once
+
+#include "Dominators.hpp"
+
+#include <memory>
+#include <vector>
+#include <unordered_map>
+
+namespace mina
+{
+
+class SSA;
+class BasicBlock;
+class BasicBlockMIR;
+
+/**
+ * @brief A natural loop: a header plus every block that can reach one of the
+ * back edges into the header without going through the header.
+ *
+ * Loops sharing a header are merged into one loop, so each header identifies
+ * exactly one loop. The blocks of a loop include the blocks of its subloops
+ * and are kept in reverse post-order, so the header is always first.
+ */
+template <typename BlockT>
+class LoopBase
+{
+public:
+    using BlockPtr = std::shared_ptr<BlockT>;
+
+    LoopBase(BlockPtr header);
+
+    BlockPtr getHeader() const;
+    LoopBase* getParentLoop() const;
+    const std::vector<LoopBase*>& getSubLoops() const;
+    const std::vector<BlockPtr>& getBlocks() const;
+    bool contains(const BlockPtr& block) const;
+    bool contains(const LoopBase* loop) const;
+
+    // Top level loops have depth 1
+    unsigned int getLoopDepth() const;
+
+    // Blocks inside the loop with a back edge to the header
+    const std::vector<BlockPtr>& getLatches() const;
+
+    // Blocks inside the loop with a successor outside of it
+    std::vector<BlockPtr> getExitingBlocks() const;
+
+    // Blocks outside the loop with a predecessor inside of it
+    std::vector<BlockPtr> getExitBlocks() const;
+
+    // Predecessors of the header that are outside of the loop
+    std::vector<BlockPtr> getOutsidePredecessors() const;
+
+    // The only predecessor outside of the loop if it falls straight into the
+    // header, nullptr otherwise
+    BlockPtr getPreheader() const;
+
+private:
+    template <typename>
+    friend class LoopForestBase;
+
+    BlockPtr m_header;
+    LoopBase* m_parent;
+    std::vector<LoopBase*> m_subLoops;
+    std::vector<BlockPtr> m_blocks;
+    std::vector<BlockPtr> m_latches;
+    std::unordered_map<BlockT*, bool> m_blockSet;
+};
+
+/**
+ * @brief Every natural loop of a function, arranged by nesting.
+ *
+ * Back edges are the edges whose target dominates their source. Headers are
+ * visited in post-order of the dominator tree, so inner loops are discovered
+ * before the loops containing them, then the body of each loop is found by
+ * walking predecessors backwards from its latches. Irreducible cycles have no
+ * dominating header and are not reported as loops.
+ */
+template <typename BlockT>
+class LoopForestBase
+{
+public:
+    using BlockPtr = std::shared_ptr<BlockT>;
+    using LoopT = LoopBase<BlockT>;
+
+    LoopForestBase(const DominatorTreeBase<BlockT>& domTree);
+
+    // Outermost loops in program order
+    const std::vector<LoopT*>& getTopLevelLoops() const;
+
+    // Every loop, inner loops before the loops containing them
+    std::vector<LoopT*> getLoopsInnermostFirst() const;
+
+    // Innermost loop containing the block, nullptr if it is not in a loop
+    LoopT* getLoopFor(const BlockPtr& block) const;
+    unsigned int getLoopDepth(const BlockPtr& block) const;
+    bool isLoopHeader(const BlockPtr& block) const;
+
+    void print() const;
+
+private:
+    std::vector<std::unique_ptr<LoopT>> m_loops;
+    std::vector<LoopT*> m_topLevelLoops;
+    std::unordered_map<BlockT*, LoopT*> m_blockToLoop;
+};
+
+using Loop = LoopBase<BasicBlock>;
+using LoopForest = LoopForestBase<BasicBlock>;
+using LoopMIR = LoopBase<BasicBlockMIR>;
+using LoopForestMIR = LoopForestBase<BasicBlockMIR>;
+
+// Makes sure the loop has a preheader and returns it. When the header has
+// several predecessors outside of the loop, or the only one also branches
+// somewhere else, a new block is placed in front of the header and the phis
+// of the header are split accordingly. The dominator tree and loop forest
+// are not updated, call ssa.invalidateCFGAnalyses() once done.
+std::shared_ptr<BasicBlock> insertPreheader(SSA& ssa, const Loop& loop);
+
+// Gives every exit block that is also reached from outside of the loop a new
+// block of its own, which takes over the edges leaving the loop. Returns
+// true if any block was added. Like insertPreheader, the analyses have to be
+// invalidated afterwards.
+bool insertDedicatedExits(SSA& ssa, const Loop& loop);
+
+}  // namespace mina
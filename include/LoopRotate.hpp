@@ -0,0 +1,32 @@
+#pragma once
+
+#include "PassManager.hpp"
+
+#include <string>
+
+namespace mina
+{
+
+/**
+ * @brief Rotation of loops testing their exit at the top.
+ *
+ * A loop whose header falls into a short chain of blocks ending with the
+ * exit test, and whose latch jumps back to the header, costs a conditional
+ * branch and a jump per iteration. The chain is copied into the preheader,
+ * where it guards the entry into the loop, and into the latch, which then
+ * branches straight back to the first block of the body. The body becomes
+ * the header of the loop and merges the values of the two copies with phis,
+ * as does the exit for the values used after the loop.
+ *
+ * The chain is copied twice, so it is limited to a few instructions. Run
+ * loop-simplify afterwards, the preheader now branches to the loop and to
+ * its exit.
+ */
+class LoopRotatePass : public FunctionPass
+{
+public:
+    std::string getName() const override;
+    bool run(SSA& ssa) override;
+};
+
+}  // namespace mina
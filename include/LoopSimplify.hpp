@@ -0,0 +1,30 @@
+#pragma once
+
+#include "PassManager.hpp"
+
+#include <string>
+
+namespace mina
+{
+
+/**
+ * @brief Puts loops into the normal form the loop passes expect.
+ *
+ * Every loop gets a preheader, and every exit block of a loop is only
+ * reached from inside of it, so code can be placed on entry to and on exit
+ * from a loop without running on other paths. Loops are rebuilt after each
+ * new block since it changes the loops around it.
+ *
+ * Critical edges, from a block with several successors to a block with
+ * several predecessors, are split afterwards so each edge has a block of its
+ * own to place copies in. Back edges are left alone: splitting them would
+ * give rotated loops their jump back.
+ */
+class LoopSimplifyPass : public FunctionPass
+{
+public:
+    std::string getName() const override;
+    bool run(SSA& ssa) override;
+};
+
+}  // namespace mina
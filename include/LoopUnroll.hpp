@@ -0,0 +1,40 @@
+#pragma once
+
+#include "PassManager.hpp"
+
+#include <string>
+
+namespace mina
+{
+
+/**
+ * @brief Unrolling of innermost loops with a constant trip count.
+ *
+ * The trip count is found from the only branch leaving the loop: it has to
+ * compare an affine function of a basic induction variable that starts at a
+ * constant against a constant, so the branch can be evaluated iteration by
+ * iteration until it leaves the loop.
+ *
+ * Loops whose unrolled size stays within a small budget are unrolled fully:
+ * the body is copied once per iteration, the copies are chained and the
+ * loop disappears. Otherwise a loop that tests its exit at the latch, like
+ * repeat ... until, is unrolled by a factor of 2, 4 or 8 picked from the
+ * size of its body. Only the last copy keeps the exit test, and the
+ * iterations left over by the factor are peeled in front of the loop.
+ *
+ * Every copy gets fresh SSA names and the phis of the header are resolved
+ * to the value flowing in from the previous copy, so no variable has to go
+ * through SSA construction again. Uses after the loop are redirected to the
+ * values of the last copy.
+ *
+ * This runs after strength reduction, so the copies step the reduced
+ * variables instead of each deriving its own offsets from them.
+ */
+class LoopUnrollPass : public FunctionPass
+{
+public:
+    std::string getName() const override;
+    bool run(SSA& ssa) override;
+};
+
+}  // namespace mina
@@ -40,9 +40,11 @@ enum class MIRType
     Setg,
     Setge,
     Movzx,
+    Cmov,
     Test,
     Jz,
     Jnz,
+    Jae,
     Ret
 };
 
@@ -210,17 +212,28 @@ public:
     ~LeaMIR() override = default;
 };
 
+// A tail call ends its block, CodeGen tears the frame down before it and
+// jumps to the callee, which returns to our caller.
+// A call clobbers every caller-saved register unless told which ones the
+// callee writes, which CodeGen knows for the routines it already allocated.
 class CallMIR : public MachineIR
 {
     std::string m_calleeName;
     unsigned int m_numArgs;
+    bool m_isTailCall;
+    std::set<int> m_clobberedRegs;
 
 public:
-    CallMIR(std::string calleeName, unsigned int numArgs);
+    CallMIR(std::string calleeName, unsigned int numArgs,
+            bool isTailCall = false);
     MIRType getMIRType() const override;
     std::string getString() const override;
 
     unsigned int getNumArgs() const;
+    bool isTailCall() const;
+
+    const std::set<int>& getClobberedRegs() const;
+    void setClobberedRegs(std::set<int> regs);
 };
 
 class AddMIR : public MachineIR
@@ -260,8 +273,15 @@ class DivMIR : public MachineIR
 {
     std::shared_ptr<MemoryMIR> m_divisor; // in a / b, b is divisor
 
+    // div instead of idiv, on the low 32 bits of the divisor when narrow
+    bool m_isUnsigned;
+    bool m_isNarrow;
+
 public:
-    DivMIR(std::shared_ptr<MemoryMIR> divisor);
+    DivMIR(std::shared_ptr<MemoryMIR> divisor, bool isUnsigned = false,
+           bool isNarrow = false);
+    bool isUnsigned() const { return m_isUnsigned; }
+    bool isNarrow() const { return m_isNarrow; }
     MIRType getMIRType() const override;
     std::string getString() const override;
     std::vector<std::shared_ptr<MachineIR>>& getOperands() override;
@@ -405,6 +425,21 @@ public:
     bool isFromRegLow() const;
 };
 
+// Moves the source into the destination register when the flags meet the
+// condition, the suffix of the matching setcc ("l" for cmovl)
+class CmovMIR : public MachineIR
+{
+    std::vector<std::shared_ptr<MachineIR>> m_operands;
+    std::string m_condition;
+
+public:
+    CmovMIR(std::vector<std::shared_ptr<MachineIR>> operands, std::string condition);
+    const std::string& getCondition() const { return m_condition; }
+    MIRType getMIRType() const override;
+    std::string getString() const override;
+    std::vector<std::shared_ptr<MachineIR>>& getOperands() override;
+};
+
 class TestMIR: public MachineIR
 {
     std::shared_ptr<Register> m_reg1;
@@ -450,6 +485,18 @@ public:
     std::string getTargetLabel() const;
 };
 
+// Unsigned above or equal, leaves the block for a label that never returns
+class JaeMIR : public MachineIR
+{
+    std::string m_targetLabel;
+
+public:
+    JaeMIR(std::string targetLabel);
+    MIRType getMIRType() const override;
+    std::string getString() const override;
+    std::string getTargetLabel() const;
+};
+
 class RetMIR : public MachineIR
 {
 public:
@@ -482,4 +529,13 @@ constexpr auto to_int(T e) noexcept
 const std::array<std::shared_ptr<Register>, to_int(RegID::COUNT)>& getAllRegisters();
 const std::shared_ptr<Register>& getReg(RegID id);
 
+// Registers a routine may change without restoring them: RAX, RCX, RDX, R8,
+// R9, R10 and R11
+std::set<int> getCallerSavedRegs();
+
+// Caller-saved registers the allocated blocks of a routine may change,
+// including through the routines they call
+std::set<int> getClobberedRegs(
+    const std::vector<std::shared_ptr<BasicBlockMIR>>& blocks);
+
 }; // namespace mina
@@ -0,0 +1,118 @@
+#pragma once
+
+#include "DisjointSetUnion.hpp"
+#include "SSA.hpp"
+
+#include <memory>
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+namespace mina
+{
+
+class Inst;
+class BasicBlock;
+
+/**
+ * @brief Translates a routine out of SSA form and coalesces the copies its
+ * phis turn into.
+ *
+ * Every phi is first isolated with parallel copies, as in Sreedhar's Method
+ * I. Each predecessor copies its operand into a fresh name at its end. The
+ * phi merges those names, and its result is copied into the original name
+ * at the head of the block. The phi and its fresh names form a phi web, and
+ * the names in a web never interfere.
+ *
+ * The copies are then coalesced, innermost loops first, in the style of
+ * Boissinot et al. A copy merges the webs of its two sides unless they
+ * interfere. Two names interfere when one is live where the other is
+ * defined and they hold different values, so a copy may share a name with
+ * the value it copies. Every web ends up with a single name, a parameter's
+ * if it holds one, and the copies inside a web disappear. The parallel
+ * copies that are left are sequentialized, breaking cycles with a temporary.
+ *
+ * CodeGen writes the result into a register before reading the second
+ * operand of an instruction, so only the first operand may share a name
+ * with the result. Arrays keep their names, CodeGen finds the stack slot of
+ * an array by following the copies of its name.
+ */
+class OutOfSSA
+{
+public:
+    OutOfSSA(SSA& ssa);
+
+    void run();
+
+private:
+    // What the instruction at a position of a block reads and writes.
+    // Reads in usesAfter happen once the result is written.
+    struct Slot
+    {
+        std::vector<int> uses;
+        std::vector<int> usesAfter;
+        std::vector<int> defs;
+    };
+
+    // A copy of a parallel copy. The source is a name, or a constant when
+    // src is -1.
+    struct Copy
+    {
+        int dest;
+        int src;
+        std::shared_ptr<Inst> constant;
+    };
+
+    SSA& m_ssa;
+    std::vector<std::shared_ptr<BasicBlock>> m_blocks;
+    std::unordered_map<BasicBlock*, int> m_blockIndex;
+
+    // Names by id, with the position defining them. Names defined more than
+    // once or not at all are never coalesced.
+    std::vector<std::string> m_names;
+    std::unordered_map<std::string, int> m_ids;
+    std::vector<int> m_defCount, m_defBlock, m_defSlot;
+
+    // The name a copy defining the name reads, -1 for other definitions
+    std::vector<int> m_copyOf;
+    std::vector<bool> m_isArray, m_isParam;
+
+    // Copies at the head and before the terminator of every block, and the
+    // phi results the head copies read
+    std::vector<std::vector<Copy>> m_headCopies, m_tailCopies;
+    std::vector<std::vector<int>> m_phiResults;
+
+    // Webs found so far, over the ids of the names. The members of the webs
+    // with more than one name are kept by their root.
+    DisjointSetUnion m_webs;
+    std::unordered_map<int, std::vector<int>> m_members;
+
+    std::vector<std::vector<Slot>> m_slots;
+    std::vector<std::vector<char>> m_liveOut;
+
+    // Positions reading every name in a block, twice the slot for reads
+    // before its result is written and one more for reads after
+    std::vector<std::unordered_map<int, std::vector<int>>> m_usePositions;
+
+    int getId(const std::string& name) const;
+    int addName(const std::string& name);
+    void collectNames();
+    void isolatePhis();
+    void buildSlots();
+    void computeLiveness();
+    void coalesce();
+    void rewrite();
+
+    int getValue(int id);
+    bool isLiveAfter(int id, int block, int slot);
+    bool interfere(int a, int b);
+    bool websInterfere(const std::vector<int>& a, const std::vector<int>& b);
+    void mergeWebs(int a, int b);
+
+    std::vector<std::shared_ptr<Inst>> sequentialize(
+        const std::vector<Copy>& copies,
+        const std::vector<std::string>& names,
+        const std::shared_ptr<BasicBlock>& block);
+};
+
+}  // namespace mina
@@ -0,0 +1,33 @@
+#pragma once
+
+#include "PassManager.hpp"
+
+#include <string>
+
+namespace mina
+{
+
+/**
+ * @brief Partial redundancy elimination at join points.
+ *
+ * An expression computed in a join block is partially redundant when some
+ * predecessors already compute it on the way in. Its operands are translated
+ * through the phis of the join into the values each predecessor passes, and
+ * a predecessor has the expression available when a block dominating it
+ * computes the translated expression.
+ *
+ * The expression is inserted at the end of the predecessors missing it and
+ * replaced by a phi merging the values of all of them. Insertion is limited
+ * to predecessors whose only successor is the join, so no path computes the
+ * expression more often than before while the paths through the other
+ * predecessors skip it. Divisions and array loads are left in place.
+ */
+class PREPass : public FunctionPass
+{
+public:
+    std::string getName() const override;
+    bool run(SSA& ssa) override;
+    bool preservesCFG() const override { return true; }
+};
+
+}  // namespace mina
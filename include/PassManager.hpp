@@ -0,0 +1,136 @@
+#pragma once
+
+#include "SSA.hpp"
+
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace mina
+{
+
+// Options of the whole compilation, filled from the command line
+struct CompilerOptions
+{
+    int optLevel = 0;
+
+    // -f<pass> and -fno-<pass> override the optimization level for one pass
+    std::map<std::string, bool> passOverrides;
+
+    bool timePasses = false;
+    bool printAfterAll = false;
+    bool verifyEach = false;
+};
+
+CompilerOptions& getCompilerOptions();
+
+// Returns false if the argument is not a compiler option, or -f<pass> and
+// -fno-<pass> name neither a pass of the default pipeline nor an option of
+// CodeGen
+bool parseCompilerOption(const std::string& arg);
+
+class FunctionPass
+{
+public:
+    virtual ~FunctionPass() = default;
+
+    virtual std::string getName() const = 0;
+
+    // Returns true if the function was changed
+    virtual bool run(SSA& ssa) = 0;
+
+    // The dominator trees and the loop forest cached in SSA only depend on
+    // the shape of the CFG. Passes that don't add, remove or redirect blocks
+    // keep them valid, every other pass invalidates them when it changes the
+    // function.
+    virtual bool preservesCFG() const { return false; }
+};
+
+// A pass over main and every function at once, for transformations that
+// move values across calls
+class ModulePass
+{
+public:
+    virtual ~ModulePass() = default;
+
+    virtual std::string getName() const = 0;
+
+    // Returns true if any routine was changed. Routines may be added to
+    // functions but main keeps its SSA graph.
+    virtual bool run(SSA& mainSSA, std::map<std::string, SSA>& functions) = 0;
+};
+
+// Number of instructions reachable from the entry of the function
+size_t countInstructions(SSA& ssa);
+
+// Checks that the CFG edges agree with the terminators, that phis have one
+// operand per predecessor and that every operand is defined in the function.
+// Throws std::runtime_error when they don't.
+void verifyFunction(SSA& ssa, const std::string& funcName);
+
+/**
+ * @brief Runs the optimization pipeline over every function.
+ *
+ * A pass is registered with the lowest optimization level it runs at, which
+ * the -f<pass>/-fno-<pass> flags can override. Function passes run over one
+ * routine at a time, module passes over the whole program once the function
+ * passes have cleaned every routine up. Passes that are never on by
+ * default are registered with OptInOnly and only run when asked for.
+ *
+ * With -time-passes the wall time and the change in instruction count of
+ * every pass are accumulated over all functions and reported on stderr.
+ */
+class PassManager
+{
+public:
+    static constexpr int OptInOnly = 100;
+
+    PassManager(const CompilerOptions& options);
+
+    void addPass(std::unique_ptr<FunctionPass> pass, int minOptLevel);
+    void addModulePass(std::unique_ptr<ModulePass> pass, int minOptLevel);
+
+    // Registers the passes of the default pipeline. The inliner copies the
+    // bodies of the callees from functions.
+    void addDefaultPipeline(std::map<std::string, SSA>& functions);
+
+    bool hasPass(const std::string& passName) const;
+    bool isEnabled(const std::string& passName, int minOptLevel) const;
+
+    // Returns true if any pass changed the function
+    bool run(SSA& ssa, const std::string& funcName);
+
+    // Returns true if any module pass changed the program
+    bool runModulePasses(SSA& mainSSA, std::map<std::string, SSA>& functions);
+
+    void printTimingReport() const;
+
+private:
+    struct PassEntry
+    {
+        std::unique_ptr<FunctionPass> pass;
+        int minOptLevel;
+    };
+
+    struct ModulePassEntry
+    {
+        std::unique_ptr<ModulePass> pass;
+        int minOptLevel;
+    };
+
+    struct PassStats
+    {
+        double milliseconds = 0;
+        long long instDelta = 0;
+        int runs = 0;
+        int changed = 0;
+    };
+
+    const CompilerOptions& m_options;
+    std::vector<PassEntry> m_passes;
+    std::vector<ModulePassEntry> m_modulePasses;
+    std::map<std::string, PassStats> m_stats;
+};
+
+}  // namespace mina
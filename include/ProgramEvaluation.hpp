@@ -0,0 +1,30 @@
+#pragma once
+
+#include "PassManager.hpp"
+
+#include <map>
+#include <string>
+
+namespace mina
+{
+
+/**
+ * @brief Runs programs that never read input at compile time.
+ *
+ * Main is run by the IREvaluator under a step budget. If it ends or halts
+ * within the budget without reaching a get, its output is known, and main
+ * is replaced with a single put of that text, written by one printf call.
+ * The routines it called are left for the dead function removal in
+ * CodeGen.
+ *
+ * Programs printing a string literal with a % or an escape in it, and those
+ * printing more than fits a reasonable literal, are left alone.
+ */
+class ProgramEvaluationPass : public ModulePass
+{
+public:
+    std::string getName() const override;
+    bool run(SSA& mainSSA, std::map<std::string, SSA>& functions) override;
+};
+
+}  // namespace mina
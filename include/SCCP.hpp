@@ -0,0 +1,32 @@
+#pragma once
+
+#include "PassManager.hpp"
+
+#include <string>
+
+namespace mina
+{
+
+/**
+ * @brief Sparse conditional constant propagation.
+ *
+ * Implements the algorithm from Wegman and Zadeck, "Constant Propagation
+ * with Conditional Branches". Every SSA value starts out undefined and can
+ * only move down to a constant and then to overdefined. CFG edges are only
+ * followed once they are found executable, so a phi ignores the values
+ * flowing in over edges that are never taken, and a branch on a constant
+ * only makes one of its successors executable.
+ *
+ * Once the solver is done, uses of constant values are replaced by the
+ * constants, the instructions computing them are deleted, branches on
+ * constants become jumps and blocks that were never reached are removed
+ * from the CFG.
+ */
+class SCCPPass : public FunctionPass
+{
+public:
+    std::string getName() const override;
+    bool run(SSA& ssa) override;
+};
+
+}  // namespace mina
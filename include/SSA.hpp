@@ -1,6 +1,8 @@
 #pragma once
 
 #include "BasicBlock.hpp"
+#include "Dominators.hpp"
+#include "LoopInfo.hpp"
 #include "InstIR.hpp"
 
 #include <string>
@@ -25,6 +27,10 @@ public:
     void printCFG();
     std::string getBaseName(std::string name);
 
+    // Name for a value created by an optimization. The counter belongs to the
+    // function, so the names do not depend on what was compiled before it.
+    std::string makeFreshName(const std::string& name);
+
     std::string& getCurrBBNameWithoutCtr();
     void incCurrBBCtr();
     int getCurrBBCtr() const;
@@ -45,17 +51,29 @@ public:
     std::shared_ptr<Inst> tryRemoveTrivialPhi(std::shared_ptr<PhiInst> phi);
     void sealBlock(std::shared_ptr<BasicBlock> block);
     
+    // Leaves SSA form, replacing the phis with copies, see OutOfSSA
     void renameSSA();
 
+    // CFG analyses are computed on first use and cached. Anything that adds,
+    // removes or redirects blocks must call invalidateCFGAnalyses().
+    std::shared_ptr<DominatorTree> getDominatorTree();
+    std::shared_ptr<DominatorTree> getPostDominatorTree();
+    std::shared_ptr<LoopForest> getLoopForest();
+    void invalidateCFGAnalyses();
+
 private:
     std::string m_currBBNameWithoutCtr;
     int m_currBBCtr;
     std::shared_ptr<BasicBlock> m_cfg, m_currentBB;
     std::unordered_map<std::string, int> m_nameCtr;
+    int m_freshCtr;
 
     std::unordered_set<std::shared_ptr<BasicBlock>> m_sealedBlocks;
     std::unordered_map<std::shared_ptr<BasicBlock>, subMap> m_currDef;
     std::unordered_map<std::shared_ptr<BasicBlock>, subPhi> m_incompletePhis;
+
+    std::shared_ptr<DominatorTree> m_domTree, m_postDomTree;
+    std::shared_ptr<LoopForest> m_loopForest;
 };
 
 }  // namespace mina
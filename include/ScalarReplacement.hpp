@@ -0,0 +1,33 @@
+#pragma once
+
+#include "PassManager.hpp"
+
+#include <string>
+
+namespace mina
+{
+
+/**
+ * @brief Scalar replacement of small arrays only indexed by constants.
+ *
+ * An array qualifies when it has at most a few elements and every load and
+ * store of every version of it uses a constant index within its bounds. Its
+ * elements then become independent values: a store replaces the value of
+ * one element, a load is replaced by the value the element holds, and every
+ * phi of the array turns into a phi per element. The array and its stack
+ * slot disappear, so the register allocator can keep the elements in
+ * registers. Elements that are read before any store get zero, or false for
+ * a boolean array.
+ *
+ * This runs after unrolling, whose copies index with constants where the
+ * loop indexed with its induction variable.
+ */
+class ScalarReplacementPass : public FunctionPass
+{
+public:
+    std::string getName() const override;
+    bool run(SSA& ssa) override;
+    bool preservesCFG() const override { return true; }
+};
+
+}  // namespace mina
@@ -0,0 +1,36 @@
+#pragma once
+
+#include "PassManager.hpp"
+
+#include <string>
+
+namespace mina
+{
+
+/**
+ * @brief Strength reduction of induction variables.
+ *
+ * A multiplication whose result is an affine function of a basic induction
+ * variable is replaced by a new header phi that starts at the value of the
+ * function on entry and is increased by scale * step on every iteration, so
+ * the loop adds instead of multiplying. Array indices that are induction
+ * variables get the same treatment with the scale multiplied by the element
+ * size: the access then uses a byte offset that is bumped every iteration
+ * instead of scaling the index at each access.
+ *
+ * Afterwards a basic induction variable that is only left to compute its own
+ * next value and the equality test ending the loop has that test rewritten
+ * against one of the new variables (linear function test replacement), which
+ * lets dead code elimination remove it.
+ *
+ * Loops need a preheader and a single latch, so this runs after LICM.
+ */
+class StrengthReductionPass : public FunctionPass
+{
+public:
+    std::string getName() const override;
+    bool run(SSA& ssa) override;
+    bool preservesCFG() const override { return true; }
+};
+
+}  // namespace mina
@@ -0,0 +1,33 @@
+#pragma once
+
+#include "PassManager.hpp"
+
+#include <string>
+
+namespace mina
+{
+
+/**
+ * @brief Turns recursive calls in tail position into a loop.
+ *
+ * A call of the routine to itself whose result is returned right away, or
+ * which ends a procedure, doesn't need a frame of its own. The body of the
+ * entry block moves to a new header, which merges the parameters with phis,
+ * and every such call becomes a jump back to it that feeds the arguments to
+ * the phis.
+ *
+ * A return found after a merge, like x := f(n - 1) in one arm of an if
+ * followed by return x, is copied into the arm first so the call ends up
+ * right before it.
+ *
+ * Tail calls to other routines are left to CodeGen, which turns them into
+ * jumps reusing the frame of the caller.
+ */
+class TailRecursionPass : public FunctionPass
+{
+public:
+    std::string getName() const override;
+    bool run(SSA& ssa) override;
+};
+
+}  // namespace mina
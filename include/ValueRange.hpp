@@ -0,0 +1,139 @@
+#pragma once
+
+#include "Dominators.hpp"
+#include "PassManager.hpp"
+
+#include <memory>
+#include <string>
+#include <vector>
+#include <limits>
+#include <unordered_map>
+
+namespace mina
+{
+
+class SSA;
+class Inst;
+class BasicBlock;
+
+// The integers lo to hi, both included. Empty when lo > hi, which is the
+// range of a value not computed yet or on a path that can't be taken.
+struct ValueRange
+{
+    long long lo = std::numeric_limits<long long>::max();
+    long long hi = std::numeric_limits<long long>::min();
+
+    static ValueRange full()
+    {
+        return {std::numeric_limits<long long>::min(),
+                std::numeric_limits<long long>::max()};
+    }
+    static ValueRange exact(long long value) { return {value, value}; }
+
+    bool isEmpty() const { return lo > hi; }
+    bool isExact() const { return lo == hi; }
+    bool operator==(const ValueRange& other) const
+    {
+        return (isEmpty() && other.isEmpty()) ||
+               (lo == other.lo && hi == other.hi);
+    }
+    bool operator!=(const ValueRange& other) const { return !(*this == other); }
+};
+
+/**
+ * @brief Ranges of the integer and boolean values of a function.
+ *
+ * Every value gets an interval of 64-bit integers, booleans being 0 or 1.
+ * Arithmetic whose result may wrap around gives the full range. The ranges
+ * are computed by sweeping the blocks in reverse post-order until nothing
+ * changes. Phis that keep growing are widened to the next constant of the
+ * function, or one past it, and finally to infinity, then a few more sweeps
+ * refine the widened ranges.
+ *
+ * Where a value is used, its range is narrowed by the comparisons of the
+ * conditional branches leading there: a block with a single predecessor
+ * ending in BRT or BRF knows the outcome of the condition, and so do the
+ * blocks it dominates. Operands of phis are narrowed by the condition on
+ * the edge they flow in from.
+ *
+ * A basic induction variable stepping by a small constant is assumed never
+ * to wrap around, it would take more iterations than any program runs, so
+ * it stays on the side of its initial value. The induction variables of a
+ * loop all step once per iteration, so the range of one of them bounds the
+ * others, like the byte offsets strength reduction makes from the counter.
+ */
+class ValueRangeAnalysis
+{
+public:
+    ValueRangeAnalysis(SSA& ssa);
+
+    // Range of the operand anywhere in the block
+    ValueRange getRange(const std::shared_ptr<Inst>& operand,
+                        const std::shared_ptr<BasicBlock>& block) const;
+
+private:
+    // A phi of a loop header counting from init by step
+    struct InductionVariable
+    {
+        std::shared_ptr<Inst> init;
+        std::shared_ptr<BasicBlock> preheader;
+        long long step;
+    };
+
+    std::shared_ptr<DominatorTree> m_domTree;
+    std::vector<std::shared_ptr<BasicBlock>> m_blocks;
+    std::unordered_map<std::string, std::shared_ptr<Inst>> m_defs;
+    std::unordered_map<std::string, std::shared_ptr<BasicBlock>> m_defBlocks;
+    std::unordered_map<std::string, InductionVariable> m_inductionVariables;
+    std::unordered_map<std::string, ValueRange> m_ranges;
+    std::unordered_map<std::string, unsigned int> m_phiUpdates;
+
+    // Bounds phis are widened to, sorted
+    std::vector<long long> m_thresholds;
+
+    // Range of the operand wherever it is defined
+    ValueRange getBaseRange(const std::shared_ptr<Inst>& operand) const;
+
+    // Range of the operand in the block given the branches leading there
+    ValueRange getRefinedRange(const std::shared_ptr<Inst>& operand,
+                               const std::shared_ptr<BasicBlock>& block) const;
+
+    // Range of the induction variable in the block from the number of
+    // iterations the others of its loop allow there
+    ValueRange getLockstepRange(const std::string& name,
+                                const std::shared_ptr<BasicBlock>& block) const;
+
+    // Narrows the range of name given that cond is isTrue
+    void refine(ValueRange& range, const std::string& name,
+                const std::shared_ptr<Inst>& cond, bool isTrue,
+                unsigned int depth) const;
+    void refineOnEdge(ValueRange& range, const std::string& name,
+                      const std::shared_ptr<BasicBlock>& from,
+                      const std::shared_ptr<BasicBlock>& to) const;
+
+    ValueRange evaluate(const std::shared_ptr<Inst>& inst,
+                        const std::shared_ptr<BasicBlock>& block) const;
+    ValueRange evaluatePhi(const std::shared_ptr<Inst>& phi,
+                           const std::shared_ptr<BasicBlock>& block) const;
+    ValueRange widen(const ValueRange& old, const ValueRange& range) const;
+    bool sweep(bool isNarrowing);
+};
+
+/**
+ * @brief Uses the value ranges to simplify the function.
+ *
+ * Comparisons and boolean operations with a known outcome are folded to
+ * constants and branches on them become jumps. Divisions of a non-negative
+ * dividend by a positive divisor are marked unsigned, so CodeGen clears rdx
+ * instead of sign extending rax into it and uses div, which is also done on
+ * 32 bits when both operands fit.
+ */
+class ValueRangePass : public FunctionPass
+{
+public:
+    std::string getName() const override;
+    bool run(SSA& ssa) override;
+    bool preservesCFG() const override { return false; }
+};
+
+}  // namespace mina
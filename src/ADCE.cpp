@@ -0,0 +1,253 @@
+#include "ADCE.hpp"
+#include "BasicBlock.hpp"
+#include "Dominators.hpp"
+#include "IRUtils.hpp"
+#include "LoopInfo.hpp"
+#include "InstIR.hpp"
+#include "SSA.hpp"
+
+#include <memory>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace mina
+{
+
+namespace
+{
+
+// Instructions whose effect is visible outside of the function
+bool isRoot(const std::shared_ptr<Inst>& inst)
+{
+    switch (inst->getInstType())
+    {
+        case InstType::Put:
+        case InstType::Get:
+        case InstType::FuncCall:
+        case InstType::ProcCall:
+        case InstType::Return:
+        case InstType::Halt:
+        case InstType::ArrUpdate:
+        case InstType::Func:
+        case InstType::LowerFunc:
+            return true;
+        default:
+            return false;
+    }
+}
+
+bool isConditionalBranch(const std::shared_ptr<Inst>& inst)
+{
+    return inst && (inst->getInstType() == InstType::BRT ||
+                    inst->getInstType() == InstType::BRF);
+}
+
+}  // namespace
+
+std::string ADCEPass::getName() const { return "adce"; }
+
+bool ADCEPass::run(SSA& ssa)
+{
+    auto blocks = getRPONodes(ssa.getCFG());
+    auto postDomTree = ssa.getPostDominatorTree();
+    auto loopForest = ssa.getLoopForest();
+
+    std::unordered_map<std::string, std::shared_ptr<Inst>> definitions;
+    std::unordered_map<Inst*, std::shared_ptr<BasicBlock>> instBlock;
+    for (auto& block : blocks)
+    {
+        for (auto& inst : block->getInstructions())
+        {
+            instBlock[inst.get()] = block;
+            auto name = getDefinedName(inst);
+            if (!name.empty())
+            {
+                definitions[name] = inst;
+            }
+        }
+    }
+
+    std::unordered_set<Inst*> liveInsts;
+    std::unordered_set<BasicBlock*> liveBlocks;
+    std::vector<std::shared_ptr<Inst>> instWorklist;
+    std::vector<std::shared_ptr<BasicBlock>> blockWorklist;
+
+    auto markLive = [&](const std::shared_ptr<Inst>& inst)
+    {
+        if (liveInsts.insert(inst.get()).second)
+        {
+            instWorklist.push_back(inst);
+        }
+    };
+    auto markBlockLive = [&](const std::shared_ptr<BasicBlock>& block)
+    {
+        if (liveBlocks.insert(block.get()).second)
+        {
+            blockWorklist.push_back(block);
+        }
+    };
+
+    for (auto& block : blocks)
+    {
+        for (auto& inst : block->getInstructions())
+        {
+            if (isRoot(inst))
+            {
+                markLive(inst);
+            }
+        }
+    }
+
+    // Deleting the exit test of a loop would turn a loop that never ends
+    // into one that does
+    for (auto loop : loopForest->getLoopsInnermostFirst())
+    {
+        for (auto& exiting : loop->getExitingBlocks())
+        {
+            auto terminator = exiting->getTerminator();
+            if (isConditionalBranch(terminator))
+            {
+                markLive(terminator);
+            }
+        }
+    }
+
+    while (!instWorklist.empty() || !blockWorklist.empty())
+    {
+        while (!instWorklist.empty())
+        {
+            auto inst = instWorklist.back();
+            instWorklist.pop_back();
+            markBlockLive(instBlock[inst.get()]);
+
+            for (auto& operand : inst->getOperands())
+            {
+                auto it = definitions.find(getValueName(operand));
+                if (it != definitions.end())
+                {
+                    markLive(it->second);
+                }
+            }
+
+            if (inst->isPhi())
+            {
+                auto phi = std::dynamic_pointer_cast<PhiInst>(inst);
+                for (unsigned int i = 0; i < phi->getOperands().size(); ++i)
+                {
+                    markBlockLive(phi->getOperandBB(i));
+                }
+            }
+        }
+
+        // A live block needs the branches that decide whether it runs
+        while (!blockWorklist.empty())
+        {
+            auto block = blockWorklist.back();
+            blockWorklist.pop_back();
+            for (auto& controlling : postDomTree->getDominanceFrontier(block))
+            {
+                auto terminator = controlling->getTerminator();
+                if (isConditionalBranch(terminator))
+                {
+                    markLive(terminator);
+                }
+            }
+        }
+    }
+
+    bool changed = false;
+    for (auto& block : blocks)
+    {
+        auto& instructions = block->getInstructions();
+        for (size_t i = 0; i < instructions.size();)
+        {
+            auto& inst = instructions[i];
+            auto type = inst->getInstType();
+            bool isTerminator = type == InstType::Jump ||
+                                type == InstType::BRT || type == InstType::BRF;
+            if (isTerminator || liveInsts.count(inst.get()) != 0)
+            {
+                ++i;
+                continue;
+            }
+            instructions.erase(instructions.begin() + i);
+            changed = true;
+        }
+    }
+
+    // No live instruction depends on a dead branch, so whichever way it goes
+    // execution ends up in its immediate post-dominator
+    for (auto& block : blocks)
+    {
+        auto terminator = block->getTerminator();
+        if (!isConditionalBranch(terminator) ||
+            liveInsts.count(terminator.get()) != 0)
+        {
+            continue;
+        }
+
+        auto target = postDomTree->getIDom(block);
+        if (!target)
+        {
+            continue;
+        }
+
+        // Phis left in the target are live. They can only have come through
+        // a direct edge from this block, otherwise the branch would be live.
+        std::vector<std::pair<std::shared_ptr<PhiInst>, std::shared_ptr<Inst>>>
+            incoming;
+        bool canRedirect = true;
+        for (auto& inst : target->getInstructions())
+        {
+            if (!inst->isPhi())
+            {
+                continue;
+            }
+            auto phi = std::dynamic_pointer_cast<PhiInst>(inst);
+            std::shared_ptr<Inst> value;
+            for (unsigned int i = 0; i < phi->getOperands().size(); ++i)
+            {
+                if (phi->getOperandBB(i) == block)
+                {
+                    value = phi->getOperands()[i];
+                    break;
+                }
+            }
+            if (!value)
+            {
+                canRedirect = false;
+                break;
+            }
+            incoming.push_back({phi, value});
+        }
+        if (!canRedirect)
+        {
+            continue;
+        }
+
+        for (auto& succ : block->getSuccessors())
+        {
+            succ->removePredecessor(block);
+        }
+        block->setSuccessors({target});
+        target->pushPredecessor(block);
+        for (auto& [phi, value] : incoming)
+        {
+            phi->appendOperand(value, block);
+        }
+
+        auto& instructions = block->getInstructions();
+        instructions.pop_back();
+        auto jumpInst = std::make_shared<JumpInst>(target);
+        jumpInst->setup_def_use();
+        instructions.push_back(jumpInst);
+        changed = true;
+    }
+
+    changed |= detachUnreachableBlocks(ssa, blocks);
+    return changed;
+}
+
+}  // namespace mina
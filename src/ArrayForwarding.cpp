@@ -0,0 +1,598 @@
+#include "ArrayForwarding.hpp"
+#include "BasicBlock.hpp"
+#include "Dominators.hpp"
+#include "IRUtils.hpp"
+#include "InstIR.hpp"
+#include "SSA.hpp"
+
+#include <memory>
+#include <string>
+#include <vector>
+#include <utility>
+#include <algorithm>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace mina
+{
+
+namespace
+{
+
+// Steps a single load may take walking back through the stores
+constexpr int MaxWalkSteps = 256;
+
+// Size in bytes of an array element, see CodeGen
+constexpr long long ElementSize = 8;
+
+enum class Overlap
+{
+    Same,
+    Disjoint,
+    Unknown
+};
+
+class ArrayForwarder
+{
+public:
+    ArrayForwarder(SSA& ssa);
+
+    bool run();
+
+private:
+    // An index as a value plus a constant, the value is empty for constants
+    struct Index
+    {
+        std::string base;
+        long long offset;
+        bool isScaled;
+    };
+
+    SSA& m_ssa;
+    std::shared_ptr<DominatorTree> m_domTree;
+
+    // Instructions defining every value, with their blocks
+    std::unordered_map<std::string, std::shared_ptr<Inst>> m_defs;
+    std::unordered_map<std::string, std::shared_ptr<BasicBlock>> m_defBlocks;
+
+    // Loads reading every version of an array, with their blocks
+    std::unordered_map<
+        std::string,
+        std::vector<std::pair<std::shared_ptr<Inst>, std::shared_ptr<BasicBlock>>>>
+        m_loads;
+
+    // Values replaced by an earlier one, and the loads and stores to delete
+    std::unordered_map<std::string, std::shared_ptr<Inst>> m_replacements;
+    std::unordered_set<Inst*> m_removed;
+
+    // State of the walk for the current load: the phis being walked through,
+    // the phis added so far and the steps left
+    std::string m_loadName;
+    std::unordered_set<std::string> m_onPath;
+    std::vector<std::pair<std::shared_ptr<Inst>, std::shared_ptr<BasicBlock>>>
+        m_addedPhis;
+    int m_steps = 0;
+
+    void collect();
+    std::shared_ptr<Inst> lookup(std::shared_ptr<Inst> operand) const;
+    Index getIndex(const std::shared_ptr<Inst>& operand, bool isScaled) const;
+    Overlap compare(const Index& a, const Index& b, bool constantsOnly) const;
+    bool isBefore(const std::shared_ptr<Inst>& inst,
+                  const std::shared_ptr<BasicBlock>& instBlock,
+                  const std::shared_ptr<BasicBlock>& block,
+                  const Inst* position) const;
+    std::shared_ptr<Inst> findValue(std::string version,
+                                    const std::shared_ptr<Inst>& index,
+                                    bool isScaled,
+                                    const std::shared_ptr<BasicBlock>& block,
+                                    const Inst* position);
+    std::shared_ptr<Inst> findValueAtPhi(const std::shared_ptr<PhiInst>& phi,
+                                         const std::shared_ptr<Inst>& index,
+                                         bool isScaled);
+    bool forwardLoads();
+    bool isRead(const std::string& version, const Index& index,
+                const std::unordered_map<std::string,
+                                         std::vector<std::shared_ptr<Inst>>>& users);
+    bool removeDeadStores();
+    void rewrite();
+};
+
+ArrayForwarder::ArrayForwarder(SSA& ssa)
+    : m_ssa{ssa}, m_domTree{ssa.getDominatorTree()}
+{
+}
+
+void ArrayForwarder::collect()
+{
+    for (auto& block : getRPONodes(m_ssa.getCFG()))
+    {
+        for (auto& inst : block->getInstructions())
+        {
+            auto name = getDefinedName(inst);
+            if (!name.empty())
+            {
+                m_defs[name] = inst;
+                m_defBlocks[name] = block;
+            }
+            if (inst->getInstType() == InstType::ArrAccess)
+            {
+                auto version = getValueName(inst->getOperands()[0]);
+                m_loads[version].push_back({inst, block});
+            }
+        }
+    }
+}
+
+std::shared_ptr<Inst> ArrayForwarder::lookup(std::shared_ptr<Inst> operand) const
+{
+    auto name = getValueName(operand);
+    while (!name.empty())
+    {
+        auto it = m_replacements.find(name);
+        if (it == m_replacements.end())
+        {
+            break;
+        }
+        operand = it->second;
+        name = getValueName(operand);
+    }
+    return operand;
+}
+
+ArrayForwarder::Index ArrayForwarder::getIndex(
+    const std::shared_ptr<Inst>& operand, bool isScaled) const
+{
+    auto value = lookup(operand)->getTarget();
+    if (value->getInstType() == InstType::IntConst)
+    {
+        // Constant byte offsets of whole elements compare with element
+        // indices
+        long long offset = std::dynamic_pointer_cast<IntConstInst>(value)->getVal();
+        if (isScaled && offset % ElementSize == 0)
+        {
+            return {"", offset / ElementSize, false};
+        }
+        return {"", offset, isScaled};
+    }
+
+    // i + c, c + i and i - c are i moved by c
+    auto name = getValueName(lookup(operand));
+    auto def = m_defs.find(name);
+    if (def != m_defs.end() && (def->second->getInstType() == InstType::Add ||
+                                def->second->getInstType() == InstType::Sub))
+    {
+        auto& operands = def->second->getOperands();
+        auto lhs = lookup(operands[0])->getTarget();
+        auto rhs = lookup(operands[1])->getTarget();
+        bool isAdd = def->second->getInstType() == InstType::Add;
+        if (rhs->getInstType() == InstType::IntConst && !getValueName(lhs).empty())
+        {
+            long long offset = std::dynamic_pointer_cast<IntConstInst>(rhs)->getVal();
+            return {getValueName(lhs), isAdd ? offset : -offset, isScaled};
+        }
+        if (isAdd && lhs->getInstType() == InstType::IntConst &&
+            !getValueName(rhs).empty())
+        {
+            return {getValueName(rhs),
+                    std::dynamic_pointer_cast<IntConstInst>(lhs)->getVal(), isScaled};
+        }
+    }
+    return {name, 0, isScaled};
+}
+
+Overlap ArrayForwarder::compare(const Index& a, const Index& b,
+                                bool constantsOnly) const
+{
+    if (a.isScaled != b.isScaled || a.base != b.base ||
+        (constantsOnly && !a.base.empty()))
+    {
+        return Overlap::Unknown;
+    }
+    return a.offset == b.offset ? Overlap::Same : Overlap::Disjoint;
+}
+
+// True if inst runs before position in block on every path, a null position
+// standing for the end of the block
+bool ArrayForwarder::isBefore(const std::shared_ptr<Inst>& inst,
+                              const std::shared_ptr<BasicBlock>& instBlock,
+                              const std::shared_ptr<BasicBlock>& block,
+                              const Inst* position) const
+{
+    if (instBlock != block)
+    {
+        return m_domTree->dominates(instBlock, block);
+    }
+    if (!position)
+    {
+        return true;
+    }
+    for (auto& blockInst : block->getInstructions())
+    {
+        if (blockInst.get() == position)
+        {
+            return false;
+        }
+        if (blockInst == inst)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Value of the array element the version holds at index, as seen at the
+// position in block, or null if it isn't known
+std::shared_ptr<Inst> ArrayForwarder::findValue(
+    std::string version, const std::shared_ptr<Inst>& index, bool isScaled,
+    const std::shared_ptr<BasicBlock>& block, const Inst* position)
+{
+    auto key = getIndex(index, isScaled);
+    while (m_steps-- > 0)
+    {
+        for (auto& [load, loadBlock] : m_loads[version])
+        {
+            auto access = std::dynamic_pointer_cast<ArrAccessInst>(load);
+            auto loadKey = getIndex(access->getIndex(), access->isIndexScaled());
+            if (compare(loadKey, key, false) == Overlap::Same &&
+                isBefore(load, loadBlock, block, position))
+            {
+                return lookup(makeValueRef(getDefinedName(load), block));
+            }
+        }
+
+        auto def = m_defs.find(version);
+        if (def == m_defs.end())
+        {
+            return nullptr;
+        }
+        if (def->second->isPhi())
+        {
+            return findValueAtPhi(std::dynamic_pointer_cast<PhiInst>(def->second),
+                                  index, isScaled);
+        }
+        if (def->second->getInstType() == InstType::Assign)
+        {
+            version = getValueName(def->second->getOperands()[0]);
+            continue;
+        }
+        if (def->second->getInstType() != InstType::ArrUpdate)
+        {
+            return nullptr;
+        }
+
+        auto update = std::dynamic_pointer_cast<ArrUpdateInst>(def->second);
+        auto storeKey = getIndex(update->getIndex(), update->isIndexScaled());
+        switch (compare(storeKey, key, false))
+        {
+            case Overlap::Same:
+                return lookup(update->getVal());
+            case Overlap::Disjoint:
+                version = getValueName(update->getSource());
+                break;
+            case Overlap::Unknown:
+                return nullptr;
+        }
+    }
+    return nullptr;
+}
+
+// Value of the element at a phi of the array, merging the values found in
+// the predecessors with a new phi when they differ
+std::shared_ptr<Inst> ArrayForwarder::findValueAtPhi(
+    const std::shared_ptr<PhiInst>& phi, const std::shared_ptr<Inst>& index,
+    bool isScaled)
+{
+    auto phiName = getDefinedName(phi);
+    auto phiBlock = m_defBlocks[phiName];
+    if (m_onPath.count(phiName) != 0)
+    {
+        return nullptr;
+    }
+
+    // The index has to name the same value in the predecessors: a constant,
+    // a value defined above the phi or a phi of the same block, which is
+    // translated into the value flowing in
+    auto indexValue = lookup(index);
+    auto indexName = getValueName(indexValue);
+    std::shared_ptr<PhiInst> indexPhi;
+    if (!indexName.empty())
+    {
+        auto def = m_defs.find(indexName);
+        if (def != m_defs.end() && m_defBlocks[indexName] == phiBlock)
+        {
+            if (!def->second->isPhi())
+            {
+                return nullptr;
+            }
+            indexPhi = std::dynamic_pointer_cast<PhiInst>(def->second);
+        }
+        else if (def != m_defs.end() &&
+                 !m_domTree->dominates(m_defBlocks[indexName], phiBlock))
+        {
+            return nullptr;
+        }
+    }
+
+    m_onPath.insert(phiName);
+    std::vector<std::shared_ptr<Inst>> values;
+    auto& operands = phi->getOperands();
+    for (unsigned int i = 0; i < operands.size(); ++i)
+    {
+        auto pred = phi->getOperandBB(i);
+        auto predIndex = indexValue;
+        if (indexPhi)
+        {
+            predIndex = nullptr;
+            auto& indexOperands = indexPhi->getOperands();
+            for (unsigned int k = 0; k < indexOperands.size(); ++k)
+            {
+                if (indexPhi->getOperandBB(k) == pred)
+                {
+                    predIndex = indexOperands[k];
+                }
+            }
+        }
+
+        auto value = predIndex ? findValue(getValueName(operands[i]), predIndex,
+                                           isScaled, pred, nullptr)
+                               : nullptr;
+        if (!value)
+        {
+            m_onPath.erase(phiName);
+            return nullptr;
+        }
+        values.push_back(value);
+    }
+    m_onPath.erase(phiName);
+
+    auto sameValue = [](const std::shared_ptr<Inst>& a,
+                        const std::shared_ptr<Inst>& b)
+    {
+        if (isConstant(a) || isConstant(b))
+        {
+            return isConstant(a) && isConstant(b) &&
+                   a->getTarget()->getString() == b->getTarget()->getString();
+        }
+        return getValueName(a) == getValueName(b);
+    };
+    if (std::all_of(values.begin(), values.end(),
+                    [&](const std::shared_ptr<Inst>& value)
+                    { return sameValue(value, values[0]); }))
+    {
+        return values[0];
+    }
+
+    auto name = m_ssa.makeFreshName(m_loadName);
+    auto merge = std::make_shared<PhiInst>(name, phiBlock);
+    for (unsigned int i = 0; i < values.size(); ++i)
+    {
+        auto pred = phi->getOperandBB(i);
+        auto valueName = getValueName(values[i]);
+        merge->appendOperand(
+            valueName.empty() ? values[i] : makeValueRef(valueName, pred), pred);
+    }
+    phiBlock->pushInstBegin(merge);
+    m_defs[name] = merge;
+    m_defBlocks[name] = phiBlock;
+    m_addedPhis.push_back({merge, phiBlock});
+    return makeValueRef(name, phiBlock);
+}
+
+bool ArrayForwarder::forwardLoads()
+{
+    bool changed = false;
+    for (auto& block : getRPONodes(m_ssa.getCFG()))
+    {
+        auto instructions = block->getInstructions();
+        for (auto& inst : instructions)
+        {
+            if (inst->getInstType() != InstType::ArrAccess)
+            {
+                continue;
+            }
+
+            auto access = std::dynamic_pointer_cast<ArrAccessInst>(inst);
+            m_loadName = getDefinedName(inst);
+            m_steps = MaxWalkSteps;
+            m_addedPhis.clear();
+            auto value = findValue(getValueName(access->getSource()),
+                                   access->getIndex(), access->isIndexScaled(),
+                                   block, inst.get());
+            if (!value)
+            {
+                // Phis merging the values of a walk that failed further up
+                for (auto& [phi, phiBlock] : m_addedPhis)
+                {
+                    auto& phiInsts = phiBlock->getInstructions();
+                    phiInsts.erase(std::find(phiInsts.begin(), phiInsts.end(), phi));
+                    m_defs.erase(getDefinedName(phi));
+                }
+                continue;
+            }
+
+            m_replacements[m_loadName] = value;
+            m_removed.insert(inst.get());
+            changed = true;
+        }
+    }
+    return changed;
+}
+
+// True if some path from the version reads the element at index before it
+// is stored again
+bool ArrayForwarder::isRead(
+    const std::string& version, const Index& index,
+    const std::unordered_map<std::string, std::vector<std::shared_ptr<Inst>>>& users)
+{
+    std::vector<std::pair<std::string, bool>> worklist{{version, false}};
+    std::unordered_set<std::string> visitedPhis;
+    while (!worklist.empty())
+    {
+        auto [current, isPastPhi] = worklist.back();
+        worklist.pop_back();
+
+        auto it = users.find(current);
+        if (it == users.end())
+        {
+            continue;
+        }
+        for (auto& user : it->second)
+        {
+            auto type = user->getInstType();
+            if (type == InstType::Phi)
+            {
+                auto name = getDefinedName(user);
+                if (visitedPhis.insert(name).second)
+                {
+                    worklist.push_back({name, true});
+                }
+                continue;
+            }
+            if (type == InstType::Assign)
+            {
+                worklist.push_back({getDefinedName(user), isPastPhi});
+                continue;
+            }
+            if (type != InstType::ArrAccess && type != InstType::ArrUpdate)
+            {
+                return true;
+            }
+
+            auto& operands = user->getOperands();
+            if (getValueName(operands[0]) != current)
+            {
+                return true;
+            }
+            bool isScaled =
+                type == InstType::ArrAccess
+                    ? std::dynamic_pointer_cast<ArrAccessInst>(user)->isIndexScaled()
+                    : std::dynamic_pointer_cast<ArrUpdateInst>(user)->isIndexScaled();
+            auto overlap = compare(getIndex(operands[1], isScaled), index, isPastPhi);
+            if (type == InstType::ArrAccess)
+            {
+                if (overlap != Overlap::Disjoint)
+                {
+                    return true;
+                }
+            }
+            else if (overlap != Overlap::Same)
+            {
+                worklist.push_back({getDefinedName(user), isPastPhi});
+            }
+        }
+    }
+    return false;
+}
+
+bool ArrayForwarder::removeDeadStores()
+{
+    auto blocks = getRPONodes(m_ssa.getCFG());
+    std::unordered_map<std::string, std::vector<std::shared_ptr<Inst>>> users;
+    for (auto& block : blocks)
+    {
+        for (auto& inst : block->getInstructions())
+        {
+            if (m_removed.count(inst.get()) != 0)
+            {
+                continue;
+            }
+            for (auto& operand : inst->getOperands())
+            {
+                auto name = getValueName(lookup(operand));
+                if (!name.empty())
+                {
+                    users[name].push_back(inst);
+                }
+            }
+        }
+    }
+
+    bool changed = false;
+    for (auto& block : blocks)
+    {
+        for (auto& inst : block->getInstructions())
+        {
+            if (inst->getInstType() != InstType::ArrUpdate)
+            {
+                continue;
+            }
+            auto update = std::dynamic_pointer_cast<ArrUpdateInst>(inst);
+            auto index = getIndex(update->getIndex(), update->isIndexScaled());
+            if (isRead(getDefinedName(inst), index, users))
+            {
+                continue;
+            }
+
+            m_replacements[getDefinedName(inst)] = lookup(update->getSource());
+            m_removed.insert(inst.get());
+            changed = true;
+        }
+    }
+    return changed;
+}
+
+void ArrayForwarder::rewrite()
+{
+    for (auto& block : getRPONodes(m_ssa.getCFG()))
+    {
+        auto& instructions = block->getInstructions();
+        instructions.erase(
+            std::remove_if(instructions.begin(), instructions.end(),
+                           [&](const std::shared_ptr<Inst>& inst)
+                           { return m_removed.count(inst.get()) != 0; }),
+            instructions.end());
+
+        for (auto& inst : instructions)
+        {
+            bool isPut = inst->getInstType() == InstType::Put;
+            for (auto& operand : inst->getOperands())
+            {
+                auto name = getValueName(operand);
+                if (name.empty() || m_replacements.count(name) == 0)
+                {
+                    continue;
+                }
+
+                auto replacement = lookup(operand);
+                auto target = replacement->getTarget();
+
+                // Boolean variables are printed as numbers
+                if (isPut && target->getInstType() == InstType::BoolConst)
+                {
+                    replacement = std::make_shared<IntConstInst>(
+                        std::dynamic_pointer_cast<BoolConstInst>(target)->getVal(),
+                        block);
+                }
+                else if (!isConstant(replacement))
+                {
+                    replacement = makeValueRef(getValueName(replacement), block);
+                }
+                operand = replacement;
+            }
+        }
+    }
+}
+
+bool ArrayForwarder::run()
+{
+    collect();
+    bool changed = forwardLoads();
+    changed |= removeDeadStores();
+    if (changed)
+    {
+        rewrite();
+    }
+    return changed;
+}
+
+}  // namespace
+
+std::string ArrayForwardingPass::getName() const { return "array-forward"; }
+
+bool ArrayForwardingPass::run(SSA& ssa)
+{
+    ArrayForwarder forwarder(ssa);
+    return forwarder.run();
+}
+
+}  // namespace mina
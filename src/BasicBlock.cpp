@@ -94,6 +94,129 @@ void BasicBlock::pushSuccessor(const std::shared_ptr<BasicBlock>& successor)
   m_successors.push_back(successor);
 }
 
+std::shared_ptr<Inst> BasicBlock::getTerminator()
+{
+    if (m_instructions.empty())
+    {
+        return nullptr;
+    }
+
+    auto& last = m_instructions.back();
+    auto type = last->getInstType();
+    if (type == InstType::Jump || type == InstType::BRT ||
+        type == InstType::BRF)
+    {
+        return last;
+    }
+    return nullptr;
+}
+
+void BasicBlock::replaceSuccessor(const std::shared_ptr<BasicBlock>& oldSucc,
+                                  const std::shared_ptr<BasicBlock>& newSucc)
+{
+    std::replace(m_successors.begin(), m_successors.end(), oldSucc, newSucc);
+
+    auto terminator = getTerminator();
+    if (!terminator)
+    {
+        return;
+    }
+
+    if (terminator->getInstType() == InstType::Jump)
+    {
+        auto jump = std::dynamic_pointer_cast<JumpInst>(terminator);
+        if (jump->getJumpTarget() == oldSucc)
+        {
+            jump->setTarget(newSucc);
+        }
+    }
+    else if (terminator->getInstType() == InstType::BRT)
+    {
+        auto brt = std::dynamic_pointer_cast<BRTInst>(terminator);
+        if (brt->getTargetSuccess() == oldSucc)
+        {
+            brt->setTargetSuccess(newSucc);
+        }
+        if (brt->getTargetFailed() == oldSucc)
+        {
+            brt->setTargetFailed(newSucc);
+        }
+    }
+    else
+    {
+        auto brf = std::dynamic_pointer_cast<BRFInst>(terminator);
+        if (brf->getTargetSuccess() == oldSucc)
+        {
+            brf->setTargetSuccess(newSucc);
+        }
+        if (brf->getTargetFailed() == oldSucc)
+        {
+            brf->setTargetFailed(newSucc);
+        }
+    }
+}
+
+void BasicBlock::removeSuccessor(const std::shared_ptr<BasicBlock>& successor)
+{
+    auto it = std::find(m_successors.begin(), m_successors.end(), successor);
+    if (it != m_successors.end())
+    {
+        m_successors.erase(it);
+    }
+}
+
+void BasicBlock::replacePredecessor(const std::shared_ptr<BasicBlock>& oldPred,
+                                    const std::shared_ptr<BasicBlock>& newPred)
+{
+    std::replace(m_predecessors.begin(), m_predecessors.end(), oldPred,
+                 newPred);
+
+    for (auto& inst : m_instructions)
+    {
+        if (!inst->isPhi())
+        {
+            continue;
+        }
+        auto phi = std::dynamic_pointer_cast<PhiInst>(inst);
+        for (unsigned int i = 0; i < phi->getOperands().size(); ++i)
+        {
+            if (phi->getOperandBB(i) == oldPred)
+            {
+                phi->setOperandBB(i, newPred);
+            }
+        }
+    }
+}
+
+void BasicBlock::removePredecessor(
+    const std::shared_ptr<BasicBlock>& predecessor)
+{
+    auto it =
+        std::find(m_predecessors.begin(), m_predecessors.end(), predecessor);
+    if (it == m_predecessors.end())
+    {
+        return;
+    }
+    m_predecessors.erase(it);
+
+    for (auto& inst : m_instructions)
+    {
+        if (!inst->isPhi())
+        {
+            continue;
+        }
+        auto phi = std::dynamic_pointer_cast<PhiInst>(inst);
+        for (unsigned int i = 0; i < phi->getOperands().size(); ++i)
+        {
+            if (phi->getOperandBB(i) == predecessor)
+            {
+                phi->removeOperand(i);
+                break;
+            }
+        }
+    }
+}
+
 std::string BasicBlock::getName() { return m_name; }
 
 std::vector<std::shared_ptr<BasicBlock>> getRPONodes(
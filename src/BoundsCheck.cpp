@@ -0,0 +1,206 @@
+#include "BoundsCheck.hpp"
+#include "BasicBlock.hpp"
+#include "Dominators.hpp"
+#include "IRUtils.hpp"
+#include "InstIR.hpp"
+#include "SSA.hpp"
+#include "ValueRange.hpp"
+
+#include <memory>
+#include <string>
+#include <vector>
+#include <utility>
+#include <algorithm>
+#include <unordered_map>
+
+namespace mina
+{
+
+namespace
+{
+
+// Size in bytes of an array element, see CodeGen
+constexpr long long ElementSize = 8;
+
+class BoundsCheckEliminator
+{
+public:
+    BoundsCheckEliminator(SSA& ssa);
+
+    bool run();
+
+private:
+    SSA& m_ssa;
+    ValueRangeAnalysis m_ranges;
+    std::shared_ptr<DominatorTree> m_domTree;
+    std::vector<std::shared_ptr<BasicBlock>> m_blocks;
+
+    // Number of elements of every version of the arrays, 0 when unknown
+    std::unordered_map<std::string, long long> m_sizes;
+
+    // Smallest bound each index has been checked against on the way from
+    // the entry, with the old bounds to restore when leaving a subtree
+    std::unordered_map<std::string, long long> m_checked;
+    std::vector<std::pair<std::string, long long>> m_undo;
+
+    void computeSizes();
+    bool visit(const std::shared_ptr<BasicBlock>& block);
+};
+
+BoundsCheckEliminator::BoundsCheckEliminator(SSA& ssa)
+    : m_ssa{ssa},
+      m_ranges{ssa},
+      m_domTree{ssa.getDominatorTree()},
+      m_blocks{getRPONodes(ssa.getCFG())}
+{
+}
+
+// Versions get the size of the array they come from. A phi may merge two
+// arrays, only the smaller size is safe to assume then.
+void BoundsCheckEliminator::computeSizes()
+{
+    bool changed = true;
+    while (changed)
+    {
+        changed = false;
+        for (auto& block : m_blocks)
+        {
+            for (auto& inst : block->getInstructions())
+            {
+                auto name = getDefinedName(inst);
+                long long size = 0;
+                switch (inst->getInstType())
+                {
+                    case InstType::Alloca:
+                        size = std::dynamic_pointer_cast<AllocaInst>(inst)->getSize();
+                        break;
+                    case InstType::ArrUpdate:
+                    case InstType::Assign:
+                    {
+                        auto it = m_sizes.find(getValueName(inst->getOperands()[0]));
+                        size = it == m_sizes.end() ? 0 : it->second;
+                        break;
+                    }
+                    case InstType::Phi:
+                        for (auto& operand : inst->getOperands())
+                        {
+                            auto it = m_sizes.find(getValueName(operand));
+                            if (it != m_sizes.end() && it->second != 0)
+                            {
+                                size = size == 0 ? it->second
+                                                 : std::min(size, it->second);
+                            }
+                        }
+                        break;
+                    default:
+                        break;
+                }
+
+                if (size != 0 && m_sizes[name] != size)
+                {
+                    m_sizes[name] = size;
+                    changed = true;
+                }
+            }
+        }
+    }
+}
+
+bool BoundsCheckEliminator::visit(const std::shared_ptr<BasicBlock>& block)
+{
+    bool changed = false;
+    auto undoSize = m_undo.size();
+    for (auto& inst : block->getInstructions())
+    {
+        auto type = inst->getInstType();
+        if (type != InstType::ArrAccess && type != InstType::ArrUpdate)
+        {
+            continue;
+        }
+
+        auto access = std::dynamic_pointer_cast<ArrAccessInst>(inst);
+        auto update = std::dynamic_pointer_cast<ArrUpdateInst>(inst);
+        bool isScaled = access ? access->isIndexScaled() : update->isIndexScaled();
+        auto& operands = inst->getOperands();
+        auto sizeIt = m_sizes.find(getValueName(operands[0]));
+
+        bool needsCheck = true;
+        if (sizeIt != m_sizes.end() && sizeIt->second != 0)
+        {
+            auto bound = isScaled ? sizeIt->second * ElementSize : sizeIt->second;
+            auto index = m_ranges.getRange(operands[1], block);
+            auto key = (isScaled ? "scaled " : "") +
+                       operands[1]->getTarget()->getString();
+            auto checked = m_checked.find(key);
+            if (!index.isEmpty() && index.lo >= 0 && index.hi < bound)
+            {
+                needsCheck = false;
+            }
+            else if (checked != m_checked.end() && checked->second <= bound)
+            {
+                needsCheck = false;
+            }
+
+            // Past this point the index is within the bound either way
+            if (checked == m_checked.end() || bound < checked->second)
+            {
+                m_undo.push_back(
+                    {key, checked == m_checked.end() ? 0 : checked->second});
+                m_checked[key] = bound;
+            }
+        }
+
+        bool oldNeedsCheck = access ? access->needsBoundsCheck()
+                                    : update->needsBoundsCheck();
+        if (needsCheck != oldNeedsCheck)
+        {
+            if (access)
+            {
+                access->setNeedsBoundsCheck(needsCheck);
+            }
+            else
+            {
+                update->setNeedsBoundsCheck(needsCheck);
+            }
+            changed = true;
+        }
+    }
+
+    for (auto& child : m_domTree->getChildren(block))
+    {
+        changed |= visit(child);
+    }
+
+    while (m_undo.size() > undoSize)
+    {
+        auto& [key, bound] = m_undo.back();
+        if (bound == 0)
+        {
+            m_checked.erase(key);
+        }
+        else
+        {
+            m_checked[key] = bound;
+        }
+        m_undo.pop_back();
+    }
+    return changed;
+}
+
+bool BoundsCheckEliminator::run()
+{
+    computeSizes();
+    return visit(m_ssa.getCFG());
+}
+
+}  // namespace
+
+std::string BoundsCheckPass::getName() const { return "bounds-check"; }
+
+bool BoundsCheckPass::run(SSA& ssa)
+{
+    BoundsCheckEliminator eliminator(ssa);
+    return eliminator.run();
+}
+
+}  // namespace mina
@@ -0,0 +1,208 @@
+#include "CallFolding.hpp"
+#include "BasicBlock.hpp"
+#include "CallGraph.hpp"
+#include "IREvaluator.hpp"
+#include "IRUtils.hpp"
+#include "InstIR.hpp"
+#include "SSA.hpp"
+
+#include <map>
+#include <limits>
+#include <memory>
+#include <string>
+#include <vector>
+#include <optional>
+
+namespace mina
+{
+
+namespace
+{
+
+// Instructions the evaluation of one call may execute
+constexpr long long MaxCallSteps = 1 << 20;
+
+// Instructions the evaluations of the whole program may execute together
+constexpr long long MaxTotalSteps = 1 << 24;
+
+// Calls the evaluation of one call may nest
+constexpr int MaxCallDepth = 512;
+
+bool isBoolFunction(SSA& ssa)
+{
+    auto signature =
+        std::dynamic_pointer_cast<Func>(ssa.getCFG()->getInstructions().front());
+    return signature->getRetType() == Type::BOOLEAN;
+}
+
+// Replaces the uses of the named value with the constant
+void replaceUses(SSA& ssa, const std::string& name,
+                 const IREvaluator::Value& value)
+{
+    for (auto& block : getRPONodes(ssa.getCFG()))
+    {
+        for (auto& inst : block->getInstructions())
+        {
+            // Boolean variables are printed as numbers, only boolean
+            // literals are printed as true/false, so put keeps a number
+            bool isPut = inst->getInstType() == InstType::Put;
+            for (auto& operand : inst->getOperands())
+            {
+                if (getValueName(operand) != name)
+                {
+                    continue;
+                }
+                if (value.isBool && !isPut)
+                {
+                    operand =
+                        std::make_shared<BoolConstInst>(value.value != 0, block);
+                }
+                else
+                {
+                    operand = std::make_shared<IntConstInst>(
+                        static_cast<int>(value.value), block);
+                }
+            }
+        }
+    }
+}
+
+class CallFolder
+{
+public:
+    CallFolder(SSA& mainSSA, std::map<std::string, SSA>& functions);
+
+    bool run();
+
+private:
+    SSA& m_mainSSA;
+    std::map<std::string, SSA>& m_functions;
+    CallGraph m_callGraph;
+    long long m_totalSteps = 0;
+
+    // Results of the calls evaluated so far, by callee and arguments
+    std::map<std::string, std::optional<IREvaluator::Value>> m_results;
+
+    bool foldCalls(SSA& ssa);
+    std::optional<IREvaluator::Value> evaluateCall(
+        const std::shared_ptr<Inst>& call);
+};
+
+CallFolder::CallFolder(SSA& mainSSA, std::map<std::string, SSA>& functions)
+    : m_mainSSA{mainSSA},
+      m_functions{functions},
+      m_callGraph{mainSSA, functions}
+{
+}
+
+std::optional<IREvaluator::Value> CallFolder::evaluateCall(
+    const std::shared_ptr<Inst>& call)
+{
+    auto callee = getCalleeName(call);
+    if (m_functions.count(callee) == 0 ||
+        !m_callGraph.getSummary(callee).isPure)
+    {
+        return std::nullopt;
+    }
+
+    std::vector<IREvaluator::Value> args;
+    std::string key = callee;
+    for (auto& operand : call->getOperands())
+    {
+        if (!isConstant(operand))
+        {
+            return std::nullopt;
+        }
+        auto target = operand->getTarget();
+        if (target->getInstType() == InstType::IntConst)
+        {
+            args.push_back(
+                {std::dynamic_pointer_cast<IntConstInst>(target)->getVal(),
+                 false});
+        }
+        else
+        {
+            args.push_back(
+                {std::dynamic_pointer_cast<BoolConstInst>(target)->getVal(),
+                 true});
+        }
+        key += " " + std::to_string(args.back().value);
+    }
+
+    auto it = m_results.find(key);
+    if (it != m_results.end())
+    {
+        return it->second;
+    }
+    if (m_totalSteps >= MaxTotalSteps)
+    {
+        return std::nullopt;
+    }
+
+    IREvaluator evaluator(m_functions, MaxCallSteps, MaxCallDepth);
+    auto result = evaluator.call(callee, args);
+    m_totalSteps += evaluator.getSteps();
+
+    // Folded integers must fit the 32-bit constants of the IR
+    if (result && call->getInstType() == InstType::FuncCall)
+    {
+        result->isBool = isBoolFunction(m_functions.at(callee));
+        if (result->value < std::numeric_limits<int>::min() ||
+            result->value > std::numeric_limits<int>::max())
+        {
+            result.reset();
+        }
+    }
+    m_results[key] = result;
+    return result;
+}
+
+bool CallFolder::foldCalls(SSA& ssa)
+{
+    bool changed = false;
+    for (auto& block : getRPONodes(ssa.getCFG()))
+    {
+        auto& insts = block->getInstructions();
+        for (size_t i = 0; i < insts.size();)
+        {
+            auto call = insts[i];
+            auto result =
+                getCalleeName(call).empty() ? std::nullopt : evaluateCall(call);
+            if (!result)
+            {
+                ++i;
+                continue;
+            }
+
+            if (call->getInstType() == InstType::FuncCall)
+            {
+                replaceUses(ssa, getDefinedName(call), *result);
+            }
+            insts.erase(insts.begin() + i);
+            changed = true;
+        }
+    }
+    return changed;
+}
+
+bool CallFolder::run()
+{
+    bool changed = foldCalls(m_mainSSA);
+    for (auto& [funcName, ssa] : m_functions)
+    {
+        changed |= foldCalls(ssa);
+    }
+    return changed;
+}
+
+}  // namespace
+
+std::string CallFoldingPass::getName() const { return "call-folding"; }
+
+bool CallFoldingPass::run(SSA& mainSSA, std::map<std::string, SSA>& functions)
+{
+    CallFolder folder(mainSSA, functions);
+    return folder.run();
+}
+
+}  // namespace mina
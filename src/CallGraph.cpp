@@ -0,0 +1,230 @@
+#include "CallGraph.hpp"
+#include "BasicBlock.hpp"
+#include "IRUtils.hpp"
+#include "InstIR.hpp"
+#include "MachineIR.hpp"
+#include "SSA.hpp"
+
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <stdexcept>
+#include <functional>
+
+namespace mina
+{
+
+CallGraph::CallGraph(SSA& mainSSA, std::map<std::string, SSA>& functions)
+{
+    for (auto& [funcName, ssa] : functions)
+    {
+        addRoutine(funcName, ssa);
+    }
+    addRoutine(MainName, mainSSA);
+
+    for (auto& [name, node] : m_nodes)
+    {
+        if (name != MainName && functions.count(name) == 0)
+        {
+            throw std::runtime_error("Call to unknown routine '" + name + "'");
+        }
+    }
+
+    findSCCs();
+    summarize();
+}
+
+void CallGraph::addRoutine(const std::string& name, SSA& ssa)
+{
+    auto& node = m_nodes[name];
+    for (auto& block : getRPONodes(ssa.getCFG()))
+    {
+        for (auto& inst : block->getInstructions())
+        {
+            auto type = inst->getInstType();
+            if (type == InstType::Get || type == InstType::Put ||
+                type == InstType::Halt)
+            {
+                node.hasSideEffects = true;
+                node.summary.readsInput |= type == InstType::Get;
+                node.summary.writesOutput |= type == InstType::Put;
+            }
+
+            auto callee = getCalleeName(inst);
+            if (callee.empty())
+            {
+                continue;
+            }
+            ++m_nodes[callee].numCallSites;
+            if (std::find(node.callees.begin(), node.callees.end(), callee) ==
+                node.callees.end())
+            {
+                node.callees.push_back(callee);
+            }
+        }
+    }
+}
+
+void CallGraph::findSCCs()
+{
+    std::map<std::string, int> index, lowLink;
+    std::set<std::string> onStack;
+    std::vector<std::string> stack;
+    int nextIndex = 0;
+
+    std::function<void(const std::string&)> visit =
+        [&](const std::string& name)
+    {
+        index[name] = lowLink[name] = nextIndex++;
+        stack.push_back(name);
+        onStack.insert(name);
+
+        for (auto& callee : m_nodes[name].callees)
+        {
+            if (index.count(callee) == 0)
+            {
+                visit(callee);
+                lowLink[name] = std::min(lowLink[name], lowLink[callee]);
+            }
+            else if (onStack.count(callee) != 0)
+            {
+                lowLink[name] = std::min(lowLink[name], index[callee]);
+            }
+        }
+
+        if (lowLink[name] != index[name])
+        {
+            return;
+        }
+        std::vector<std::string> scc;
+        std::string member;
+        do
+        {
+            member = stack.back();
+            stack.pop_back();
+            onStack.erase(member);
+            scc.push_back(member);
+        } while (member != name);
+        m_sccs.push_back(std::move(scc));
+    };
+
+    // Nothing calls main, so its component is the last of those it reaches
+    // and every unreachable one comes before it
+    for (auto& [name, node] : m_nodes)
+    {
+        if (name != MainName && index.count(name) == 0)
+        {
+            visit(name);
+        }
+    }
+    if (index.count(MainName) == 0)
+    {
+        visit(MainName);
+    }
+
+    std::vector<std::string> worklist{MainName};
+    m_reachable.insert(MainName);
+    while (!worklist.empty())
+    {
+        auto name = worklist.back();
+        worklist.pop_back();
+        for (auto& callee : m_nodes[name].callees)
+        {
+            if (m_reachable.insert(callee).second)
+            {
+                worklist.push_back(callee);
+            }
+        }
+    }
+}
+
+void CallGraph::summarize()
+{
+    for (auto& scc : m_sccs)
+    {
+        FunctionSummary effects;
+        bool hasSideEffects = false;
+        for (auto& name : scc)
+        {
+            auto& node = m_nodes[name];
+            hasSideEffects |= node.hasSideEffects;
+            effects.readsInput |= node.summary.readsInput;
+            effects.writesOutput |= node.summary.writesOutput;
+            for (auto& callee : node.callees)
+            {
+                if (std::find(scc.begin(), scc.end(), callee) != scc.end())
+                {
+                    continue;
+                }
+                auto& calleeSummary = m_nodes[callee].summary;
+                hasSideEffects |= !calleeSummary.isPure;
+                effects.readsInput |= calleeSummary.readsInput;
+                effects.writesOutput |= calleeSummary.writesOutput;
+            }
+        }
+
+        for (auto& name : scc)
+        {
+            auto& summary = m_nodes[name].summary;
+            summary.readsInput = effects.readsInput;
+            summary.writesOutput = effects.writesOutput;
+            summary.isRecursive =
+                scc.size() > 1 ||
+                std::find(m_nodes[name].callees.begin(),
+                          m_nodes[name].callees.end(),
+                          name) != m_nodes[name].callees.end();
+            summary.isPure = !hasSideEffects;
+            summary.clobberedRegs = getCallerSavedRegs();
+        }
+    }
+}
+
+const std::vector<std::string>& CallGraph::getCallees(
+    const std::string& name) const
+{
+    return m_nodes.at(name).callees;
+}
+
+size_t CallGraph::getNumCallSites(const std::string& name) const
+{
+    return m_nodes.at(name).numCallSites;
+}
+
+const std::vector<std::vector<std::string>>& CallGraph::getSCCs() const
+{
+    return m_sccs;
+}
+
+bool CallGraph::isReachable(const std::string& name) const
+{
+    return m_reachable.count(name) != 0;
+}
+
+std::vector<std::string> CallGraph::getUnreachable() const
+{
+    std::vector<std::string> unreachable;
+    for (auto& [name, node] : m_nodes)
+    {
+        if (!isReachable(name))
+        {
+            unreachable.push_back(name);
+        }
+    }
+    return unreachable;
+}
+
+const FunctionSummary& CallGraph::getSummary(const std::string& name) const
+{
+    return m_nodes.at(name).summary;
+}
+
+void CallGraph::setClobberedRegs(const std::string& name, std::set<int> regs)
+{
+    auto& summary = m_nodes.at(name).summary;
+    summary.clobberedRegs = std::move(regs);
+    summary.hasClobberInfo = true;
+}
+
+}  // namespace mina
@@ -3,6 +3,9 @@
 #include "BasicBlock.hpp"
 #include "MachineIR.hpp"
 #include "InstIR.hpp"
+#include "IRUtils.hpp"
+#include "CallGraph.hpp"
+#include "PassManager.hpp"
 #include "RegisterAllocator.hpp"
 
 #include <map>
@@ -20,6 +23,15 @@
 namespace mina
 {
 
+// Entries of the memo table of a function, each holding whether it is filled
+// and the result
+static constexpr long long MemoTableSize = 4096;
+
+// Arguments of a memoized function with two parameters use the table when
+// both are below this, with one parameter when it is below MemoTableSize.
+// Other calls run the body every time.
+static constexpr long long MemoTwoParamRange = 64;
+
 CodeGen::CodeGen(SSA ssa) : m_ssa{ssa}
 {
 }
@@ -32,13 +44,13 @@ void CodeGen::generateMIR(bool isMain)
     auto rbx = std::make_shared<Register>(1, "rbx", "ebx", "bx", "bh", "bl");
     auto rcx = std::make_shared<Register>(2, "rcx", "ecx", "cx", "ch", "cl");
     auto rdx = std::make_shared<Register>(3, "rdx", "edx", "dx", "dh", "dl");
-    auto rdi = std::make_shared<Register>(4, "rdi", "edi", "di", "dil", "");
-    auto rsi = std::make_shared<Register>(5, "rsi", "esi", "si", "sil", "");
-    auto r8 = std::make_shared<Register>(6, "r8", "r8d", "r8w", "r8b", "");
-    auto r9 = std::make_shared<Register>(7, "r9", "r9d", "r9w", "r9b", "");
-    auto r12 = std::make_shared<Register>(8, "r12", "r12d", "r12w", "r12b", "");
-    auto r13 = std::make_shared<Register>(9, "r13", "r13d", "r13w", "r13b", "");
-    auto r14 = std::make_shared<Register>(10, "r14", "r14d", "r14w", "r14b", "");
+    auto rdi = std::make_shared<Register>(4, "rdi", "edi", "di", "", "dil");
+    auto rsi = std::make_shared<Register>(5, "rsi", "esi", "si", "", "sil");
+    auto r8 = std::make_shared<Register>(6, "r8", "r8d", "r8w", "", "r8b");
+    auto r9 = std::make_shared<Register>(7, "r9", "r9d", "r9w", "", "r9b");
+    auto r12 = std::make_shared<Register>(8, "r12", "r12d", "r12w", "", "r12b");
+    auto r13 = std::make_shared<Register>(9, "r13", "r13d", "r13w", "", "r13b");
+    auto r14 = std::make_shared<Register>(10, "r14", "r14d", "r14w", "", "r14b");
     auto rbp = std::make_shared<Register>(11, "rbp", "ebp", "bp", "", "");
     auto rsp = std::make_shared<Register>(12, "rsp", "esp", "sp", "", "");
     auto rip = std::make_shared<Register>(13, "rip", "eip", "ip", "", "");
@@ -114,6 +126,24 @@ void CodeGen::generateMIR(bool isMain)
         return getOrCreateVReg(name);
     };
 
+    // Constants become immediates, any other operand lives in the vreg named
+    // after the value it refers to
+    auto operandToMIR = [&](const std::shared_ptr<Inst>& operand) -> std::shared_ptr<MachineIR>
+    {
+        auto target = operand->getTarget();
+        if (target->getInstType() == InstType::IntConst)
+        {
+            return std::make_shared<ConstMIR>(
+                std::dynamic_pointer_cast<IntConstInst>(target)->getVal());
+        }
+        if (target->getInstType() == InstType::BoolConst)
+        {
+            return std::make_shared<ConstMIR>(
+                std::dynamic_pointer_cast<BoolConstInst>(target)->getVal() ? 1 : 0);
+        }
+        return getOrCreateVReg("v_" + target->getString());
+    };
+
     // Helper to legalize mov instructions based on x86-64 constraints
     // (No memory-to-memory moves)
     auto legalizeMov = [&](std::shared_ptr<BasicBlockMIR> bb,
@@ -183,7 +213,7 @@ void CodeGen::generateMIR(bool isMain)
         }
     }
 
-    for (int i = 0; i < rpo.size(); ++i)
+    for (size_t i = 0; i < rpo.size(); ++i)
     {
         auto& currBlock = rpo[i];
         auto& bbMIR = linearizedMIRBlock[i];
@@ -196,13 +226,14 @@ void CodeGen::generateMIR(bool isMain)
         // needed, we need to rematerialize the address each time to avoid
         // storing addresses in vregs which may become invalid after function
         // calls.
-        auto resolveArrayAddress = [&](const std::string& arrayName, std::shared_ptr<Inst> index) -> std::shared_ptr<Register>
+        // A scaled index is already a byte offset, see StrengthReduction.
+        auto resolveArrayAddress = [&](const std::string& arrayName, std::shared_ptr<Inst> index, bool isIndexScaled) -> std::shared_ptr<Register>
         {
             auto addrVReg = createTempVReg();
             if (index->getInstType() == InstType::IntConst)
             {
                 int indexVal = std::dynamic_pointer_cast<IntConstInst>(index)->getVal();
-                int elementOffset = indexVal * 8; // Scale by 8 bytes
+                int elementOffset = isIndexScaled ? indexVal : indexVal * 8; // Scale by 8 bytes
 
                 unsigned int baseOffset = vRegToOffset[arrayName];
                 int finalOffset = -(static_cast<int>(baseOffset) + elementOffset);
@@ -219,9 +250,12 @@ void CodeGen::generateMIR(bool isMain)
                 bbMIR->addInstruction(std::make_shared<MovMIR>(
                     std::vector<std::shared_ptr<MachineIR>>{rax, rawIdxVReg}));
 
-                bbMIR->addInstruction(std::make_shared<MulMIR>(
-                    std::vector<std::shared_ptr<MachineIR>>{
-                        rax, std::make_shared<ConstMIR>(8)}));
+                if (!isIndexScaled)
+                {
+                    bbMIR->addInstruction(std::make_shared<MulMIR>(
+                        std::vector<std::shared_ptr<MachineIR>>{
+                            rax, std::make_shared<ConstMIR>(8)}));
+                }
 
                 auto memLocation = memoryLocationForVReg(arrayName);
                 bbMIR->addInstruction(std::make_shared<LeaMIR>(
@@ -235,6 +269,7 @@ void CodeGen::generateMIR(bool isMain)
         };
 
         auto& inst = currBlock->getInstructions();
+        bool endsWithTailCall = false;
         for (int j = 0; j < inst.size(); ++j)
         {
             auto instType = inst[j]->getInstType();
@@ -260,39 +295,68 @@ void CodeGen::generateMIR(bool isMain)
                 // Windows x64 Calling Convention: rcx, rdx, r8, r9
                 std::vector<std::shared_ptr<Register>> paramRegs = {rcx, rdx, r8, r9};
 
-                for (int i = 0; i < arguments.size(); ++i)
+                for (size_t i = 0; i < arguments.size(); ++i)
                 {
                     if (i >= 4)
                     {
                         throw std::runtime_error("CodeGen Error: More than 4 arguments not supported.");
                     }
 
-                    const auto& argTarget = arguments[i]->getTarget();
-                    std::shared_ptr<MachineIR> mirSource;
+                    // Move to physical parameter register
+                    auto movMIR = std::make_shared<MovMIR>(
+                        std::vector<std::shared_ptr<MachineIR>>{
+                            paramRegs[i], operandToMIR(arguments[i])});
+                    bbMIR->addInstruction(movMIR);
+                }
 
-                    if (argTarget->getInstType() == InstType::IntConst)
-                    {
-                        auto intConst = std::dynamic_pointer_cast<IntConstInst>(argTarget);
-                        mirSource = std::make_shared<ConstMIR>(intConst->getVal());
-                    }
-                    else if (argTarget->getInstType() == InstType::BoolConst)
+                // A call whose result is returned right away, or which ends
+                // a procedure, leaves nothing to do in this frame. Every
+                // argument is in a register, so the callee can take over the
+                // frame of our caller.
+                if (m_tailCalls && !isMain)
+                {
+                    // Instructions from the call to the end of the block
+                    size_t numLeft = inst.size() - j;
+                    if (isFunc)
                     {
-                        auto boolConst = std::dynamic_pointer_cast<BoolConstInst>(argTarget);
-                        mirSource = std::make_shared<ConstMIR>(boolConst->getVal() ? 1 : 0);
+                        endsWithTailCall =
+                            numLeft == 2 &&
+                            inst[j + 1]->getInstType() == InstType::Return &&
+                            !inst[j + 1]->getOperands().empty() &&
+                            getValueName(inst[j + 1]->getOperands()[0]) ==
+                                getDefinedName(inst[j]);
                     }
                     else
                     {
-                        mirSource = getOrCreateVReg("v_" + argTarget->getString());
+                        // The end of a procedure is often an empty block
+                        // merging its branches
+                        auto succs = currBlock->getSuccessors();
+                        endsWithTailCall =
+                            (numLeft == 1 && succs.empty()) ||
+                            (numLeft == 2 && succs.size() == 1 &&
+                             inst[j + 1]->getInstType() == InstType::Jump &&
+                             succs[0]->getInstructions().empty() &&
+                             succs[0]->getSuccessors().empty());
                     }
-
-                    // Move to physical parameter register
-                    auto movMIR = std::make_shared<MovMIR>(
-                        std::vector<std::shared_ptr<MachineIR>>{paramRegs[i], mirSource});
-                    bbMIR->addInstruction(movMIR);
                 }
+                auto callMIR = std::make_shared<CallMIR>(
+                    callee, arguments.size(), endsWithTailCall);
 
-                auto callMIR = std::make_shared<CallMIR>(callee, arguments.size());
+                // Callees are allocated before their callers, so the call
+                // only clobbers what the callee actually writes
+                if (m_callClobbers)
+                {
+                    auto& summary = m_callGraph->getSummary(callee);
+                    if (summary.hasClobberInfo)
+                    {
+                        callMIR->setClobberedRegs(summary.clobberedRegs);
+                    }
+                }
                 bbMIR->addInstruction(callMIR);
+                if (endsWithTailCall)
+                {
+                    break;
+                }
 
                 // If FuncCall, handle return value: mov targetVReg, rax
                 if (isFunc)
@@ -382,7 +446,7 @@ void CodeGen::generateMIR(bool isMain)
                 auto targetStr = assignInst->getTarget()->getString();
                 auto targetVRegName = "v_" + targetStr;
                 auto targetVReg = getOrCreateVReg(targetVRegName);
-                auto source = assignInst->getSource();
+                auto source = assignInst->getSource()->getTarget();
 
                 if (source->getInstType() == InstType::Ident)
                 {
@@ -400,19 +464,7 @@ void CodeGen::generateMIR(bool isMain)
                     }
                 }
 
-                std::shared_ptr<MachineIR> mirSource;
-                if (source->getInstType() == InstType::IntConst)
-                {
-                    mirSource = std::make_shared<ConstMIR>(std::dynamic_pointer_cast<IntConstInst>(source)->getVal());
-                }
-                else if (source->getInstType() == InstType::BoolConst)
-                {
-                    mirSource = std::make_shared<ConstMIR>(std::dynamic_pointer_cast<BoolConstInst>(source)->getVal() ? 1 : 0);
-                }
-                else
-                {
-                    mirSource = getOrCreateVReg("v_" + source->getString());
-                }
+                auto mirSource = operandToMIR(source);
 
                 // Make sure no illegal mov occurs (memory to memory)
                 legalizeMov(bbMIR, targetVReg, mirSource);
@@ -543,18 +595,12 @@ void CodeGen::generateMIR(bool isMain)
                 auto targetVReg = getOrCreateVReg("v_" + targetStr);
 
                 // Resolve Operand 1 and move to target via legalizer
-                auto op1 = operands[0]->getTarget();
-                std::shared_ptr<MachineIR> op1MIR = (op1->getInstType() == InstType::IntConst) ?
-                    std::static_pointer_cast<MachineIR>(std::make_shared<ConstMIR>(std::dynamic_pointer_cast<IntConstInst>(op1)->getVal())) :
-                    std::static_pointer_cast<MachineIR>(getOrCreateVReg("v_" + op1->getString()));
+                auto op1MIR = operandToMIR(operands[0]);
 
                 legalizeMov(bbMIR, targetVReg, op1MIR);
 
                 // Resolve Operand 2 and force it into a physical register (rdx)
-                auto op2 = operands[1]->getTarget();
-                std::shared_ptr<MachineIR> op2MIR = (op2->getInstType() == InstType::IntConst) ?
-                    std::static_pointer_cast<MachineIR>(std::make_shared<ConstMIR>(std::dynamic_pointer_cast<IntConstInst>(op2)->getVal())) :
-                    std::static_pointer_cast<MachineIR>(getOrCreateVReg("v_" + op2->getString()));
+                auto op2MIR = operandToMIR(operands[1]);
 
                 bbMIR->addInstruction(std::make_shared<MovMIR>(std::vector<std::shared_ptr<MachineIR>>{rdx, op2MIR}));
 
@@ -587,22 +633,24 @@ void CodeGen::generateMIR(bool isMain)
                 const auto& operand2 = operands[1]->getTarget();
 
                 // Prepare Dividend: mov rax, operand1
-                if (operand1->getInstType() == InstType::IntConst)
+                bbMIR->addInstruction(std::make_shared<MovMIR>(
+                    std::vector<std::shared_ptr<MachineIR>>{rax, operandToMIR(operand1)}));
+
+                // idiv divides rdx:rax, so rax is sign-extended into rdx.
+                // Divisions of values known to be non-negative clear rdx
+                // and use div instead.
+                bool isUnsigned = divInst->getKind() != DivKind::Signed;
+                if (isUnsigned)
                 {
-                    auto intConst = std::dynamic_pointer_cast<IntConstInst>(operand1);
                     bbMIR->addInstruction(std::make_shared<MovMIR>(
-                        std::vector<std::shared_ptr<MachineIR>>{rax, std::make_shared<ConstMIR>(intConst->getVal())}));
+                        std::vector<std::shared_ptr<MachineIR>>{
+                            rdx, std::make_shared<ConstMIR>(0)}));
                 }
                 else
                 {
-                    auto op1VReg = getOrCreateVReg("v_" + operand1->getString());
-                    bbMIR->addInstruction(std::make_shared<MovMIR>(
-                        std::vector<std::shared_ptr<MachineIR>>{rax, op1VReg}));
+                    bbMIR->addInstruction(std::make_shared<CqoMIR>());
                 }
 
-                // Sign-extend rax into rdx (Requirement for idiv)
-                bbMIR->addInstruction(std::make_shared<CqoMIR>());
-
                 // Pin Divisor to Memory
                 std::string divisorName;
                 if (operand2->getInstType() == InstType::IntConst)
@@ -633,7 +681,9 @@ void CodeGen::generateMIR(bool isMain)
                 }
 
                 // idiv QWORD PTR [rbp - offset]
-                bbMIR->addInstruction(std::make_shared<DivMIR>(memoryLocationForVReg(divisorName)));
+                bbMIR->addInstruction(std::make_shared<DivMIR>(
+                    memoryLocationForVReg(divisorName), isUnsigned,
+                    divInst->getKind() == DivKind::Unsigned32));
 
                 // mov targetVReg, rax
                 auto targetVReg = getOrCreateVReg("v_" + targetStr);
@@ -646,10 +696,9 @@ void CodeGen::generateMIR(bool isMain)
                 auto notInst = std::dynamic_pointer_cast<NotInst>(inst[j]);
 
                 const auto& targetStr = notInst->getTarget()->getString();
-                const auto& operandStr = notInst->getOperand()->getTarget()->getString();
 
                 auto targetVReg = getOrCreateVReg("v_" + targetStr);
-                auto operandVReg = getOrCreateVReg("v_" + operandStr);
+                auto operandVReg = operandToMIR(notInst->getOperand());
 
                 // mov targetVReg, operandVReg
                 // We copy the operand to the target first so we don't destroy the original variable
@@ -671,27 +720,8 @@ void CodeGen::generateMIR(bool isMain)
 
                 auto targetVReg = getOrCreateVReg("v_" + targetStr);
 
-                std::shared_ptr<MachineIR> op1MIR;
-                if (operand1->getInstType() == InstType::BoolConst)
-                {
-                    auto boolConst = std::dynamic_pointer_cast<BoolConstInst>(operand1);
-                    op1MIR = std::make_shared<ConstMIR>(boolConst->getVal() ? 1 : 0);
-                }
-                else
-                {
-                    op1MIR = getOrCreateVReg("v_" + operand1->getString());
-                }
-
-                std::shared_ptr<MachineIR> op2MIR;
-                if (operand2->getInstType() == InstType::BoolConst)
-                {
-                    auto boolConst = std::dynamic_pointer_cast<BoolConstInst>(operand2);
-                    op2MIR = std::make_shared<ConstMIR>(boolConst->getVal() ? 1 : 0);
-                }
-                else
-                {
-                    op2MIR = getOrCreateVReg("v_" + operand2->getString());
-                }
+                auto op1MIR = operandToMIR(operand1);
+                auto op2MIR = operandToMIR(operand2);
 
                 // mov targetVReg, op1MIR
                 bbMIR->addInstruction(std::make_shared<MovMIR>(
@@ -721,17 +751,8 @@ void CodeGen::generateMIR(bool isMain)
 
                 auto targetVReg = getOrCreateVReg("v_" + targetStr);
 
-                auto getOpMIR = [&](std::shared_ptr<Inst> op) -> std::shared_ptr<MachineIR>
-                {
-                    if (op->getInstType() == InstType::IntConst)
-                    {
-                        return std::make_shared<ConstMIR>(std::dynamic_pointer_cast<IntConstInst>(op)->getVal());
-                    }
-                    return getOrCreateVReg("v_" + op->getString());
-                };
-
-                auto op1MIR = getOpMIR(operands[0]->getTarget());
-                auto op2MIR = getOpMIR(operands[1]->getTarget());
+                auto op1MIR = operandToMIR(operands[0]);
+                auto op2MIR = operandToMIR(operands[1]);
 
                 // Legalize Op1 and Op2 into physical registers before CMP.
                 // We use rax and rdx directly as destinations here because 
@@ -763,11 +784,87 @@ void CodeGen::generateMIR(bool isMain)
                 auto movzxMIR = std::make_shared<MovzxMIR>(targetVReg, 64, 8, true);
                 bbMIR->addInstruction(movzxMIR);
             }
+            else if (instType == InstType::Select)
+            {
+                auto selectInst = std::dynamic_pointer_cast<SelectInst>(inst[j]);
+                auto targetVReg = getOrCreateVReg("v_" + selectInst->getTarget()->getString());
+                auto cond = selectInst->getCond()->getTarget();
+                auto trueMIR = operandToMIR(selectInst->getTrueValue());
+                auto falseMIR = operandToMIR(selectInst->getFalseValue());
+
+                // A constant condition always picks the same value
+                if (cond->getInstType() == InstType::BoolConst ||
+                    cond->getInstType() == InstType::IntConst)
+                {
+                    auto condMIR = std::dynamic_pointer_cast<ConstMIR>(operandToMIR(cond));
+                    legalizeMov(bbMIR, targetVReg,
+                                condMIR->getConst() != 0 ? trueMIR : falseMIR);
+                    continue;
+                }
+
+                // When the comparison computing the condition comes right
+                // before, with only copies and selects on the same condition
+                // in between, its flags are still set: copies are lowered to
+                // moves, and those selects either use the same flags or test
+                // the condition the same way.
+                std::string condition;
+                for (int k = j - 1; k >= 0; --k)
+                {
+                    auto prevType = inst[k]->getInstType();
+                    if (prevType == InstType::Assign ||
+                        (prevType == InstType::Select &&
+                         inst[k]->getOperands()[0]->getTarget()->getString() ==
+                             cond->getString()))
+                    {
+                        continue;
+                    }
+                    if (getDefinedName(inst[k]) == cond->getString())
+                    {
+                        switch (prevType)
+                        {
+                            case InstType::CmpEq:  { condition = "e"; break; }
+                            case InstType::CmpNE:  { condition = "ne"; break; }
+                            case InstType::CmpLT:  { condition = "l"; break; }
+                            case InstType::CmpLTE: { condition = "le"; break; }
+                            case InstType::CmpGT:  { condition = "g"; break; }
+                            case InstType::CmpGTE: { condition = "ge"; break; }
+                            default: { break; }
+                        }
+                    }
+                    break;
+                }
+                if (condition.empty())
+                {
+                    auto condVReg = getOrCreateVReg("v_" + cond->getString());
+                    bbMIR->addInstruction(std::make_shared<TestMIR>(condVReg, condVReg));
+                    condition = "ne";
+                }
+
+                // target = false value, then cmov the true value over it.
+                // cmov takes no immediate.
+                if (trueMIR->getMIRType() == MIRType::Const)
+                {
+                    auto trueVReg = createTempVReg();
+                    bbMIR->addInstruction(std::make_shared<MovMIR>(
+                        std::vector<std::shared_ptr<MachineIR>>{trueVReg, trueMIR}));
+                    trueMIR = trueVReg;
+                }
+                legalizeMov(bbMIR, targetVReg, falseMIR);
+                bbMIR->addInstruction(std::make_shared<CmovMIR>(
+                    std::vector<std::shared_ptr<MachineIR>>{targetVReg, trueMIR},
+                    condition));
+            }
             else if (instType == InstType::Jump)
             {
                 auto jumpInst = std::dynamic_pointer_cast<JumpInst>(inst[j]);
                 auto targetBB = jumpInst->getJumpTarget();
 
+                // The next block in the layout is reached by falling through
+                if (i + 1 < rpo.size() && rpo[i + 1] == targetBB)
+                {
+                    continue;
+                }
+
                 // Unconditional jump to the label of the target BasicBlock
                 auto jmpMIR = std::make_shared<JmpMIR>(targetBB->getName());
                 bbMIR->addInstruction(jmpMIR);
@@ -795,6 +892,17 @@ void CodeGen::generateMIR(bool isMain)
                     targetFailed = brf->getTargetFailed();
                 }
 
+                // A constant condition always takes the same edge
+                if (cond->getInstType() == InstType::BoolConst ||
+                    cond->getInstType() == InstType::IntConst)
+                {
+                    auto condMIR = std::dynamic_pointer_cast<ConstMIR>(operandToMIR(cond));
+                    bool isTaken = (condMIR->getConst() != 0) == isBRT;
+                    bbMIR->addInstruction(std::make_shared<JmpMIR>(
+                        isTaken ? targetSuccess->getName() : targetFailed->getName()));
+                    continue;
+                }
+
                 // Fetch the existing VReg for the condition variable
                 auto condVReg = getOrCreateVReg("v_" + cond->getString());
 
@@ -802,6 +910,15 @@ void CodeGen::generateMIR(bool isMain)
                 // test condVReg, condVReg sets ZF=1 if value is 0, ZF=0 if value is 1
                 bbMIR->addInstruction(std::make_shared<TestMIR>(condVReg, condVReg));
 
+                // When the success target comes next in the layout, branch
+                // to the failed target on the opposite condition instead
+                auto nextBB = i + 1 < rpo.size() ? rpo[i + 1] : nullptr;
+                if (targetSuccess == nextBB && targetFailed != nextBB)
+                {
+                    std::swap(targetSuccess, targetFailed);
+                    isBRT = !isBRT;
+                }
+
                 if (isBRT)
                 {
                     // BRT: Jump to success label if vreg != 0 (ZF=0)
@@ -813,8 +930,12 @@ void CodeGen::generateMIR(bool isMain)
                     bbMIR->addInstruction(std::make_shared<JzMIR>(targetSuccess->getName()));
                 }
 
-                // Unconditional jump to the failed target (the "else" path)
-                bbMIR->addInstruction(std::make_shared<JmpMIR>(targetFailed->getName()));
+                // Unconditional jump to the failed target (the "else" path),
+                // unless it is reached by falling through
+                if (targetFailed != nextBB)
+                {
+                    bbMIR->addInstruction(std::make_shared<JmpMIR>(targetFailed->getName()));
+                }
             }
             else if (instType == InstType::Alloca)
             {
@@ -839,6 +960,7 @@ void CodeGen::generateMIR(bool isMain)
                 bool isUpdate = (instType == InstType::ArrUpdate);
                 std::string arrayName;
                 std::shared_ptr<Inst> indexOperand;
+                bool isIndexScaled;
 
                 std::shared_ptr<ArrUpdateInst> arrUpdate = nullptr;
                 std::shared_ptr<ArrAccessInst> arrAccess = nullptr;
@@ -849,6 +971,7 @@ void CodeGen::generateMIR(bool isMain)
                     std::string sourceArrayName = arrUpdate->getSource()->getTarget()->getString();
                     arrayName = arrUpdate->getTarget()->getString();
                     indexOperand = arrUpdate->getIndex()->getTarget();
+                    isIndexScaled = arrUpdate->isIndexScaled();
 
                     std::string sourceVRegName = "v_" + sourceArrayName;
                     if (vRegToOffset.find(sourceVRegName) != vRegToOffset.end())
@@ -869,29 +992,50 @@ void CodeGen::generateMIR(bool isMain)
                     arrAccess = std::dynamic_pointer_cast<ArrAccessInst>(inst[j]);
                     arrayName = arrAccess->getSource()->getTarget()->getString();
                     indexOperand = arrAccess->getIndex()->getTarget();
+                    isIndexScaled = arrAccess->isIndexScaled();
+                }
+
+                // An index outside of the array leaves through the bounds
+                // error routine. Compared unsigned, negative indices fail too.
+                bool needsCheck = isUpdate ? arrUpdate->needsBoundsCheck()
+                                           : arrAccess->needsBoundsCheck();
+                if (m_boundsCheck && needsCheck)
+                {
+                    auto sizeIt = arrVRegToSize.find(arrayName);
+                    if (sizeIt == arrVRegToSize.end())
+                    {
+                        throw std::runtime_error("CodeGen Error: Size of array not known for bounds check: " + arrayName);
+                    }
+                    int bound = static_cast<int>(sizeIt->second);
+                    if (isIndexScaled)
+                    {
+                        bound *= 8;
+                    }
+
+                    auto indexMIR = operandToMIR(indexOperand);
+                    if (indexMIR->getMIRType() == MIRType::Const)
+                    {
+                        auto indexVReg = createTempVReg();
+                        bbMIR->addInstruction(std::make_shared<MovMIR>(
+                            std::vector<std::shared_ptr<MachineIR>>{indexVReg, indexMIR}));
+                        indexMIR = indexVReg;
+                    }
+                    bbMIR->addInstruction(std::make_shared<CmpMIR>(
+                        std::vector<std::shared_ptr<MachineIR>>{
+                            indexMIR, std::make_shared<ConstMIR>(bound)}));
+                    bbMIR->addInstruction(std::make_shared<JaeMIR>("bounds_error"));
                 }
 
                 // Rematerialize element address (e.g., lea finalAddrVReg, [rbp - offset])
                 auto finalAddrVReg =
-                    resolveArrayAddress("v_" + arrayName, indexOperand);
+                    resolveArrayAddress("v_" + arrayName, indexOperand, isIndexScaled);
 
                 // Create the memory operand [finalAddrVReg + 0]
                 auto memOp = std::make_shared<MemoryMIR>(finalAddrVReg, 0);
 
                 if (isUpdate)
                 {
-                    auto value = arrUpdate->getVal()->getTarget();
-                    std::shared_ptr<MachineIR> valSource;
-
-                    if (value->getInstType() == InstType::IntConst)
-                    {
-                        valSource = std::make_shared<ConstMIR>(
-                            std::dynamic_pointer_cast<IntConstInst>(value)->getVal());
-                    }
-                    else
-                    {
-                        valSource = getOrCreateVReg("v_" + value->getString());
-                    }
+                    auto valSource = operandToMIR(arrUpdate->getVal());
 
                     // Prevents mov QWORD PTR [reg_addr], QWORD PTR [stack_slot]
                     legalizeMov(bbMIR, memOp, valSource);
@@ -908,10 +1052,21 @@ void CodeGen::generateMIR(bool isMain)
 
         // Last processing for the basic block
         // Make sure the terminal block have no successors and
-        // end with RetMIR
-        auto& lastInst = currBlock->getInstructions().back();
-        if (lastInst->getInstType() == InstType::Return ||
-            lastInst->getInstType() == InstType::Halt)
+        // end with RetMIR. A procedure may end with an empty block.
+        auto isTerminal = [&]()
+        {
+            if (endsWithTailCall)
+            {
+                return true;
+            }
+            if (inst.empty())
+            {
+                return false;
+            }
+            auto lastType = inst.back()->getInstType();
+            return lastType == InstType::Return || lastType == InstType::Halt;
+        };
+        if (isTerminal())
         {
             // TERMINAL BLOCK: Clear successors to break the circle
             currBlock->getSuccessors().clear();
@@ -947,28 +1102,27 @@ void CodeGen::generateMIR(bool isMain)
     // Initialize Allocator
     RegisterAllocator ra(std::move(m_mirBlocks));
     std::set<int> usedCalleeSaved = ra.getUsedCalleeSavedRegs();
-    size_t pushed_regs_size = (usedCalleeSaved.size() + 1) * 8;  // RBP + Callee
 
     // Base Offset for Spills
-    // Spills start immediately after Pushed Regs + Pinned Variables.
-    // We do NOT add 32 here. This keeps spills "high" in the stack.
-    int reserved_base_offset = static_cast<int>(pushed_regs_size + pinned_size);
+    // The callee-saved registers are pushed before RBP is set up, so the
+    // frame below RBP starts with the Pinned Variables and the spills follow
+    // them. We do NOT add 32 here. This keeps spills "high" in the stack.
+    int reserved_base_offset = static_cast<int>(pinned_size);
 
     // Run Replacement
-    // Now spills will generate offsets like [rbp - 40], [rbp - 48]
+    // Now spills will generate offsets like [rbp - pinned_size - 8],
+    // [rbp - pinned_size - 16]
     m_mirBlocks = ra.replaceVirtualRegisters(m_vregMap, reserved_base_offset);
 
     // Final Stack Math
     // NOW we add the 32 bytes for Shadow Space to the total size.
-    // The layout is: [Pushed] [Pinned] [Spills] [Shadow Space] [RSP]
-    size_t total_stack_growth =
-        pinned_size + ra.getSpillAreaSize() + 32 + pushed_regs_size;
+    // The layout is: [push rbp] [Callee-saved] RBP-> [Pinned] [Spills]
+    // [Shadow Space] [RSP]
 
     // Alignment (Total Frame must be multiple of 16)
-    // We align the entire growth (Pushed Callee + Local Frame) excluding RBP
-    // Actually, simply ensuring (CalleePushes + SubAmount) % 16 == 0 is the
-    // goal. Since 'pushed_regs_size' includes RBP (8 bytes), let's separate
-    // them.
+    // The call pushed the return address and the prologue pushes RBP, which
+    // together keep RSP aligned. What moves RSP after that, the callee-saved
+    // pushes and the 'sub rsp', must add up to a multiple of 16.
     size_t callee_pushes = usedCalleeSaved.size() * 8;
     size_t local_frame = pinned_size + ra.getSpillAreaSize() + 32;
 
@@ -986,13 +1140,13 @@ void CodeGen::generateMIR(bool isMain)
 
     // Prologue
     std::cout << "    push rbp\n";
-    std::cout << "    mov rbp, rsp\n";
 
     // Pushes for callee-saved registers identified by the allocator
     for (int regID : usedCalleeSaved)
     {
         std::cout << "    push " << mina::getReg((mina::RegID)regID)->get64BitName() << "\n";
     }
+    std::cout << "    mov rbp, rsp\n";
 
     // Allocate the calculated gap
     if (prologue_sub_amount > 0)
@@ -1000,46 +1154,223 @@ void CodeGen::generateMIR(bool isMain)
         std::cout << "    sub rsp, " << prologue_sub_amount << "\n";
     }
 
+    // Tears the frame down, a tail call does it before jumping to the callee
+    auto printFrameTeardown = [&]()
+    {
+        std::cout << "    mov rsp, rbp\n";
+
+        // Restore registers in reverse order
+        for (auto it = usedCalleeSaved.rbegin(); it != usedCalleeSaved.rend(); ++it)
+        {
+            std::cout << "    pop " << mina::getReg((mina::RegID)*it)->get64BitName() << "\n";
+        }
+
+        if (isMain)
+        {
+            std::cout << "    xor rax, rax\n";  // Default return value for main"
+        }
+        std::cout << "    pop rbp\n";
+    };
+
     // Body: Print the transformed instructions
+    // Blocks ending in a return or halt that are not laid out last jump to
+    // the epilogue instead of falling into the next block
+    auto epilogueLabel = m_mirBlocks.front()->getName() + "_epilogue";
     int blockCtr = 0;
     for (const auto& mirBlock : m_mirBlocks)
     {
         if (blockCtr++ > 0) std::cout << mirBlock->getName() << ": \n";
+
+        auto& insts = mirBlock->getInstructions();
+        auto tailCall = std::find_if(
+            insts.begin(), insts.end(),
+            [](const std::shared_ptr<MachineIR>& inst)
+            {
+                auto call = std::dynamic_pointer_cast<CallMIR>(inst);
+                return call && call->isTailCall();
+            });
+        if (tailCall != insts.end())
+        {
+            for (auto it = insts.begin(); it != tailCall; ++it)
+            {
+                std::cout << "    " << (*it)->getString() << "\n";
+            }
+            printFrameTeardown();
+            std::cout << "    " << (*tailCall)->getString() << "\n";
+            continue;
+        }
+
         mirBlock->printInstructions();
+        if (mirBlock != m_mirBlocks.back() && !insts.empty() &&
+            insts.back()->getMIRType() == MIRType::Ret)
+        {
+            std::cout << "    jmp " << epilogueLabel << "\n";
+        }
     }
 
     // Epilogue
-    if (prologue_sub_amount > 0)
+    std::cout << epilogueLabel << ": \n";
+    printFrameTeardown();
+    std::cout << "    ret\n";
+}
+
+void CodeGen::addSSA(std::string funcName, SSA& ssa)
+{
+    if (m_functionSSAMap.find(funcName) != m_functionSSAMap.end())
+    {
+        throw std::runtime_error("SSA for function '" + funcName + "' already exists in CodeGen.");
+    }
+    m_functionSSAMap[funcName] = ssa;
+}
+
+void CodeGen::removeUnreachableFunctions()
+{
+    CallGraph callGraph(m_ssa, m_functionSSAMap);
+    for (auto& funcName : callGraph.getUnreachable())
+    {
+        m_functionSSAMap.erase(funcName);
+    }
+}
+
+bool CodeGen::isMemoizable(const std::string& funcName)
+{
+    auto& summary = m_callGraph->getSummary(funcName);
+    if (!summary.isPure || !summary.isRecursive)
+    {
+        return false;
+    }
+
+    auto entry = m_functionSSAMap.at(funcName).getCFG();
+    auto& insts = entry->getInstructions();
+    auto signature =
+        insts.empty() ? nullptr : std::dynamic_pointer_cast<Func>(insts.front());
+    if (!signature || signature->getFType() != FType::FUNC ||
+        signature->getRetType() != Type::INTEGER)
     {
-        std::cout << "    add rsp, " << prologue_sub_amount << "\n";
+        return false;
     }
 
-    // Restore registers in reverse order
-    for (auto it = usedCalleeSaved.rbegin(); it != usedCalleeSaved.rend(); ++it)
+    auto& params = signature->getParameters();
+    if (params.empty() || params.size() > 2)
     {
-        std::cout << "    pop " << mina::getReg((mina::RegID)*it)->get64BitName() << "\n";
+        return false;
     }
+    for (auto& param : params)
+    {
+        if (param->getType() != Type::INTEGER)
+        {
+            return false;
+        }
+    }
+
+    // The wrapper takes the label of the entry block, so nothing may jump
+    // back to it
+    return entry->getPredecessors().empty();
+}
 
-    if (isMain)
+void CodeGen::printMemoWrapper(const std::string& funcName)
+{
+    auto entry = m_functionSSAMap.at(funcName).getCFG();
+    auto signature =
+        std::dynamic_pointer_cast<Func>(entry->getInstructions().front());
+    auto bodyLabel = funcName + "_memo_body";
+    auto missLabel = funcName + "_memo_miss";
+
+    // Arguments outside the table go straight to the body, negative ones
+    // compare above the range as unsigned. r11 gets the entry offset.
+    std::cout << funcName << ": \n";
+    if (signature->getParameters().size() == 1)
+    {
+        std::cout << "    cmp rcx, " << MemoTableSize << "\n";
+        std::cout << "    jae " << bodyLabel << "\n";
+        std::cout << "    mov r11, rcx\n";
+    }
+    else
     {
-        std::cout << "    xor rax, rax\n";  // Default return value for main"
+        std::cout << "    cmp rcx, " << MemoTwoParamRange << "\n";
+        std::cout << "    jae " << bodyLabel << "\n";
+        std::cout << "    cmp rdx, " << MemoTwoParamRange << "\n";
+        std::cout << "    jae " << bodyLabel << "\n";
+        std::cout << "    mov r11, rcx\n";
+        std::cout << "    imul r11, " << MemoTwoParamRange << "\n";
+        std::cout << "    add r11, rdx\n";
     }
-    std::cout << "    mov rsp, rbp\n";
-    std::cout << "    pop rbp\n";
+    std::cout << "    shl r11, 4\n";
+    std::cout << "    lea r10, QWORD PTR [rip + " << funcName << "_memo]\n";
+    std::cout << "    add r10, r11\n";
+    std::cout << "    cmp QWORD PTR [r10], 0\n";
+    std::cout << "    je " << missLabel << "\n";
+    std::cout << "    mov rax, QWORD PTR [r10 + 8]\n";
+    std::cout << "    ret\n";
+
+    // The body runs in its own frame, with the entry address saved across
+    // the call. The push and the shadow space keep the stack aligned.
+    std::cout << missLabel << ": \n";
+    std::cout << "    push r10\n";
+    std::cout << "    sub rsp, 32\n";
+    std::cout << "    call " << bodyLabel << "\n";
+    std::cout << "    add rsp, 32\n";
+    std::cout << "    pop r10\n";
+    std::cout << "    mov QWORD PTR [r10], 1\n";
+    std::cout << "    mov QWORD PTR [r10 + 8], rax\n";
     std::cout << "    ret\n";
 }
 
-void CodeGen::addSSA(std::string funcName, SSA& ssa)
+void CodeGen::optimize()
 {
-    if (m_functionSSAMap.find(funcName) != m_functionSSAMap.end())
+    PassManager passManager(getCompilerOptions());
+    passManager.addDefaultPipeline(m_functionSSAMap);
+    m_tailCalls = passManager.isEnabled("tail-calls", 2);
+
+    // Trades memory for time, so only -fmemoize turns it on
+    m_memoize = passManager.isEnabled("memoize", PassManager::OptInOnly);
+    m_callClobbers = passManager.isEnabled("ipra", 1);
+    m_boundsCheck = passManager.isEnabled("bounds-check", PassManager::OptInOnly);
+
+    bool removeDeadFunctions = passManager.isEnabled("dead-functions", 1);
+    if (removeDeadFunctions)
     {
-        throw std::runtime_error("SSA for function '" + funcName + "' already exists in CodeGen.");
+        removeUnreachableFunctions();
     }
-    m_functionSSAMap[funcName] = ssa;
+
+    // Callees are optimized before their callers, so calls are inlined from
+    // optimized bodies
+    auto runFunctionPasses = [&]()
+    {
+        CallGraph callGraph(m_ssa, m_functionSSAMap);
+        for (auto& scc : callGraph.getSCCs())
+        {
+            for (auto& funcName : scc)
+            {
+                passManager.run(funcName == CallGraph::MainName
+                                    ? m_ssa
+                                    : m_functionSSAMap.at(funcName),
+                                funcName);
+            }
+        }
+    };
+    runFunctionPasses();
+
+    // Constants moved across calls make the callees foldable
+    if (passManager.runModulePasses(m_ssa, m_functionSSAMap))
+    {
+        runFunctionPasses();
+    }
+
+    // Inlining leaves routines nobody calls anymore
+    if (removeDeadFunctions)
+    {
+        removeUnreachableFunctions();
+    }
+    m_callGraph = std::make_shared<CallGraph>(m_ssa, m_functionSSAMap);
+
+    passManager.printTimingReport();
 }
 
 void CodeGen::generateAllFunctionsMIR()
 {
+    optimize();
+
     // Global prologue
     std::cout << std::endl << std::endl;
     std::cout << ".intel_syntax noprefix\n.globl main\n";
@@ -1053,22 +1384,79 @@ void CodeGen::generateAllFunctionsMIR()
     m_stringLiterals.insert("false_str");
     m_stringLiterals.insert("newline_str");
 
-    // Generate MIR for main function first
-    m_ssa.renameSSA();
-    //m_ssa.printCFG();
-    generateMIR(/*isMain=*/ true);
+    // Callees are generated before their callers, which then know the
+    // registers their calls clobber. Main comes last.
+    auto mainSSA = m_ssa;
+    for (auto& scc : m_callGraph->getSCCs())
+    {
+        for (auto& funcName : scc)
+        {
+            if (funcName == CallGraph::MainName)
+            {
+                m_ssa = mainSSA;
+                m_ssa.renameSSA();
+                //m_ssa.printCFG();
+                std::cout << "\n";
+                generateMIR(/*isMain=*/ true);
+                continue;
+            }
+
+            bool isMemoized = m_memoize && isMemoizable(funcName);
+            m_ssa = m_functionSSAMap.at(funcName);
+            m_ssa.renameSSA();
+            //m_ssa.printCFG();
+            std::cout << "\n";
+            if (isMemoized)
+            {
+                printMemoWrapper(funcName);
+                std::cout << funcName << "_memo_body: \n";
+                m_memoized.push_back(funcName);
+            }
+            else
+            {
+                std::cout << funcName << ": \n";
+            }
+            generateMIR();
+
+            auto clobberedRegs = getClobberedRegs(m_mirBlocks);
+            if (isMemoized)
+            {
+                clobberedRegs.insert(to_int(RegID::RAX));
+                clobberedRegs.insert(to_int(RegID::R10));
+                clobberedRegs.insert(to_int(RegID::R11));
+            }
+            m_callGraph->setClobberedRegs(funcName, clobberedRegs);
+        }
+    }
 
-    for (auto& [funcName, ssa] : m_functionSSAMap)
+    // Reached by a failed bounds check from anywhere in a routine, so the
+    // stack is realigned before reporting the error and exiting
+    if (m_boundsCheck)
     {
-        m_ssa = ssa;
-        m_ssa.renameSSA();
-        //m_ssa.printCFG();
-        std::cout << "\n" << funcName << ": \n";
-        generateMIR();
+        std::cout << "\nbounds_error: \n";
+        std::cout << "    and rsp, -16\n";
+        std::cout << "    sub rsp, 32\n";
+        std::cout << "    lea rcx, QWORD PTR [rip + bounds_str]\n";
+        std::cout << "    call printf\n";
+        std::cout << "    mov rcx, 1\n";
+        std::cout << "    call exit\n";
+        std::cout << "bounds_str: .string \"index out of bounds\\n\"\n";
     }
 
     // Global epilogue
     std::cout << "\nnewline_str: .string \"\\n\"\n";
+
+    // Memo tables start out zeroed, with no entry filled
+    if (!m_memoized.empty())
+    {
+        std::cout << ".section .bss\n";
+        for (auto& funcName : m_memoized)
+        {
+            std::cout << ".balign 16\n";
+            std::cout << funcName << "_memo: .zero " << MemoTableSize * 16
+                      << "\n";
+        }
+    }
     std::cout << "\n";
 }
 
@@ -1,41 +1,71 @@
 #include "DisjointSetUnion.hpp"
 
+#include <vector>
+#include <utility>
+
 namespace mina
 {
 
-// Adds a new variable to the DSU, initially in its own set.
-void DisjointSetUnion::make_set(const std::string& v)
+DisjointSetUnion::DisjointSetUnion(int size) { reset(size); }
+
+void DisjointSetUnion::reset(int size)
 {
-    if (parent.find(v) == parent.end())
+    parent.clear();
+    rank.clear();
+    for (int v = 0; v < size; ++v)
     {
-        parent[v] = v;
+        make_set();
     }
 }
 
-// Finds the representative (root) of the set containing variable v.
-std::string DisjointSetUnion::find(const std::string& v)
+int DisjointSetUnion::size() const { return static_cast<int>(parent.size()); }
+
+int DisjointSetUnion::make_set()
 {
-    // If v is not in the map, add it.
-    make_set(v);
+    auto v = size();
+    parent.push_back(v);
+    rank.push_back(0);
+    return v;
+}
 
-    // Find the root with path compression for efficiency.
-    if (parent[v] == v)
+int DisjointSetUnion::find(int v)
+{
+    auto root = v;
+    while (parent[root] != root)
     {
-        return v;
+        root = parent[root];
     }
-    return parent[v] = find(parent[v]);
+
+    // Point everything on the path straight at the root
+    while (parent[v] != root)
+    {
+        auto next = parent[v];
+        parent[v] = root;
+        v = next;
+    }
+    return root;
 }
 
-// Merges the sets containing variables u and v.
-void DisjointSetUnion::unite(const std::string& u, const std::string& v)
+bool DisjointSetUnion::unite(int u, int v)
 {
-    std::string root_u = find(u);
-    std::string root_v = find(v);
-    if (root_u != root_v)
+    auto rootU = find(u);
+    auto rootV = find(v);
+    if (rootU == rootV)
+    {
+        return false;
+    }
+
+    // The shallower tree goes under the deeper one
+    if (rank[rootU] < rank[rootV])
+    {
+        std::swap(rootU, rootV);
+    }
+    parent[rootV] = rootU;
+    if (rank[rootU] == rank[rootV])
     {
-        // Point the root of v's set to the root of u's set.
-        parent[root_v] = root_u;
+        ++rank[rootU];
     }
+    return true;
 }
 
 }  // namespace mina
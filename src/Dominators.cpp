@@ -0,0 +1,508 @@
+#include "Dominators.hpp"
+#include "BasicBlock.hpp"
+#include "MachineIR.hpp"
+
+#include <memory>
+#include <vector>
+#include <utility>
+#include <iostream>
+#include <algorithm>
+#include <unordered_set>
+#include <unordered_map>
+
+namespace mina
+{
+
+template <typename BlockT>
+std::vector<std::shared_ptr<BlockT>> computeRPO(
+    const std::shared_ptr<BlockT>& entry)
+{
+    std::vector<std::shared_ptr<BlockT>> postOrder;
+    if (!entry)
+    {
+        return postOrder;
+    }
+
+    // Explicit stack of (block, successors, next successor to visit) so deep
+    // CFGs don't overflow the call stack. Successors are visited from the
+    // last one to the first one, which gives the same order as getRPONodes.
+    struct Frame
+    {
+        std::shared_ptr<BlockT> block;
+        std::vector<std::shared_ptr<BlockT>> succs;
+        int next;
+    };
+
+    std::unordered_set<BlockT*> visited;
+    std::vector<Frame> stack;
+    visited.insert(entry.get());
+    stack.push_back({entry, entry->getSuccessors(), 0});
+    stack.back().next = static_cast<int>(stack.back().succs.size()) - 1;
+
+    while (!stack.empty())
+    {
+        auto& frame = stack.back();
+        if (frame.next < 0)
+        {
+            postOrder.push_back(frame.block);
+            stack.pop_back();
+            continue;
+        }
+
+        auto succ = frame.succs[frame.next--];
+        if (succ && visited.insert(succ.get()).second)
+        {
+            stack.push_back({succ, succ->getSuccessors(), 0});
+            stack.back().next = static_cast<int>(stack.back().succs.size()) - 1;
+        }
+    }
+
+    std::reverse(postOrder.begin(), postOrder.end());
+    return postOrder;
+}
+
+template <typename BlockT>
+DominatorTreeBase<BlockT>::DominatorTreeBase(BlockPtr entry,
+                                             bool isPostDominator)
+    : m_isPostDominator{isPostDominator}
+{
+    auto blocks = computeRPO(entry);
+    if (blocks.empty())
+    {
+        return;
+    }
+
+    // For post-dominators node 0 is the virtual exit, real blocks start at 1
+    int offset = m_isPostDominator ? 1 : 0;
+    if (m_isPostDominator)
+    {
+        m_nodes.push_back(nullptr);
+    }
+    for (auto& block : blocks)
+    {
+        m_index[block.get()] = static_cast<int>(m_nodes.size());
+        m_nodes.push_back(block);
+    }
+
+    int numNodes = static_cast<int>(m_nodes.size());
+    std::vector<std::vector<int>> fwdSuccs(numNodes), fwdPreds(numNodes);
+    for (int i = offset; i < numNodes; ++i)
+    {
+        for (auto& succ : m_nodes[i]->getSuccessors())
+        {
+            auto it = m_index.find(succ.get());
+            if (it != m_index.end())
+            {
+                fwdSuccs[i].push_back(it->second);
+            }
+        }
+        for (auto& pred : m_nodes[i]->getPredecessors())
+        {
+            // Predecessors that are unreachable from the entry are ignored
+            auto it = m_index.find(pred.get());
+            if (it != m_index.end())
+            {
+                fwdPreds[i].push_back(it->second);
+            }
+        }
+    }
+
+    if (!m_isPostDominator)
+    {
+        build(fwdSuccs, fwdPreds);
+        return;
+    }
+
+    // Reverse the graph and connect the exits to the virtual exit
+    auto& succs = fwdPreds;
+    auto& preds = fwdSuccs;
+    for (int i = offset; i < numNodes; ++i)
+    {
+        if (preds[i].empty())
+        {
+            succs[Root].push_back(i);
+            preds[i].push_back(Root);
+        }
+    }
+
+    // Blocks that can't reach an exit get an artificial edge from the virtual
+    // exit. The block latest in forward RPO is picked first since it is the
+    // one closest to the bottom of the infinite loop.
+    std::vector<bool> reached(numNodes, false);
+    std::vector<int> worklist{Root};
+    reached[Root] = true;
+    int candidate = numNodes - 1;
+    while (true)
+    {
+        while (!worklist.empty())
+        {
+            int node = worklist.back();
+            worklist.pop_back();
+            for (int succ : succs[node])
+            {
+                if (!reached[succ])
+                {
+                    reached[succ] = true;
+                    worklist.push_back(succ);
+                }
+            }
+        }
+
+        while (candidate > Root && reached[candidate])
+        {
+            --candidate;
+        }
+        if (candidate == Root)
+        {
+            break;
+        }
+
+        succs[Root].push_back(candidate);
+        preds[candidate].push_back(Root);
+        reached[candidate] = true;
+        worklist.push_back(candidate);
+    }
+
+    build(succs, preds);
+}
+
+template <typename BlockT>
+void DominatorTreeBase<BlockT>::build(
+    const std::vector<std::vector<int>>& succs,
+    const std::vector<std::vector<int>>& preds)
+{
+    int numNodes = static_cast<int>(m_nodes.size());
+
+    // Reverse post-order of the analysed graph starting from the root
+    std::vector<int> postOrder;
+    std::vector<bool> visited(numNodes, false);
+    std::vector<std::pair<int, int>> stack{{Root, 0}};
+    visited[Root] = true;
+    while (!stack.empty())
+    {
+        auto& [node, next] = stack.back();
+        if (next == static_cast<int>(succs[node].size()))
+        {
+            postOrder.push_back(node);
+            stack.pop_back();
+            continue;
+        }
+        int succ = succs[node][next++];
+        if (!visited[succ])
+        {
+            visited[succ] = true;
+            stack.push_back({succ, 0});
+        }
+    }
+    std::vector<int> order(postOrder.rbegin(), postOrder.rend());
+
+    std::vector<int> rpoNumber(numNodes, None);
+    for (int i = 0; i < static_cast<int>(order.size()); ++i)
+    {
+        rpoNumber[order[i]] = i;
+    }
+
+    m_idom.assign(numNodes, None);
+    m_idom[Root] = Root;
+    bool changed = true;
+    while (changed)
+    {
+        changed = false;
+        for (int i = 1; i < static_cast<int>(order.size()); ++i)
+        {
+            int node = order[i];
+            int newIDom = None;
+            for (int pred : preds[node])
+            {
+                if (m_idom[pred] == None)
+                {
+                    continue;
+                }
+                newIDom = newIDom == None ? pred
+                                          : intersect(pred, newIDom, rpoNumber);
+            }
+            if (newIDom != m_idom[node])
+            {
+                m_idom[node] = newIDom;
+                changed = true;
+            }
+        }
+    }
+
+    std::vector<std::vector<int>> children(numNodes);
+    for (int node : order)
+    {
+        if (node != Root)
+        {
+            children[m_idom[node]].push_back(node);
+        }
+    }
+
+    m_children.assign(numNodes, {});
+    for (int node = 0; node < numNodes; ++node)
+    {
+        for (int child : children[node])
+        {
+            m_children[node].push_back(m_nodes[child]);
+        }
+    }
+
+    // Number the tree so that a dominates b iff a's interval encloses b's
+    m_level.assign(numNodes, 0);
+    m_dfsIn.assign(numNodes, 0);
+    m_dfsOut.assign(numNodes, 0);
+    unsigned int counter = 0;
+    std::vector<std::pair<int, size_t>> dfsStack{{Root, 0}};
+    m_dfsIn[Root] = counter++;
+    while (!dfsStack.empty())
+    {
+        auto& [node, next] = dfsStack.back();
+        if (next == children[node].size())
+        {
+            m_dfsOut[node] = counter++;
+            dfsStack.pop_back();
+            continue;
+        }
+        int child = children[node][next++];
+        m_dfsIn[child] = counter++;
+        m_level[child] = node == Root && m_isPostDominator
+                             ? 0
+                             : m_level[node] + 1;
+        dfsStack.push_back({child, 0});
+    }
+
+    // Dominance frontiers, computed by walking up from the predecessors of
+    // every join point until its immediate dominator is reached
+    std::vector<std::vector<int>> frontier(numNodes);
+    for (int node : order)
+    {
+        if (preds[node].size() < 2)
+        {
+            continue;
+        }
+        for (int pred : preds[node])
+        {
+            int runner = pred;
+            while (runner != None && runner != m_idom[node])
+            {
+                if (frontier[runner].empty() || frontier[runner].back() != node)
+                {
+                    frontier[runner].push_back(node);
+                }
+                runner = runner == Root ? None : m_idom[runner];
+            }
+        }
+    }
+
+    m_frontier.assign(numNodes, {});
+    for (int node = 0; node < numNodes; ++node)
+    {
+        for (int f : frontier[node])
+        {
+            m_frontier[node].push_back(m_nodes[f]);
+        }
+    }
+
+    for (int node : order)
+    {
+        if (m_nodes[node])
+        {
+            m_blocks.push_back(m_nodes[node]);
+        }
+    }
+    m_roots = m_isPostDominator ? m_children[Root]
+                                : std::vector<BlockPtr>{m_nodes[Root]};
+}
+
+template <typename BlockT>
+int DominatorTreeBase<BlockT>::intersect(
+    int a, int b, const std::vector<int>& rpoNumber) const
+{
+    while (a != b)
+    {
+        while (rpoNumber[a] > rpoNumber[b])
+        {
+            a = m_idom[a];
+        }
+        while (rpoNumber[b] > rpoNumber[a])
+        {
+            b = m_idom[b];
+        }
+    }
+    return a;
+}
+
+template <typename BlockT>
+int DominatorTreeBase<BlockT>::indexOf(const BlockPtr& block) const
+{
+    if (!block)
+    {
+        return None;
+    }
+    auto it = m_index.find(block.get());
+    return it == m_index.end() ? None : it->second;
+}
+
+template <typename BlockT>
+bool DominatorTreeBase<BlockT>::isPostDominator() const
+{
+    return m_isPostDominator;
+}
+
+template <typename BlockT>
+const std::vector<std::shared_ptr<BlockT>>&
+DominatorTreeBase<BlockT>::getBlocks() const
+{
+    return m_blocks;
+}
+
+template <typename BlockT>
+bool DominatorTreeBase<BlockT>::contains(const BlockPtr& block) const
+{
+    return indexOf(block) != None;
+}
+
+template <typename BlockT>
+std::shared_ptr<BlockT> DominatorTreeBase<BlockT>::getIDom(
+    const BlockPtr& block) const
+{
+    int node = indexOf(block);
+    if (node == None || node == Root)
+    {
+        return nullptr;
+    }
+    return m_nodes[m_idom[node]];
+}
+
+template <typename BlockT>
+const std::vector<std::shared_ptr<BlockT>>&
+DominatorTreeBase<BlockT>::getChildren(const BlockPtr& block) const
+{
+    static const std::vector<BlockPtr> empty;
+    int node = indexOf(block);
+    return node == None ? empty : m_children[node];
+}
+
+template <typename BlockT>
+const std::vector<std::shared_ptr<BlockT>>&
+DominatorTreeBase<BlockT>::getRoots() const
+{
+    return m_roots;
+}
+
+template <typename BlockT>
+unsigned int DominatorTreeBase<BlockT>::getLevel(const BlockPtr& block) const
+{
+    int node = indexOf(block);
+    return node == None ? 0 : m_level[node];
+}
+
+template <typename BlockT>
+bool DominatorTreeBase<BlockT>::dominates(const BlockPtr& a,
+                                          const BlockPtr& b) const
+{
+    int nodeA = indexOf(a);
+    int nodeB = indexOf(b);
+    if (nodeA == None || nodeB == None)
+    {
+        return false;
+    }
+    return m_dfsIn[nodeA] <= m_dfsIn[nodeB] &&
+           m_dfsOut[nodeB] <= m_dfsOut[nodeA];
+}
+
+template <typename BlockT>
+bool DominatorTreeBase<BlockT>::strictlyDominates(const BlockPtr& a,
+                                                  const BlockPtr& b) const
+{
+    return a != b && dominates(a, b);
+}
+
+template <typename BlockT>
+std::shared_ptr<BlockT> DominatorTreeBase<BlockT>::findNearestCommonDominator(
+    const BlockPtr& a, const BlockPtr& b) const
+{
+    int nodeA = indexOf(a);
+    int nodeB = indexOf(b);
+    if (nodeA == None || nodeB == None)
+    {
+        return nullptr;
+    }
+
+    // Walk up from the block that is deeper in the tree until both meet
+    while (nodeA != nodeB)
+    {
+        if (m_dfsIn[nodeA] <= m_dfsIn[nodeB] &&
+            m_dfsOut[nodeB] <= m_dfsOut[nodeA])
+        {
+            return m_nodes[nodeA];
+        }
+        nodeA = m_idom[nodeA];
+    }
+    return m_nodes[nodeA];
+}
+
+template <typename BlockT>
+const std::vector<std::shared_ptr<BlockT>>&
+DominatorTreeBase<BlockT>::getDominanceFrontier(const BlockPtr& block) const
+{
+    static const std::vector<BlockPtr> empty;
+    int node = indexOf(block);
+    return node == None ? empty : m_frontier[node];
+}
+
+template <typename BlockT>
+std::vector<std::shared_ptr<BlockT>> DominatorTreeBase<BlockT>::getPreOrder()
+    const
+{
+    std::vector<BlockPtr> preOrder;
+    if (m_nodes.empty())
+    {
+        return preOrder;
+    }
+
+    std::vector<int> stack{Root};
+    while (!stack.empty())
+    {
+        int node = stack.back();
+        stack.pop_back();
+        if (m_nodes[node])
+        {
+            preOrder.push_back(m_nodes[node]);
+        }
+        auto& children = m_children[node];
+        for (auto it = children.rbegin(); it != children.rend(); ++it)
+        {
+            stack.push_back(m_index.at(it->get()));
+        }
+    }
+    return preOrder;
+}
+
+template <typename BlockT>
+void DominatorTreeBase<BlockT>::print() const
+{
+    for (auto& block : m_blocks)
+    {
+        auto idom = getIDom(block);
+        std::cout << (m_isPostDominator ? "ipdom(" : "idom(")
+                  << block->getName() << ") = "
+                  << (idom ? idom->getName()
+                           : std::string(m_isPostDominator ? "<exit>" : "-"))
+                  << ", frontier:";
+        for (auto& f : getDominanceFrontier(block))
+        {
+            std::cout << " " << f->getName();
+        }
+        std::cout << std::endl;
+    }
+}
+
+template std::vector<std::shared_ptr<BasicBlock>> computeRPO(
+    const std::shared_ptr<BasicBlock>&);
+template std::vector<std::shared_ptr<BasicBlockMIR>> computeRPO(
+    const std::shared_ptr<BasicBlockMIR>&);
+template class DominatorTreeBase<BasicBlock>;
+template class DominatorTreeBase<BasicBlockMIR>;
+
+}  // namespace mina
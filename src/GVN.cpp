@@ -0,0 +1,302 @@
+#include "GVN.hpp"
+#include "BasicBlock.hpp"
+#include "Dominators.hpp"
+#include "IRUtils.hpp"
+#include "InstIR.hpp"
+#include "SSA.hpp"
+
+#include <memory>
+#include <string>
+#include <vector>
+#include <utility>
+#include <unordered_map>
+
+namespace mina
+{
+
+namespace
+{
+
+class ValueNumbering
+{
+public:
+    ValueNumbering(SSA& ssa);
+
+    bool run();
+
+private:
+    SSA& m_ssa;
+
+    // Values found equal to an earlier one, mapped to the operand that
+    // replaces them
+    std::unordered_map<std::string, std::shared_ptr<Inst>> m_replacements;
+
+    // Expression key to the name of the first value computing it, and the
+    // keys added along the current dominator tree path
+    std::unordered_map<std::string, std::string> m_table;
+    std::vector<std::string> m_scopeKeys;
+
+    std::shared_ptr<Inst> lookup(std::shared_ptr<Inst> operand) const;
+    std::string operandKey(const std::shared_ptr<Inst>& operand) const;
+    std::string expressionKey(const std::shared_ptr<Inst>& inst,
+                              const std::shared_ptr<BasicBlock>& block) const;
+    bool numberBlock(const std::shared_ptr<BasicBlock>& block);
+    bool replaceUses();
+};
+
+ValueNumbering::ValueNumbering(SSA& ssa) : m_ssa{ssa}
+{
+}
+
+std::shared_ptr<Inst> ValueNumbering::lookup(std::shared_ptr<Inst> operand) const
+{
+    auto name = getValueName(operand);
+    while (!name.empty())
+    {
+        auto it = m_replacements.find(name);
+        if (it == m_replacements.end())
+        {
+            break;
+        }
+        operand = it->second;
+        name = getValueName(operand);
+    }
+    return operand;
+}
+
+std::string ValueNumbering::operandKey(const std::shared_ptr<Inst>& operand) const
+{
+    auto value = lookup(operand)->getTarget();
+    if (value->getInstType() == InstType::IntConst)
+    {
+        return "#i" +
+               std::to_string(std::dynamic_pointer_cast<IntConstInst>(value)->getVal());
+    }
+    if (value->getInstType() == InstType::BoolConst)
+    {
+        return std::string("#b") +
+               (std::dynamic_pointer_cast<BoolConstInst>(value)->getVal() ? "1" : "0");
+    }
+    return value->getString();
+}
+
+std::string ValueNumbering::expressionKey(
+    const std::shared_ptr<Inst>& inst,
+    const std::shared_ptr<BasicBlock>& block) const
+{
+    auto type = inst->getInstType();
+    auto& operands = inst->getOperands();
+
+    std::vector<std::string> keys;
+    for (auto& operand : operands)
+    {
+        keys.push_back(operandKey(operand));
+    }
+
+    switch (type)
+    {
+        case InstType::Add:
+        case InstType::Mul:
+        case InstType::And:
+        case InstType::Or:
+        case InstType::CmpEq:
+        case InstType::CmpNE:
+            if (keys[1] < keys[0])
+            {
+                std::swap(keys[0], keys[1]);
+            }
+            break;
+        case InstType::CmpGT:
+            type = InstType::CmpLT;
+            std::swap(keys[0], keys[1]);
+            break;
+        case InstType::CmpGTE:
+            type = InstType::CmpLTE;
+            std::swap(keys[0], keys[1]);
+            break;
+        case InstType::Sub:
+        case InstType::Div:
+        case InstType::Not:
+        case InstType::CmpLT:
+        case InstType::CmpLTE:
+        case InstType::Select:
+            break;
+        case InstType::ArrAccess:
+            if (std::dynamic_pointer_cast<ArrAccessInst>(inst)->isIndexScaled())
+            {
+                keys.push_back("bytes");
+            }
+            break;
+        case InstType::Phi:
+        {
+            // Phis are only equal to the phis of the same block merging the
+            // same values along the same edges
+            auto phi = std::dynamic_pointer_cast<PhiInst>(inst);
+            if (operands.empty())
+            {
+                return "";
+            }
+            for (unsigned int i = 0; i < operands.size(); ++i)
+            {
+                keys[i] += "@" + phi->getOperandBB(i)->getName();
+            }
+            keys.insert(keys.begin(), block->getName());
+            break;
+        }
+        default:
+            return "";
+    }
+
+    std::string key = std::to_string(static_cast<int>(type)) + "(";
+    for (auto& operandKey : keys)
+    {
+        key += operandKey + ",";
+    }
+    return key + ")";
+}
+
+bool ValueNumbering::numberBlock(const std::shared_ptr<BasicBlock>& block)
+{
+    bool changed = false;
+    auto& instructions = block->getInstructions();
+    for (size_t i = 0; i < instructions.size();)
+    {
+        auto& inst = instructions[i];
+        auto name = getDefinedName(inst);
+
+        // A copy has the value number of its source
+        if (inst->getInstType() == InstType::Assign)
+        {
+            auto source = lookup(inst->getOperands()[0]);
+            if (!isConstant(source))
+            {
+                auto sourceName = getValueName(source);
+                if (sourceName.empty())
+                {
+                    ++i;
+                    continue;
+                }
+                source = makeValueRef(sourceName, block);
+            }
+            m_replacements[name] = source;
+            instructions.erase(instructions.begin() + i);
+            changed = true;
+            continue;
+        }
+
+        auto key = expressionKey(inst, block);
+        if (key.empty())
+        {
+            ++i;
+            continue;
+        }
+
+        auto it = m_table.find(key);
+        if (it != m_table.end())
+        {
+            m_replacements[name] = makeValueRef(it->second, block);
+            instructions.erase(instructions.begin() + i);
+            changed = true;
+            continue;
+        }
+
+        m_table[key] = name;
+        m_scopeKeys.push_back(key);
+        ++i;
+    }
+    return changed;
+}
+
+bool ValueNumbering::replaceUses()
+{
+    bool changed = false;
+    for (auto& block : getRPONodes(m_ssa.getCFG()))
+    {
+        for (auto& inst : block->getInstructions())
+        {
+            bool isPut = inst->getInstType() == InstType::Put;
+            for (auto& operand : inst->getOperands())
+            {
+                auto name = getValueName(operand);
+                if (name.empty() || m_replacements.count(name) == 0)
+                {
+                    continue;
+                }
+
+                auto replacement = lookup(operand);
+                auto target = replacement->getTarget();
+
+                // Boolean variables are printed as numbers
+                if (isPut && target->getInstType() == InstType::BoolConst)
+                {
+                    replacement = std::make_shared<IntConstInst>(
+                        std::dynamic_pointer_cast<BoolConstInst>(target)->getVal(),
+                        block);
+                }
+                operand = replacement;
+                changed = true;
+            }
+        }
+    }
+    return changed;
+}
+
+bool ValueNumbering::run()
+{
+    auto domTree = m_ssa.getDominatorTree();
+    bool changed = false;
+
+    // Walk the dominator tree keeping, for every block on the path, the
+    // number of keys that were in scope before entering it
+    struct Frame
+    {
+        std::shared_ptr<BasicBlock> block;
+        size_t nextChild;
+        size_t scopeMark;
+    };
+    std::vector<Frame> stack;
+
+    auto enter = [&](const std::shared_ptr<BasicBlock>& block)
+    {
+        stack.push_back({block, 0, m_scopeKeys.size()});
+        changed |= numberBlock(block);
+    };
+
+    for (auto& root : domTree->getRoots())
+    {
+        enter(root);
+        while (!stack.empty())
+        {
+            auto& frame = stack.back();
+            auto& children = domTree->getChildren(frame.block);
+            if (frame.nextChild < children.size())
+            {
+                auto child = children[frame.nextChild++];
+                enter(child);
+                continue;
+            }
+
+            while (m_scopeKeys.size() > frame.scopeMark)
+            {
+                m_table.erase(m_scopeKeys.back());
+                m_scopeKeys.pop_back();
+            }
+            stack.pop_back();
+        }
+    }
+
+    changed |= replaceUses();
+    return changed;
+}
+
+}  // namespace
+
+std::string GVNPass::getName() const { return "gvn"; }
+
+bool GVNPass::run(SSA& ssa)
+{
+    ValueNumbering numbering(ssa);
+    return numbering.run();
+}
+
+}  // namespace mina
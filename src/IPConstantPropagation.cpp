@@ -0,0 +1,398 @@
+#include "IPConstantPropagation.hpp"
+#include "BasicBlock.hpp"
+#include "IRUtils.hpp"
+#include "InstIR.hpp"
+#include "SSA.hpp"
+
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+#include <unordered_set>
+
+namespace mina
+{
+
+namespace
+{
+
+// Instructions a routine may have to be specialized
+constexpr size_t MaxSpecializedSize = 200;
+
+// Clones made of one routine, counting the clones of its clones
+constexpr int MaxSpecializations = 3;
+
+// Instructions of a clone that one instruction folding away at one call site
+// pays for
+constexpr size_t SizePerFoldedInst = 4;
+
+// A branch on a constant also removes the arm not taken
+constexpr size_t BranchFoldBonus = 4;
+
+struct CallSite
+{
+    SSA* caller;
+    std::shared_ptr<BasicBlock> block;
+    size_t index;
+
+    std::shared_ptr<Inst>& getCall() { return block->getInstructions()[index]; }
+};
+
+// Signature heading the entry block of a routine
+std::shared_ptr<Func> getSignature(SSA& ssa)
+{
+    auto& insts = ssa.getCFG()->getInstructions();
+    if (insts.empty())
+    {
+        return nullptr;
+    }
+    return std::dynamic_pointer_cast<Func>(insts.front());
+}
+
+bool isSameConstant(const std::shared_ptr<Inst>& lhs,
+                    const std::shared_ptr<Inst>& rhs)
+{
+    return lhs->getTarget()->getInstType() == rhs->getTarget()->getInstType() &&
+           lhs->getTarget()->getString() == rhs->getTarget()->getString();
+}
+
+// Calls to the functions, grouped by callee
+std::map<std::string, std::vector<CallSite>> findCallSites(
+    SSA& mainSSA, std::map<std::string, SSA>& functions)
+{
+    std::map<std::string, std::vector<CallSite>> callSites;
+    auto addCalls = [&](SSA& caller)
+    {
+        for (auto& block : getRPONodes(caller.getCFG()))
+        {
+            auto& insts = block->getInstructions();
+            for (size_t i = 0; i < insts.size(); ++i)
+            {
+                auto callee = getCalleeName(insts[i]);
+                if (functions.count(callee) != 0)
+                {
+                    callSites[callee].push_back({&caller, block, i});
+                }
+            }
+        }
+    };
+
+    addCalls(mainSSA);
+    for (auto& [funcName, ssa] : functions)
+    {
+        addCalls(ssa);
+    }
+    return callSites;
+}
+
+void replaceUses(SSA& ssa, const std::string& name,
+                 const std::shared_ptr<Inst>& value)
+{
+    for (auto& block : getRPONodes(ssa.getCFG()))
+    {
+        for (auto& inst : block->getInstructions())
+        {
+            for (auto& operand : inst->getOperands())
+            {
+                if (getValueName(operand) == name)
+                {
+                    operand = value;
+                }
+            }
+        }
+    }
+}
+
+// Replaces the parameters at the given positions with the constants and
+// drops them from the signature
+void bindParameters(SSA& ssa,
+                    const std::map<size_t, std::shared_ptr<Inst>>& constants)
+{
+    auto& params = getSignature(ssa)->getParameters();
+    for (auto it = constants.rbegin(); it != constants.rend(); ++it)
+    {
+        replaceUses(ssa, params[it->first]->getName(), it->second);
+        params.erase(params.begin() + it->first);
+    }
+}
+
+// Makes the call go to callee without the arguments at the given positions
+void redirectCall(CallSite& site, const std::string& callee,
+                  const std::map<size_t, std::shared_ptr<Inst>>& dropped)
+{
+    auto& call = site.getCall();
+    std::vector<std::shared_ptr<Inst>> args;
+    auto& operands = call->getOperands();
+    for (size_t i = 0; i < operands.size(); ++i)
+    {
+        if (dropped.count(i) == 0)
+        {
+            args.push_back(operands[i]);
+        }
+    }
+
+    std::shared_ptr<Inst> newCall;
+    if (call->getInstType() == InstType::FuncCall)
+    {
+        newCall = std::make_shared<FuncCallInst>(callee, getDefinedName(call),
+                                                 args, site.block);
+    }
+    else
+    {
+        newCall = std::make_shared<ProcCallInst>(callee, args, site.block);
+    }
+    newCall->setup_def_use();
+    call = newCall;
+}
+
+// Instructions of the routine that fold once the named values are known
+size_t estimateFolding(SSA& ssa, std::unordered_set<std::string> known)
+{
+    size_t folded = 0;
+    for (auto& block : getRPONodes(ssa.getCFG()))
+    {
+        for (auto& inst : block->getInstructions())
+        {
+            auto type = inst->getInstType();
+            auto& operands = inst->getOperands();
+            if (type == InstType::BRT || type == InstType::BRF)
+            {
+                if (known.count(getValueName(operands[0])) != 0)
+                {
+                    folded += BranchFoldBonus;
+                }
+                continue;
+            }
+            if (!isRemovableIfUnused(inst) || inst->isPhi() ||
+                type == InstType::Alloca || type == InstType::ArrAccess)
+            {
+                continue;
+            }
+
+            bool isKnown = true;
+            for (auto& operand : operands)
+            {
+                isKnown &= isConstant(operand) ||
+                           known.count(getValueName(operand)) != 0;
+            }
+            if (isKnown)
+            {
+                known.insert(getDefinedName(inst));
+                ++folded;
+            }
+        }
+    }
+    return folded;
+}
+
+class IPConstantPropagator
+{
+public:
+    IPConstantPropagator(SSA& mainSSA, std::map<std::string, SSA>& functions);
+
+    bool run();
+
+private:
+    SSA& m_mainSSA;
+    std::map<std::string, SSA>& m_functions;
+
+    // Routine every clone was first made from, and the number of clones made
+    // of each routine
+    std::map<std::string, std::string> m_origin;
+    std::map<std::string, int> m_numClones;
+
+    // Clone serving each set of constant arguments
+    std::map<std::string, std::string> m_clones;
+
+    // Binds the parameters receiving the same constant from every call
+    bool propagateArguments();
+
+    // Redirects calls with constant arguments to specialized clones
+    bool specializeCalls();
+
+    std::string makeCloneName(const std::string& funcName);
+};
+
+IPConstantPropagator::IPConstantPropagator(
+    SSA& mainSSA, std::map<std::string, SSA>& functions)
+    : m_mainSSA{mainSSA}, m_functions{functions}
+{
+}
+
+bool IPConstantPropagator::propagateArguments()
+{
+    bool changed = false;
+    auto callSites = findCallSites(m_mainSSA, m_functions);
+    for (auto& [funcName, sites] : callSites)
+    {
+        auto& callee = m_functions.at(funcName);
+        auto signature = getSignature(callee);
+        if (!signature)
+        {
+            continue;
+        }
+
+        auto& params = signature->getParameters();
+        std::map<size_t, std::shared_ptr<Inst>> constants;
+        for (size_t i = 0; i < params.size(); ++i)
+        {
+            std::shared_ptr<Inst> constant;
+            bool agrees = true;
+            for (auto& site : sites)
+            {
+                auto& arg = site.getCall()->getOperands()[i];
+
+                // A recursive call passing the parameter along
+                if (site.caller == &callee &&
+                    getValueName(arg) == params[i]->getName())
+                {
+                    continue;
+                }
+                if (!isConstant(arg) ||
+                    (constant && !isSameConstant(constant, arg)))
+                {
+                    agrees = false;
+                    break;
+                }
+                constant = arg;
+            }
+            if (agrees && constant)
+            {
+                constants[i] = constant;
+            }
+        }
+        if (constants.empty())
+        {
+            continue;
+        }
+
+        bindParameters(callee, constants);
+        for (auto& site : sites)
+        {
+            redirectCall(site, funcName, constants);
+        }
+        changed = true;
+    }
+    return changed;
+}
+
+std::string IPConstantPropagator::makeCloneName(const std::string& funcName)
+{
+    static int cloneCtr = 0;
+    std::string name;
+    do
+    {
+        name = funcName + "_spec" + std::to_string(cloneCtr++);
+    } while (m_functions.count(name) != 0);
+    return name;
+}
+
+bool IPConstantPropagator::specializeCalls()
+{
+    bool changed = false;
+    bool isRedirected = true;
+    while (isRedirected)
+    {
+        isRedirected = false;
+
+        // Calls grouped by callee and constant arguments
+        std::map<std::string, std::vector<CallSite>> groups;
+        std::map<std::string, std::map<size_t, std::shared_ptr<Inst>>>
+            groupConstants;
+        std::map<std::string, std::string> groupCallee;
+        for (auto& [funcName, sites] : findCallSites(m_mainSSA, m_functions))
+        {
+            for (auto& site : sites)
+            {
+                std::string key = funcName;
+                std::map<size_t, std::shared_ptr<Inst>> constants;
+                auto& args = site.getCall()->getOperands();
+                for (size_t i = 0; i < args.size(); ++i)
+                {
+                    if (isConstant(args[i]))
+                    {
+                        constants[i] = args[i];
+                        key += " " + std::to_string(i) + "=" +
+                               args[i]->getTarget()->getString();
+                    }
+                }
+                if (constants.empty())
+                {
+                    continue;
+                }
+                groups[key].push_back(site);
+                groupConstants[key] = constants;
+                groupCallee[key] = funcName;
+            }
+        }
+
+        for (auto& [key, sites] : groups)
+        {
+            auto& funcName = groupCallee[key];
+            auto& constants = groupConstants[key];
+            auto clone = m_clones.find(key);
+            if (clone == m_clones.end())
+            {
+                auto& callee = m_functions.at(funcName);
+                auto origin = m_origin.count(funcName) != 0
+                                  ? m_origin[funcName]
+                                  : funcName;
+                auto size = countInstructions(callee);
+                if (!getSignature(callee) ||
+                    m_numClones[origin] >= MaxSpecializations ||
+                    size > MaxSpecializedSize)
+                {
+                    continue;
+                }
+
+                std::unordered_set<std::string> known;
+                auto& params = getSignature(callee)->getParameters();
+                for (auto& [index, constant] : constants)
+                {
+                    known.insert(params[index]->getName());
+                }
+                auto folded = estimateFolding(callee, known);
+                if (folded == 0 ||
+                    folded * sites.size() * SizePerFoldedInst < size)
+                {
+                    continue;
+                }
+
+                auto cloneName = makeCloneName(funcName);
+                auto cloneSSA = cloneFunction(callee, cloneName);
+                bindParameters(cloneSSA, constants);
+                m_functions.emplace(cloneName, cloneSSA);
+                m_origin[cloneName] = origin;
+                ++m_numClones[origin];
+                clone = m_clones.emplace(key, cloneName).first;
+            }
+
+            for (auto& site : sites)
+            {
+                redirectCall(site, clone->second, constants);
+            }
+            isRedirected = changed = true;
+        }
+    }
+    return changed;
+}
+
+bool IPConstantPropagator::run()
+{
+    bool changed = propagateArguments();
+    changed |= specializeCalls();
+    return changed;
+}
+
+}  // namespace
+
+std::string IPConstantPropagationPass::getName() const { return "ipcp"; }
+
+bool IPConstantPropagationPass::run(SSA& mainSSA,
+                                    std::map<std::string, SSA>& functions)
+{
+    IPConstantPropagator propagator(mainSSA, functions);
+    return propagator.run();
+}
+
+}  // namespace mina
@@ -0,0 +1,459 @@
+#include "IREvaluator.hpp"
+#include "BasicBlock.hpp"
+#include "IRUtils.hpp"
+#include "InstIR.hpp"
+#include "SSA.hpp"
+
+#include <map>
+#include <limits>
+#include <memory>
+#include <string>
+#include <vector>
+#include <optional>
+
+namespace mina
+{
+
+namespace
+{
+
+// Arithmetic of the 64-bit registers, which wraps around on overflow
+long long wrap(unsigned long long value)
+{
+    return static_cast<long long>(value);
+}
+
+}  // namespace
+
+IREvaluator::IREvaluator(std::map<std::string, SSA>& functions,
+                         long long maxSteps, int maxDepth)
+    : m_functions{functions}, m_maxSteps{maxSteps}, m_maxDepth{maxDepth}
+{
+}
+
+long long IREvaluator::getSteps() const { return m_steps; }
+
+std::optional<IREvaluator::Value> IREvaluator::call(
+    const std::string& funcName, const std::vector<Value>& args)
+{
+    auto function = m_functions.find(funcName);
+    if (function == m_functions.end())
+    {
+        return std::nullopt;
+    }
+
+    std::vector<Slot> slots;
+    for (auto& arg : args)
+    {
+        slots.push_back({arg, nullptr});
+    }
+    auto result = run(function->second, slots);
+    if (!result || result->array)
+    {
+        return std::nullopt;
+    }
+    return result->scalar;
+}
+
+std::optional<std::string> IREvaluator::runProgram(SSA& mainSSA,
+                                                   size_t maxOutput)
+{
+    m_isProgram = true;
+    m_isHalted = false;
+    m_maxOutput = maxOutput;
+    m_output.clear();
+    auto result = run(mainSSA, {});
+    m_isProgram = false;
+    if (!result)
+    {
+        return std::nullopt;
+    }
+    return m_output;
+}
+
+bool IREvaluator::print(Frame& frame, const std::shared_ptr<Inst>& operand)
+{
+    auto target = operand->getTarget();
+    if (target->getInstType() == InstType::StrConst)
+    {
+        // printf takes the literal as its format, so a % or an escape
+        // the assembler reads would not print as written
+        auto text = target->getString();
+        if (text == "'\\n'")
+        {
+            m_output += '\n';
+        }
+        else if (text.size() < 2 ||
+                 text.find_first_of("%\\") != std::string::npos)
+        {
+            return false;
+        }
+        else
+        {
+            m_output += text.substr(1, text.size() - 2);
+        }
+    }
+    else if (target->getInstType() == InstType::BoolConst)
+    {
+        // Only boolean literals print as words, variables print as numbers
+        m_output +=
+            std::dynamic_pointer_cast<BoolConstInst>(target)->getVal()
+                ? "true"
+                : "false";
+    }
+    else
+    {
+        auto value = getOperand(frame, operand);
+        if (!value || value->array)
+        {
+            return false;
+        }
+        m_output += std::to_string(value->scalar.value);
+    }
+    return m_output.size() <= m_maxOutput;
+}
+
+std::optional<IREvaluator::Slot> IREvaluator::getOperand(
+    Frame& frame, const std::shared_ptr<Inst>& operand)
+{
+    auto target = operand->getTarget();
+    if (target->getInstType() == InstType::IntConst)
+    {
+        return Slot{
+            {std::dynamic_pointer_cast<IntConstInst>(target)->getVal(), false},
+            nullptr};
+    }
+    if (target->getInstType() == InstType::BoolConst)
+    {
+        return Slot{
+            {std::dynamic_pointer_cast<BoolConstInst>(target)->getVal(), true},
+            nullptr};
+    }
+
+    auto it = frame.find(getValueName(operand));
+    if (it == frame.end())
+    {
+        return std::nullopt;
+    }
+    return it->second;
+}
+
+std::optional<IREvaluator::Slot> IREvaluator::run(SSA& ssa,
+                                                  const std::vector<Slot>& args)
+{
+    if (m_depth >= m_maxDepth)
+    {
+        return std::nullopt;
+    }
+
+    Frame frame;
+    auto entry = ssa.getCFG();
+    auto& entryInsts = entry->getInstructions();
+    if (!entryInsts.empty() && entryInsts.front()->getInstType() == InstType::Func)
+    {
+        auto& params =
+            std::dynamic_pointer_cast<Func>(entryInsts.front())->getParameters();
+        if (params.size() != args.size())
+        {
+            return std::nullopt;
+        }
+        for (size_t i = 0; i < params.size(); ++i)
+        {
+            frame[params[i]->getName()] = args[i];
+        }
+    }
+
+    ++m_depth;
+    std::optional<Slot> result;
+    std::shared_ptr<BasicBlock> block = entry, prev;
+    while (block)
+    {
+        auto& insts = block->getInstructions();
+
+        // The phis of a block read their operands before any of them is set
+        std::vector<std::pair<std::string, Slot>> phiValues;
+        size_t i = 0;
+        for (; i < insts.size() && insts[i]->isPhi(); ++i)
+        {
+            auto phi = std::dynamic_pointer_cast<PhiInst>(insts[i]);
+            std::optional<Slot> value;
+            for (unsigned int j = 0; j < phi->getOperands().size(); ++j)
+            {
+                if (phi->getOperandBB(j) == prev)
+                {
+                    value = getOperand(frame, phi->getOperands()[j]);
+                    break;
+                }
+            }
+            if (!value)
+            {
+                --m_depth;
+                return std::nullopt;
+            }
+            phiValues.push_back({getDefinedName(phi), *value});
+        }
+        for (auto& [name, value] : phiValues)
+        {
+            frame[name] = value;
+        }
+
+        std::shared_ptr<BasicBlock> next;
+        bool isDone = false;
+        for (; i < insts.size() && !next && !isDone && !m_isHalted; ++i)
+        {
+            auto& inst = insts[i];
+            if (++m_steps > m_maxSteps)
+            {
+                --m_depth;
+                return std::nullopt;
+            }
+
+            switch (inst->getInstType())
+            {
+                case InstType::Func:
+                case InstType::Noop:
+                    break;
+                case InstType::Jump:
+                    next = std::dynamic_pointer_cast<JumpInst>(inst)
+                               ->getJumpTarget();
+                    break;
+                case InstType::BRT:
+                case InstType::BRF:
+                {
+                    auto cond = getOperand(frame, inst->getOperands()[0]);
+                    if (!cond)
+                    {
+                        --m_depth;
+                        return std::nullopt;
+                    }
+
+                    // BRT goes to the success target on true, BRF on false
+                    bool isBRT = inst->getInstType() == InstType::BRT;
+                    bool takesSuccess = (cond->scalar.value != 0) == isBRT;
+                    if (isBRT)
+                    {
+                        auto brt = std::dynamic_pointer_cast<BRTInst>(inst);
+                        next = takesSuccess ? brt->getTargetSuccess()
+                                            : brt->getTargetFailed();
+                    }
+                    else
+                    {
+                        auto brf = std::dynamic_pointer_cast<BRFInst>(inst);
+                        next = takesSuccess ? brf->getTargetSuccess()
+                                            : brf->getTargetFailed();
+                    }
+                    break;
+                }
+                case InstType::Put:
+                    if (!m_isProgram || !print(frame, inst->getOperands()[0]))
+                    {
+                        --m_depth;
+                        return std::nullopt;
+                    }
+                    break;
+                case InstType::Halt:
+                    if (!m_isProgram)
+                    {
+                        --m_depth;
+                        return std::nullopt;
+                    }
+                    m_isHalted = true;
+                    break;
+                case InstType::Return:
+                    result = getOperand(frame, inst->getOperands()[0]);
+                    if (!result)
+                    {
+                        --m_depth;
+                        return std::nullopt;
+                    }
+                    isDone = true;
+                    break;
+                default:
+                {
+                    auto value = evaluate(frame, inst);
+                    if (!value)
+                    {
+                        --m_depth;
+                        return std::nullopt;
+                    }
+                    auto name = getDefinedName(inst);
+                    if (!name.empty())
+                    {
+                        frame[name] = *value;
+                    }
+                    break;
+                }
+            }
+        }
+
+        // A halt in this routine or any it called ends the program
+        if (m_isHalted)
+        {
+            result = Slot{};
+            break;
+        }
+        if (isDone)
+        {
+            break;
+        }
+
+        // A procedure ends with a block without successors, often empty
+        if (!next)
+        {
+            auto succs = block->getSuccessors();
+            if (succs.size() > 1)
+            {
+                --m_depth;
+                return std::nullopt;
+            }
+            if (succs.empty())
+            {
+                result = Slot{};
+                break;
+            }
+            next = succs[0];
+        }
+        prev = block;
+        block = next;
+    }
+    --m_depth;
+    return result;
+}
+
+std::optional<IREvaluator::Slot> IREvaluator::evaluate(
+    Frame& frame, const std::shared_ptr<Inst>& inst)
+{
+    auto type = inst->getInstType();
+    std::vector<Slot> operands;
+    for (auto& operand : inst->getOperands())
+    {
+        auto value = getOperand(frame, operand);
+        if (!value)
+        {
+            return std::nullopt;
+        }
+        operands.push_back(*value);
+    }
+
+    auto scalar = [](long long value, bool isBool)
+    { return std::optional<Slot>{Slot{{value, isBool}, nullptr}}; };
+
+    switch (type)
+    {
+        case InstType::Assign:
+            return operands[0];
+        case InstType::Select:
+            return operands[operands[0].scalar.value != 0 ? 1 : 2];
+        case InstType::Not:
+        {
+            // Not is lowered to xor with 1, which is also what an int gets
+            auto& value = operands[0].scalar;
+            return scalar(value.isBool ? !value.value : value.value ^ 1,
+                          value.isBool);
+        }
+        case InstType::Alloca:
+        {
+            auto size = std::dynamic_pointer_cast<AllocaInst>(inst)->getSize();
+            return Slot{{}, std::make_shared<Array>(size)};
+        }
+        case InstType::ArrAccess:
+        case InstType::ArrUpdate:
+        {
+            auto& array = operands[0].array;
+            if (!array)
+            {
+                return std::nullopt;
+            }
+
+            bool isScaled =
+                type == InstType::ArrAccess
+                    ? std::dynamic_pointer_cast<ArrAccessInst>(inst)
+                          ->isIndexScaled()
+                    : std::dynamic_pointer_cast<ArrUpdateInst>(inst)
+                          ->isIndexScaled();
+            auto index = operands[1].scalar.value;
+            if (isScaled)
+            {
+                if (index % 8 != 0)
+                {
+                    return std::nullopt;
+                }
+                index /= 8;
+            }
+            if (index < 0 || index >= static_cast<long long>(array->size()))
+            {
+                return std::nullopt;
+            }
+
+            auto& element = (*array)[index];
+            if (type == InstType::ArrUpdate)
+            {
+                element = operands[2].scalar.value;
+                return operands[0];
+            }
+            if (!element)
+            {
+                return std::nullopt;
+            }
+            return scalar(*element, false);
+        }
+        case InstType::FuncCall:
+        case InstType::ProcCall:
+        {
+            auto function = m_functions.find(getCalleeName(inst));
+            if (function == m_functions.end())
+            {
+                return std::nullopt;
+            }
+            return run(function->second, operands);
+        }
+        default:
+            break;
+    }
+
+    bool isBinary = type == InstType::Add || type == InstType::Sub ||
+                    type == InstType::Mul || type == InstType::Div ||
+                    type == InstType::And || type == InstType::Or ||
+                    type == InstType::CmpEq || type == InstType::CmpNE ||
+                    type == InstType::CmpLT || type == InstType::CmpLTE ||
+                    type == InstType::CmpGT || type == InstType::CmpGTE;
+    if (!isBinary)
+    {
+        // Input, output, halting and undefined values
+        return std::nullopt;
+    }
+
+    auto& lhs = operands[0].scalar;
+    auto& rhs = operands[1].scalar;
+    auto a = lhs.value;
+    auto b = rhs.value;
+    auto ua = static_cast<unsigned long long>(a);
+    auto ub = static_cast<unsigned long long>(b);
+    switch (type)
+    {
+        case InstType::Add: return scalar(wrap(ua + ub), false);
+        case InstType::Sub: return scalar(wrap(ua - ub), false);
+        case InstType::Mul: return scalar(wrap(ua * ub), false);
+        case InstType::Div:
+            // Both fault in idiv
+            if (b == 0 ||
+                (a == std::numeric_limits<long long>::min() && b == -1))
+            {
+                return std::nullopt;
+            }
+            return scalar(a / b, false);
+        case InstType::And:
+            return scalar(a & b, lhs.isBool && rhs.isBool);
+        case InstType::Or:
+            return scalar(a | b, lhs.isBool && rhs.isBool);
+        case InstType::CmpEq: return scalar(a == b, true);
+        case InstType::CmpNE: return scalar(a != b, true);
+        case InstType::CmpLT: return scalar(a < b, true);
+        case InstType::CmpLTE: return scalar(a <= b, true);
+        case InstType::CmpGT: return scalar(a > b, true);
+        case InstType::CmpGTE: return scalar(a >= b, true);
+        default: return std::nullopt;
+    }
+}
+
+}  // namespace mina
@@ -0,0 +1,524 @@
+#include "IRUtils.hpp"
+#include "BasicBlock.hpp"
+#include "InstIR.hpp"
+#include "SSA.hpp"
+
+#include <memory>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <stdexcept>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace mina
+{
+
+bool isConstant(const std::shared_ptr<Inst>& operand)
+{
+    auto type = operand->getTarget()->getInstType();
+    return type == InstType::IntConst || type == InstType::BoolConst;
+}
+
+std::string getValueName(const std::shared_ptr<Inst>& operand)
+{
+    if (!operand)
+    {
+        return "";
+    }
+
+    auto target = operand->getTarget();
+    if (!target)
+    {
+        return "";
+    }
+
+    switch (target->getInstType())
+    {
+        case InstType::IntConst:
+        case InstType::BoolConst:
+        case InstType::StrConst:
+        case InstType::Undef:
+            return "";
+        default:
+            return target->getString();
+    }
+}
+
+std::string getDefinedName(const std::shared_ptr<Inst>& inst)
+{
+    switch (inst->getInstType())
+    {
+        case InstType::Add:
+        case InstType::Sub:
+        case InstType::Mul:
+        case InstType::Div:
+        case InstType::Not:
+        case InstType::And:
+        case InstType::Or:
+        case InstType::Alloca:
+        case InstType::ArrAccess:
+        case InstType::ArrUpdate:
+        case InstType::Assign:
+        case InstType::CmpEq:
+        case InstType::CmpNE:
+        case InstType::CmpLT:
+        case InstType::CmpLTE:
+        case InstType::CmpGT:
+        case InstType::CmpGTE:
+        case InstType::Select:
+        case InstType::Get:
+        case InstType::FuncCall:
+        case InstType::Phi:
+            return inst->getTarget()->getString();
+        default:
+            return "";
+    }
+}
+
+bool isRemovableIfUnused(const std::shared_ptr<Inst>& inst)
+{
+    switch (inst->getInstType())
+    {
+        case InstType::Add:
+        case InstType::Sub:
+        case InstType::Mul:
+        case InstType::Div:
+        case InstType::Not:
+        case InstType::And:
+        case InstType::Or:
+        case InstType::Alloca:
+        case InstType::ArrAccess:
+        case InstType::Assign:
+        case InstType::CmpEq:
+        case InstType::CmpNE:
+        case InstType::CmpLT:
+        case InstType::CmpLTE:
+        case InstType::CmpGT:
+        case InstType::CmpGTE:
+        case InstType::Select:
+        case InstType::Phi:
+            return true;
+        default:
+            return false;
+    }
+}
+
+std::string getCalleeName(const std::shared_ptr<Inst>& inst)
+{
+    if (inst->getInstType() == InstType::FuncCall)
+    {
+        return std::dynamic_pointer_cast<FuncCallInst>(inst)->getCalleeStr();
+    }
+    if (inst->getInstType() == InstType::ProcCall)
+    {
+        return std::dynamic_pointer_cast<ProcCallInst>(inst)->getCalleeStr();
+    }
+    return "";
+}
+
+std::shared_ptr<Inst> makeValueRef(const std::string& name,
+                                   const std::shared_ptr<BasicBlock>& block)
+{
+    auto ident = std::make_shared<IdentInst>(name, block);
+    ident->setup_def_use();
+    return ident;
+}
+
+namespace
+{
+
+template <typename T>
+std::shared_ptr<Inst> cloneBinary(const std::shared_ptr<Inst>& target,
+                                  std::vector<std::shared_ptr<Inst>>& operands,
+                                  const std::shared_ptr<BasicBlock>& block)
+{
+    return std::make_shared<T>(target, operands[0], operands[1], block);
+}
+
+}  // namespace
+
+std::shared_ptr<Inst> cloneInst(const std::shared_ptr<Inst>& inst,
+                                const std::string& name,
+                                const std::shared_ptr<BasicBlock>& block)
+{
+    std::vector<std::shared_ptr<Inst>> operands;
+    for (auto& operand : inst->getOperands())
+    {
+        auto operandName = getValueName(operand);
+        operands.push_back(operandName.empty() ? operand
+                                               : makeValueRef(operandName, block));
+    }
+
+    auto target = std::make_shared<IdentInst>(name, block);
+    target->setup_def_use();
+
+    std::shared_ptr<Inst> copy;
+    switch (inst->getInstType())
+    {
+        case InstType::Add:
+            copy = cloneBinary<AddInst>(target, operands, block);
+            break;
+        case InstType::Sub:
+            copy = cloneBinary<SubInst>(target, operands, block);
+            break;
+        case InstType::Mul:
+            copy = cloneBinary<MulInst>(target, operands, block);
+            break;
+        case InstType::Div:
+        {
+            auto divCopy = std::make_shared<DivInst>(target, operands[0],
+                                                  operands[1], block);
+            divCopy->setKind(std::dynamic_pointer_cast<DivInst>(inst)->getKind());
+            copy = divCopy;
+            break;
+        }
+        case InstType::And:
+            copy = cloneBinary<AndInst>(target, operands, block);
+            break;
+        case InstType::Or:
+            copy = cloneBinary<OrInst>(target, operands, block);
+            break;
+        case InstType::CmpEq:
+            copy = cloneBinary<CmpEQInst>(target, operands, block);
+            break;
+        case InstType::CmpNE:
+            copy = cloneBinary<CmpNEInst>(target, operands, block);
+            break;
+        case InstType::CmpLT:
+            copy = cloneBinary<CmpLTInst>(target, operands, block);
+            break;
+        case InstType::CmpLTE:
+            copy = cloneBinary<CmpLTEInst>(target, operands, block);
+            break;
+        case InstType::CmpGT:
+            copy = cloneBinary<CmpGTInst>(target, operands, block);
+            break;
+        case InstType::CmpGTE:
+            copy = cloneBinary<CmpGTEInst>(target, operands, block);
+            break;
+        case InstType::Not:
+            copy = std::make_shared<NotInst>(target, operands[0], block);
+            break;
+        case InstType::Assign:
+            copy = std::make_shared<AssignInst>(target, operands[0], block);
+            break;
+        case InstType::Select:
+            copy = std::make_shared<SelectInst>(target, operands[0], operands[1],
+                                                operands[2], block);
+            break;
+        case InstType::Alloca:
+        {
+            auto alloca = std::dynamic_pointer_cast<AllocaInst>(inst);
+            copy = std::make_shared<AllocaInst>(target, alloca->getType(),
+                                                alloca->getSize(), block);
+            break;
+        }
+        case InstType::ArrAccess:
+        {
+            auto access = std::dynamic_pointer_cast<ArrAccessInst>(inst);
+            auto accessCopy = std::make_shared<ArrAccessInst>(
+                target, operands[0], operands[1], block, access->getType());
+            accessCopy->setIndexScaled(access->isIndexScaled());
+            copy = accessCopy;
+            break;
+        }
+        case InstType::ArrUpdate:
+        {
+            auto update = std::dynamic_pointer_cast<ArrUpdateInst>(inst);
+            auto updateCopy = std::make_shared<ArrUpdateInst>(
+                target, operands[0], operands[1], operands[2], block,
+                update->getType());
+            updateCopy->setIndexScaled(update->isIndexScaled());
+            copy = updateCopy;
+            break;
+        }
+        case InstType::Get:
+            copy = std::make_shared<GetInst>(target, block);
+            break;
+        case InstType::Put:
+            copy = std::make_shared<PutInst>(operands[0], block);
+            break;
+        case InstType::ProcCall:
+        {
+            auto call = std::dynamic_pointer_cast<ProcCallInst>(inst);
+            copy = std::make_shared<ProcCallInst>(call->getCalleeStr(),
+                                                  operands, block);
+            break;
+        }
+        case InstType::FuncCall:
+        {
+            auto call = std::dynamic_pointer_cast<FuncCallInst>(inst);
+            copy = std::make_shared<FuncCallInst>(call->getCalleeStr(), name,
+                                                  operands, block);
+            break;
+        }
+        case InstType::Phi:
+        {
+            auto phi = std::dynamic_pointer_cast<PhiInst>(inst);
+            auto phiCopy = std::make_shared<PhiInst>(name, block);
+            for (unsigned int i = 0; i < operands.size(); ++i)
+            {
+                phiCopy->appendOperand(operands[i], phi->getOperandBB(i));
+            }
+            copy = phiCopy;
+            break;
+        }
+        case InstType::Jump:
+            copy = std::make_shared<JumpInst>(
+                std::dynamic_pointer_cast<JumpInst>(inst)->getJumpTarget());
+            break;
+        case InstType::BRT:
+        {
+            auto brt = std::dynamic_pointer_cast<BRTInst>(inst);
+            copy = std::make_shared<BRTInst>(operands[0],
+                                             brt->getTargetSuccess(),
+                                             brt->getTargetFailed(), block);
+            break;
+        }
+        case InstType::BRF:
+        {
+            auto brf = std::dynamic_pointer_cast<BRFInst>(inst);
+            copy = std::make_shared<BRFInst>(operands[0],
+                                             brf->getTargetSuccess(),
+                                             brf->getTargetFailed(), block);
+            break;
+        }
+        case InstType::Return:
+            copy = std::make_shared<ReturnInst>(operands[0], block);
+            break;
+        case InstType::Halt:
+            copy = std::make_shared<HaltInst>(block);
+            break;
+        case InstType::Noop:
+            copy = std::make_shared<NoopInst>(block);
+            break;
+        default:
+            throw std::runtime_error("Cannot copy instruction " +
+                                     inst->getString());
+    }
+    copy->setup_def_use();
+    return copy;
+}
+
+SSA cloneFunction(SSA& function, const std::string& name)
+{
+    auto entry = function.getCFG();
+    auto blocks = getRPONodes(entry);
+    std::unordered_map<BasicBlock*, std::shared_ptr<BasicBlock>> copies;
+    for (auto& block : blocks)
+    {
+        copies[block.get()] = std::make_shared<BasicBlock>(
+            block == entry ? name : block->getName() + "_" + name);
+    }
+
+    for (auto& block : blocks)
+    {
+        auto copy = copies[block.get()];
+        for (auto& inst : block->getInstructions())
+        {
+            if (inst->getInstType() == InstType::Func)
+            {
+                auto signature = std::dynamic_pointer_cast<Func>(inst);
+                auto newSignature = std::make_shared<Func>(
+                    name, signature->getFType(), signature->getRetType(),
+                    signature->getParameters(), copy);
+                newSignature->setup_def_use();
+                copy->pushInst(newSignature);
+                continue;
+            }
+
+            auto newInst = cloneInst(inst, getDefinedName(inst), copy);
+            if (newInst->isPhi())
+            {
+                auto phi = std::dynamic_pointer_cast<PhiInst>(newInst);
+                for (unsigned int i = phi->getOperands().size(); i-- > 0;)
+                {
+                    auto it = copies.find(phi->getOperandBB(i).get());
+                    if (it == copies.end())
+                    {
+                        phi->removeOperand(i);
+                    }
+                    else
+                    {
+                        phi->setOperandBB(i, it->second);
+                    }
+                }
+            }
+            copy->pushInst(newInst);
+        }
+
+        copy->setSuccessors(block->getSuccessors());
+        for (auto& succ : block->getSuccessors())
+        {
+            copy->replaceSuccessor(succ, copies[succ.get()]);
+        }
+        for (auto& pred : block->getPredecessors())
+        {
+            auto it = copies.find(pred.get());
+            if (it != copies.end())
+            {
+                copy->pushPredecessor(it->second);
+            }
+        }
+    }
+
+    SSA clone;
+    clone.setCFG(copies[entry.get()]);
+    return clone;
+}
+
+void replaceBranchWithJump(const std::shared_ptr<BasicBlock>& block,
+                           const std::shared_ptr<BasicBlock>& target)
+{
+    auto terminator = block->getTerminator();
+    std::shared_ptr<BasicBlock> success, failed;
+    if (terminator && terminator->getInstType() == InstType::BRT)
+    {
+        auto brt = std::dynamic_pointer_cast<BRTInst>(terminator);
+        success = brt->getTargetSuccess();
+        failed = brt->getTargetFailed();
+    }
+    else if (terminator && terminator->getInstType() == InstType::BRF)
+    {
+        auto brf = std::dynamic_pointer_cast<BRFInst>(terminator);
+        success = brf->getTargetSuccess();
+        failed = brf->getTargetFailed();
+    }
+    else
+    {
+        throw std::runtime_error("Block " + block->getName() +
+                                 " does not end with a conditional branch");
+    }
+
+    auto other = (target == success) ? failed : success;
+    auto& instructions = block->getInstructions();
+    instructions.pop_back();
+
+    auto jumpInst = std::make_shared<JumpInst>(target);
+    jumpInst->setup_def_use();
+    instructions.push_back(jumpInst);
+
+    // When both targets are the same block only one of the two edges goes
+    block->removeSuccessor(other);
+    other->removePredecessor(block);
+}
+
+std::shared_ptr<BasicBlock> splitPredecessors(
+    SSA& ssa, const std::shared_ptr<BasicBlock>& block,
+    const std::vector<std::shared_ptr<BasicBlock>>& preds,
+    const std::string& name)
+{
+    auto newBlock = std::make_shared<BasicBlock>(name);
+    auto isMoved = [&](const std::shared_ptr<BasicBlock>& pred)
+    { return std::find(preds.begin(), preds.end(), pred) != preds.end(); };
+
+    for (auto& inst : block->getInstructions())
+    {
+        if (!inst->isPhi())
+        {
+            continue;
+        }
+
+        auto phi = std::dynamic_pointer_cast<PhiInst>(inst);
+        auto& operands = phi->getOperands();
+        std::vector<std::shared_ptr<Inst>> movedValues;
+        std::vector<std::shared_ptr<BasicBlock>> movedBlocks;
+        for (unsigned int i = 0; i < operands.size();)
+        {
+            auto bb = phi->getOperandBB(i);
+            if (!isMoved(bb))
+            {
+                ++i;
+                continue;
+            }
+            movedValues.push_back(operands[i]);
+            movedBlocks.push_back(bb);
+            phi->removeOperand(i);
+        }
+        if (movedValues.empty())
+        {
+            continue;
+        }
+
+        bool allSame = true;
+        for (auto& value : movedValues)
+        {
+            allSame &= value->getTarget()->getString() ==
+                       movedValues[0]->getTarget()->getString();
+        }
+
+        if (allSame)
+        {
+            phi->appendOperand(movedValues[0], newBlock);
+            continue;
+        }
+
+        auto newPhi = std::make_shared<PhiInst>(
+            ssa.makeFreshName(phi->getTarget()->getString()), newBlock);
+        for (unsigned int i = 0; i < movedValues.size(); ++i)
+        {
+            newPhi->appendOperand(movedValues[i], movedBlocks[i]);
+        }
+        newBlock->pushInst(newPhi);
+        phi->appendOperand(newPhi, newBlock);
+    }
+
+    auto jumpInst = std::make_shared<JumpInst>(block);
+    jumpInst->setup_def_use();
+    newBlock->pushInst(jumpInst);
+
+    // The new block takes the place of the first predecessor it replaces
+    std::vector<std::shared_ptr<BasicBlock>> blockPreds;
+    for (auto& pred : block->getPredecessors())
+    {
+        if (!isMoved(pred))
+        {
+            blockPreds.push_back(pred);
+        }
+        else if (std::find(blockPreds.begin(), blockPreds.end(), newBlock) ==
+                 blockPreds.end())
+        {
+            blockPreds.push_back(newBlock);
+        }
+    }
+    for (auto& pred : preds)
+    {
+        pred->replaceSuccessor(block, newBlock);
+        newBlock->pushPredecessor(pred);
+    }
+    block->setPredecessors(blockPreds);
+    newBlock->pushSuccessor(block);
+
+    return newBlock;
+}
+
+bool detachUnreachableBlocks(
+    SSA& ssa, const std::vector<std::shared_ptr<BasicBlock>>& blocks)
+{
+    std::unordered_set<BasicBlock*> reachable;
+    for (auto& block : getRPONodes(ssa.getCFG()))
+    {
+        reachable.insert(block.get());
+    }
+
+    bool changed = false;
+    for (auto& block : blocks)
+    {
+        if (reachable.count(block.get()) != 0)
+        {
+            continue;
+        }
+        for (auto& succ : block->getSuccessors())
+        {
+            if (reachable.count(succ.get()) != 0)
+            {
+                succ->removePredecessor(block);
+            }
+        }
+        changed = true;
+    }
+    return changed;
+}
+
+}  // namespace mina
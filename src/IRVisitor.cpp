@@ -23,12 +23,39 @@ IRVisitor::IRVisitor()
       m_cg{m_ssa}
 {
     m_currentBB = m_ssa.getCFG();
+    m_entryBB = m_currentBB;
+}
+
+bool IRVisitor::isUnreachable() const
+{
+    auto terminator = m_currentBB->getTerminator();
+    if (terminator && (terminator->getInstType() == InstType::Jump ||
+                       terminator->getInstType() == InstType::BRT ||
+                       terminator->getInstType() == InstType::BRF))
+    {
+        return true;
+    }
+
+    // A return leaves the routine, the block has no successors
+    auto& insts = m_currentBB->getInstructions();
+    if (!insts.empty() && insts.back()->getInstType() == InstType::Return)
+    {
+        return true;
+    }
+    return m_currentBB != m_entryBB && m_currentBB->getPredecessors().empty();
 }
 
 void IRVisitor::visit(StatementsAST& v)
 {
     auto statementAST = v.getStatement();
     auto statementsAST = v.getStatements();
+
+    // Code after an exit is never executed and reading variables in a
+    // block without predecessors has no definition to find
+    if (isUnreachable())
+    {
+        return;
+    }
     if (statementAST)
     {
         statementAST->accept(*this);
@@ -302,13 +329,13 @@ void IRVisitor::visit(OutputsAST& v)
                 }
                 else
                 {
-                    auto operand = std::make_shared<IdentInst>(
-                        m_ssa.getCurrentSSAName(temp), m_currentBB);
-                    operand->setup_def_use();
-                    auto inst = std::make_shared<PutInst>(std::move(operand),
-                                                          m_currentBB);
-                    inst->setup_def_use();
-                    m_currentBB->pushInst(inst);
+                    // Print the definition reaching this point, the latest
+                    // SSA name of the variable may belong to another path.
+                    // Using it directly makes the put one of its users, so
+                    // it follows a trivial phi being replaced.
+                    auto putInst = std::make_shared<PutInst>(inst, m_currentBB);
+                    putInst->setup_def_use();
+                    m_currentBB->pushInst(putInst);
                 }
             } catch (const std::out_of_range& e) {
                 throw std::runtime_error("index was out of range for an int");
@@ -354,7 +381,9 @@ void IRVisitor::visit(InputsAST& v)
 
 void IRVisitor::visit(IfAST& v)
 {
-    auto ifExprLabel = "ifExprBlock_" + std::to_string(m_labelCounter);
+    // Reserve the label now, nested statements must not reuse it
+    auto labelID = std::to_string(m_labelCounter++);
+    auto ifExprLabel = "ifExprBlock_" + labelID;
     auto ifExprBB = std::make_shared<BasicBlock>(ifExprLabel);
     auto jumpInst = std::make_shared<JumpInst>(ifExprBB);
     jumpInst->setup_def_use();
@@ -362,7 +391,10 @@ void IRVisitor::visit(IfAST& v)
     m_currentBB->pushSuccessor(ifExprBB);
     ifExprBB->pushPredecessor(m_currentBB);
 
-    m_ssa.sealBlock(m_currentBB);
+    // A block is sealed as soon as all of its predecessors are known. The
+    // current block is left alone, it may be a loop header that still waits
+    // for its back edge.
+    m_ssa.sealBlock(ifExprBB);
     m_currentBB = ifExprBB;
 
     auto expr = v.getCondition();
@@ -373,15 +405,15 @@ void IRVisitor::visit(IfAST& v)
 
     auto exprInst = popInst();
 
-    auto thenBlockLabel = "thenBlock_" + std::to_string(m_labelCounter);
+    auto thenBlockLabel = "thenBlock_" + labelID;
     auto thenBB = std::make_shared<BasicBlock>(thenBlockLabel);
     thenBB->pushPredecessor(m_currentBB);
 
-    auto elseBlockLabel = "elseBlock_" + std::to_string(m_labelCounter);
+    auto elseBlockLabel = "elseBlock_" + labelID;
     auto elseBB = std::make_shared<BasicBlock>(elseBlockLabel);
     elseBB->pushPredecessor(m_currentBB);
 
-    auto mergeBlockLabel = "mergeBlock_" + std::to_string(m_labelCounter);
+    auto mergeBlockLabel = "mergeBlock_" + labelID;
     auto mergeBB = std::make_shared<BasicBlock>(mergeBlockLabel);
 
     auto branchInst =
@@ -391,19 +423,23 @@ void IRVisitor::visit(IfAST& v)
     m_currentBB->pushSuccessor(thenBB);
     m_currentBB->pushSuccessor(elseBB);
 
-    m_ssa.sealBlock(m_currentBB);
+    m_ssa.sealBlock(thenBB);
+    m_ssa.sealBlock(elseBB);
     m_currentBB = thenBB;
 
     thenArm->accept(*this);
 
-    mergeBB->pushPredecessor(m_currentBB);
-    m_currentBB->pushSuccessor(mergeBB);
+    // An arm ending in an exit doesn't reach the merge block
+    if (!isUnreachable())
+    {
+        mergeBB->pushPredecessor(m_currentBB);
+        m_currentBB->pushSuccessor(mergeBB);
 
-    auto otherjumpInst = std::make_shared<JumpInst>(mergeBB);
-    otherjumpInst->setup_def_use();
-    m_currentBB->pushInst(otherjumpInst);
+        auto otherjumpInst = std::make_shared<JumpInst>(mergeBB);
+        otherjumpInst->setup_def_use();
+        m_currentBB->pushInst(otherjumpInst);
+    }
 
-    m_ssa.sealBlock(m_currentBB);
     m_currentBB = elseBB;
 
     if (elseArm)
@@ -411,17 +447,18 @@ void IRVisitor::visit(IfAST& v)
         elseArm->accept(*this);
     }
 
-    mergeBB->pushPredecessor(m_currentBB);
-    m_currentBB->pushSuccessor(mergeBB);
+    if (!isUnreachable())
+    {
+        mergeBB->pushPredecessor(m_currentBB);
+        m_currentBB->pushSuccessor(mergeBB);
 
-    auto moreJumpInst = std::make_shared<JumpInst>(mergeBB);
-    moreJumpInst->setup_def_use();
-    m_currentBB->pushInst(moreJumpInst);
+        auto moreJumpInst = std::make_shared<JumpInst>(mergeBB);
+        moreJumpInst->setup_def_use();
+        m_currentBB->pushInst(moreJumpInst);
+    }
 
     m_currentBB = mergeBB;
     m_ssa.sealBlock(m_currentBB);
-
-    ++m_labelCounter;
 }
 
 void IRVisitor::visit(RepeatUntilAST& v)
@@ -434,39 +471,97 @@ void IRVisitor::visit(RepeatUntilAST& v)
 
     m_currentBB->pushSuccessor(repeatUntilBB);
     repeatUntilBB->pushPredecessor(m_currentBB);
-    repeatUntilBB->pushPredecessor(repeatUntilBB);
-    repeatUntilBB->pushSuccessor(repeatUntilBB);
 
-    m_ssa.sealBlock(m_currentBB);
     m_currentBB = repeatUntilBB;
 
     auto statements = v.getStatements();
     auto expr = v.getExitCond();
     statements->accept(*this);
+
+    std::string newBBName = label + "_exit";
+    auto repeatUntilExitBB = std::make_shared<BasicBlock>(newBBName);
+
+    // The body left through an exit, so the condition is never tested
+    if (isUnreachable())
+    {
+        m_ssa.sealBlock(repeatUntilBB);
+        m_ssa.sealBlock(repeatUntilExitBB);
+        m_currentBB = repeatUntilExitBB;
+        return;
+    }
+
     expr->accept(*this);
 
     auto cond = popInst();
-    std::string newBBName =
-        "repeatUntilBlock_" + std::to_string(m_labelCounter - 1) + "_exit";
-    auto repeatUntilExitBB = std::make_shared<BasicBlock>(newBBName);
     auto newJumpInst = std::make_shared<BRFInst>(std::move(cond), repeatUntilBB, repeatUntilExitBB, m_currentBB);
     newJumpInst->setup_def_use();
     m_currentBB->pushInst(std::move(newJumpInst));
+
+    // The body may contain control flow, so the back edge comes from the
+    // block the body ended in, which is not necessarily the loop header
+    m_currentBB->pushSuccessor(repeatUntilBB);
+    repeatUntilBB->pushPredecessor(m_currentBB);
     m_currentBB->pushSuccessor(repeatUntilExitBB);
     repeatUntilExitBB->pushPredecessor(m_currentBB);
-    m_ssa.sealBlock(m_currentBB);
+
+    // Every predecessor of the header is known only now
+    m_ssa.sealBlock(repeatUntilBB);
+    m_ssa.sealBlock(repeatUntilExitBB);
     m_currentBB = repeatUntilExitBB;
 }
 
 void IRVisitor::visit(LoopAST& v)
 {
-    auto label = "Loop_" + std::to_string(m_labelCounter++) + ":";
+    auto label = "loopBlock_" + std::to_string(m_labelCounter++);
+    auto loopBB = std::make_shared<BasicBlock>(label);
+    auto jumpInst = std::make_shared<JumpInst>(loopBB);
+    jumpInst->setup_def_use();
+    m_currentBB->pushInst(std::move(jumpInst));
+
+    m_currentBB->pushSuccessor(loopBB);
+    loopBB->pushPredecessor(m_currentBB);
 
+    m_currentBB = loopBB;
+
+    auto loopExitBB = std::make_shared<BasicBlock>(label + "_exit");
+    m_loopExits.push_back(loopExitBB);
     auto statements = v.getStatements();
-    v.accept(*this);
+    if (statements)
+    {
+        statements->accept(*this);
+    }
+    m_loopExits.pop_back();
+
+    if (!isUnreachable())
+    {
+        auto backJumpInst = std::make_shared<JumpInst>(loopBB);
+        backJumpInst->setup_def_use();
+        m_currentBB->pushInst(std::move(backJumpInst));
+        m_currentBB->pushSuccessor(loopBB);
+        loopBB->pushPredecessor(m_currentBB);
+    }
+
+    // Every exit has been seen, a loop without one leaves the exit block
+    // without predecessors and the code after it unreachable
+    m_ssa.sealBlock(loopBB);
+    m_ssa.sealBlock(loopExitBB);
+    m_currentBB = loopExitBB;
 }
 
-void IRVisitor::visit(ExitAST& v) { }
+void IRVisitor::visit(ExitAST& v)
+{
+    if (m_loopExits.empty())
+    {
+        throw std::runtime_error("exit outside of a loop");
+    }
+
+    auto loopExitBB = m_loopExits.back();
+    auto jumpInst = std::make_shared<JumpInst>(loopExitBB);
+    jumpInst->setup_def_use();
+    m_currentBB->pushInst(std::move(jumpInst));
+    m_currentBB->pushSuccessor(loopExitBB);
+    loopExitBB->pushPredecessor(m_currentBB);
+}
 void IRVisitor::visit(ReturnAST& v)
 {
     auto retExpr = v.getRetExpr();
@@ -527,6 +622,10 @@ void IRVisitor::visit(ArgumentsAST& v)
 
 void IRVisitor::visit(CallAST& v)
 {
+    // A call nested in the arguments of another call must not clobber the
+    // arguments collected so far for the outer one
+    auto outerArguments = std::move(m_arguments);
+    auto outerArgNames = std::move(m_argNames);
     m_arguments = {};
     m_argNames = {};
 
@@ -537,15 +636,19 @@ void IRVisitor::visit(CallAST& v)
        args->accept(*this);
     }
 
+    auto arguments = std::move(m_arguments);
+    m_arguments = std::move(outerArguments);
+    m_argNames = std::move(outerArgNames);
+
     auto& func = m_funcBB[funcName];
 
     if (func->getFType() == FType::FUNC)
     {
         // Create temporary variable to store the result of function call
-        pushCurrentTemp();
         auto temp = getCurrentTemp();
+        pushCurrentTemp();
         auto callInst =
-            std::make_shared<FuncCallInst>(funcName, temp, m_arguments, m_currentBB);
+            std::make_shared<FuncCallInst>(funcName, temp, arguments, m_currentBB);
         callInst->setup_def_use();
         m_currentBB->pushInst(callInst);
         m_ssa.writeVariable(temp, m_currentBB, callInst);
@@ -554,7 +657,7 @@ void IRVisitor::visit(CallAST& v)
     else
     {
         auto callInst =
-            std::make_shared<ProcCallInst>(funcName, m_arguments, m_currentBB);
+            std::make_shared<ProcCallInst>(funcName, arguments, m_currentBB);
         callInst->setup_def_use();
         m_currentBB->pushInst(callInst);
     }
@@ -901,7 +1004,11 @@ void IRVisitor::visit(ProcDeclAST& v)
 
     auto basicBlock = std::make_shared<BasicBlock>(bbName);
     std::shared_ptr<BasicBlock> oldBB = m_currentBB;
+    std::shared_ptr<BasicBlock> oldEntryBB = m_entryBB;
+    auto oldLoopExits = std::move(m_loopExits);
+    m_loopExits.clear();
     m_currentBB = basicBlock;
+    m_entryBB = basicBlock;
 
     auto params = v.getParams();
     auto scope = v.getScope();
@@ -920,6 +1027,8 @@ void IRVisitor::visit(ProcDeclAST& v)
 
     scope->accept(*this);
     m_currentBB = oldBB;
+    m_entryBB = oldEntryBB;
+    m_loopExits = std::move(oldLoopExits);
 }
 
 void IRVisitor::visit(FuncDeclAST& v)
@@ -929,7 +1038,11 @@ void IRVisitor::visit(FuncDeclAST& v)
     
     auto basicBlock = std::make_shared<BasicBlock>(bbName);
     std::shared_ptr<BasicBlock> oldBB = m_currentBB;
+    std::shared_ptr<BasicBlock> oldEntryBB = m_entryBB;
+    auto oldLoopExits = std::move(m_loopExits);
+    m_loopExits.clear();
     m_currentBB = basicBlock;
+    m_entryBB = basicBlock;
     auto params = v.getParams();
     auto scope = v.getScope();
     auto type = v.getType();
@@ -948,6 +1061,8 @@ void IRVisitor::visit(FuncDeclAST& v)
 
     scope->accept(*this);
     m_currentBB = oldBB;
+    m_entryBB = oldEntryBB;
+    m_loopExits = std::move(oldLoopExits);
 }
 
 std::string IRVisitor::getCurrentTemp() const
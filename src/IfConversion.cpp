@@ -0,0 +1,347 @@
+#include "IfConversion.hpp"
+#include "BasicBlock.hpp"
+#include "IRUtils.hpp"
+#include "InstIR.hpp"
+#include "SSA.hpp"
+
+#include <memory>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <unordered_set>
+
+namespace mina
+{
+
+namespace
+{
+
+// Instructions of both arms together that may run whichever way the branch
+// would have gone
+constexpr size_t MaxSpeculated = 4;
+
+// Phis of the join turned into selects, each costs a move and a cmov
+constexpr size_t MaxSelects = 4;
+
+bool isComparison(InstType type)
+{
+    return type == InstType::CmpEq || type == InstType::CmpNE ||
+           type == InstType::CmpLT || type == InstType::CmpLTE ||
+           type == InstType::CmpGT || type == InstType::CmpGTE;
+}
+
+class IfConverter
+{
+public:
+    IfConverter(SSA& ssa);
+
+    bool run();
+
+private:
+    std::vector<std::shared_ptr<BasicBlock>> m_blocks;
+
+    // Arrays and their versions, which are never selected
+    std::unordered_set<std::string> m_arrays;
+
+    // Arms and joins merged into the block of their branch
+    std::unordered_set<BasicBlock*> m_removed;
+
+    void findArrays();
+    bool isSpeculatable(const std::shared_ptr<Inst>& inst) const;
+    bool canHoist(const std::shared_ptr<BasicBlock>& arm,
+                  const std::shared_ptr<BasicBlock>& join,
+                  size_t& numSpeculated) const;
+    bool convert(const std::shared_ptr<BasicBlock>& head);
+};
+
+IfConverter::IfConverter(SSA& ssa) : m_blocks{getRPONodes(ssa.getCFG())}
+{
+}
+
+void IfConverter::findArrays()
+{
+    bool changed = true;
+    while (changed)
+    {
+        changed = false;
+        for (auto& block : m_blocks)
+        {
+            for (auto& inst : block->getInstructions())
+            {
+                auto name = getDefinedName(inst);
+                auto type = inst->getInstType();
+                bool isArray = type == InstType::Alloca ||
+                               type == InstType::ArrUpdate;
+                if (type == InstType::Assign || inst->isPhi())
+                {
+                    for (auto& operand : inst->getOperands())
+                    {
+                        isArray |= m_arrays.count(getValueName(operand)) != 0;
+                    }
+                }
+                if (isArray && m_arrays.insert(name).second)
+                {
+                    changed = true;
+                }
+            }
+        }
+    }
+}
+
+// Instructions computing a value from their operands alone, which can't
+// fault
+bool IfConverter::isSpeculatable(const std::shared_ptr<Inst>& inst) const
+{
+    switch (inst->getInstType())
+    {
+        case InstType::Add:
+        case InstType::Sub:
+        case InstType::Mul:
+        case InstType::Not:
+        case InstType::And:
+        case InstType::Or:
+        case InstType::CmpEq:
+        case InstType::CmpNE:
+        case InstType::CmpLT:
+        case InstType::CmpLTE:
+        case InstType::CmpGT:
+        case InstType::CmpGTE:
+        case InstType::Select:
+            return true;
+        case InstType::Assign:
+            return m_arrays.count(getDefinedName(inst)) == 0;
+        default:
+            return false;
+    }
+}
+
+// An arm is a block of its own between the branch and the join, running
+// nothing but speculatable instructions
+bool IfConverter::canHoist(const std::shared_ptr<BasicBlock>& arm,
+                           const std::shared_ptr<BasicBlock>& join,
+                           size_t& numSpeculated) const
+{
+    auto& insts = arm->getInstructions();
+    if (arm->getNumPredecessors() != 1 || arm->getNumSuccessors() != 1 ||
+        arm->getSuccessors()[0] != join || insts.empty() ||
+        insts.back()->getInstType() != InstType::Jump)
+    {
+        return false;
+    }
+    for (size_t i = 0; i + 1 < insts.size(); ++i)
+    {
+        if (!isSpeculatable(insts[i]))
+        {
+            return false;
+        }
+    }
+    numSpeculated += insts.size() - 1;
+    return numSpeculated <= MaxSpeculated;
+}
+
+bool IfConverter::convert(const std::shared_ptr<BasicBlock>& head)
+{
+    auto terminator = head->getTerminator();
+    if (!terminator || (terminator->getInstType() != InstType::BRT &&
+                        terminator->getInstType() != InstType::BRF))
+    {
+        return false;
+    }
+
+    // BRF takes its success target when the condition fails
+    bool isBRT = terminator->getInstType() == InstType::BRT;
+    std::shared_ptr<BasicBlock> whenTrue, whenFalse;
+    if (isBRT)
+    {
+        auto brt = std::dynamic_pointer_cast<BRTInst>(terminator);
+        whenTrue = brt->getTargetSuccess();
+        whenFalse = brt->getTargetFailed();
+    }
+    else
+    {
+        auto brf = std::dynamic_pointer_cast<BRFInst>(terminator);
+        whenTrue = brf->getTargetFailed();
+        whenFalse = brf->getTargetSuccess();
+    }
+    auto condName = getValueName(terminator->getOperands()[0]);
+    if (condName.empty() || whenTrue == whenFalse || whenTrue == head ||
+        whenFalse == head)
+    {
+        return false;
+    }
+
+    // A diamond, or a triangle whose branch goes straight to the join on
+    // one side
+    std::shared_ptr<BasicBlock> join, trueArm, falseArm;
+    size_t numSpeculated = 0;
+    auto leadsTo = [](const std::shared_ptr<BasicBlock>& block,
+                      const std::shared_ptr<BasicBlock>& target)
+    {
+        return block->getNumSuccessors() == 1 &&
+               block->getSuccessors()[0] == target;
+    };
+    if (leadsTo(whenTrue, whenFalse))
+    {
+        join = whenFalse;
+        trueArm = whenTrue;
+    }
+    else if (leadsTo(whenFalse, whenTrue))
+    {
+        join = whenTrue;
+        falseArm = whenFalse;
+    }
+    else if (whenTrue->getNumSuccessors() == 1 &&
+             leadsTo(whenFalse, whenTrue->getSuccessors()[0]))
+    {
+        join = whenTrue->getSuccessors()[0];
+        trueArm = whenTrue;
+        falseArm = whenFalse;
+    }
+    if (!join || join == head || join->getNumPredecessors() != 2 ||
+        (trueArm && !canHoist(trueArm, join, numSpeculated)) ||
+        (falseArm && !canHoist(falseArm, join, numSpeculated)))
+    {
+        return false;
+    }
+
+    auto trueEdge = trueArm ? trueArm : head;
+    std::vector<std::shared_ptr<PhiInst>> phis;
+    for (auto& inst : join->getInstructions())
+    {
+        if (!inst->isPhi())
+        {
+            break;
+        }
+        auto phi = std::dynamic_pointer_cast<PhiInst>(inst);
+        if (phi->getOperands().size() != 2 ||
+            m_arrays.count(getDefinedName(phi)) != 0)
+        {
+            return false;
+        }
+        phis.push_back(phi);
+    }
+    if (phis.empty() || phis.size() > MaxSelects)
+    {
+        return false;
+    }
+
+    std::vector<std::shared_ptr<Inst>> hoisted;
+    for (auto& arm : {trueArm, falseArm})
+    {
+        if (arm)
+        {
+            auto& armInsts = arm->getInstructions();
+            hoisted.insert(hoisted.end(), armInsts.begin(), armInsts.end() - 1);
+        }
+    }
+
+    auto valueIn = [&](const std::shared_ptr<Inst>& operand)
+    {
+        auto name = getValueName(operand);
+        return name.empty() ? operand : makeValueRef(name, head);
+    };
+    std::vector<std::shared_ptr<Inst>> selects;
+    for (auto& phi : phis)
+    {
+        auto& operands = phi->getOperands();
+        bool isTrueFirst = phi->getOperandBB(0) == trueEdge;
+        auto trueValue = operands[isTrueFirst ? 0 : 1];
+        auto falseValue = operands[isTrueFirst ? 1 : 0];
+
+        auto target = std::make_shared<IdentInst>(getDefinedName(phi), head);
+        target->setup_def_use();
+        std::shared_ptr<Inst> select;
+        if (trueValue->getTarget()->getString() ==
+            falseValue->getTarget()->getString())
+        {
+            select = std::make_shared<AssignInst>(target, valueIn(trueValue), head);
+        }
+        else
+        {
+            select = std::make_shared<SelectInst>(
+                target, makeValueRef(condName, head), valueIn(trueValue),
+                valueIn(falseValue), head);
+        }
+        select->setup_def_use();
+        selects.push_back(select);
+    }
+
+    // The arms go before the comparison computing the condition when they
+    // don't need it, so the selects follow it and CodeGen reuses its flags
+    auto& insts = head->getInstructions();
+    insts.pop_back();
+    std::shared_ptr<Inst> compare;
+    if (!insts.empty() && getDefinedName(insts.back()) == condName &&
+        isComparison(insts.back()->getInstType()))
+    {
+        compare = insts.back();
+        for (auto& inst : hoisted)
+        {
+            for (auto& operand : inst->getOperands())
+            {
+                if (getValueName(operand) == condName)
+                {
+                    compare = nullptr;
+                }
+            }
+        }
+    }
+    if (compare)
+    {
+        insts.pop_back();
+    }
+    insts.insert(insts.end(), hoisted.begin(), hoisted.end());
+    if (compare)
+    {
+        insts.push_back(compare);
+    }
+    insts.insert(insts.end(), selects.begin(), selects.end());
+
+    // Only the head reaches the join now, so the two become one block, which
+    // may in turn be the arm of an enclosing diamond
+    auto& joinInsts = join->getInstructions();
+    insts.insert(insts.end(), joinInsts.begin() + phis.size(), joinInsts.end());
+    head->setSuccessors(join->getSuccessors());
+    for (auto& succ : join->getSuccessors())
+    {
+        succ->replacePredecessor(join, head);
+    }
+    for (auto& block : {trueArm, falseArm, join})
+    {
+        if (block)
+        {
+            block->setPredecessors({});
+            block->setSuccessors({});
+            m_removed.insert(block.get());
+        }
+    }
+    return true;
+}
+
+bool IfConverter::run()
+{
+    findArrays();
+
+    // Inner diamonds first, an arm left as a single block can go next
+    bool changed = false;
+    for (auto it = m_blocks.rbegin(); it != m_blocks.rend(); ++it)
+    {
+        if (m_removed.count(it->get()) == 0)
+        {
+            changed |= convert(*it);
+        }
+    }
+    return changed;
+}
+
+}  // namespace
+
+std::string IfConversionPass::getName() const { return "if-conversion"; }
+
+bool IfConversionPass::run(SSA& ssa)
+{
+    IfConverter converter(ssa);
+    return converter.run();
+}
+
+}  // namespace mina
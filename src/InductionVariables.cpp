@@ -0,0 +1,231 @@
+#include "InductionVariables.hpp"
+#include "BasicBlock.hpp"
+#include "IRUtils.hpp"
+#include "InstIR.hpp"
+
+#include <limits>
+#include <memory>
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+namespace mina
+{
+
+namespace
+{
+
+bool fitsInt(long long value)
+{
+    return value >= std::numeric_limits<int>::min() &&
+           value <= std::numeric_limits<int>::max();
+}
+
+bool getIntConstant(const std::shared_ptr<Inst>& operand, long long& value)
+{
+    auto target = operand->getTarget();
+    if (target->getInstType() != InstType::IntConst)
+    {
+        return false;
+    }
+    value = std::dynamic_pointer_cast<IntConstInst>(target)->getVal();
+    return true;
+}
+
+// Affine form of scale * x + offset, false if it doesn't fit
+bool makeAffine(const std::string& base, long long scale, long long offset,
+                AffineValue& result)
+{
+    if (scale == 0 || !fitsInt(scale) || !fitsInt(offset))
+    {
+        return false;
+    }
+    result = {base, scale, offset};
+    return true;
+}
+
+}  // namespace
+
+InductionVariables::InductionVariables(const Loop& loop)
+{
+    auto header = loop.getHeader();
+    auto preheader = loop.getPreheader();
+    if (!preheader || loop.getLatches().size() != 1)
+    {
+        return;
+    }
+    auto latch = loop.getLatches()[0];
+
+    for (auto& inst : header->getInstructions())
+    {
+        if (!inst->isPhi())
+        {
+            continue;
+        }
+        auto phi = std::dynamic_pointer_cast<PhiInst>(inst);
+        if (phi->getOperands().size() != 2)
+        {
+            continue;
+        }
+
+        BasicInductionVariable iv{phi->getTarget()->getString(), nullptr, "", 0};
+        for (unsigned int i = 0; i < 2; ++i)
+        {
+            if (phi->getOperandBB(i) == preheader)
+            {
+                iv.init = phi->getOperands()[i];
+            }
+            else if (phi->getOperandBB(i) == latch)
+            {
+                iv.next = getValueName(phi->getOperands()[i]);
+            }
+        }
+        if (iv.init && !iv.next.empty())
+        {
+            m_basicIVs.push_back(iv);
+        }
+    }
+
+    // Dropping a candidate can only remove affine forms, so this ends
+    bool isStable = false;
+    while (!isStable)
+    {
+        computeAffineForms(loop);
+        isStable = true;
+        for (size_t i = 0; i < m_basicIVs.size();)
+        {
+            auto& iv = m_basicIVs[i];
+            auto next = getAffine(iv.next);
+            if (next && next->base == iv.name && next->scale == 1 &&
+                next->offset != 0)
+            {
+                iv.step = next->offset;
+                ++i;
+                continue;
+            }
+            m_basicIVs.erase(m_basicIVs.begin() + i);
+            isStable = false;
+        }
+    }
+}
+
+void InductionVariables::computeAffineForms(const Loop& loop)
+{
+    m_affine.clear();
+    for (auto& iv : m_basicIVs)
+    {
+        m_affine[iv.name] = {iv.name, 1, 0};
+    }
+
+    // The blocks are in reverse post-order, so apart from the phis the
+    // operands computed in the loop are seen before their uses
+    for (auto& block : loop.getBlocks())
+    {
+        for (auto& inst : block->getInstructions())
+        {
+            auto type = inst->getInstType();
+            if (type != InstType::Assign && type != InstType::Add &&
+                type != InstType::Sub && type != InstType::Mul)
+            {
+                continue;
+            }
+
+            auto& operands = inst->getOperands();
+            auto lhs = getAffine(getValueName(operands[0]));
+            if (type == InstType::Assign)
+            {
+                if (lhs)
+                {
+                    m_affine[getDefinedName(inst)] = *lhs;
+                }
+                continue;
+            }
+
+            AffineValue result;
+            bool isAffine = false;
+            auto rhs = getAffine(getValueName(operands[1]));
+            long long lhsConst = 0, rhsConst = 0;
+            bool isLhsConst = getIntConstant(operands[0], lhsConst);
+            bool isRhsConst = getIntConstant(operands[1], rhsConst);
+
+            if (type == InstType::Add)
+            {
+                if (lhs && isRhsConst)
+                {
+                    isAffine = makeAffine(lhs->base, lhs->scale,
+                                          lhs->offset + rhsConst, result);
+                }
+                else if (isLhsConst && rhs)
+                {
+                    isAffine = makeAffine(rhs->base, rhs->scale,
+                                          lhsConst + rhs->offset, result);
+                }
+                else if (lhs && rhs && lhs->base == rhs->base)
+                {
+                    isAffine = makeAffine(lhs->base, lhs->scale + rhs->scale,
+                                          lhs->offset + rhs->offset, result);
+                }
+            }
+            else if (type == InstType::Sub)
+            {
+                if (lhs && isRhsConst)
+                {
+                    isAffine = makeAffine(lhs->base, lhs->scale,
+                                          lhs->offset - rhsConst, result);
+                }
+                else if (isLhsConst && rhs)
+                {
+                    isAffine = makeAffine(rhs->base, -rhs->scale,
+                                          lhsConst - rhs->offset, result);
+                }
+                else if (lhs && rhs && lhs->base == rhs->base)
+                {
+                    isAffine = makeAffine(lhs->base, lhs->scale - rhs->scale,
+                                          lhs->offset - rhs->offset, result);
+                }
+            }
+            else if (lhs && isRhsConst)
+            {
+                isAffine = makeAffine(lhs->base, lhs->scale * rhsConst,
+                                      lhs->offset * rhsConst, result);
+            }
+            else if (isLhsConst && rhs)
+            {
+                isAffine = makeAffine(rhs->base, lhsConst * rhs->scale,
+                                      lhsConst * rhs->offset, result);
+            }
+
+            if (isAffine)
+            {
+                m_affine[getDefinedName(inst)] = result;
+            }
+        }
+    }
+}
+
+const std::vector<BasicInductionVariable>&
+InductionVariables::getBasicIVs() const
+{
+    return m_basicIVs;
+}
+
+const BasicInductionVariable* InductionVariables::getBasicIV(
+    const std::string& name) const
+{
+    for (auto& iv : m_basicIVs)
+    {
+        if (iv.name == name)
+        {
+            return &iv;
+        }
+    }
+    return nullptr;
+}
+
+const AffineValue* InductionVariables::getAffine(const std::string& name) const
+{
+    auto it = m_affine.find(name);
+    return it == m_affine.end() ? nullptr : &it->second;
+}
+
+}  // namespace mina
@@ -0,0 +1,342 @@
+#include "Inliner.hpp"
+#include "BasicBlock.hpp"
+#include "IRUtils.hpp"
+#include "InstIR.hpp"
+#include "SSA.hpp"
+
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+#include <utility>
+#include <unordered_map>
+
+namespace mina
+{
+
+namespace
+{
+
+// Instructions a callee may have to be inlined
+constexpr size_t InlineThreshold = 24;
+
+// Allowance added to the threshold for every constant argument
+constexpr size_t ConstantArgBonus = 8;
+
+// Instructions a caller may grow to by inlining
+constexpr size_t MaxCallerSize = 2000;
+
+using ValueMap = std::unordered_map<std::string, std::shared_ptr<Inst>>;
+
+// Operand using the value, which is either a constant or a name
+std::shared_ptr<Inst> useValue(const std::shared_ptr<Inst>& value,
+                               const std::shared_ptr<BasicBlock>& block)
+{
+    auto name = getValueName(value);
+    return name.empty() ? value : makeValueRef(name, block);
+}
+
+void remapOperands(const std::shared_ptr<Inst>& inst, const ValueMap& values,
+                   const std::shared_ptr<BasicBlock>& block)
+{
+    for (auto& operand : inst->getOperands())
+    {
+        auto it = values.find(getValueName(operand));
+        if (it != values.end())
+        {
+            operand = useValue(it->second, block);
+        }
+    }
+}
+
+// Signature heading the entry block of a routine
+std::shared_ptr<Func> getSignature(SSA& ssa)
+{
+    auto& insts = ssa.getCFG()->getInstructions();
+    if (insts.empty())
+    {
+        return nullptr;
+    }
+    return std::dynamic_pointer_cast<Func>(insts.front());
+}
+
+struct CalleeInfo
+{
+    bool isInlinable = false;
+
+    // Instructions left once inlined, phis and jumps aside
+    size_t size = 0;
+};
+
+CalleeInfo analyzeCallee(SSA& callee, const std::string& calleeName)
+{
+    CalleeInfo info;
+    auto signature = getSignature(callee);
+    if (!signature)
+    {
+        return info;
+    }
+
+    bool isFunc = signature->getFType() == FType::FUNC;
+    bool leaves = false;
+    for (auto& block : getRPONodes(callee.getCFG()))
+    {
+        auto& insts = block->getInstructions();
+        bool isReturning =
+            !insts.empty() && insts.back()->getInstType() == InstType::Return;
+
+        // A function has to return a value on every path leaving it
+        if (block->getNumSuccessors() == 0)
+        {
+            if (isFunc && !isReturning)
+            {
+                return info;
+            }
+            leaves = true;
+        }
+
+        for (auto& inst : insts)
+        {
+            auto type = inst->getInstType();
+            if (type == InstType::Alloca || type == InstType::Halt ||
+                (type == InstType::Return && inst != insts.back()) ||
+                getCalleeName(inst) == calleeName)
+            {
+                return info;
+            }
+            if (!inst->isPhi() && type != InstType::Func &&
+                type != InstType::Jump)
+            {
+                ++info.size;
+            }
+        }
+    }
+
+    // The code after a call that never returns would be left unreachable
+    info.isInlinable = leaves;
+    return info;
+}
+
+// Replaces the call at index in block with a copy of the callee
+void inlineCall(SSA& ssa, const std::shared_ptr<BasicBlock>& block,
+                size_t index, SSA& callee)
+{
+    static int inlineCtr = 0;
+    auto inlineID = std::to_string(inlineCtr++);
+    auto suffix = "_inline" + inlineID;
+
+    auto& insts = block->getInstructions();
+    auto call = insts[index];
+    auto signature = getSignature(callee);
+    auto calleeBlocks = getRPONodes(callee.getCFG());
+
+    // The parameters take the arguments, every value of the copy a fresh name
+    ValueMap values;
+    auto& params = signature->getParameters();
+    auto& args = call->getOperands();
+    for (size_t i = 0; i < params.size(); ++i)
+    {
+        values[params[i]->getName()] = args[i];
+    }
+
+    std::unordered_map<BasicBlock*, std::shared_ptr<BasicBlock>> blocks;
+    for (auto& calleeBlock : calleeBlocks)
+    {
+        blocks[calleeBlock.get()] =
+            std::make_shared<BasicBlock>(calleeBlock->getName() + suffix);
+        for (auto& inst : calleeBlock->getInstructions())
+        {
+            auto name = getDefinedName(inst);
+            if (!name.empty())
+            {
+                values[name] =
+                    makeValueRef(ssa.makeFreshName(name), calleeBlock);
+            }
+        }
+    }
+
+    // The instructions after the call continue in a block of their own,
+    // which the copy returns to
+    auto returnBlock = std::make_shared<BasicBlock>(
+        signature->getFuncName() + "_return" + inlineID);
+    returnBlock->setInstructions({insts.begin() + index + 1, insts.end()});
+    insts.erase(insts.begin() + index, insts.end());
+    for (auto& succ : block->getSuccessors())
+    {
+        succ->replacePredecessor(block, returnBlock);
+    }
+    returnBlock->setSuccessors(block->getSuccessors());
+
+    auto entry = blocks[callee.getCFG().get()];
+    auto jumpInst = std::make_shared<JumpInst>(entry);
+    jumpInst->setup_def_use();
+    block->pushInst(jumpInst);
+    block->setSuccessors({entry});
+    entry->pushPredecessor(block);
+
+    std::vector<std::pair<std::shared_ptr<BasicBlock>, std::shared_ptr<Inst>>>
+        returns;
+    for (auto& calleeBlock : calleeBlocks)
+    {
+        auto newBlock = blocks[calleeBlock.get()];
+        std::shared_ptr<Inst> returnValue;
+        for (auto& inst : calleeBlock->getInstructions())
+        {
+            auto type = inst->getInstType();
+            if (type == InstType::Func)
+            {
+                continue;
+            }
+            if (type == InstType::Return)
+            {
+                auto& operands = inst->getOperands();
+                if (!operands.empty())
+                {
+                    auto it = values.find(getValueName(operands[0]));
+                    returnValue =
+                        it != values.end() ? it->second : operands[0];
+                }
+                continue;
+            }
+
+            auto name = getDefinedName(inst);
+            auto newInst = cloneInst(
+                inst, name.empty() ? "" : getValueName(values[name]), newBlock);
+            remapOperands(newInst, values, newBlock);
+            if (newInst->isPhi())
+            {
+                // Operands flowing in from blocks the callee never reaches
+                // have no copy
+                auto phi = std::dynamic_pointer_cast<PhiInst>(newInst);
+                for (unsigned int i = phi->getOperands().size(); i-- > 0;)
+                {
+                    auto it = blocks.find(phi->getOperandBB(i).get());
+                    if (it == blocks.end())
+                    {
+                        phi->removeOperand(i);
+                    }
+                    else
+                    {
+                        phi->setOperandBB(i, it->second);
+                    }
+                }
+            }
+            newBlock->pushInst(newInst);
+        }
+
+        newBlock->setSuccessors(calleeBlock->getSuccessors());
+        for (auto& succ : calleeBlock->getSuccessors())
+        {
+            newBlock->replaceSuccessor(succ, blocks[succ.get()]);
+        }
+        for (auto& pred : calleeBlock->getPredecessors())
+        {
+            auto it = blocks.find(pred.get());
+            if (it != blocks.end())
+            {
+                newBlock->pushPredecessor(it->second);
+            }
+        }
+
+        if (calleeBlock->getNumSuccessors() == 0)
+        {
+            auto returnJump = std::make_shared<JumpInst>(returnBlock);
+            returnJump->setup_def_use();
+            newBlock->pushInst(returnJump);
+            newBlock->pushSuccessor(returnBlock);
+            returnBlock->pushPredecessor(newBlock);
+            returns.push_back({newBlock, returnValue});
+        }
+    }
+
+    // The result of the call is the returned value
+    if (call->getInstType() != InstType::FuncCall)
+    {
+        return;
+    }
+    auto resultName = getDefinedName(call);
+    if (returns.size() == 1)
+    {
+        ValueMap result{{resultName, returns[0].second}};
+        for (auto& callerBlock : getRPONodes(ssa.getCFG()))
+        {
+            for (auto& inst : callerBlock->getInstructions())
+            {
+                remapOperands(inst, result, callerBlock);
+            }
+        }
+        return;
+    }
+
+    auto phi = std::make_shared<PhiInst>(resultName, returnBlock);
+    for (auto& [returnFrom, value] : returns)
+    {
+        phi->appendOperand(useValue(value, returnBlock), returnFrom);
+    }
+    phi->setup_def_use();
+    returnBlock->pushInstBegin(phi);
+}
+
+}  // namespace
+
+InlinerPass::InlinerPass(std::map<std::string, SSA>& functions)
+    : m_functions{functions}
+{
+}
+
+std::string InlinerPass::getName() const { return "inline"; }
+
+bool InlinerPass::run(SSA& ssa)
+{
+    std::map<std::string, CalleeInfo> callees;
+    auto callerSize = countInstructions(ssa);
+    bool changed = false;
+    for (auto& block : getRPONodes(ssa.getCFG()))
+    {
+        // Inlining moves the instructions following the call to a new block,
+        // so the calls of a block are visited from the last
+        auto& insts = block->getInstructions();
+        for (size_t i = insts.size(); i-- > 0;)
+        {
+            auto calleeName = getCalleeName(insts[i]);
+            auto function = m_functions.find(calleeName);
+            if (function == m_functions.end() || &function->second == &ssa)
+            {
+                continue;
+            }
+
+            auto& callee = function->second;
+            auto it = callees.find(calleeName);
+            if (it == callees.end())
+            {
+                it = callees.emplace(calleeName,
+                                     analyzeCallee(callee, calleeName))
+                         .first;
+            }
+            auto& info = it->second;
+
+            auto threshold = InlineThreshold;
+            auto& args = insts[i]->getOperands();
+            for (auto& arg : args)
+            {
+                if (isConstant(arg))
+                {
+                    threshold += ConstantArgBonus;
+                }
+            }
+            if (!info.isInlinable || info.size > threshold ||
+                callerSize + info.size > MaxCallerSize ||
+                args.size() != getSignature(callee)->getParameters().size())
+            {
+                continue;
+            }
+
+            inlineCall(ssa, block, i, callee);
+            callerSize += info.size;
+            changed = true;
+        }
+    }
+    return changed;
+}
+
+}  // namespace mina
@@ -261,6 +261,14 @@ std::string DivInst::getString()
     auto target = m_target->getTarget()->getString();
 
     std::string res = target + " <- Div(";
+    if (m_kind == DivKind::Unsigned)
+    {
+        res = target + " <- UDiv(";
+    }
+    else if (m_kind == DivKind::Unsigned32)
+    {
+        res = target + " <- UDiv32(";
+    }
     for (int i = 0; i < m_operands.size(); ++i)
     {
         if (i)
@@ -487,6 +495,10 @@ std::string ArrAccessInst::getString()
             res += ", ";
         }
         res += m_operands[i]->getTarget()->getString();
+        if (i == 1 && m_isIndexScaled)
+        {
+            res += " bytes";
+        }
     }
     res += ")";
     return res;
@@ -541,6 +553,10 @@ std::string ArrUpdateInst::getString()
             res += ", ";
         }
         res += m_operands[i]->getTarget()->getString();
+        if (i == 1 && m_isIndexScaled)
+        {
+            res += " bytes";
+        }
     }
     res += ")";
     return res;
@@ -1084,6 +1100,7 @@ Func::Func(std::string funcName, FType fType, Type retType,
 }
 std::string Func::getFuncName() { return m_funcName; }
 FType Func::getFType() const { return m_fType; }
+Type Func::getRetType() const { return m_retType; }
 std::string Func::getString()
 {
     std::string res;
@@ -1243,7 +1260,13 @@ void ProcCallInst::push_user(std::shared_ptr<Inst> user)
 {
     m_users.push_back(user);
 }
-void ProcCallInst::setup_def_use() {}
+void ProcCallInst::setup_def_use()
+{
+    for (auto& operand : m_operands)
+    {
+        operand->push_user(shared_from_this());
+    }
+}
 std::vector<std::shared_ptr<Inst>>& ProcCallInst::getOperands()
 {
     return m_operands;
@@ -1285,7 +1308,13 @@ void FuncCallInst::push_user(std::shared_ptr<Inst> user)
 {
     m_users.push_back(user);
 }
-void FuncCallInst::setup_def_use() {}
+void FuncCallInst::setup_def_use()
+{
+    for (auto& operand : m_operands)
+    {
+        operand->push_user(shared_from_this());
+    }
+}
 std::vector<std::shared_ptr<Inst>>& FuncCallInst::getOperands()
 {
     return m_operands;
@@ -1299,6 +1328,11 @@ PhiInst::PhiInst(std::string name, std::shared_ptr<BasicBlock> block)
 }
 void PhiInst::appendOperand(std::shared_ptr<Inst> operand, std::shared_ptr<BasicBlock> operandBB)
 {
+    // Removing a trivial phi rewrites the phis using it through this list
+    if (operand)
+    {
+        operand->push_user(shared_from_this());
+    }
     m_operands.push_back(operand);
     m_operandBBs.push_back(operandBB);
 }
@@ -1310,6 +1344,24 @@ std::shared_ptr<BasicBlock> PhiInst::getOperandBB(unsigned index)
     }
     return m_operandBBs[index];
 }
+void PhiInst::setOperandBB(unsigned index,
+                           std::shared_ptr<BasicBlock> operandBB)
+{
+    if (index >= m_operandBBs.size())
+    {
+        throw std::runtime_error("PhiInst: operand index out of range!");
+    }
+    m_operandBBs[index] = std::move(operandBB);
+}
+void PhiInst::removeOperand(unsigned index)
+{
+    if (index >= m_operands.size())
+    {
+        throw std::runtime_error("PhiInst: operand index out of range!");
+    }
+    m_operands.erase(m_operands.begin() + index);
+    m_operandBBs.erase(m_operandBBs.begin() + index);
+}
 
 std::shared_ptr<Inst> PhiInst::getTarget() { return m_target; }
 std::shared_ptr<BasicBlock> PhiInst::getBlock() { return m_block; }
@@ -1351,6 +1403,57 @@ bool PhiInst::isPhi() { return true; }
 void PhiInst::setTarget(std::shared_ptr<Inst> target) { m_target = target; }
 InstType PhiInst::getInstType() const { return InstType::Phi; }
 
+SelectInst::SelectInst(std::shared_ptr<Inst> target, std::shared_ptr<Inst> cond,
+                       std::shared_ptr<Inst> trueValue,
+                       std::shared_ptr<Inst> falseValue,
+                       std::shared_ptr<BasicBlock> block)
+    : m_target(std::move(target)),
+      m_cond(std::move(cond)),
+      m_trueValue(std::move(trueValue)),
+      m_falseValue(std::move(falseValue)),
+      m_block(std::move(block))
+{
+    m_operands =
+        std::vector<std::shared_ptr<Inst>>{m_cond, m_trueValue, m_falseValue};
+}
+std::shared_ptr<Inst> SelectInst::getTarget() { return m_target; }
+std::shared_ptr<Inst> SelectInst::getCond() { return m_operands[0]; }
+std::shared_ptr<Inst> SelectInst::getTrueValue() { return m_operands[1]; }
+std::shared_ptr<Inst> SelectInst::getFalseValue() { return m_operands[2]; }
+std::string SelectInst::getString()
+{
+    auto target = m_target->getTarget()->getString();
+
+    std::string res = target + " <- Select(";
+    for (size_t i = 0; i < m_operands.size(); ++i)
+    {
+        if (i)
+        {
+            res += ", ";
+        }
+        res += m_operands[i]->getTarget()->getString();
+    }
+    res += ")";
+    return res;
+}
+void SelectInst::push_user(std::shared_ptr<Inst> user)
+{
+    m_users.push_back(user);
+}
+void SelectInst::setup_def_use()
+{
+    m_cond->push_user(shared_from_this());
+    m_trueValue->push_user(shared_from_this());
+    m_falseValue->push_user(shared_from_this());
+}
+std::vector<std::shared_ptr<Inst>>& SelectInst::getOperands()
+{
+    return m_operands;
+}
+void SelectInst::setTarget(std::shared_ptr<Inst> target) { m_target = target; }
+std::shared_ptr<BasicBlock> SelectInst::getBlock() { return m_block; };
+InstType SelectInst::getInstType() const { return InstType::Select; }
+
 HaltInst::HaltInst(std::shared_ptr<BasicBlock> block)
     : m_block(std::move(block))
 {
@@ -0,0 +1,154 @@
+#include "LICM.hpp"
+#include "BasicBlock.hpp"
+#include "Dominators.hpp"
+#include "IRUtils.hpp"
+#include "LoopInfo.hpp"
+#include "InstIR.hpp"
+#include "SSA.hpp"
+
+#include <memory>
+#include <string>
+#include <vector>
+#include <unordered_set>
+
+namespace mina
+{
+
+namespace
+{
+
+// isGuaranteed tells whether the block of the instruction runs on every
+// iteration of the loop
+bool isHoistable(const std::shared_ptr<Inst>& inst, bool isGuaranteed)
+{
+    switch (inst->getInstType())
+    {
+        case InstType::Add:
+        case InstType::Sub:
+        case InstType::Mul:
+        case InstType::Not:
+        case InstType::And:
+        case InstType::Or:
+        case InstType::Assign:
+        case InstType::CmpEq:
+        case InstType::CmpNE:
+        case InstType::CmpLT:
+        case InstType::CmpLTE:
+        case InstType::CmpGT:
+        case InstType::CmpGTE:
+        case InstType::Select:
+            return true;
+        case InstType::Div:
+        {
+            // Dividing by a constant other than 0 and -1 can't fault
+            auto divisor = inst->getOperands()[1]->getTarget();
+            if (divisor->getInstType() == InstType::IntConst)
+            {
+                auto value =
+                    std::dynamic_pointer_cast<IntConstInst>(divisor)->getVal();
+                return isGuaranteed || (value != 0 && value != -1);
+            }
+            return isGuaranteed;
+        }
+        case InstType::ArrAccess:
+            return isGuaranteed;
+        default:
+            return false;
+    }
+}
+
+bool hoistInvariants(const Loop& loop, const DominatorTree& domTree)
+{
+    auto preheader = loop.getPreheader();
+    if (!preheader)
+    {
+        return false;
+    }
+
+    std::unordered_set<std::string> definedInLoop;
+    for (auto& block : loop.getBlocks())
+    {
+        for (auto& inst : block->getInstructions())
+        {
+            auto name = getDefinedName(inst);
+            if (!name.empty())
+            {
+                definedInLoop.insert(name);
+            }
+        }
+    }
+
+    auto exitingBlocks = loop.getExitingBlocks();
+
+    bool changed = false;
+    for (auto& block : loop.getBlocks())
+    {
+        bool isGuaranteed = !exitingBlocks.empty();
+        for (auto& exiting : exitingBlocks)
+        {
+            isGuaranteed &= domTree.dominates(block, exiting);
+        }
+
+        // Blocks are in reverse post-order, so the operands defined in the
+        // loop have been looked at before their uses, except for phis
+        auto& instructions = block->getInstructions();
+        for (size_t i = 0; i < instructions.size();)
+        {
+            auto inst = instructions[i];
+            bool isInvariant = isHoistable(inst, isGuaranteed);
+            for (auto& operand : inst->getOperands())
+            {
+                if (!isInvariant)
+                {
+                    break;
+                }
+                isInvariant = definedInLoop.count(getValueName(operand)) == 0;
+            }
+            if (!isInvariant)
+            {
+                ++i;
+                continue;
+            }
+
+            instructions.erase(instructions.begin() + i);
+            auto& preheaderInsts = preheader->getInstructions();
+            preheader->insertInstAtIndex(preheaderInsts.size() - 1, inst);
+            definedInLoop.erase(getDefinedName(inst));
+            changed = true;
+        }
+    }
+    return changed;
+}
+
+}  // namespace
+
+std::string LICMPass::getName() const { return "licm"; }
+
+bool LICMPass::run(SSA& ssa)
+{
+    // Preheaders come first since the loop forest has to be rebuilt once the
+    // CFG changes. A new preheader only adds a block to the loops around it,
+    // which keeps the other loops of the forest usable meanwhile.
+    bool changed = false;
+    for (auto loop : ssa.getLoopForest()->getLoopsInnermostFirst())
+    {
+        if (!loop->getPreheader())
+        {
+            insertPreheader(ssa, *loop);
+            changed = true;
+        }
+    }
+    if (changed)
+    {
+        ssa.invalidateCFGAnalyses();
+    }
+
+    auto domTree = ssa.getDominatorTree();
+    for (auto loop : ssa.getLoopForest()->getLoopsInnermostFirst())
+    {
+        changed |= hoistInvariants(*loop, *domTree);
+    }
+    return changed;
+}
+
+}  // namespace mina
@@ -0,0 +1,390 @@
+#include "LoopInfo.hpp"
+#include "BasicBlock.hpp"
+#include "IRUtils.hpp"
+#include "MachineIR.hpp"
+#include "InstIR.hpp"
+#include "SSA.hpp"
+
+#include <memory>
+#include <string>
+#include <vector>
+#include <iostream>
+#include <algorithm>
+#include <unordered_set>
+#include <unordered_map>
+
+namespace mina
+{
+
+template <typename BlockT>
+LoopBase<BlockT>::LoopBase(BlockPtr header)
+    : m_header{std::move(header)},
+      m_parent{nullptr}
+{
+}
+
+template <typename BlockT>
+std::shared_ptr<BlockT> LoopBase<BlockT>::getHeader() const
+{
+    return m_header;
+}
+
+template <typename BlockT>
+LoopBase<BlockT>* LoopBase<BlockT>::getParentLoop() const
+{
+    return m_parent;
+}
+
+template <typename BlockT>
+const std::vector<LoopBase<BlockT>*>& LoopBase<BlockT>::getSubLoops() const
+{
+    return m_subLoops;
+}
+
+template <typename BlockT>
+const std::vector<std::shared_ptr<BlockT>>& LoopBase<BlockT>::getBlocks() const
+{
+    return m_blocks;
+}
+
+template <typename BlockT>
+bool LoopBase<BlockT>::contains(const BlockPtr& block) const
+{
+    return block && m_blockSet.count(block.get()) != 0;
+}
+
+template <typename BlockT>
+bool LoopBase<BlockT>::contains(const LoopBase* loop) const
+{
+    for (; loop; loop = loop->m_parent)
+    {
+        if (loop == this)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+template <typename BlockT>
+unsigned int LoopBase<BlockT>::getLoopDepth() const
+{
+    unsigned int depth = 1;
+    for (auto loop = m_parent; loop; loop = loop->m_parent)
+    {
+        ++depth;
+    }
+    return depth;
+}
+
+template <typename BlockT>
+const std::vector<std::shared_ptr<BlockT>>& LoopBase<BlockT>::getLatches() const
+{
+    return m_latches;
+}
+
+template <typename BlockT>
+std::vector<std::shared_ptr<BlockT>> LoopBase<BlockT>::getExitingBlocks() const
+{
+    std::vector<BlockPtr> exiting;
+    for (auto& block : m_blocks)
+    {
+        for (auto& succ : block->getSuccessors())
+        {
+            if (!contains(succ))
+            {
+                exiting.push_back(block);
+                break;
+            }
+        }
+    }
+    return exiting;
+}
+
+template <typename BlockT>
+std::vector<std::shared_ptr<BlockT>> LoopBase<BlockT>::getExitBlocks() const
+{
+    std::vector<BlockPtr> exits;
+    std::unordered_set<BlockT*> seen;
+    for (auto& block : m_blocks)
+    {
+        for (auto& succ : block->getSuccessors())
+        {
+            if (!contains(succ) && seen.insert(succ.get()).second)
+            {
+                exits.push_back(succ);
+            }
+        }
+    }
+    return exits;
+}
+
+template <typename BlockT>
+std::vector<std::shared_ptr<BlockT>> LoopBase<BlockT>::getOutsidePredecessors()
+    const
+{
+    std::vector<BlockPtr> preds;
+    for (auto& pred : m_header->getPredecessors())
+    {
+        if (!contains(pred) &&
+            std::find(preds.begin(), preds.end(), pred) == preds.end())
+        {
+            preds.push_back(pred);
+        }
+    }
+    return preds;
+}
+
+template <typename BlockT>
+std::shared_ptr<BlockT> LoopBase<BlockT>::getPreheader() const
+{
+    auto preds = getOutsidePredecessors();
+    if (preds.size() != 1 || preds[0]->getSuccessors().size() != 1)
+    {
+        return nullptr;
+    }
+    return preds[0];
+}
+
+template <typename BlockT>
+LoopForestBase<BlockT>::LoopForestBase(
+    const DominatorTreeBase<BlockT>& domTree)
+{
+    // Inner headers come after their enclosing headers in dominator tree
+    // pre-order, so walking it backwards discovers inner loops first
+    auto preOrder = domTree.getPreOrder();
+    for (auto it = preOrder.rbegin(); it != preOrder.rend(); ++it)
+    {
+        auto& header = *it;
+        std::vector<BlockPtr> latches;
+        for (auto& pred : header->getPredecessors())
+        {
+            if (domTree.dominates(header, pred) &&
+                std::find(latches.begin(), latches.end(), pred) ==
+                    latches.end())
+            {
+                latches.push_back(pred);
+            }
+        }
+        if (latches.empty())
+        {
+            continue;
+        }
+
+        m_loops.push_back(std::make_unique<LoopT>(header));
+        auto loop = m_loops.back().get();
+        loop->m_latches = latches;
+        m_blockToLoop[header.get()] = loop;
+
+        std::vector<BlockPtr> worklist(latches.begin(), latches.end());
+        while (!worklist.empty())
+        {
+            auto block = worklist.back();
+            worklist.pop_back();
+            if (!domTree.contains(block))
+            {
+                continue;
+            }
+
+            auto found = m_blockToLoop.find(block.get());
+            if (found == m_blockToLoop.end())
+            {
+                m_blockToLoop[block.get()] = loop;
+                for (auto& pred : block->getPredecessors())
+                {
+                    worklist.push_back(pred);
+                }
+                continue;
+            }
+
+            // The block is already in a loop, find the outermost loop found
+            // so far that contains it and make it a subloop of this one
+            auto subLoop = found->second;
+            while (subLoop->m_parent)
+            {
+                subLoop = subLoop->m_parent;
+            }
+            if (subLoop == loop)
+            {
+                continue;
+            }
+
+            subLoop->m_parent = loop;
+            loop->m_subLoops.push_back(subLoop);
+            for (auto& pred : subLoop->m_header->getPredecessors())
+            {
+                if (!subLoop->contains(pred) &&
+                    std::find(subLoop->m_latches.begin(),
+                              subLoop->m_latches.end(),
+                              pred) == subLoop->m_latches.end())
+                {
+                    worklist.push_back(pred);
+                }
+            }
+        }
+
+        // Fill the block lists of this loop right away, they are needed to
+        // tell the entries of a subloop from its back edges when the loop
+        // becomes a subloop itself
+        for (auto& block : domTree.getBlocks())
+        {
+            auto inner = m_blockToLoop.find(block.get());
+            if (inner != m_blockToLoop.end() && loop->contains(inner->second))
+            {
+                loop->m_blocks.push_back(block);
+                loop->m_blockSet[block.get()] = true;
+            }
+        }
+    }
+
+    // Blocks were collected in reverse post-order of the dominator tree
+    // builder, sort the loops into program order
+    for (auto& loop : m_loops)
+    {
+        std::reverse(loop->m_subLoops.begin(), loop->m_subLoops.end());
+        if (!loop->m_parent)
+        {
+            m_topLevelLoops.push_back(loop.get());
+        }
+    }
+    std::reverse(m_topLevelLoops.begin(), m_topLevelLoops.end());
+}
+
+template <typename BlockT>
+const std::vector<LoopBase<BlockT>*>& LoopForestBase<BlockT>::getTopLevelLoops()
+    const
+{
+    return m_topLevelLoops;
+}
+
+template <typename BlockT>
+std::vector<LoopBase<BlockT>*> LoopForestBase<BlockT>::getLoopsInnermostFirst()
+    const
+{
+    std::vector<LoopT*> loops;
+    for (auto& loop : m_loops)
+    {
+        loops.push_back(loop.get());
+    }
+    return loops;
+}
+
+template <typename BlockT>
+LoopBase<BlockT>* LoopForestBase<BlockT>::getLoopFor(const BlockPtr& block) const
+{
+    if (!block)
+    {
+        return nullptr;
+    }
+    auto it = m_blockToLoop.find(block.get());
+    return it == m_blockToLoop.end() ? nullptr : it->second;
+}
+
+template <typename BlockT>
+unsigned int LoopForestBase<BlockT>::getLoopDepth(const BlockPtr& block) const
+{
+    auto loop = getLoopFor(block);
+    return loop ? loop->getLoopDepth() : 0;
+}
+
+template <typename BlockT>
+bool LoopForestBase<BlockT>::isLoopHeader(const BlockPtr& block) const
+{
+    auto loop = getLoopFor(block);
+    return loop && loop->getHeader() == block;
+}
+
+template <typename BlockT>
+void LoopForestBase<BlockT>::print() const
+{
+    for (auto& loop : m_loops)
+    {
+        std::cout << std::string(2 * (loop->getLoopDepth() - 1), ' ')
+                  << "loop " << loop->getHeader()->getName()
+                  << " depth=" << loop->getLoopDepth() << " blocks:";
+        for (auto& block : loop->getBlocks())
+        {
+            std::cout << " " << block->getName();
+        }
+        std::cout << " latches:";
+        for (auto& latch : loop->getLatches())
+        {
+            std::cout << " " << latch->getName();
+        }
+        std::cout << " exits:";
+        for (auto& exit : loop->getExitBlocks())
+        {
+            std::cout << " " << exit->getName();
+        }
+        std::cout << std::endl;
+    }
+}
+
+template class LoopBase<BasicBlock>;
+template class LoopBase<BasicBlockMIR>;
+template class LoopForestBase<BasicBlock>;
+template class LoopForestBase<BasicBlockMIR>;
+
+// The name unless a block of the function already has it, then the name
+// with the first free numeric suffix
+static std::string makeBlockName(SSA& ssa, const std::string& name)
+{
+    std::unordered_set<std::string> names;
+    for (auto& block : getRPONodes(ssa.getCFG()))
+    {
+        names.insert(block->getName());
+    }
+
+    auto newName = name;
+    for (int suffix = 1; names.count(newName) != 0; ++suffix)
+    {
+        newName = name + "_" + std::to_string(suffix);
+    }
+    return newName;
+}
+
+std::shared_ptr<BasicBlock> insertPreheader(SSA& ssa, const Loop& loop)
+{
+    if (auto preheader = loop.getPreheader())
+    {
+        return preheader;
+    }
+
+    auto header = loop.getHeader();
+    return splitPredecessors(ssa, header, loop.getOutsidePredecessors(),
+                             makeBlockName(ssa, header->getName() + "_preheader"));
+}
+
+bool insertDedicatedExits(SSA& ssa, const Loop& loop)
+{
+    bool changed = false;
+    for (auto& exit : loop.getExitBlocks())
+    {
+        std::vector<std::shared_ptr<BasicBlock>> insidePreds;
+        bool isDedicated = true;
+        for (auto& pred : exit->getPredecessors())
+        {
+            if (!loop.contains(pred))
+            {
+                isDedicated = false;
+            }
+            else if (std::find(insidePreds.begin(), insidePreds.end(), pred) ==
+                     insidePreds.end())
+            {
+                insidePreds.push_back(pred);
+            }
+        }
+        if (isDedicated)
+        {
+            continue;
+        }
+
+        splitPredecessors(
+            ssa, exit, insidePreds,
+            makeBlockName(ssa, loop.getHeader()->getName() + "_loopexit"));
+        changed = true;
+    }
+    return changed;
+}
+
+}  // namespace mina
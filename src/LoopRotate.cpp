@@ -0,0 +1,420 @@
+#include "LoopRotate.hpp"
+#include "BasicBlock.hpp"
+#include "IRUtils.hpp"
+#include "InstIR.hpp"
+#include "LoopInfo.hpp"
+#include "SSA.hpp"
+
+#include <memory>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace mina
+{
+
+namespace
+{
+
+// Instructions of the chain ending with the exit test, it is copied twice
+constexpr size_t MaxRotatedSize = 16;
+
+using ValueMap = std::unordered_map<std::string, std::shared_ptr<Inst>>;
+
+// Operand using the value, which is either a constant or a name
+std::shared_ptr<Inst> useValue(const std::shared_ptr<Inst>& value,
+                               const std::shared_ptr<BasicBlock>& block)
+{
+    auto name = getValueName(value);
+    return name.empty() ? value : makeValueRef(name, block);
+}
+
+void remapOperands(const std::shared_ptr<Inst>& inst, const ValueMap& values,
+                   const std::shared_ptr<BasicBlock>& block)
+{
+    for (auto& operand : inst->getOperands())
+    {
+        auto it = values.find(getValueName(operand));
+        if (it != values.end())
+        {
+            operand = useValue(it->second, block);
+        }
+    }
+}
+
+class LoopRotator
+{
+public:
+    LoopRotator(SSA& ssa, const Loop& loop);
+
+    bool run();
+
+private:
+    SSA& m_ssa;
+    const Loop& m_loop;
+    std::shared_ptr<BasicBlock> m_header, m_preheader, m_latch, m_exiting,
+        m_body, m_exit;
+
+    // The header and the blocks it falls into, up to the exit test
+    std::vector<std::shared_ptr<BasicBlock>> m_chain;
+
+    bool findChain();
+    bool isInChain(const std::shared_ptr<BasicBlock>& block) const;
+    ValueMap copyChain(const std::shared_ptr<BasicBlock>& block,
+                       const ValueMap& headerValues);
+};
+
+LoopRotator::LoopRotator(SSA& ssa, const Loop& loop)
+    : m_ssa{ssa}, m_loop{loop}
+{
+}
+
+bool LoopRotator::findChain()
+{
+    m_header = m_loop.getHeader();
+    m_preheader = m_loop.getPreheader();
+    if (!m_preheader || m_loop.getLatches().size() != 1)
+    {
+        return false;
+    }
+    m_latch = m_loop.getLatches()[0];
+    auto latchTerminator = m_latch->getTerminator();
+    if (!latchTerminator || latchTerminator->getInstType() != InstType::Jump)
+    {
+        return false;
+    }
+
+    size_t size = 0;
+    auto block = m_header;
+    while (true)
+    {
+        m_chain.push_back(block);
+        for (auto& inst : block->getInstructions())
+        {
+            if (inst->isPhi())
+            {
+                if (block != m_header || inst->getOperands().size() != 2)
+                {
+                    return false;
+                }
+                continue;
+            }
+
+            auto type = inst->getInstType();
+            if (++size > MaxRotatedSize || type == InstType::Alloca ||
+                type == InstType::Return || type == InstType::Halt)
+            {
+                return false;
+            }
+        }
+
+        auto terminator = block->getTerminator();
+        if (!terminator)
+        {
+            return false;
+        }
+        if (terminator->getInstType() != InstType::Jump)
+        {
+            break;
+        }
+
+        // The latch jumps back to the header, so it never continues the chain
+        auto next = block->getSuccessors()[0];
+        if (next == m_header || !m_loop.contains(next) ||
+            next->getNumPredecessors() != 1)
+        {
+            return false;
+        }
+        block = next;
+    }
+
+    m_exiting = block;
+    auto succs = m_exiting->getSuccessors();
+    if (succs.size() != 2 ||
+        m_loop.contains(succs[0]) == m_loop.contains(succs[1]))
+    {
+        return false;
+    }
+    m_body = m_loop.contains(succs[0]) ? succs[0] : succs[1];
+    m_exit = m_loop.contains(succs[0]) ? succs[1] : succs[0];
+    if (m_body == m_header || m_body->getNumPredecessors() != 1 ||
+        m_exit->getNumPredecessors() != 1)
+    {
+        return false;
+    }
+    for (auto& inst : m_body->getInstructions())
+    {
+        if (inst->isPhi())
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool LoopRotator::isInChain(const std::shared_ptr<BasicBlock>& block) const
+{
+    return std::find(m_chain.begin(), m_chain.end(), block) != m_chain.end();
+}
+
+// Replaces the jump ending the block with a copy of the chain, in which the
+// header phis take the given values. Returns the values of the copy.
+ValueMap LoopRotator::copyChain(const std::shared_ptr<BasicBlock>& block,
+                                const ValueMap& headerValues)
+{
+    ValueMap values = headerValues;
+    for (auto& chainBlock : m_chain)
+    {
+        for (auto& inst : chainBlock->getInstructions())
+        {
+            auto name = getDefinedName(inst);
+            if (!name.empty() && values.count(name) == 0)
+            {
+                values[name] = makeValueRef(m_ssa.makeFreshName(name), block);
+            }
+        }
+    }
+
+    block->getInstructions().pop_back();
+    for (auto& chainBlock : m_chain)
+    {
+        for (auto& inst : chainBlock->getInstructions())
+        {
+            if (inst->isPhi() || inst->getInstType() == InstType::Jump)
+            {
+                continue;
+            }
+
+            auto name = getDefinedName(inst);
+            auto newInst = cloneInst(
+                inst, name.empty() ? "" : getValueName(values[name]), block);
+            remapOperands(newInst, values, block);
+            block->pushInst(newInst);
+        }
+    }
+    block->setSuccessors(m_exiting->getSuccessors());
+    return values;
+}
+
+bool LoopRotator::run()
+{
+    if (!findChain())
+    {
+        return false;
+    }
+
+    std::vector<std::string> chainValues;
+    std::unordered_set<std::string> isChainValue;
+    for (auto& block : m_chain)
+    {
+        for (auto& inst : block->getInstructions())
+        {
+            auto name = getDefinedName(inst);
+            if (!name.empty())
+            {
+                chainValues.push_back(name);
+                isChainValue.insert(name);
+            }
+        }
+    }
+
+    // Values of the chain read after the exit test, inside the loop or past
+    // its exit. The phis of the exit are rewritten on their own.
+    auto blocks = getRPONodes(m_ssa.getCFG());
+    std::unordered_set<std::string> usedInLoop, usedOutside;
+    for (auto& block : blocks)
+    {
+        if (isInChain(block))
+        {
+            continue;
+        }
+        for (auto& inst : block->getInstructions())
+        {
+            if (block == m_exit && inst->isPhi())
+            {
+                continue;
+            }
+            for (auto& operand : inst->getOperands())
+            {
+                auto name = getValueName(operand);
+                if (isChainValue.count(name) != 0)
+                {
+                    (m_loop.contains(block) ? usedInLoop : usedOutside)
+                        .insert(name);
+                }
+            }
+        }
+    }
+
+    ValueMap entryValues, latchValues;
+    for (auto& inst : m_header->getInstructions())
+    {
+        if (!inst->isPhi())
+        {
+            continue;
+        }
+        auto phi = std::dynamic_pointer_cast<PhiInst>(inst);
+        for (unsigned int i = 0; i < 2; ++i)
+        {
+            auto& values =
+                phi->getOperandBB(i) == m_preheader ? entryValues : latchValues;
+            values[getDefinedName(phi)] = phi->getOperands()[i];
+        }
+    }
+
+    // The body now starts the loop and merges the two copies of the chain.
+    // A header phi fed by a value of the chain reads it from the previous
+    // iteration, which the body has in its phi.
+    ValueMap bodyValues;
+    for (auto& [name, value] : latchValues)
+    {
+        auto valueName = getValueName(value);
+        if (isChainValue.count(valueName) != 0)
+        {
+            usedInLoop.insert(valueName);
+        }
+    }
+    for (auto& name : chainValues)
+    {
+        if (usedInLoop.count(name) != 0)
+        {
+            bodyValues[name] =
+                makeValueRef(m_ssa.makeFreshName(name), m_body);
+        }
+    }
+    for (auto& [name, value] : latchValues)
+    {
+        auto it = bodyValues.find(getValueName(value));
+        if (it != bodyValues.end())
+        {
+            value = it->second;
+        }
+    }
+    for (auto& block : m_loop.getBlocks())
+    {
+        if (isInChain(block))
+        {
+            continue;
+        }
+        for (auto& inst : block->getInstructions())
+        {
+            remapOperands(inst, bodyValues, block);
+        }
+    }
+
+    auto guardValues = copyChain(m_preheader, entryValues);
+    auto backValues = copyChain(m_latch, latchValues);
+
+    // Phi merging the copies of a value of the chain
+    auto insertMergePhi = [&](const std::string& name,
+                              const std::string& phiName,
+                              const std::shared_ptr<BasicBlock>& block)
+    {
+        auto phi = std::make_shared<PhiInst>(phiName, block);
+        phi->appendOperand(useValue(guardValues[name], block), m_preheader);
+        phi->appendOperand(useValue(backValues[name], block), m_latch);
+        phi->setup_def_use();
+        block->pushInstBegin(phi);
+    };
+
+    for (auto& name : chainValues)
+    {
+        auto it = bodyValues.find(name);
+        if (it != bodyValues.end())
+        {
+            insertMergePhi(name, getValueName(it->second), m_body);
+        }
+    }
+
+    // The exit is entered from the guard or from the latch instead of from
+    // the exit test
+    for (auto& inst : m_exit->getInstructions())
+    {
+        if (!inst->isPhi())
+        {
+            continue;
+        }
+        auto phi = std::dynamic_pointer_cast<PhiInst>(inst);
+        auto value = phi->getOperands()[0];
+        auto name = getValueName(value);
+        bool isFromChain = isChainValue.count(name) != 0;
+        phi->removeOperand(0);
+        phi->appendOperand(
+            useValue(isFromChain ? guardValues[name] : value, m_exit),
+            m_preheader);
+        phi->appendOperand(
+            useValue(isFromChain ? backValues[name] : value, m_exit),
+            m_latch);
+    }
+
+    ValueMap exitValues;
+    for (auto& name : chainValues)
+    {
+        if (usedOutside.count(name) == 0)
+        {
+            continue;
+        }
+        auto phiName = m_ssa.makeFreshName(name);
+        insertMergePhi(name, phiName, m_exit);
+        exitValues[name] = makeValueRef(phiName, m_exit);
+    }
+    for (auto& block : blocks)
+    {
+        if (m_loop.contains(block))
+        {
+            continue;
+        }
+        for (auto& inst : block->getInstructions())
+        {
+            if (!(block == m_exit && inst->isPhi()))
+            {
+                remapOperands(inst, exitValues, block);
+            }
+        }
+    }
+
+    m_body->setPredecessors({m_preheader, m_latch});
+    m_exit->setPredecessors({m_preheader, m_latch});
+    return true;
+}
+
+}  // namespace
+
+std::string LoopRotatePass::getName() const { return "loop-rotate"; }
+
+bool LoopRotatePass::run(SSA& ssa)
+{
+    bool changed = false;
+    for (auto loop : ssa.getLoopForest()->getLoopsInnermostFirst())
+    {
+        if (!loop->getPreheader())
+        {
+            insertPreheader(ssa, *loop);
+            changed = true;
+        }
+    }
+
+    // A rotation changes the blocks of the loops around the rotated one, so
+    // the forest is rebuilt after each. Rotated loops branch at the latch and
+    // are not rotated again.
+    bool isRotated = true;
+    while (isRotated)
+    {
+        ssa.invalidateCFGAnalyses();
+        isRotated = false;
+        for (auto loop : ssa.getLoopForest()->getLoopsInnermostFirst())
+        {
+            LoopRotator rotator(ssa, *loop);
+            if (rotator.run())
+            {
+                isRotated = changed = true;
+                break;
+            }
+        }
+    }
+    return changed;
+}
+
+}  // namespace mina
@@ -0,0 +1,88 @@
+#include "LoopSimplify.hpp"
+#include "BasicBlock.hpp"
+#include "Dominators.hpp"
+#include "IRUtils.hpp"
+#include "LoopInfo.hpp"
+#include "SSA.hpp"
+
+#include <memory>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+namespace mina
+{
+
+namespace
+{
+
+// Returns true once a loop needed a new block, the loop forest is stale then
+bool simplifyOneLoop(SSA& ssa)
+{
+    for (auto loop : ssa.getLoopForest()->getLoopsInnermostFirst())
+    {
+        bool changed = false;
+        if (!loop->getPreheader())
+        {
+            insertPreheader(ssa, *loop);
+            changed = true;
+        }
+        changed |= insertDedicatedExits(ssa, *loop);
+        if (changed)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool splitCriticalEdges(SSA& ssa)
+{
+    static int splitCtr = 0;
+
+    auto domTree = ssa.getDominatorTree();
+    bool changed = false;
+    for (auto& block : getRPONodes(ssa.getCFG()))
+    {
+        auto succs = block->getSuccessors();
+        if (succs.size() < 2)
+        {
+            continue;
+        }
+        for (auto& succ : succs)
+        {
+            if (succ->getNumPredecessors() < 2 ||
+                std::count(succs.begin(), succs.end(), succ) != 1 ||
+                domTree->dominates(succ, block))
+            {
+                continue;
+            }
+            splitPredecessors(ssa, succ, {block},
+                              succ->getName() + "_split" +
+                                  std::to_string(splitCtr++));
+            changed = true;
+        }
+    }
+    return changed;
+}
+
+}  // namespace
+
+std::string LoopSimplifyPass::getName() const { return "loop-simplify"; }
+
+bool LoopSimplifyPass::run(SSA& ssa)
+{
+    bool changed = false;
+    while (simplifyOneLoop(ssa))
+    {
+        ssa.invalidateCFGAnalyses();
+        changed = true;
+    }
+
+    // Splitting an edge that isn't a back edge leaves the dominance between
+    // the other blocks as it was
+    changed |= splitCriticalEdges(ssa);
+    return changed;
+}
+
+}  // namespace mina
@@ -0,0 +1,628 @@
+#include "LoopUnroll.hpp"
+#include "BasicBlock.hpp"
+#include "Dominators.hpp"
+#include "IRUtils.hpp"
+#include "InductionVariables.hpp"
+#include "InstIR.hpp"
+#include "LoopInfo.hpp"
+#include "SSA.hpp"
+
+#include <limits>
+#include <memory>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace mina
+{
+
+namespace
+{
+
+// Instructions a fully unrolled loop may grow to
+constexpr long long FullUnrollBudget = 128;
+
+// Instructions the body of a partially unrolled loop may grow to
+constexpr long long PartialUnrollBudget = 64;
+
+// Iterations simulated while looking for the trip count
+constexpr long long MaxTripCount = 1 << 20;
+
+bool fitsInt(long long value)
+{
+    return value >= std::numeric_limits<int>::min() &&
+           value <= std::numeric_limits<int>::max();
+}
+
+bool getIntConstant(const std::shared_ptr<Inst>& operand, long long& value)
+{
+    auto target = operand->getTarget();
+    if (target->getInstType() != InstType::IntConst)
+    {
+        return false;
+    }
+    value = std::dynamic_pointer_cast<IntConstInst>(target)->getVal();
+    return true;
+}
+
+bool compare(InstType type, long long lhs, long long rhs)
+{
+    switch (type)
+    {
+        case InstType::CmpEq:
+            return lhs == rhs;
+        case InstType::CmpNE:
+            return lhs != rhs;
+        case InstType::CmpLT:
+            return lhs < rhs;
+        case InstType::CmpLTE:
+            return lhs <= rhs;
+        case InstType::CmpGT:
+            return lhs > rhs;
+        default:
+            return lhs >= rhs;
+    }
+}
+
+// Comparison with its operands swapped, a < b being b > a
+InstType swapComparison(InstType type)
+{
+    switch (type)
+    {
+        case InstType::CmpLT:
+            return InstType::CmpGT;
+        case InstType::CmpLTE:
+            return InstType::CmpGTE;
+        case InstType::CmpGT:
+            return InstType::CmpLT;
+        case InstType::CmpGTE:
+            return InstType::CmpLTE;
+        default:
+            return type;
+    }
+}
+
+bool isComparison(InstType type)
+{
+    return type == InstType::CmpEq || type == InstType::CmpNE ||
+           type == InstType::CmpLT || type == InstType::CmpLTE ||
+           type == InstType::CmpGT || type == InstType::CmpGTE;
+}
+
+// Operand using the value, which is either a constant or a name
+std::shared_ptr<Inst> useValue(const std::shared_ptr<Inst>& value,
+                               const std::shared_ptr<BasicBlock>& block)
+{
+    auto name = getValueName(value);
+    return name.empty() ? value : makeValueRef(name, block);
+}
+
+using ValueMap = std::unordered_map<std::string, std::shared_ptr<Inst>>;
+
+void remapOperands(const std::shared_ptr<Inst>& inst, const ValueMap& values,
+                   const std::shared_ptr<BasicBlock>& block)
+{
+    for (auto& operand : inst->getOperands())
+    {
+        auto it = values.find(getValueName(operand));
+        if (it != values.end())
+        {
+            operand = useValue(it->second, block);
+        }
+    }
+}
+
+// One copy of the body of the loop
+struct LoopCopy
+{
+    std::unordered_map<BasicBlock*, std::shared_ptr<BasicBlock>> blocks;
+
+    // Values of the loop, header phis included, mapped to their value in
+    // the copy
+    ValueMap values;
+};
+
+class LoopUnroller
+{
+public:
+    LoopUnroller(SSA& ssa, const Loop& loop, const DominatorTree& domTree);
+
+    bool run();
+
+private:
+    SSA& m_ssa;
+    const Loop& m_loop;
+    InductionVariables m_ivs;
+    std::shared_ptr<BasicBlock> m_header, m_preheader, m_latch, m_exiting,
+        m_exit;
+    bool m_isUnrollable = false;
+
+    long long getTripCount();
+    long long getLoopSize();
+
+    ValueMap getEntryValues();
+    ValueMap getNextValues(const LoopCopy& copy);
+    LoopCopy copyBody(const ValueMap& headerValues);
+
+    // Chains a copy after prev, which branches to the original header
+    void linkCopy(const std::shared_ptr<BasicBlock>& prev, LoopCopy& copy);
+    void remapUsesOutside(const std::vector<LoopCopy>& copies,
+                          const ValueMap& values);
+
+    void unrollFully(long long tripCount);
+    void unrollPartially(long long tripCount, long long factor);
+};
+
+LoopUnroller::LoopUnroller(SSA& ssa, const Loop& loop,
+                           const DominatorTree& domTree)
+    : m_ssa{ssa}, m_loop{loop}, m_ivs{loop}
+{
+    m_header = loop.getHeader();
+    m_preheader = loop.getPreheader();
+    auto exitingBlocks = loop.getExitingBlocks();
+    auto exitBlocks = loop.getExitBlocks();
+    if (!m_preheader || !loop.getSubLoops().empty() ||
+        loop.getLatches().size() != 1 || exitingBlocks.size() != 1 ||
+        exitBlocks.size() != 1)
+    {
+        return;
+    }
+    m_latch = loop.getLatches()[0];
+    m_exiting = exitingBlocks[0];
+    m_exit = exitBlocks[0];
+
+    // The exit test has to run on every iteration for the trip count to
+    // mean anything
+    auto terminator = m_exiting->getTerminator();
+    if (!terminator || terminator->getInstType() == InstType::Jump ||
+        !domTree.dominates(m_exiting, m_latch))
+    {
+        return;
+    }
+
+    for (auto& inst : m_header->getInstructions())
+    {
+        if (inst->isPhi() && inst->getOperands().size() != 2)
+        {
+            return;
+        }
+    }
+    for (auto& block : loop.getBlocks())
+    {
+        for (auto& inst : block->getInstructions())
+        {
+            auto type = inst->getInstType();
+            if (type == InstType::Alloca || type == InstType::Return ||
+                type == InstType::Halt)
+            {
+                return;
+            }
+        }
+    }
+    m_isUnrollable = true;
+}
+
+// Number of times the exit test runs, the last one leaving the loop. 0 when
+// it is not a known constant.
+long long LoopUnroller::getTripCount()
+{
+    auto terminator = m_exiting->getTerminator();
+    std::shared_ptr<BasicBlock> success;
+    bool isBranchOnTrue = terminator->getInstType() == InstType::BRT;
+    if (isBranchOnTrue)
+    {
+        success = std::dynamic_pointer_cast<BRTInst>(terminator)
+                      ->getTargetSuccess();
+    }
+    else
+    {
+        success = std::dynamic_pointer_cast<BRFInst>(terminator)
+                      ->getTargetSuccess();
+    }
+    bool exitsOnTrue = isBranchOnTrue == (success == m_exit);
+
+    auto condName = getValueName(terminator->getOperands()[0]);
+    std::shared_ptr<Inst> cond;
+    for (auto& block : m_loop.getBlocks())
+    {
+        for (auto& inst : block->getInstructions())
+        {
+            if (!condName.empty() && getDefinedName(inst) == condName)
+            {
+                cond = inst;
+            }
+        }
+    }
+    if (!cond || !isComparison(cond->getInstType()))
+    {
+        return 0;
+    }
+
+    auto type = cond->getInstType();
+    auto& operands = cond->getOperands();
+    long long bound = 0;
+    auto affine = m_ivs.getAffine(getValueName(operands[0]));
+    if (!affine || !getIntConstant(operands[1], bound))
+    {
+        affine = m_ivs.getAffine(getValueName(operands[1]));
+        if (!affine || !getIntConstant(operands[0], bound))
+        {
+            return 0;
+        }
+        type = swapComparison(type);
+    }
+
+    auto iv = m_ivs.getBasicIV(affine->base);
+    long long value = 0;
+    if (!iv || !getIntConstant(iv->init, value))
+    {
+        return 0;
+    }
+
+    for (long long trip = 1; trip <= MaxTripCount; ++trip)
+    {
+        auto tested = affine->scale * value + affine->offset;
+        if (!fitsInt(tested))
+        {
+            return 0;
+        }
+        if (compare(type, tested, bound) == exitsOnTrue)
+        {
+            return trip;
+        }
+
+        value += iv->step;
+        if (!fitsInt(value))
+        {
+            return 0;
+        }
+    }
+    return 0;
+}
+
+long long LoopUnroller::getLoopSize()
+{
+    long long size = 0;
+    for (auto& block : m_loop.getBlocks())
+    {
+        size += block->getInstructions().size();
+    }
+    return size;
+}
+
+// Values of the header phis on entry to the loop
+ValueMap LoopUnroller::getEntryValues()
+{
+    ValueMap values;
+    for (auto& inst : m_header->getInstructions())
+    {
+        if (!inst->isPhi())
+        {
+            continue;
+        }
+        auto phi = std::dynamic_pointer_cast<PhiInst>(inst);
+        for (unsigned int i = 0; i < 2; ++i)
+        {
+            if (phi->getOperandBB(i) == m_preheader)
+            {
+                values[getDefinedName(phi)] = phi->getOperands()[i];
+            }
+        }
+    }
+    return values;
+}
+
+// Values of the header phis in the iteration following the copy
+ValueMap LoopUnroller::getNextValues(const LoopCopy& copy)
+{
+    ValueMap values;
+    for (auto& inst : m_header->getInstructions())
+    {
+        if (!inst->isPhi())
+        {
+            continue;
+        }
+        auto phi = std::dynamic_pointer_cast<PhiInst>(inst);
+        for (unsigned int i = 0; i < 2; ++i)
+        {
+            if (phi->getOperandBB(i) != m_latch)
+            {
+                continue;
+            }
+            auto next = phi->getOperands()[i];
+            auto it = copy.values.find(getValueName(next));
+            values[getDefinedName(phi)] =
+                it == copy.values.end() ? next : it->second;
+        }
+    }
+    return values;
+}
+
+// Copies every block of the loop with fresh names. The phis of the header
+// are not copied, they take the given values instead. Edges to the original
+// header and to the exit are kept, and the copy of the header is left
+// without predecessors.
+LoopCopy LoopUnroller::copyBody(const ValueMap& headerValues)
+{
+    static int copyCtr = 0;
+    auto suffix = "_unroll" + std::to_string(copyCtr++);
+
+    LoopCopy copy;
+    copy.values = headerValues;
+    for (auto& block : m_loop.getBlocks())
+    {
+        copy.blocks[block.get()] =
+            std::make_shared<BasicBlock>(block->getName() + suffix);
+        for (auto& inst : block->getInstructions())
+        {
+            auto name = getDefinedName(inst);
+            if (!name.empty() && copy.values.count(name) == 0)
+            {
+                copy.values[name] =
+                    makeValueRef(m_ssa.makeFreshName(name), block);
+            }
+        }
+    }
+
+    for (auto& block : m_loop.getBlocks())
+    {
+        auto newBlock = copy.blocks[block.get()];
+        for (auto& inst : block->getInstructions())
+        {
+            if (block == m_header && inst->isPhi())
+            {
+                continue;
+            }
+
+            auto name = getDefinedName(inst);
+            auto newInst = cloneInst(
+                inst, name.empty() ? "" : getValueName(copy.values[name]),
+                newBlock);
+            remapOperands(newInst, copy.values, newBlock);
+            if (newInst->isPhi())
+            {
+                auto phi = std::dynamic_pointer_cast<PhiInst>(newInst);
+                for (unsigned int i = 0; i < phi->getOperands().size(); ++i)
+                {
+                    phi->setOperandBB(i,
+                                      copy.blocks[phi->getOperandBB(i).get()]);
+                }
+            }
+            newBlock->pushInst(newInst);
+        }
+
+        newBlock->setSuccessors(block->getSuccessors());
+        for (auto& succ : block->getSuccessors())
+        {
+            if (succ != m_header && m_loop.contains(succ))
+            {
+                newBlock->replaceSuccessor(succ, copy.blocks[succ.get()]);
+            }
+        }
+        if (block == m_header)
+        {
+            continue;
+        }
+
+        std::vector<std::shared_ptr<BasicBlock>> preds;
+        for (auto& pred : block->getPredecessors())
+        {
+            preds.push_back(copy.blocks[pred.get()]);
+        }
+        newBlock->setPredecessors(preds);
+    }
+    return copy;
+}
+
+void LoopUnroller::linkCopy(const std::shared_ptr<BasicBlock>& prev,
+                            LoopCopy& copy)
+{
+    auto header = copy.blocks[m_header.get()];
+    prev->replaceSuccessor(m_header, header);
+    header->pushPredecessor(prev);
+}
+
+// Uses after the loop read the values of the last iteration
+void LoopUnroller::remapUsesOutside(const std::vector<LoopCopy>& copies,
+                                    const ValueMap& values)
+{
+    std::unordered_set<BasicBlock*> inside;
+    for (auto& block : m_loop.getBlocks())
+    {
+        inside.insert(block.get());
+    }
+    for (auto& copy : copies)
+    {
+        for (auto& [original, block] : copy.blocks)
+        {
+            inside.insert(block.get());
+        }
+    }
+
+    for (auto& block : getRPONodes(m_ssa.getCFG()))
+    {
+        if (inside.count(block.get()) != 0)
+        {
+            continue;
+        }
+        for (auto& inst : block->getInstructions())
+        {
+            remapOperands(inst, values, block);
+        }
+    }
+}
+
+// One copy per iteration, the exit test of the last copy leaves and the
+// others fall through to the next copy
+void LoopUnroller::unrollFully(long long tripCount)
+{
+    std::vector<LoopCopy> copies;
+    auto values = getEntryValues();
+    auto prev = m_preheader;
+    for (long long trip = 0; trip < tripCount; ++trip)
+    {
+        copies.push_back(copyBody(values));
+        auto& copy = copies.back();
+        linkCopy(prev, copy);
+
+        auto exiting = copy.blocks[m_exiting.get()];
+        if (trip + 1 == tripCount)
+        {
+            replaceBranchWithJump(exiting, m_exit);
+            m_exit->replacePredecessor(m_exiting, exiting);
+            break;
+        }
+
+        auto successors = exiting->getSuccessors();
+        replaceBranchWithJump(exiting, successors[0] == m_exit ? successors[1]
+                                                               : successors[0]);
+        values = getNextValues(copy);
+        prev = copy.blocks[m_latch.get()];
+    }
+
+    auto& last = copies.back();
+    remapUsesOutside(copies, last.values);
+
+    // The blocks of the last copy following the exit test are dead
+    std::vector<std::shared_ptr<BasicBlock>> deadBlocks = m_loop.getBlocks();
+    for (auto& [original, block] : last.blocks)
+    {
+        deadBlocks.push_back(block);
+    }
+    detachUnreachableBlocks(m_ssa, deadBlocks);
+}
+
+// The leftover iterations are peeled in front of the loop, then the body is
+// repeated factor times with only the last exit test kept
+void LoopUnroller::unrollPartially(long long tripCount, long long factor)
+{
+    std::vector<LoopCopy> copies;
+    auto values = getEntryValues();
+    auto prev = m_preheader;
+    for (long long trip = 0; trip < tripCount % factor; ++trip)
+    {
+        copies.push_back(copyBody(values));
+        auto& copy = copies.back();
+        linkCopy(prev, copy);
+
+        prev = copy.blocks[m_latch.get()];
+        replaceBranchWithJump(prev, m_header);
+        values = getNextValues(copy);
+    }
+    if (prev != m_preheader)
+    {
+        m_header->replacePredecessor(m_preheader, prev);
+        for (auto& inst : m_header->getInstructions())
+        {
+            if (!inst->isPhi())
+            {
+                continue;
+            }
+            auto phi = std::dynamic_pointer_cast<PhiInst>(inst);
+            for (unsigned int i = 0; i < 2; ++i)
+            {
+                if (phi->getOperandBB(i) == prev)
+                {
+                    phi->getOperands()[i] =
+                        useValue(values[getDefinedName(phi)], m_header);
+                }
+            }
+        }
+    }
+
+    // The original body is the first of the unrolled iterations
+    LoopCopy original;
+    values = getNextValues(original);
+    std::vector<LoopCopy> unrolled;
+    for (long long i = 1; i < factor; ++i)
+    {
+        unrolled.push_back(copyBody(values));
+        values = getNextValues(unrolled.back());
+    }
+
+    // The last copy takes over the back edge and the exit
+    auto& last = unrolled.back();
+    auto lastLatch = last.blocks[m_latch.get()];
+    m_exit->replacePredecessor(m_latch, lastLatch);
+    m_header->removePredecessor(m_latch);
+    m_header->pushPredecessor(lastLatch);
+    for (auto& inst : m_header->getInstructions())
+    {
+        if (inst->isPhi())
+        {
+            auto phi = std::dynamic_pointer_cast<PhiInst>(inst);
+            phi->appendOperand(
+                useValue(values[getDefinedName(phi)], m_header), lastLatch);
+        }
+    }
+
+    prev = m_latch;
+    for (auto& copy : unrolled)
+    {
+        replaceBranchWithJump(prev, m_header);
+        linkCopy(prev, copy);
+        prev = copy.blocks[m_latch.get()];
+    }
+
+    copies.insert(copies.end(), unrolled.begin(), unrolled.end());
+    remapUsesOutside(copies, last.values);
+}
+
+bool LoopUnroller::run()
+{
+    if (!m_isUnrollable)
+    {
+        return false;
+    }
+
+    auto tripCount = getTripCount();
+    if (tripCount == 0)
+    {
+        return false;
+    }
+
+    auto size = getLoopSize();
+    if (tripCount * size <= FullUnrollBudget)
+    {
+        unrollFully(tripCount);
+        return true;
+    }
+
+    // Without the exit test at the bottom, the part of the body after it
+    // runs one time less than the part before it
+    if (m_exiting != m_latch)
+    {
+        return false;
+    }
+    for (long long factor = 8; factor > 1; factor /= 2)
+    {
+        if (factor * size <= PartialUnrollBudget &&
+            tripCount >= 2 * factor)
+        {
+            unrollPartially(tripCount, factor);
+            return true;
+        }
+    }
+    return false;
+}
+
+}  // namespace
+
+std::string LoopUnrollPass::getName() const { return "loop-unroll"; }
+
+bool LoopUnrollPass::run(SSA& ssa)
+{
+    // Only innermost loops are unrolled, and their blocks don't overlap, so
+    // the forest stays usable for the loops not unrolled yet
+    auto domTree = ssa.getDominatorTree();
+    bool changed = false;
+    for (auto loop : ssa.getLoopForest()->getLoopsInnermostFirst())
+    {
+        LoopUnroller unroller(ssa, *loop, *domTree);
+        changed |= unroller.run();
+    }
+    return changed;
+}
+
+}  // namespace mina
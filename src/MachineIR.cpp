@@ -184,8 +184,11 @@ void BasicBlockMIR::generateDefUse()
         {
             case MIRType::Add:
             case MIRType::Sub:
+            case MIRType::Mul:
             case MIRType::And:
             case MIRType::Or:
+            case MIRType::Not:
+            case MIRType::Cmov:
             {
                 if (operands.size() > 1)
                 {
@@ -255,13 +258,10 @@ void BasicBlockMIR::generateDefUse()
                 if (numArgs >= 4) markUse(to_int(RegID::R9));
 
                 // Defs (Clobbers)
-                markDef(to_int(RegID::RAX));
-                markDef(to_int(RegID::RCX));
-                markDef(to_int(RegID::RDX));
-                markDef(to_int(RegID::R8));
-                markDef(to_int(RegID::R9));
-                markDef(to_int(RegID::R10));
-                markDef(to_int(RegID::R11));
+                for (int reg : callInst->getClobberedRegs())
+                {
+                    markDef(reg);
+                }
                 break;
             }
 
@@ -271,6 +271,49 @@ void BasicBlockMIR::generateDefUse()
                 break;
             }
 
+            case MIRType::Cqo:
+            {
+                markUse(to_int(RegID::RAX));
+                markDef(to_int(RegID::RDX));
+                break;
+            }
+
+            case MIRType::Div:
+            {
+                markUse(to_int(RegID::RAX));
+                markUse(to_int(RegID::RDX));
+                markDef(to_int(RegID::RAX));
+                markDef(to_int(RegID::RDX));
+                break;
+            }
+
+            case MIRType::Cmp:
+            case MIRType::Test:
+            {
+                for (auto& operand : operands)
+                {
+                    if (operand->getMIRType() == MIRType::Reg)
+                    {
+                        markUse(getID(operand));
+                    }
+                }
+                break;
+            }
+
+            case MIRType::Sete:
+            case MIRType::Setne:
+            case MIRType::Setl:
+            case MIRType::Setle:
+            case MIRType::Setg:
+            case MIRType::Setge:
+            {
+                if (!operands.empty() && operands[0]->getMIRType() == MIRType::Reg)
+                {
+                    markDef(getID(operands[0]));
+                }
+                break;
+            }
+
             default:
             {
                 break;
@@ -588,8 +631,12 @@ std::vector<std::shared_ptr<MachineIR>>& LeaMIR::getOperands()
 // CallMIR
 // ==========================================
 
-CallMIR::CallMIR(std::string calleeName, unsigned int numArgs)
-    : m_calleeName{calleeName}, m_numArgs{numArgs}
+CallMIR::CallMIR(std::string calleeName, unsigned int numArgs,
+                 bool isTailCall)
+    : m_calleeName{calleeName},
+      m_numArgs{numArgs},
+      m_isTailCall{isTailCall},
+      m_clobberedRegs{getCallerSavedRegs()}
 {
 }
 
@@ -600,14 +647,26 @@ MIRType CallMIR::getMIRType() const
 
 std::string CallMIR::getString() const
 {
-    return "call " + m_calleeName;
+    return (m_isTailCall ? "jmp " : "call ") + m_calleeName;
 }
 
+bool CallMIR::isTailCall() const { return m_isTailCall; }
+
 unsigned int CallMIR::getNumArgs() const
 {
     return m_numArgs;
 }
 
+const std::set<int>& CallMIR::getClobberedRegs() const
+{
+    return m_clobberedRegs;
+}
+
+void CallMIR::setClobberedRegs(std::set<int> regs)
+{
+    m_clobberedRegs = std::move(regs);
+}
+
 // ==========================================
 // AddMIR
 // ==========================================
@@ -699,8 +758,11 @@ std::string MulMIR::getString() const
 // DivMIR
 // ==========================================
 
-DivMIR::DivMIR(std::shared_ptr<MemoryMIR> divisor)
-    : m_divisor{std::move(divisor)}
+DivMIR::DivMIR(std::shared_ptr<MemoryMIR> divisor, bool isUnsigned,
+               bool isNarrow)
+    : m_divisor{std::move(divisor)},
+      m_isUnsigned{isUnsigned},
+      m_isNarrow{isNarrow}
 {
     m_operands.push_back(m_divisor);
 }
@@ -718,7 +780,18 @@ MIRType DivMIR::getMIRType() const
 std::string DivMIR::getString() const
 {
     // Access operands safely assuming the constructor check passed
-    return "idiv " + m_operands[0]->getString();
+    if (!m_isUnsigned)
+    {
+        return "idiv " + m_operands[0]->getString();
+    }
+
+    // A narrow division reads the low half of the divisor's slot
+    auto divisor = m_operands[0]->getString();
+    if (m_isNarrow && divisor.rfind("QWORD", 0) == 0)
+    {
+        divisor.replace(0, 5, "DWORD");
+    }
+    return "div " + divisor;
 }
 
 // ==========================================
@@ -1104,6 +1177,36 @@ bool MovzxMIR::isFromRegLow() const
 }
 
 
+// ==========================================
+// CmovMIR
+// ==========================================
+
+CmovMIR::CmovMIR(std::vector<std::shared_ptr<MachineIR>> operands,
+                 std::string condition)
+    : m_operands{std::move(operands)}, m_condition{std::move(condition)}
+{
+    if (m_operands.size() != 2)
+    {
+        throw std::runtime_error("CmovMIR should have exactly 2 operands!");
+    }
+}
+
+MIRType CmovMIR::getMIRType() const
+{
+    return MIRType::Cmov;
+}
+
+std::string CmovMIR::getString() const
+{
+    return "cmov" + m_condition + " " + m_operands[0]->getString() + ", " +
+           m_operands[1]->getString();
+}
+
+std::vector<std::shared_ptr<MachineIR>>& CmovMIR::getOperands()
+{
+    return m_operands;
+}
+
 // ==========================================
 // TestMIR
 // ==========================================
@@ -1199,6 +1302,29 @@ std::string JnzMIR::getTargetLabel() const
     return m_targetLabel;
 }
 
+// ==========================================
+// JaeMIR
+// ==========================================
+
+JaeMIR::JaeMIR(std::string targetLabel) : m_targetLabel{targetLabel}
+{
+}
+
+MIRType JaeMIR::getMIRType() const
+{
+    return MIRType::Jae;
+}
+
+std::string JaeMIR::getString() const
+{
+    return "jae " + m_targetLabel;
+}
+
+std::string JaeMIR::getTargetLabel() const
+{
+    return m_targetLabel;
+}
+
 // ==========================================
 // RetMIR
 // ==========================================
@@ -1226,20 +1352,20 @@ static std::array<std::shared_ptr<Register>, to_int(RegID::COUNT)> registersFact
     add(RegID::RBX, "rbx", "ebx", "bx",  "bh",  "bl");
     add(RegID::RCX, "rcx", "ecx", "cx",  "ch",  "cl");
     add(RegID::RDX, "rdx", "edx", "dx",  "dh",  "dl");
-    add(RegID::RDI, "rdi", "edi", "di",  "dil", "");
-    add(RegID::RSI, "rsi", "esi", "si",  "sil", "");
-    add(RegID::R8,  "r8",  "r8d", "r8w", "r8b", "");
-    add(RegID::R9,  "r9",  "r9d", "r9w", "r9b", "");
-    add(RegID::R12, "r12", "r12d", "r12w", "r12b", "");
-    add(RegID::R13, "r13", "r13d", "r13w", "r13b", "");
-    add(RegID::R14, "r14", "r14d", "r14w", "r14b", "");
-
-    add(RegID::RBP, "rbp", "ebp", "bp", "bpl", "");
-    add(RegID::RSP, "rsp", "esp", "sp", "spl", "");
+    add(RegID::RDI, "rdi", "edi", "di",  "", "dil");
+    add(RegID::RSI, "rsi", "esi", "si",  "", "sil");
+    add(RegID::R8,  "r8",  "r8d", "r8w", "", "r8b");
+    add(RegID::R9,  "r9",  "r9d", "r9w", "", "r9b");
+    add(RegID::R12, "r12", "r12d", "r12w", "", "r12b");
+    add(RegID::R13, "r13", "r13d", "r13w", "", "r13b");
+    add(RegID::R14, "r14", "r14d", "r14w", "", "r14b");
+
+    add(RegID::RBP, "rbp", "ebp", "bp", "", "bpl");
+    add(RegID::RSP, "rsp", "esp", "sp", "", "spl");
     add(RegID::RIP, "rip");
 
-    add(RegID::R10, "r10", "r10d", "r10w", "r10b", "");
-    add(RegID::R11, "r11", "r11d", "r11w", "r11b", "");
+    add(RegID::R10, "r10", "r10d", "r10w", "", "r10b");
+    add(RegID::R11, "r11", "r11d", "r11w", "", "r11b");
 
     return registers;
 }
@@ -1256,4 +1382,64 @@ const std::shared_ptr<Register>& getReg(RegID id)
     return getAllRegisters()[to_int(id)];
 }
 
+std::set<int> getCallerSavedRegs()
+{
+    return {to_int(RegID::RAX), to_int(RegID::RCX), to_int(RegID::RDX),
+            to_int(RegID::R8),  to_int(RegID::R9),  to_int(RegID::R10),
+            to_int(RegID::R11)};
+}
+
+std::set<int> getClobberedRegs(
+    const std::vector<std::shared_ptr<BasicBlockMIR>>& blocks)
+{
+    // Every register the code mentions is taken as written, reads included
+    std::set<int> mentioned;
+    for (const auto& block : blocks)
+    {
+        for (const auto& inst : block->getInstructions())
+        {
+            auto mirType = inst->getMIRType();
+            if (mirType == MIRType::Call)
+            {
+                auto& callClobbers =
+                    std::dynamic_pointer_cast<CallMIR>(inst)->getClobberedRegs();
+                mentioned.insert(callClobbers.begin(), callClobbers.end());
+            }
+            else if (mirType == MIRType::Div || mirType == MIRType::Cqo)
+            {
+                mentioned.insert(to_int(RegID::RAX));
+                mentioned.insert(to_int(RegID::RDX));
+            }
+
+            for (const auto& operand : inst->getOperands())
+            {
+                if (operand->getMIRType() == MIRType::Reg)
+                {
+                    mentioned.insert(
+                        std::dynamic_pointer_cast<Register>(operand)->getID());
+                }
+                else if (operand->getMIRType() == MIRType::Memory)
+                {
+                    auto& base = std::dynamic_pointer_cast<MemoryMIR>(operand)
+                                     ->getBaseRegister();
+                    if (base)
+                    {
+                        mentioned.insert(base->getID());
+                    }
+                }
+            }
+        }
+    }
+
+    std::set<int> clobbered;
+    for (int reg : getCallerSavedRegs())
+    {
+        if (mentioned.count(reg) != 0)
+        {
+            clobbered.insert(reg);
+        }
+    }
+    return clobbered;
+}
+
 }  // namespace mina
@@ -0,0 +1,678 @@
+#include "OutOfSSA.hpp"
+#include "BasicBlock.hpp"
+#include "IRUtils.hpp"
+#include "InstIR.hpp"
+#include "SSA.hpp"
+
+#include <limits>
+#include <memory>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <unordered_map>
+
+namespace mina
+{
+
+OutOfSSA::OutOfSSA(SSA& ssa) : m_ssa{ssa} {}
+
+int OutOfSSA::getId(const std::string& name) const
+{
+    auto it = m_ids.find(name);
+    return it == m_ids.end() ? -1 : it->second;
+}
+
+int OutOfSSA::addName(const std::string& name)
+{
+    auto id = getId(name);
+    if (id != -1)
+    {
+        return id;
+    }
+
+    id = static_cast<int>(m_names.size());
+    m_ids[name] = id;
+    m_names.push_back(name);
+    m_webs.make_set();
+    m_defCount.push_back(0);
+    m_defBlock.push_back(-1);
+    m_defSlot.push_back(-1);
+    m_copyOf.push_back(-1);
+    m_isArray.push_back(false);
+    m_isParam.push_back(false);
+    return id;
+}
+
+void OutOfSSA::collectNames()
+{
+    auto& entryInsts = m_blocks.front()->getInstructions();
+    if (!entryInsts.empty() && entryInsts.front()->getInstType() == InstType::Func)
+    {
+        auto signature = std::dynamic_pointer_cast<Func>(entryInsts.front());
+        for (auto& param : signature->getParameters())
+        {
+            auto id = addName(param->getName());
+            m_isParam[id] = true;
+            ++m_defCount[id];
+        }
+    }
+
+    for (auto& block : m_blocks)
+    {
+        for (auto& inst : block->getInstructions())
+        {
+            auto name = getDefinedName(inst);
+            if (name.empty())
+            {
+                continue;
+            }
+            auto id = addName(name);
+            ++m_defCount[id];
+
+            auto type = inst->getInstType();
+            if (type == InstType::Alloca || type == InstType::ArrUpdate)
+            {
+                m_isArray[id] = true;
+            }
+            if (type == InstType::Assign)
+            {
+                auto source = getValueName(inst->getOperands()[0]);
+                if (!source.empty())
+                {
+                    m_copyOf[id] = addName(source);
+                }
+            }
+        }
+    }
+
+    // Copies and phis of arrays are arrays too
+    bool changed = true;
+    while (changed)
+    {
+        changed = false;
+        for (auto& block : m_blocks)
+        {
+            for (auto& inst : block->getInstructions())
+            {
+                if (inst->getInstType() != InstType::Assign && !inst->isPhi())
+                {
+                    continue;
+                }
+                auto id = getId(getDefinedName(inst));
+                for (auto& operand : inst->getOperands())
+                {
+                    auto source = getId(getValueName(operand));
+                    if (!m_isArray[id] && source != -1 && m_isArray[source])
+                    {
+                        m_isArray[id] = true;
+                        changed = true;
+                    }
+                }
+            }
+        }
+    }
+}
+
+void OutOfSSA::isolatePhis()
+{
+    for (size_t b = 0; b < m_blocks.size(); ++b)
+    {
+        for (auto& inst : m_blocks[b]->getInstructions())
+        {
+            if (!inst->isPhi())
+            {
+                continue;
+            }
+
+            // x <- phi(a, b) becomes x' <- phi(x'0, x'1) followed by the
+            // copy x <- x', with x'0 <- a and x'1 <- b ending the predecessors
+            auto phi = std::dynamic_pointer_cast<PhiInst>(inst);
+            auto name = getDefinedName(phi);
+            auto result = getId(name);
+            auto merged = addName(name + "'");
+            ++m_defCount[merged];
+            m_isArray[merged] = m_isArray[result];
+            m_copyOf[result] = merged;
+            m_phiResults[b].push_back(merged);
+            m_headCopies[b].push_back({result, merged, nullptr});
+
+            auto& operands = phi->getOperands();
+            for (unsigned int i = 0; i < operands.size(); ++i)
+            {
+                auto pred = m_blockIndex.find(phi->getOperandBB(i).get());
+                if (pred == m_blockIndex.end())
+                {
+                    continue;
+                }
+
+                auto incoming = addName(name + "'" + std::to_string(i));
+                ++m_defCount[incoming];
+                m_isArray[incoming] = m_isArray[result];
+
+                Copy copy{incoming, -1, nullptr};
+                auto source = getValueName(operands[i]);
+                if (source.empty())
+                {
+                    copy.constant = operands[i]->getTarget();
+                }
+                else
+                {
+                    copy.src = addName(source);
+                    m_copyOf[incoming] = copy.src;
+                }
+                m_tailCopies[pred->second].push_back(copy);
+                mergeWebs(merged, incoming);
+            }
+        }
+    }
+}
+
+void OutOfSSA::buildSlots()
+{
+    auto addUses = [&](Slot& slot, const std::shared_ptr<Inst>& inst)
+    {
+        bool isCopy = inst->getInstType() == InstType::Assign;
+        auto& operands = inst->getOperands();
+        for (size_t i = 0; i < operands.size(); ++i)
+        {
+            auto name = getValueName(operands[i]);
+            if (name.empty())
+            {
+                continue;
+            }
+            auto id = addName(name);
+            (i == 0 || isCopy ? slot.uses : slot.usesAfter).push_back(id);
+        }
+    };
+
+    for (size_t b = 0; b < m_blocks.size(); ++b)
+    {
+        auto& block = m_blocks[b];
+        auto terminator = block->getTerminator();
+        auto& slots = m_slots[b];
+
+        // Parameters and phi results, then the copies out of the phis
+        slots.emplace_back();
+        if (b == 0)
+        {
+            for (int id = 0; id < static_cast<int>(m_names.size()); ++id)
+            {
+                if (m_isParam[id])
+                {
+                    slots.back().defs.push_back(id);
+                }
+            }
+        }
+        for (auto id : m_phiResults[b])
+        {
+            slots.back().defs.push_back(id);
+        }
+        slots.emplace_back();
+        for (auto& copy : m_headCopies[b])
+        {
+            slots.back().uses.push_back(copy.src);
+            slots.back().defs.push_back(copy.dest);
+        }
+
+        for (auto& inst : block->getInstructions())
+        {
+            if (inst->isPhi() || inst == terminator)
+            {
+                continue;
+            }
+            slots.emplace_back();
+            addUses(slots.back(), inst);
+            auto name = getDefinedName(inst);
+            if (!name.empty())
+            {
+                slots.back().defs.push_back(getId(name));
+            }
+        }
+
+        // The copies into the phis of the successors, the terminator, and
+        // the phis reading the copies on the way out
+        slots.emplace_back();
+        for (auto& copy : m_tailCopies[b])
+        {
+            if (copy.src != -1)
+            {
+                slots.back().uses.push_back(copy.src);
+            }
+            slots.back().defs.push_back(copy.dest);
+        }
+        slots.emplace_back();
+        if (terminator)
+        {
+            addUses(slots.back(), terminator);
+        }
+        slots.emplace_back();
+        for (auto& copy : m_tailCopies[b])
+        {
+            slots.back().uses.push_back(copy.dest);
+        }
+
+        for (int s = 0; s < static_cast<int>(slots.size()); ++s)
+        {
+            for (auto id : slots[s].defs)
+            {
+                m_defBlock[id] = static_cast<int>(b);
+                m_defSlot[id] = s;
+            }
+            for (auto id : slots[s].uses)
+            {
+                m_usePositions[b][id].push_back(2 * s);
+            }
+            for (auto id : slots[s].usesAfter)
+            {
+                m_usePositions[b][id].push_back(2 * s + 1);
+            }
+        }
+    }
+}
+
+void OutOfSSA::computeLiveness()
+{
+    auto numNames = m_names.size();
+    std::vector<std::vector<char>> liveIn(m_blocks.size(),
+                                          std::vector<char>(numNames, 0));
+    m_liveOut.assign(m_blocks.size(), std::vector<char>(numNames, 0));
+
+    bool changed = true;
+    while (changed)
+    {
+        changed = false;
+        for (size_t b = m_blocks.size(); b-- > 0;)
+        {
+            auto& liveOut = m_liveOut[b];
+            for (auto& succ : m_blocks[b]->getSuccessors())
+            {
+                auto it = m_blockIndex.find(succ.get());
+                if (it == m_blockIndex.end())
+                {
+                    continue;
+                }
+                auto& succIn = liveIn[it->second];
+                for (size_t id = 0; id < numNames; ++id)
+                {
+                    liveOut[id] |= succIn[id];
+                }
+            }
+
+            auto live = liveOut;
+            auto& slots = m_slots[b];
+            for (size_t s = slots.size(); s-- > 0;)
+            {
+                for (auto id : slots[s].usesAfter)
+                {
+                    live[id] = 1;
+                }
+                for (auto id : slots[s].defs)
+                {
+                    live[id] = 0;
+                }
+                for (auto id : slots[s].uses)
+                {
+                    live[id] = 1;
+                }
+            }
+            if (live != liveIn[b])
+            {
+                liveIn[b] = std::move(live);
+                changed = true;
+            }
+        }
+    }
+}
+
+int OutOfSSA::getValue(int id)
+{
+    while (m_copyOf[id] != -1)
+    {
+        id = m_copyOf[id];
+    }
+    return id;
+}
+
+bool OutOfSSA::isLiveAfter(int id, int block, int slot)
+{
+    // A definition later in the block ends what is live here
+    auto bound = std::numeric_limits<int>::max();
+    if (m_defBlock[id] == block && m_defSlot[id] > slot)
+    {
+        bound = 2 * m_defSlot[id];
+    }
+
+    auto it = m_usePositions[block].find(id);
+    if (it != m_usePositions[block].end())
+    {
+        for (auto position : it->second)
+        {
+            if (position > 2 * slot && position <= bound)
+            {
+                return true;
+            }
+        }
+    }
+    return bound == std::numeric_limits<int>::max() && m_liveOut[block][id];
+}
+
+bool OutOfSSA::interfere(int a, int b)
+{
+    if (a == b || getValue(a) == getValue(b))
+    {
+        return false;
+    }
+    return isLiveAfter(a, m_defBlock[b], m_defSlot[b]) ||
+           isLiveAfter(b, m_defBlock[a], m_defSlot[a]);
+}
+
+bool OutOfSSA::websInterfere(const std::vector<int>& a,
+                             const std::vector<int>& b)
+{
+    bool hasParam = false;
+    for (auto x : a)
+    {
+        hasParam |= m_isParam[x];
+    }
+    for (auto y : b)
+    {
+        // Every parameter keeps its own name
+        if (hasParam && m_isParam[y])
+        {
+            return true;
+        }
+        for (auto x : a)
+        {
+            if (interfere(x, y))
+            {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+void OutOfSSA::mergeWebs(int a, int b)
+{
+    auto rootA = m_webs.find(a);
+    auto rootB = m_webs.find(b);
+    if (rootA == rootB)
+    {
+        return;
+    }
+
+    auto membersA = m_members.count(rootA) ? std::move(m_members[rootA])
+                                           : std::vector<int>{a};
+    auto membersB = m_members.count(rootB) ? std::move(m_members[rootB])
+                                           : std::vector<int>{b};
+    m_members.erase(rootA);
+    m_members.erase(rootB);
+    membersA.insert(membersA.end(), membersB.begin(), membersB.end());
+
+    // Either root may end up representing the merged web
+    m_webs.unite(rootA, rootB);
+    m_members[m_webs.find(rootA)] = std::move(membersA);
+}
+
+void OutOfSSA::coalesce()
+{
+    struct Candidate
+    {
+        int dest;
+        int src;
+        unsigned int depth;
+    };
+
+    auto loopForest = m_ssa.getLoopForest();
+    std::vector<Candidate> candidates;
+    for (size_t b = 0; b < m_blocks.size(); ++b)
+    {
+        auto depth = loopForest->getLoopDepth(m_blocks[b]);
+        for (auto& copy : m_headCopies[b])
+        {
+            candidates.push_back({copy.dest, copy.src, depth});
+        }
+        for (auto& copy : m_tailCopies[b])
+        {
+            if (copy.src != -1)
+            {
+                candidates.push_back({copy.dest, copy.src, depth});
+            }
+        }
+        for (auto& inst : m_blocks[b]->getInstructions())
+        {
+            if (inst->getInstType() != InstType::Assign)
+            {
+                continue;
+            }
+            auto dest = getId(getDefinedName(inst));
+            auto src = getId(getValueName(inst->getOperands()[0]));
+            if (src != -1)
+            {
+                candidates.push_back({dest, src, depth});
+            }
+        }
+    }
+
+    // Copies run more often in deeper loops
+    std::stable_sort(candidates.begin(), candidates.end(),
+                     [](const Candidate& a, const Candidate& b)
+                     { return a.depth > b.depth; });
+
+    auto getWeb = [&](int id) -> std::vector<int>
+    {
+        auto it = m_members.find(m_webs.find(id));
+        return it == m_members.end() ? std::vector<int>{id} : it->second;
+    };
+
+    for (auto& candidate : candidates)
+    {
+        auto dest = candidate.dest;
+        auto src = candidate.src;
+        if (m_isArray[dest] || m_isArray[src] || m_defCount[dest] != 1 ||
+            m_defCount[src] != 1)
+        {
+            continue;
+        }
+        if (m_webs.find(dest) == m_webs.find(src))
+        {
+            continue;
+        }
+        if (!websInterfere(getWeb(dest), getWeb(src)))
+        {
+            mergeWebs(dest, src);
+        }
+    }
+}
+
+std::vector<std::shared_ptr<Inst>> OutOfSSA::sequentialize(
+    const std::vector<Copy>& copies, const std::vector<std::string>& names,
+    const std::shared_ptr<BasicBlock>& block)
+{
+    struct Move
+    {
+        std::string dest;
+        std::string src;
+        std::shared_ptr<Inst> constant;
+    };
+
+    std::vector<Move> pending;
+    for (auto& copy : copies)
+    {
+        Move move{names[copy.dest], "", copy.constant};
+        if (copy.src != -1)
+        {
+            move.src = names[copy.src];
+        }
+
+        // Copies within a web need no move, and a web written twice is
+        // written the same value
+        bool isDuplicate = std::any_of(pending.begin(), pending.end(),
+                                       [&](const Move& other)
+                                       { return other.dest == move.dest; });
+        if (move.dest != move.src && !isDuplicate)
+        {
+            pending.push_back(std::move(move));
+        }
+    }
+
+    std::vector<std::shared_ptr<Inst>> insts;
+    auto emit = [&](const std::string& dest, const std::shared_ptr<Inst>& src)
+    {
+        auto target = std::make_shared<IdentInst>(dest, block);
+        target->setup_def_use();
+        auto assign = std::make_shared<AssignInst>(target, src, block);
+        assign->setup_def_use();
+        insts.push_back(std::move(assign));
+    };
+
+    while (!pending.empty())
+    {
+        // A move whose destination no other move still reads can go first
+        auto ready = std::find_if(
+            pending.begin(), pending.end(),
+            [&](const Move& move)
+            {
+                return std::none_of(pending.begin(), pending.end(),
+                                    [&](const Move& other)
+                                    { return other.src == move.dest; });
+            });
+        if (ready != pending.end())
+        {
+            emit(ready->dest, ready->constant
+                                  ? ready->constant
+                                  : makeValueRef(ready->src, block));
+            pending.erase(ready);
+            continue;
+        }
+
+        // Only cycles are left. Saving one destination in a temporary lets
+        // the moves reading it read the temporary instead.
+        auto saved = pending.front().dest;
+        auto temp = m_ssa.makeFreshName(saved);
+        emit(temp, makeValueRef(saved, block));
+        for (auto& move : pending)
+        {
+            if (move.src == saved)
+            {
+                move.src = temp;
+            }
+        }
+    }
+    return insts;
+}
+
+void OutOfSSA::rewrite()
+{
+    // Every web takes the name of its parameter or of its oldest value
+    std::unordered_map<int, std::string> webNames;
+    for (auto& [root, members] : m_members)
+    {
+        auto best = *std::min_element(members.begin(), members.end());
+        for (auto id : members)
+        {
+            if (m_isParam[id])
+            {
+                best = id;
+            }
+        }
+        webNames[root] = m_names[best];
+    }
+
+    std::vector<std::string> names(m_names.size());
+    for (size_t id = 0; id < m_names.size(); ++id)
+    {
+        auto it = webNames.find(m_webs.find(id));
+        names[id] = it == webNames.end() ? m_names[id] : it->second;
+    }
+
+    auto renameOperands = [&](const std::shared_ptr<Inst>& inst,
+                              const std::shared_ptr<BasicBlock>& block)
+    {
+        for (auto& operand : inst->getOperands())
+        {
+            auto id = getId(getValueName(operand));
+            if (id != -1 && names[id] != m_names[id])
+            {
+                operand = makeValueRef(names[id], block);
+            }
+        }
+    };
+
+    for (size_t b = 0; b < m_blocks.size(); ++b)
+    {
+        auto& block = m_blocks[b];
+        auto terminator = block->getTerminator();
+        auto& oldInsts = block->getInstructions();
+
+        std::vector<std::shared_ptr<Inst>> insts;
+        size_t i = 0;
+        if (!oldInsts.empty() && oldInsts.front()->getInstType() == InstType::Func)
+        {
+            insts.push_back(oldInsts.front());
+            ++i;
+        }
+
+        auto headCopies = sequentialize(m_headCopies[b], names, block);
+        insts.insert(insts.end(), headCopies.begin(), headCopies.end());
+
+        for (; i < oldInsts.size(); ++i)
+        {
+            auto inst = oldInsts[i];
+            if (inst->isPhi() || inst == terminator)
+            {
+                continue;
+            }
+
+            renameOperands(inst, block);
+            auto name = getDefinedName(inst);
+            if (!name.empty())
+            {
+                auto& newName = names[getId(name)];
+                if (inst->getInstType() == InstType::Assign &&
+                    getValueName(inst->getOperands()[0]) == newName)
+                {
+                    continue;
+                }
+                if (newName != name)
+                {
+                    inst = cloneInst(inst, newName, block);
+                }
+            }
+            insts.push_back(inst);
+        }
+
+        auto tailCopies = sequentialize(m_tailCopies[b], names, block);
+        insts.insert(insts.end(), tailCopies.begin(), tailCopies.end());
+        if (terminator)
+        {
+            renameOperands(terminator, block);
+            insts.push_back(terminator);
+        }
+        block->setInstructions(std::move(insts));
+    }
+}
+
+void OutOfSSA::run()
+{
+    m_ssa.invalidateCFGAnalyses();
+    m_blocks = getRPONodes(m_ssa.getCFG());
+    for (size_t b = 0; b < m_blocks.size(); ++b)
+    {
+        m_blockIndex[m_blocks[b].get()] = static_cast<int>(b);
+    }
+    m_headCopies.resize(m_blocks.size());
+    m_tailCopies.resize(m_blocks.size());
+    m_phiResults.resize(m_blocks.size());
+    m_slots.resize(m_blocks.size());
+    m_usePositions.resize(m_blocks.size());
+
+    collectNames();
+    isolatePhis();
+    buildSlots();
+    computeLiveness();
+    coalesce();
+    rewrite();
+}
+
+}  // namespace mina
@@ -0,0 +1,343 @@
+#include "PRE.hpp"
+#include "BasicBlock.hpp"
+#include "Dominators.hpp"
+#include "IRUtils.hpp"
+#include "InstIR.hpp"
+#include "SSA.hpp"
+
+#include <memory>
+#include <string>
+#include <vector>
+#include <utility>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace mina
+{
+
+namespace
+{
+
+class PartialRedundancy
+{
+public:
+    PartialRedundancy(SSA& ssa);
+
+    bool run();
+
+private:
+    SSA& m_ssa;
+    std::shared_ptr<DominatorTree> m_domTree;
+
+    // Expression key to the values computing it, with their blocks
+    std::unordered_map<
+        std::string,
+        std::vector<std::pair<std::string, std::shared_ptr<BasicBlock>>>>
+        m_table;
+
+    // Instructions replaced by a phi, whose uses still point to them
+    std::unordered_set<Inst*> m_replaced;
+
+    std::string expressionKey(
+        InstType type, const std::vector<std::shared_ptr<Inst>>& operands) const;
+    std::string findAvailable(const std::string& key, const std::string& name,
+                              const std::shared_ptr<BasicBlock>& block) const;
+    bool processJoin(const std::shared_ptr<BasicBlock>& join);
+    void replaceUses();
+};
+
+PartialRedundancy::PartialRedundancy(SSA& ssa)
+    : m_ssa{ssa}, m_domTree{ssa.getDominatorTree()}
+{
+}
+
+std::string PartialRedundancy::expressionKey(
+    InstType type, const std::vector<std::shared_ptr<Inst>>& operands) const
+{
+    std::vector<std::string> keys;
+    for (auto& operand : operands)
+    {
+        auto value = operand->getTarget();
+        if (value->getInstType() == InstType::IntConst)
+        {
+            keys.push_back(
+                "#i" +
+                std::to_string(std::dynamic_pointer_cast<IntConstInst>(value)->getVal()));
+            continue;
+        }
+        if (value->getInstType() == InstType::BoolConst)
+        {
+            keys.push_back(
+                std::string("#b") +
+                (std::dynamic_pointer_cast<BoolConstInst>(value)->getVal() ? "1" : "0"));
+            continue;
+        }
+        auto name = getValueName(operand);
+        if (name.empty())
+        {
+            return "";
+        }
+        keys.push_back(name);
+    }
+
+    switch (type)
+    {
+        case InstType::Add:
+        case InstType::Mul:
+        case InstType::And:
+        case InstType::Or:
+        case InstType::CmpEq:
+        case InstType::CmpNE:
+            if (keys[1] < keys[0])
+            {
+                std::swap(keys[0], keys[1]);
+            }
+            break;
+        case InstType::CmpGT:
+            type = InstType::CmpLT;
+            std::swap(keys[0], keys[1]);
+            break;
+        case InstType::CmpGTE:
+            type = InstType::CmpLTE;
+            std::swap(keys[0], keys[1]);
+            break;
+        case InstType::Sub:
+        case InstType::Not:
+        case InstType::CmpLT:
+        case InstType::CmpLTE:
+        case InstType::Select:
+            break;
+        default:
+            // Divisions may trap on the paths that didn't divide before
+            return "";
+    }
+
+    std::string key = std::to_string(static_cast<int>(type)) + "(";
+    for (auto& operandKey : keys)
+    {
+        key += operandKey + ",";
+    }
+    return key + ")";
+}
+
+// Name of a value other than name computing the expression in a block that
+// dominates block, empty if there is none
+std::string PartialRedundancy::findAvailable(
+    const std::string& key, const std::string& name,
+    const std::shared_ptr<BasicBlock>& block) const
+{
+    auto it = m_table.find(key);
+    if (it == m_table.end())
+    {
+        return "";
+    }
+    for (auto& [value, valueBlock] : it->second)
+    {
+        if (value != name && m_domTree->dominates(valueBlock, block))
+        {
+            return value;
+        }
+    }
+    return "";
+}
+
+bool PartialRedundancy::processJoin(const std::shared_ptr<BasicBlock>& join)
+{
+    auto preds = join->getPredecessors();
+    if (preds.size() < 2)
+    {
+        return false;
+    }
+
+    // Operands defined in the join by anything but a phi can't be
+    // translated into the predecessors
+    std::unordered_map<std::string, std::shared_ptr<PhiInst>> phis;
+    std::unordered_set<std::string> definedHere;
+    for (auto& inst : join->getInstructions())
+    {
+        auto name = getDefinedName(inst);
+        if (inst->isPhi())
+        {
+            phis[name] = std::dynamic_pointer_cast<PhiInst>(inst);
+        }
+        else if (!name.empty())
+        {
+            definedHere.insert(name);
+        }
+    }
+
+    bool changed = false;
+    auto& instructions = join->getInstructions();
+    for (size_t i = 0; i < instructions.size(); ++i)
+    {
+        auto inst = instructions[i];
+        auto name = getDefinedName(inst);
+        if (inst->isPhi() || name.empty() ||
+            expressionKey(inst->getInstType(), inst->getOperands()).empty())
+        {
+            continue;
+        }
+
+        // The operands every predecessor passes in, and the value computing
+        // the expression on the way if there is one
+        std::vector<std::vector<std::shared_ptr<Inst>>> translated(preds.size());
+        std::vector<std::string> available(preds.size());
+        bool isTranslatable = true;
+        bool isPartiallyRedundant = false;
+        for (size_t p = 0; p < preds.size() && isTranslatable; ++p)
+        {
+            for (auto& operand : inst->getOperands())
+            {
+                auto operandName = getValueName(operand);
+                if (definedHere.count(operandName) != 0)
+                {
+                    isTranslatable = false;
+                    break;
+                }
+
+                auto phi = phis.find(operandName);
+                if (phi == phis.end())
+                {
+                    translated[p].push_back(operand);
+                    continue;
+                }
+
+                std::shared_ptr<Inst> incoming;
+                auto& phiOperands = phi->second->getOperands();
+                for (unsigned int k = 0; k < phiOperands.size(); ++k)
+                {
+                    if (phi->second->getOperandBB(k) == preds[p])
+                    {
+                        incoming = phiOperands[k];
+                        break;
+                    }
+                }
+                if (!incoming)
+                {
+                    isTranslatable = false;
+                    break;
+                }
+                translated[p].push_back(incoming);
+            }
+            if (!isTranslatable)
+            {
+                break;
+            }
+
+            auto key = expressionKey(inst->getInstType(), translated[p]);
+            available[p] = key.empty() ? "" : findAvailable(key, name, preds[p]);
+            if (!available[p].empty())
+            {
+                isPartiallyRedundant = true;
+            }
+            else if (key.empty() || preds[p]->getSuccessors().size() != 1)
+            {
+                isTranslatable = false;
+            }
+        }
+        if (!isTranslatable || !isPartiallyRedundant)
+        {
+            continue;
+        }
+
+        auto phi = std::make_shared<PhiInst>(name, join);
+        for (size_t p = 0; p < preds.size(); ++p)
+        {
+            if (available[p].empty())
+            {
+                available[p] = m_ssa.makeFreshName(name);
+                auto copy = cloneInst(inst, available[p], preds[p]);
+                auto& copyOperands = copy->getOperands();
+                for (size_t k = 0; k < copyOperands.size(); ++k)
+                {
+                    auto operandName = getValueName(translated[p][k]);
+                    copyOperands[k] = operandName.empty()
+                                          ? translated[p][k]
+                                          : makeValueRef(operandName, preds[p]);
+                }
+
+                auto& predInsts = preds[p]->getInstructions();
+                preds[p]->insertInstAtIndex(predInsts.size() - 1, copy);
+                m_table[expressionKey(copy->getInstType(), copyOperands)]
+                    .push_back({available[p], preds[p]});
+            }
+            phi->appendOperand(makeValueRef(available[p], preds[p]), preds[p]);
+        }
+
+        // The phi joins the phis at the head of the block, and later
+        // expressions may be translated through it
+        instructions.erase(instructions.begin() + i);
+        size_t head = 0;
+        while (head < instructions.size() &&
+               (instructions[head]->isPhi() ||
+                instructions[head]->getInstType() == InstType::Func))
+        {
+            ++head;
+        }
+        join->insertInstAtIndex(head, phi);
+        phis[name] = phi;
+        definedHere.erase(name);
+        m_replaced.insert(inst.get());
+        changed = true;
+    }
+    return changed;
+}
+
+void PartialRedundancy::replaceUses()
+{
+    for (auto& block : getRPONodes(m_ssa.getCFG()))
+    {
+        for (auto& inst : block->getInstructions())
+        {
+            for (auto& operand : inst->getOperands())
+            {
+                if (m_replaced.count(operand.get()) != 0)
+                {
+                    operand = makeValueRef(getValueName(operand), block);
+                }
+            }
+        }
+    }
+}
+
+bool PartialRedundancy::run()
+{
+    auto blocks = getRPONodes(m_ssa.getCFG());
+    for (auto& block : blocks)
+    {
+        for (auto& inst : block->getInstructions())
+        {
+            auto name = getDefinedName(inst);
+            auto key = inst->isPhi()
+                           ? ""
+                           : expressionKey(inst->getInstType(), inst->getOperands());
+            if (!name.empty() && !key.empty())
+            {
+                m_table[key].push_back({name, block});
+            }
+        }
+    }
+
+    bool changed = false;
+    for (auto& block : blocks)
+    {
+        changed |= processJoin(block);
+    }
+    if (changed)
+    {
+        replaceUses();
+    }
+    return changed;
+}
+
+}  // namespace
+
+std::string PREPass::getName() const { return "pre"; }
+
+bool PREPass::run(SSA& ssa)
+{
+    PartialRedundancy redundancy(ssa);
+    return redundancy.run();
+}
+
+}  // namespace mina
@@ -676,7 +676,7 @@ std::shared_ptr<StatementAST> Parser::statement()
     else if (getCurrTokenType() == EXIT)
     {
         advance();
-        return nullptr;
+        return std::make_shared<ExitAST>();
     }
     else if (getCurrTokenType() == PUT)
     {
@@ -0,0 +1,507 @@
+#include "PassManager.hpp"
+#include "ADCE.hpp"
+#include "ArrayForwarding.hpp"
+#include "BasicBlock.hpp"
+#include "BoundsCheck.hpp"
+#include "CallFolding.hpp"
+#include "GVN.hpp"
+#include "IfConversion.hpp"
+#include "Inliner.hpp"
+#include "IPConstantPropagation.hpp"
+#include "IRUtils.hpp"
+#include "InstIR.hpp"
+#include "LICM.hpp"
+#include "LoopRotate.hpp"
+#include "LoopSimplify.hpp"
+#include "LoopUnroll.hpp"
+#include "PRE.hpp"
+#include "ProgramEvaluation.hpp"
+#include "SCCP.hpp"
+#include "SSA.hpp"
+#include "ScalarReplacement.hpp"
+#include "StrengthReduction.hpp"
+#include "TailRecursion.hpp"
+#include "ValueRange.hpp"
+
+#include <map>
+#include <set>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+#include <iomanip>
+#include <utility>
+#include <iostream>
+#include <algorithm>
+#include <stdexcept>
+
+namespace mina
+{
+
+CompilerOptions& getCompilerOptions()
+{
+    static CompilerOptions options;
+    return options;
+}
+
+// Options CodeGen asks PassManager::isEnabled about, which -f<name> and
+// -fno-<name> take besides the names of the passes
+static const std::set<std::string> CodeGenOptionNames = {
+    "dead-functions", "ipra", "memoize", "tail-calls"};
+
+static bool isKnownPassName(const std::string& name)
+{
+    if (CodeGenOptionNames.count(name) != 0)
+    {
+        return true;
+    }
+
+    std::map<std::string, SSA> functions;
+    PassManager pipeline(getCompilerOptions());
+    pipeline.addDefaultPipeline(functions);
+    return pipeline.hasPass(name);
+}
+
+bool parseCompilerOption(const std::string& arg)
+{
+    auto& options = getCompilerOptions();
+    if (arg == "-O0" || arg == "-O1" || arg == "-O2")
+    {
+        options.optLevel = arg[2] - '0';
+    }
+    else if (arg == "-time-passes")
+    {
+        options.timePasses = true;
+    }
+    else if (arg == "-print-after-all")
+    {
+        options.printAfterAll = true;
+    }
+    else if (arg == "-verify-each")
+    {
+        options.verifyEach = true;
+    }
+    else if (arg.rfind("-fno-", 0) == 0 && isKnownPassName(arg.substr(5)))
+    {
+        options.passOverrides[arg.substr(5)] = false;
+    }
+    else if (arg.rfind("-f", 0) == 0 && isKnownPassName(arg.substr(2)))
+    {
+        options.passOverrides[arg.substr(2)] = true;
+    }
+    else
+    {
+        return false;
+    }
+    return true;
+}
+
+size_t countInstructions(SSA& ssa)
+{
+    size_t count = 0;
+    for (auto& block : getRPONodes(ssa.getCFG()))
+    {
+        count += block->getInstructions().size();
+    }
+    return count;
+}
+
+static size_t countOf(const std::vector<std::shared_ptr<BasicBlock>>& blocks,
+                      const std::shared_ptr<BasicBlock>& block)
+{
+    return std::count(blocks.begin(), blocks.end(), block);
+}
+
+void verifyFunction(SSA& ssa, const std::string& funcName)
+{
+    auto fail = [&](const std::shared_ptr<BasicBlock>& block,
+                    const std::string& message)
+    {
+        throw std::runtime_error("Invalid IR in " + funcName + ", block " +
+                                 block->getName() + ": " + message);
+    };
+
+    // Values defined in the function, the parameters included
+    std::set<std::string> defined;
+    auto& entryInsts = ssa.getCFG()->getInstructions();
+    if (!entryInsts.empty() && entryInsts.front()->getInstType() == InstType::Func)
+    {
+        for (auto& param :
+             std::dynamic_pointer_cast<Func>(entryInsts.front())->getParameters())
+        {
+            defined.insert(param->getName());
+        }
+    }
+    for (auto& block : getRPONodes(ssa.getCFG()))
+    {
+        for (auto& inst : block->getInstructions())
+        {
+            if (inst)
+            {
+                defined.insert(getDefinedName(inst));
+            }
+        }
+    }
+
+    for (auto& block : getRPONodes(ssa.getCFG()))
+    {
+        auto succs = block->getSuccessors();
+        auto preds = block->getPredecessors();
+
+        std::vector<std::shared_ptr<BasicBlock>> targets;
+        auto terminator = block->getTerminator();
+        if (terminator && terminator->getInstType() == InstType::Jump)
+        {
+            targets.push_back(
+                std::dynamic_pointer_cast<JumpInst>(terminator)->getJumpTarget());
+        }
+        else if (terminator && terminator->getInstType() == InstType::BRT)
+        {
+            auto brt = std::dynamic_pointer_cast<BRTInst>(terminator);
+            targets.push_back(brt->getTargetSuccess());
+            targets.push_back(brt->getTargetFailed());
+        }
+        else if (terminator)
+        {
+            auto brf = std::dynamic_pointer_cast<BRFInst>(terminator);
+            targets.push_back(brf->getTargetSuccess());
+            targets.push_back(brf->getTargetFailed());
+        }
+
+        for (auto& target : targets)
+        {
+            if (countOf(succs, target) == 0)
+            {
+                fail(block, "branch to " + target->getName() +
+                                " is not a successor");
+            }
+        }
+        for (auto& succ : succs)
+        {
+            if (countOf(targets, succ) == 0)
+            {
+                fail(block, "successor " + succ->getName() +
+                                " is not a branch target");
+            }
+            if (countOf(succ->getPredecessors(), block) != countOf(succs, succ))
+            {
+                fail(block, "missing predecessor edge in " + succ->getName());
+            }
+        }
+        for (auto& pred : preds)
+        {
+            if (countOf(pred->getSuccessors(), block) != countOf(preds, pred))
+            {
+                fail(block, "missing successor edge in " + pred->getName());
+            }
+        }
+
+        bool seenNonPhi = false;
+        for (auto& inst : block->getInstructions())
+        {
+            if (!inst)
+            {
+                fail(block, "null instruction");
+            }
+            for (auto& op : inst->getOperands())
+            {
+                if (!op)
+                {
+                    fail(block, "null operand in " + inst->getString());
+                }
+                auto name = getValueName(op);
+                if (!name.empty() && defined.count(name) == 0)
+                {
+                    fail(block, "undefined value " + name + " in " +
+                                    inst->getString());
+                }
+            }
+
+            if (!inst->isPhi())
+            {
+                seenNonPhi = true;
+                continue;
+            }
+            if (seenNonPhi)
+            {
+                fail(block, "phi after a non-phi: " + inst->getString());
+            }
+
+            // Phis without operands are incomplete phis of variables that
+            // are read before being written, they stand for undefined values
+            auto phi = std::dynamic_pointer_cast<PhiInst>(inst);
+            auto numOperands = phi->getOperands().size();
+            if (numOperands == 0)
+            {
+                continue;
+            }
+            if (numOperands != preds.size())
+            {
+                fail(block, "phi operands don't match predecessors: " +
+                                inst->getString());
+            }
+            for (unsigned int i = 0; i < numOperands; ++i)
+            {
+                if (countOf(preds, phi->getOperandBB(i)) == 0)
+                {
+                    fail(block, "phi operand from a non-predecessor: " +
+                                    inst->getString());
+                }
+            }
+        }
+    }
+}
+
+PassManager::PassManager(const CompilerOptions& options)
+    : m_options{options}
+{
+}
+
+void PassManager::addPass(std::unique_ptr<FunctionPass> pass, int minOptLevel)
+{
+    m_passes.push_back({std::move(pass), minOptLevel});
+}
+
+void PassManager::addModulePass(std::unique_ptr<ModulePass> pass,
+                                int minOptLevel)
+{
+    m_modulePasses.push_back({std::move(pass), minOptLevel});
+}
+
+void PassManager::addDefaultPipeline(std::map<std::string, SSA>& functions)
+{
+    addPass(std::make_unique<TailRecursionPass>(), 2);
+    addPass(std::make_unique<InlinerPass>(functions), 2);
+    addPass(std::make_unique<SCCPPass>(), 1);
+    addPass(std::make_unique<LoopRotatePass>(), 2);
+    addPass(std::make_unique<LoopSimplifyPass>(), 2);
+    addPass(std::make_unique<GVNPass>(), 2);
+    addPass(std::make_unique<PREPass>(), 2);
+    addPass(std::make_unique<LICMPass>(), 2);
+    addPass(std::make_unique<StrengthReductionPass>(), 2);
+    addPass(std::make_unique<LoopUnrollPass>(), 2);
+
+    // Fully unrolled loops leave the induction variables as constants
+    addPass(std::make_unique<SCCPPass>(), 2);
+
+    // Loads and stores at indices the unroller made constant
+    addPass(std::make_unique<ScalarReplacementPass>(), 2);
+    addPass(std::make_unique<ArrayForwardingPass>(), 2);
+
+    // Comparisons and divisions settled by the ranges of their operands
+    addPass(std::make_unique<ValueRangePass>(), 2);
+
+    // Small if-then-else diamonds become selects, lowered to cmov
+    addPass(std::make_unique<IfConversionPass>(), 2);
+    addPass(std::make_unique<ADCEPass>(), 1);
+
+    // Keeps only the bounds checks that may fail, with -fbounds-check
+    addPass(std::make_unique<BoundsCheckPass>(), PassManager::OptInOnly);
+
+    // Programs that run to the end at compile time need nothing else
+    addModulePass(std::make_unique<ProgramEvaluationPass>(), 2);
+    addModulePass(std::make_unique<CallFoldingPass>(), 1);
+    addModulePass(std::make_unique<IPConstantPropagationPass>(), 2);
+}
+
+bool PassManager::hasPass(const std::string& passName) const
+{
+    for (auto& [pass, minOptLevel] : m_passes)
+    {
+        if (pass->getName() == passName)
+        {
+            return true;
+        }
+    }
+    for (auto& [pass, minOptLevel] : m_modulePasses)
+    {
+        if (pass->getName() == passName)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool PassManager::isEnabled(const std::string& passName, int minOptLevel) const
+{
+    auto it = m_options.passOverrides.find(passName);
+    if (it != m_options.passOverrides.end())
+    {
+        return it->second;
+    }
+    return m_options.optLevel >= minOptLevel;
+}
+
+bool PassManager::run(SSA& ssa, const std::string& funcName)
+{
+    if (m_options.verifyEach)
+    {
+        verifyFunction(ssa, funcName);
+    }
+
+    bool changed = false;
+    for (auto& [pass, minOptLevel] : m_passes)
+    {
+        auto passName = pass->getName();
+        if (!isEnabled(passName, minOptLevel))
+        {
+            continue;
+        }
+
+        auto sizeBefore = m_options.timePasses ? countInstructions(ssa) : 0;
+        auto start = std::chrono::steady_clock::now();
+
+        bool passChanged = pass->run(ssa);
+
+        auto end = std::chrono::steady_clock::now();
+        if (passChanged && !pass->preservesCFG())
+        {
+            ssa.invalidateCFGAnalyses();
+        }
+        changed |= passChanged;
+
+        if (m_options.timePasses)
+        {
+            auto& stats = m_stats[passName];
+            stats.milliseconds +=
+                std::chrono::duration<double, std::milli>(end - start).count();
+            stats.instDelta += static_cast<long long>(countInstructions(ssa)) -
+                               static_cast<long long>(sizeBefore);
+            ++stats.runs;
+            stats.changed += passChanged;
+        }
+
+        if (m_options.printAfterAll)
+        {
+            std::cout << "; IR after " << passName << " on " << funcName
+                      << "\n";
+            ssa.printCFG();
+        }
+
+        if (m_options.verifyEach)
+        {
+            verifyFunction(ssa, funcName);
+        }
+    }
+    return changed;
+}
+
+bool PassManager::runModulePasses(SSA& mainSSA,
+                                  std::map<std::string, SSA>& functions)
+{
+    auto forEachRoutine = [&](auto&& visit)
+    {
+        visit(mainSSA, std::string("main"));
+        for (auto& [funcName, ssa] : functions)
+        {
+            visit(ssa, funcName);
+        }
+    };
+    auto countProgram = [&]()
+    {
+        size_t size = 0;
+        forEachRoutine([&](SSA& ssa, const std::string&)
+                       { size += countInstructions(ssa); });
+        return size;
+    };
+
+    bool changed = false;
+    for (auto& [pass, minOptLevel] : m_modulePasses)
+    {
+        auto passName = pass->getName();
+        if (!isEnabled(passName, minOptLevel))
+        {
+            continue;
+        }
+
+        auto sizeBefore = m_options.timePasses ? countProgram() : 0;
+        auto start = std::chrono::steady_clock::now();
+
+        bool passChanged = pass->run(mainSSA, functions);
+
+        auto end = std::chrono::steady_clock::now();
+        if (passChanged)
+        {
+            forEachRoutine([](SSA& ssa, const std::string&)
+                           { ssa.invalidateCFGAnalyses(); });
+        }
+        changed |= passChanged;
+
+        if (m_options.timePasses)
+        {
+            auto& stats = m_stats[passName];
+            stats.milliseconds +=
+                std::chrono::duration<double, std::milli>(end - start).count();
+            stats.instDelta += static_cast<long long>(countProgram()) -
+                               static_cast<long long>(sizeBefore);
+            ++stats.runs;
+            stats.changed += passChanged;
+        }
+
+        if (m_options.printAfterAll)
+        {
+            forEachRoutine(
+                [&](SSA& ssa, const std::string& funcName)
+                {
+                    std::cout << "; IR after " << passName << " on "
+                              << funcName << "\n";
+                    ssa.printCFG();
+                });
+        }
+
+        if (m_options.verifyEach)
+        {
+            forEachRoutine([](SSA& ssa, const std::string& funcName)
+                           { verifyFunction(ssa, funcName); });
+        }
+    }
+    return changed;
+}
+
+void PassManager::printTimingReport() const
+{
+    if (!m_options.timePasses)
+    {
+        return;
+    }
+
+    double total = 0;
+    std::cerr << "===== Pass execution timing report (-O"
+              << m_options.optLevel << ") =====\n";
+    std::cerr << std::setw(12) << "Time (ms)" << std::setw(12) << "Inst delta"
+              << std::setw(10) << "Changed"
+              << "  Pass\n";
+    std::vector<std::string> passNames;
+    for (auto& [pass, minOptLevel] : m_passes)
+    {
+        passNames.push_back(pass->getName());
+    }
+    for (auto& [pass, minOptLevel] : m_modulePasses)
+    {
+        passNames.push_back(pass->getName());
+    }
+
+    // A pass registered twice is reported once with the runs of both
+    std::set<std::string> reported;
+    for (auto& passName : passNames)
+    {
+        auto it = m_stats.find(passName);
+        if (it == m_stats.end() || !reported.insert(passName).second)
+        {
+            continue;
+        }
+        auto& stats = it->second;
+        total += stats.milliseconds;
+        std::cerr << std::setw(12) << std::fixed << std::setprecision(3)
+                  << stats.milliseconds << std::setw(12) << stats.instDelta
+                  << std::setw(10)
+                  << (std::to_string(stats.changed) + "/" +
+                      std::to_string(stats.runs))
+                  << "  " << it->first << "\n";
+    }
+    std::cerr << std::setw(12) << std::fixed << std::setprecision(3) << total
+              << "  Total\n";
+}
+
+}  // namespace mina
@@ -0,0 +1,80 @@
+#include "ProgramEvaluation.hpp"
+#include "BasicBlock.hpp"
+#include "IREvaluator.hpp"
+#include "InstIR.hpp"
+#include "SSA.hpp"
+
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace mina
+{
+
+namespace
+{
+
+// Instructions the evaluation of the program may execute
+constexpr long long MaxProgramSteps = 1 << 22;
+
+// Calls the evaluation may nest
+constexpr int MaxCallDepth = 512;
+
+// Characters of output the literal replacing main may hold
+constexpr size_t MaxOutputSize = 1 << 16;
+
+// The text as the operand of an assembler .string directive
+std::string quote(const std::string& text)
+{
+    std::string quoted = "\"";
+    for (char c : text)
+    {
+        if (c == '\n')
+        {
+            quoted += "\\n";
+        }
+        else
+        {
+            if (c == '"')
+            {
+                quoted += '\\';
+            }
+            quoted += c;
+        }
+    }
+    return quoted + "\"";
+}
+
+}  // namespace
+
+std::string ProgramEvaluationPass::getName() const { return "partial-eval"; }
+
+bool ProgramEvaluationPass::run(SSA& mainSSA,
+                                std::map<std::string, SSA>& functions)
+{
+    IREvaluator evaluator(functions, MaxProgramSteps, MaxCallDepth);
+    auto output = evaluator.runProgram(mainSSA, MaxOutputSize);
+    if (!output)
+    {
+        return false;
+    }
+
+    // Main keeps its entry, which now only prints
+    auto entry = mainSSA.getCFG();
+    std::vector<std::shared_ptr<Inst>> insts;
+    if (!output->empty())
+    {
+        auto text = std::make_shared<StrConstInst>(quote(*output), entry);
+        text->setup_def_use();
+        auto put = std::make_shared<PutInst>(std::move(text), entry);
+        put->setup_def_use();
+        insts.push_back(std::move(put));
+    }
+    entry->setInstructions(std::move(insts));
+    entry->setPredecessors({});
+    entry->setSuccessors({});
+    return true;
+}
+
+}  // namespace mina
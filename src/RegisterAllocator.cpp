@@ -1,4 +1,6 @@
+#include "LoopInfo.hpp"
 #include "MachineIR.hpp"
+#include "Dominators.hpp"
 #include "RegisterAllocator.hpp"
 
 #include <map>
@@ -546,8 +548,11 @@ std::map<int, std::shared_ptr<Register>> RegisterAllocator::createRegisterMap(st
         {
             registerMap[regID] = colorPalette[color];
 
-            // Track used callee-saved registers (R12, R13, R14 in palette)
-            if (color >= 8)
+            // Track used callee-saved registers, the Windows x64 ABI has
+            // RBX, RDI and RSI besides R12-R15
+            auto physRegID = static_cast<RegID>(colorPalette[color]->getID());
+            if (physRegID == RegID::RBX || physRegID == RegID::RDI ||
+                physRegID == RegID::RSI || color >= 8)
             {
                 m_usedCalleeSavedRegs.insert(colorPalette[color]->getID());
             }
@@ -711,12 +716,12 @@ std::vector<std::shared_ptr<BasicBlockMIR>> RegisterAllocator::replaceVirtualReg
             }
 
             // Instruction Legalization
-            // x86 does not allow two memory operands in a single instruction (except movs, but usually handled by regs).
+            // x86 does not allow two memory operands in a single instruction, mov included.
             // Example: add [rbp-8], [rbp-16] is ILLEGAL.
             bool op0Mem = (newOps.size() > 0 && newOps[0]->getMIRType() == MIRType::Memory);
             bool op1Mem = (newOps.size() > 1 && newOps[1]->getMIRType() == MIRType::Memory);
 
-            if (op0Mem && op1Mem && mirType != MIRType::Mov)
+            if (op0Mem && op1Mem)
             {
                 newBlock->addInstruction(std::make_shared<MovMIR>(
                     std::vector<std::shared_ptr<MachineIR>>{ r10, newOps[1] }
@@ -731,7 +736,6 @@ std::vector<std::shared_ptr<BasicBlockMIR>> RegisterAllocator::replaceVirtualReg
                 case MIRType::Mov:   newBlock->addInstruction(std::make_shared<MovMIR>(newOps)); break;
                 case MIRType::Add:   newBlock->addInstruction(std::make_shared<AddMIR>(newOps)); break;
                 case MIRType::Sub:   newBlock->addInstruction(std::make_shared<SubMIR>(newOps)); break;
-                case MIRType::Mul:   newBlock->addInstruction(std::make_shared<MulMIR>(newOps)); break;
                 case MIRType::And:   newBlock->addInstruction(std::make_shared<AndMIR>(newOps)); break;
                 case MIRType::Or:    newBlock->addInstruction(std::make_shared<OrMIR>(newOps)); break;
                 case MIRType::Cmp:   newBlock->addInstruction(std::make_shared<CmpMIR>(newOps)); break;
@@ -755,12 +759,31 @@ std::vector<std::shared_ptr<BasicBlockMIR>> RegisterAllocator::replaceVirtualReg
                     break;
                 }
 
+                // imul requires a Register destination. If spilled, use R11 as a bridge.
+                case MIRType::Mul:
+                {
+                    if (newOps[0]->getMIRType() == MIRType::Reg)
+                    {
+                        newBlock->addInstruction(std::make_shared<MulMIR>(newOps));
+                    }
+                    else
+                    {
+                        // Fixup: IMUL [mem], src -> MOV R11, [mem]; IMUL R11, src; MOV [mem], R11
+                        newBlock->addInstruction(std::make_shared<MovMIR>(std::vector<std::shared_ptr<MachineIR>>{ r11, newOps[0] }));
+                        newBlock->addInstruction(std::make_shared<MulMIR>(std::vector<std::shared_ptr<MachineIR>>{ r11, newOps[1] }));
+                        newBlock->addInstruction(std::make_shared<MovMIR>(std::vector<std::shared_ptr<MachineIR>>{ newOps[0], r11 }));
+                    }
+                    break;
+                }
+
                 // Div requires Memory operand in our implementation (idiv [mem])
                 case MIRType::Div:
                 {
                     if (auto mem = std::dynamic_pointer_cast<MemoryMIR>(newOps[0]))
                     {
-                        newBlock->addInstruction(std::make_shared<DivMIR>(mem));
+                        auto div = std::dynamic_pointer_cast<DivMIR>(inst);
+                        newBlock->addInstruction(std::make_shared<DivMIR>(
+                            mem, div->isUnsigned(), div->isNarrow()));
                     }
                     else
                     {
@@ -808,6 +831,25 @@ std::vector<std::shared_ptr<BasicBlockMIR>> RegisterAllocator::replaceVirtualReg
                     break;
                 }
 
+                // Cmov requires a Register destination. If spilled, the old
+                // value is loaded into R11 so it survives a false condition.
+                case MIRType::Cmov:
+                {
+                    auto cmov = std::dynamic_pointer_cast<CmovMIR>(inst);
+                    if (newOps[0]->getMIRType() == MIRType::Reg)
+                    {
+                        newBlock->addInstruction(std::make_shared<CmovMIR>(newOps, cmov->getCondition()));
+                    }
+                    else
+                    {
+                        // Fixup: CMOV [mem], src -> MOV R11, [mem]; CMOV R11, src; MOV [mem], R11
+                        newBlock->addInstruction(std::make_shared<MovMIR>(std::vector<std::shared_ptr<MachineIR>>{ r11, newOps[0] }));
+                        newBlock->addInstruction(std::make_shared<CmovMIR>(std::vector<std::shared_ptr<MachineIR>>{ r11, newOps[1] }, cmov->getCondition()));
+                        newBlock->addInstruction(std::make_shared<MovMIR>(std::vector<std::shared_ptr<MachineIR>>{ newOps[0], r11 }));
+                    }
+                    break;
+                }
+
                 // Test instruction
                 case MIRType::Test:
                 {
@@ -1041,9 +1083,11 @@ void RegisterAllocator::addEdgesBasedOnLiveness(std::shared_ptr<InferenceGraph>
 
                 case MIRType::Add:
                 case MIRType::Sub:
+                case MIRType::Mul:
                 case MIRType::And:
                 case MIRType::Or:
                 case MIRType::Not:
+                case MIRType::Cmov:
                 {
                     if (!operands.empty() && operands[0]->getMIRType() == MIRType::Reg)
                     {
@@ -1058,16 +1102,11 @@ void RegisterAllocator::addEdgesBasedOnLiveness(std::shared_ptr<InferenceGraph>
                     break;
                 }
 
-                case MIRType::Mul:
+                case MIRType::Cqo:
                 {
-                    // Implicit RDX:RAX = RAX * op
+                    // Sign extends RAX into RDX
                     instUses.insert(to_int(RegID::RAX));
-                    instDefs.insert(to_int(RegID::RAX));
                     instDefs.insert(to_int(RegID::RDX));
-                    if (!operands.empty() && operands[0]->getMIRType() == MIRType::Reg)
-                    {
-                        instUses.insert(getID(operands[0]));
-                    }
                     break;
                 }
 
@@ -1087,16 +1126,20 @@ void RegisterAllocator::addEdgesBasedOnLiveness(std::shared_ptr<InferenceGraph>
 
                 case MIRType::Call:
                 {
-                    // Defs: Caller-saved registers (Clobbers)
-                    instDefs.insert(to_int(RegID::RAX));
-                    instDefs.insert(to_int(RegID::RCX));
-                    instDefs.insert(to_int(RegID::RDX));
-                    instDefs.insert(to_int(RegID::R8));
-                    instDefs.insert(to_int(RegID::R9));
-
-                    // Uses: Arguments
+                    // Defs: Caller-saved registers the callee writes
+                    // (Clobbers), R10 and R11 are never allocated
                     const auto callInst =
                         std::dynamic_pointer_cast<CallMIR>(inst);
+                    for (int reg : callInst->getClobberedRegs())
+                    {
+                        if (reg != to_int(RegID::R10) &&
+                            reg != to_int(RegID::R11))
+                        {
+                            instDefs.insert(reg);
+                        }
+                    }
+
+                    // Uses: Arguments
                     unsigned int numArgs = callInst->getNumArgs();
 
                     if (numArgs >= 1) instUses.insert(to_int(RegID::RCX));
@@ -1269,7 +1312,7 @@ void RegisterAllocator::livenessAnalysis()
     // Process Worklist
     while (!worklist.empty())
     {
-        auto& block = worklist.front();
+        auto block = worklist.front();
         worklist.pop_front();
         inWorklist.erase(block->getName());
 
@@ -1342,38 +1385,17 @@ void RegisterAllocator::printLivenessData(
     }
 }
 
-// We can implement this using dominator tree for better accuracy
+// The loop depth of a block is the number of natural loops containing it, so
+// every block of a loop body is weighted, not only the one with the back edge
 void RegisterAllocator::calculateLoopDepths(std::shared_ptr<BasicBlockMIR> entry)
 {
-    std::map<std::string, bool> visited;
-    std::map<std::string, bool> onStack;
+    DominatorTreeMIR domTree(entry);
+    LoopForestMIR loops(domTree);
 
-    std::function<void(std::shared_ptr<BasicBlockMIR>, int)> dfs =
-        [&](std::shared_ptr<BasicBlockMIR> block, int currentDepth)
+    for (auto& block : m_MIRBlocks)
     {
-
-        visited[block->getName()] = true;
-        onStack[block->getName()] = true;
-        block->setLoopDepth(currentDepth);
-
-        for (auto& succ : block->getSuccessors())
-        {
-            if (onStack[succ->getName()])
-            {
-                // We found a back-edge! This successor is a loop header.
-                // In a real compiler, we'd mark the header and re-scan,
-                // but for a heuristic, we increment the depth of the current path.
-                block->setLoopDepth(currentDepth + 1);
-            }
-            else if (!visited[succ->getName()])
-            {
-                dfs(succ, currentDepth);
-            }
-        }
-        onStack[block->getName()] = false;
-    };
-
-    dfs(entry, 0);
+        block->setLoopDepth(loops.getLoopDepth(block));
+    }
 }
 
 void RegisterAllocator::printSpillCosts(std::shared_ptr<InferenceGraph> graph)
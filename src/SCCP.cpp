@@ -0,0 +1,569 @@
+#include "SCCP.hpp"
+#include "BasicBlock.hpp"
+#include "IRUtils.hpp"
+#include "InstIR.hpp"
+#include "SSA.hpp"
+
+#include <set>
+#include <limits>
+#include <memory>
+#include <string>
+#include <vector>
+#include <utility>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace mina
+{
+
+namespace
+{
+
+struct LatticeValue
+{
+    enum class State
+    {
+        Top,       // no value seen yet
+        Constant,
+        Bottom     // not a constant
+    };
+
+    State state = State::Top;
+    long long value = 0;
+    bool isBool = false;
+
+    static LatticeValue constant(long long value, bool isBool)
+    {
+        return {State::Constant, value, isBool};
+    }
+    static LatticeValue bottom() { return {State::Bottom, 0, false}; }
+
+    bool isTop() const { return state == State::Top; }
+    bool isConstant() const { return state == State::Constant; }
+    bool isBottom() const { return state == State::Bottom; }
+
+    bool operator==(const LatticeValue& other) const
+    {
+        return state == other.state &&
+               (state != State::Constant ||
+                (value == other.value && isBool == other.isBool));
+    }
+};
+
+LatticeValue meet(const LatticeValue& a, const LatticeValue& b)
+{
+    if (a.isTop())
+    {
+        return b;
+    }
+    if (b.isTop())
+    {
+        return a;
+    }
+    if (a == b)
+    {
+        return a;
+    }
+    return LatticeValue::bottom();
+}
+
+// Folded integers must fit the 32-bit constants of the IR
+LatticeValue makeInt(long long value)
+{
+    if (value < std::numeric_limits<int>::min() ||
+        value > std::numeric_limits<int>::max())
+    {
+        return LatticeValue::bottom();
+    }
+    return LatticeValue::constant(value, false);
+}
+
+class SCCPSolver
+{
+public:
+    SCCPSolver(SSA& ssa);
+
+    void solve();
+    bool transform();
+
+private:
+    using Edge = std::pair<BasicBlock*, BasicBlock*>;
+
+    SSA& m_ssa;
+    std::vector<std::shared_ptr<BasicBlock>> m_blocks;
+    std::unordered_map<Inst*, std::shared_ptr<BasicBlock>> m_instBlock;
+    std::unordered_map<std::string, std::vector<std::shared_ptr<Inst>>> m_users;
+    std::unordered_set<std::string> m_defined;
+    std::unordered_map<std::string, LatticeValue> m_values;
+
+    std::set<Edge> m_executableEdges;
+    std::unordered_set<BasicBlock*> m_executableBlocks;
+    std::vector<std::pair<std::shared_ptr<BasicBlock>,
+                          std::shared_ptr<BasicBlock>>> m_edgeWorklist;
+    std::vector<std::shared_ptr<Inst>> m_instWorklist;
+
+    bool isExecutable(const std::shared_ptr<BasicBlock>& block) const;
+    void markEdgeExecutable(const std::shared_ptr<BasicBlock>& from,
+                            const std::shared_ptr<BasicBlock>& to);
+    void setValue(const std::string& name, const LatticeValue& value);
+    LatticeValue getValue(const std::shared_ptr<Inst>& operand);
+
+    void visitInst(const std::shared_ptr<Inst>& inst,
+                   const std::shared_ptr<BasicBlock>& block);
+    void visitPhi(const std::shared_ptr<PhiInst>& phi,
+                  const std::shared_ptr<BasicBlock>& block);
+    void visitBranch(const std::shared_ptr<Inst>& inst,
+                     const std::shared_ptr<BasicBlock>& block);
+    LatticeValue evaluate(const std::shared_ptr<Inst>& inst);
+
+    std::shared_ptr<Inst> makeConstant(const LatticeValue& value,
+                                       const std::shared_ptr<BasicBlock>& block,
+                                       bool isPutOperand) const;
+};
+
+SCCPSolver::SCCPSolver(SSA& ssa) : m_ssa{ssa}
+{
+    m_blocks = getRPONodes(ssa.getCFG());
+    for (auto& block : m_blocks)
+    {
+        for (auto& inst : block->getInstructions())
+        {
+            m_instBlock[inst.get()] = block;
+
+            auto defined = getDefinedName(inst);
+            if (!defined.empty())
+            {
+                m_defined.insert(defined);
+            }
+
+            for (auto& operand : inst->getOperands())
+            {
+                auto name = getValueName(operand);
+                if (!name.empty())
+                {
+                    m_users[name].push_back(inst);
+                }
+            }
+        }
+    }
+}
+
+bool SCCPSolver::isExecutable(const std::shared_ptr<BasicBlock>& block) const
+{
+    return m_executableBlocks.count(block.get()) != 0;
+}
+
+void SCCPSolver::markEdgeExecutable(const std::shared_ptr<BasicBlock>& from,
+                                    const std::shared_ptr<BasicBlock>& to)
+{
+    if (m_executableEdges.count({from.get(), to.get()}) == 0)
+    {
+        m_edgeWorklist.push_back({from, to});
+    }
+}
+
+void SCCPSolver::setValue(const std::string& name, const LatticeValue& value)
+{
+    auto& current = m_values[name];
+    auto lowered = meet(current, value);
+    if (lowered == current)
+    {
+        return;
+    }
+
+    current = lowered;
+    for (auto& user : m_users[name])
+    {
+        m_instWorklist.push_back(user);
+    }
+}
+
+LatticeValue SCCPSolver::getValue(const std::shared_ptr<Inst>& operand)
+{
+    auto target = operand->getTarget();
+    if (target->getInstType() == InstType::IntConst)
+    {
+        return LatticeValue::constant(
+            std::dynamic_pointer_cast<IntConstInst>(target)->getVal(), false);
+    }
+    if (target->getInstType() == InstType::BoolConst)
+    {
+        return LatticeValue::constant(
+            std::dynamic_pointer_cast<BoolConstInst>(target)->getVal(), true);
+    }
+
+    // Parameters and undefined values have no definition to track
+    auto name = getValueName(operand);
+    if (name.empty() || m_defined.count(name) == 0)
+    {
+        return LatticeValue::bottom();
+    }
+    return m_values[name];
+}
+
+void SCCPSolver::solve()
+{
+    markEdgeExecutable(nullptr, m_ssa.getCFG());
+
+    while (!m_edgeWorklist.empty() || !m_instWorklist.empty())
+    {
+        while (!m_edgeWorklist.empty())
+        {
+            auto [from, to] = m_edgeWorklist.back();
+            m_edgeWorklist.pop_back();
+            if (!m_executableEdges.insert({from.get(), to.get()}).second)
+            {
+                continue;
+            }
+
+            // A block is visited in full the first time it is reached, after
+            // that a new incoming edge can only change its phis
+            bool firstVisit = m_executableBlocks.insert(to.get()).second;
+            for (auto& inst : to->getInstructions())
+            {
+                if (firstVisit || inst->isPhi())
+                {
+                    visitInst(inst, to);
+                }
+            }
+        }
+
+        while (!m_instWorklist.empty())
+        {
+            auto inst = m_instWorklist.back();
+            m_instWorklist.pop_back();
+
+            auto& block = m_instBlock[inst.get()];
+            if (isExecutable(block))
+            {
+                visitInst(inst, block);
+            }
+        }
+    }
+}
+
+void SCCPSolver::visitInst(const std::shared_ptr<Inst>& inst,
+                           const std::shared_ptr<BasicBlock>& block)
+{
+    switch (inst->getInstType())
+    {
+        case InstType::Phi:
+            visitPhi(std::dynamic_pointer_cast<PhiInst>(inst), block);
+            return;
+        case InstType::Jump:
+        case InstType::BRT:
+        case InstType::BRF:
+            visitBranch(inst, block);
+            return;
+        default:
+            break;
+    }
+
+    auto name = getDefinedName(inst);
+    if (!name.empty())
+    {
+        setValue(name, evaluate(inst));
+    }
+}
+
+void SCCPSolver::visitPhi(const std::shared_ptr<PhiInst>& phi,
+                          const std::shared_ptr<BasicBlock>& block)
+{
+    auto name = phi->getTarget()->getString();
+    auto& operands = phi->getOperands();
+
+    // A phi without operands stands for a variable read before being written
+    if (operands.empty())
+    {
+        setValue(name, LatticeValue::bottom());
+        return;
+    }
+
+    LatticeValue value;
+    for (unsigned int i = 0; i < operands.size(); ++i)
+    {
+        Edge edge{phi->getOperandBB(i).get(), block.get()};
+        if (m_executableEdges.count(edge) != 0)
+        {
+            value = meet(value, getValue(operands[i]));
+        }
+    }
+    setValue(name, value);
+}
+
+void SCCPSolver::visitBranch(const std::shared_ptr<Inst>& inst,
+                             const std::shared_ptr<BasicBlock>& block)
+{
+    if (inst->getInstType() == InstType::Jump)
+    {
+        markEdgeExecutable(
+            block, std::dynamic_pointer_cast<JumpInst>(inst)->getJumpTarget());
+        return;
+    }
+
+    bool isBRT = inst->getInstType() == InstType::BRT;
+    std::shared_ptr<Inst> cond;
+    std::shared_ptr<BasicBlock> success, failed;
+    if (isBRT)
+    {
+        auto brt = std::dynamic_pointer_cast<BRTInst>(inst);
+        cond = brt->getCond();
+        success = brt->getTargetSuccess();
+        failed = brt->getTargetFailed();
+    }
+    else
+    {
+        auto brf = std::dynamic_pointer_cast<BRFInst>(inst);
+        cond = brf->getCond();
+        success = brf->getTargetSuccess();
+        failed = brf->getTargetFailed();
+    }
+
+    auto value = getValue(cond);
+    if (value.isTop())
+    {
+        return;
+    }
+    if (value.isConstant())
+    {
+        // BRT goes to the success target on true, BRF on false
+        bool takesSuccess = (value.value != 0) == isBRT;
+        markEdgeExecutable(block, takesSuccess ? success : failed);
+        return;
+    }
+    markEdgeExecutable(block, success);
+    markEdgeExecutable(block, failed);
+}
+
+LatticeValue SCCPSolver::evaluate(const std::shared_ptr<Inst>& inst)
+{
+    auto type = inst->getInstType();
+    auto& operands = inst->getOperands();
+
+    if (type == InstType::Assign)
+    {
+        return getValue(operands[0]);
+    }
+
+    if (type == InstType::Not)
+    {
+        auto operand = getValue(operands[0]);
+        if (!operand.isConstant())
+        {
+            return operand;
+        }
+        // Not is lowered to xor with 1, which is also what an int gets
+        return LatticeValue::constant(operand.isBool ? !operand.value
+                                                     : operand.value ^ 1,
+                                      operand.isBool);
+    }
+
+    // Either value while the condition isn't known
+    if (type == InstType::Select)
+    {
+        auto cond = getValue(operands[0]);
+        if (cond.isTop())
+        {
+            return cond;
+        }
+        if (cond.isConstant())
+        {
+            return getValue(operands[cond.value != 0 ? 1 : 2]);
+        }
+        return meet(getValue(operands[1]), getValue(operands[2]));
+    }
+
+    bool isBinary = type == InstType::Add || type == InstType::Sub ||
+                    type == InstType::Mul || type == InstType::Div ||
+                    type == InstType::And || type == InstType::Or ||
+                    type == InstType::CmpEq || type == InstType::CmpNE ||
+                    type == InstType::CmpLT || type == InstType::CmpLTE ||
+                    type == InstType::CmpGT || type == InstType::CmpGTE;
+    if (!isBinary)
+    {
+        // Input, calls and memory are never constant
+        return LatticeValue::bottom();
+    }
+
+    auto lhs = getValue(operands[0]);
+    auto rhs = getValue(operands[1]);
+    if (lhs.isBottom() || rhs.isBottom())
+    {
+        return LatticeValue::bottom();
+    }
+    if (lhs.isTop() || rhs.isTop())
+    {
+        return LatticeValue();
+    }
+
+    auto a = lhs.value;
+    auto b = rhs.value;
+    switch (type)
+    {
+        case InstType::Add: return makeInt(a + b);
+        case InstType::Sub: return makeInt(a - b);
+        case InstType::Mul: return makeInt(a * b);
+        case InstType::Div:
+            // Leave the fault of a division by zero to run time
+            return b == 0 ? LatticeValue::bottom() : makeInt(a / b);
+        case InstType::And:
+            return LatticeValue::constant(a & b, lhs.isBool && rhs.isBool);
+        case InstType::Or:
+            return LatticeValue::constant(a | b, lhs.isBool && rhs.isBool);
+        case InstType::CmpEq: return LatticeValue::constant(a == b, true);
+        case InstType::CmpNE: return LatticeValue::constant(a != b, true);
+        case InstType::CmpLT: return LatticeValue::constant(a < b, true);
+        case InstType::CmpLTE: return LatticeValue::constant(a <= b, true);
+        case InstType::CmpGT: return LatticeValue::constant(a > b, true);
+        case InstType::CmpGTE: return LatticeValue::constant(a >= b, true);
+        default: return LatticeValue::bottom();
+    }
+}
+
+std::shared_ptr<Inst> SCCPSolver::makeConstant(
+    const LatticeValue& value, const std::shared_ptr<BasicBlock>& block,
+    bool isPutOperand) const
+{
+    // Boolean variables are printed as numbers, only boolean literals are
+    // printed as true/false, so put keeps getting a number
+    if (value.isBool && !isPutOperand)
+    {
+        return std::make_shared<BoolConstInst>(value.value != 0, block);
+    }
+    return std::make_shared<IntConstInst>(static_cast<int>(value.value), block);
+}
+
+bool SCCPSolver::transform()
+{
+    bool changed = false;
+
+    for (auto& block : m_blocks)
+    {
+        if (!isExecutable(block))
+        {
+            continue;
+        }
+
+        // Replace the uses of constants and drop their definitions
+        auto& instructions = block->getInstructions();
+        for (size_t i = 0; i < instructions.size();)
+        {
+            auto& inst = instructions[i];
+            bool isPut = inst->getInstType() == InstType::Put;
+            for (auto& operand : inst->getOperands())
+            {
+                if (isConstant(operand))
+                {
+                    continue;
+                }
+                auto name = getValueName(operand);
+                if (name.empty() || m_defined.count(name) == 0)
+                {
+                    continue;
+                }
+                auto& value = m_values[name];
+                if (value.isConstant())
+                {
+                    operand = makeConstant(value, block, isPut);
+                    changed = true;
+                }
+            }
+
+            auto defined = getDefinedName(inst);
+            if (!defined.empty() && m_values[defined].isConstant() &&
+                isRemovableIfUnused(inst))
+            {
+                instructions.erase(instructions.begin() + i);
+                changed = true;
+                continue;
+            }
+            ++i;
+        }
+
+        // Branches on constants only have one executable edge
+        auto terminator = block->getTerminator();
+        if (terminator && terminator->getInstType() != InstType::Jump)
+        {
+            auto value = getValue(terminator->getOperands()[0]);
+            if (value.isConstant())
+            {
+                bool isBRT = terminator->getInstType() == InstType::BRT;
+                std::shared_ptr<BasicBlock> target;
+                if (isBRT)
+                {
+                    auto brt = std::dynamic_pointer_cast<BRTInst>(terminator);
+                    target = (value.value != 0) ? brt->getTargetSuccess()
+                                                : brt->getTargetFailed();
+                }
+                else
+                {
+                    auto brf = std::dynamic_pointer_cast<BRFInst>(terminator);
+                    target = (value.value == 0) ? brf->getTargetSuccess()
+                                                : brf->getTargetFailed();
+                }
+                replaceBranchWithJump(block, target);
+                changed = true;
+            }
+        }
+    }
+
+    // With the branches folded the blocks that were never executed can't be
+    // reached anymore
+    changed |= detachUnreachableBlocks(m_ssa, m_blocks);
+
+    // Phis left with a single incoming value are plain copies
+    for (auto& block : m_blocks)
+    {
+        if (!isExecutable(block) || block->getNumPredecessors() != 1)
+        {
+            continue;
+        }
+
+        std::vector<std::shared_ptr<Inst>> phis, copies, rest;
+        for (auto& inst : block->getInstructions())
+        {
+            auto phi = inst->isPhi() ? std::dynamic_pointer_cast<PhiInst>(inst)
+                                     : nullptr;
+            if (!phi)
+            {
+                rest.push_back(inst);
+            }
+            else if (phi->getOperands().size() == 1 &&
+                     phi->getOperandBB(0) != block)
+            {
+                auto copy = std::make_shared<AssignInst>(
+                    phi->getTarget(), phi->getOperands()[0], block);
+                copy->setup_def_use();
+                copies.push_back(copy);
+            }
+            else
+            {
+                phis.push_back(inst);
+            }
+        }
+        if (copies.empty())
+        {
+            continue;
+        }
+
+        phis.insert(phis.end(), copies.begin(), copies.end());
+        phis.insert(phis.end(), rest.begin(), rest.end());
+        block->setInstructions(std::move(phis));
+        changed = true;
+    }
+
+    return changed;
+}
+
+}  // namespace
+
+std::string SCCPPass::getName() const { return "sccp"; }
+
+bool SCCPPass::run(SSA& ssa)
+{
+    SCCPSolver solver(ssa);
+    solver.solve();
+    return solver.transform();
+}
+
+}  // namespace mina
@@ -1,11 +1,13 @@
 #include "SSA.hpp"
 #include "InstIR.hpp"
 #include "BasicBlock.hpp"
+#include "OutOfSSA.hpp"
 
 #include <memory>
 #include <string>
 #include <vector>
 #include <iostream>
+#include <algorithm>
 #include <unordered_map>
 
 namespace mina
@@ -15,11 +17,16 @@ SSA::SSA()
     : m_cfg{std::make_shared<BasicBlock>("Entry_0")},
       m_currBBNameWithoutCtr{"Entry"},
       m_currBBCtr{0},
-      m_currentBB{}
+      m_currentBB{},
+      m_freshCtr{0}
 {
 }
 
-void SSA::setCFG(std::shared_ptr<BasicBlock> cfg) { m_cfg = cfg; }
+void SSA::setCFG(std::shared_ptr<BasicBlock> cfg)
+{
+    m_cfg = cfg;
+    invalidateCFGAnalyses();
+}
 
 std::string SSA::baseNameToSSA(const std::string& name)
 {
@@ -74,6 +81,11 @@ std::string SSA::getBaseName(std::string name)
     return name.substr(0, pos);
 }
 
+std::string SSA::makeFreshName(const std::string& name)
+{
+    return getBaseName(name) + ".o" + std::to_string(m_freshCtr++);
+}
+
 std::string& SSA::getCurrBBNameWithoutCtr() { return m_currBBNameWithoutCtr; }
 
 void SSA::incCurrBBCtr() { ++m_currBBCtr; }
@@ -195,27 +207,34 @@ std::shared_ptr<Inst> SSA::tryRemoveTrivialPhi(std::shared_ptr<PhiInst> phi)
                 auto& inst = instructions[i];
                 auto& operands = inst->getOperands();
                 
+                // A phi may take the value from several predecessors
                 for (int i = 0; i < operands.size(); ++i)
                 {
                     if (operands[i] == phi)
                     {
                         operands[i] = same;
-                        same->push_user(inst);
-                        break;
+                        if (same)
+                        {
+                            same->push_user(inst);
+                        }
                     }
                 }
             }
         }
     }
     
-    // remove phi from the hash table
+    // remove phi from the hash table, blocks reading the variable through
+    // a single predecessor cached it as their definition too
     const auto& block = phi->getBlock();
-    for (auto& [varName, value] : m_currDef[block])
+    for (auto& [defBlock, defs] : m_currDef)
     {
-      if (value == phi)
-      {
-        m_currDef[block][varName] = same;
-      }
+        for (auto& [varName, value] : defs)
+        {
+            if (value == phi)
+            {
+                value = same;
+            }
+        }
     }
     
     // remove phi from instructions
@@ -233,11 +252,27 @@ std::shared_ptr<Inst> SSA::tryRemoveTrivialPhi(std::shared_ptr<PhiInst> phi)
         }
     }
 
-    for (auto& user : users)
+    // Phis using this one may have become trivial, same among them, in
+    // which case it is replaced in turn. Phis still collecting operands, or
+    // already removed through an earlier user, are left alone.
+    for (auto& user : users_without_phi)
     {
-        if (user && user->isPhi())
+        if (!user || !user->isPhi() ||
+            user->getOperands().size() !=
+                user->getBlock()->getPredecessors().size())
         {
-            tryRemoveTrivialPhi(std::dynamic_pointer_cast<PhiInst>(user));
+            continue;
+        }
+        auto& userInsts = user->getBlock()->getInstructions();
+        if (std::find(userInsts.begin(), userInsts.end(), user) !=
+            userInsts.end())
+        {
+            auto value =
+                tryRemoveTrivialPhi(std::dynamic_pointer_cast<PhiInst>(user));
+            if (user == same)
+            {
+                same = value;
+            }
         }
     }
     return same;
@@ -245,6 +280,12 @@ std::shared_ptr<Inst> SSA::tryRemoveTrivialPhi(std::shared_ptr<PhiInst> phi)
 
 void SSA::sealBlock(std::shared_ptr<BasicBlock> block)
 {
+    // Sealing twice would add the phi operands a second time
+    if (m_sealedBlocks.find(block) != m_sealedBlocks.end())
+    {
+        return;
+    }
+
     for (const auto& [var, val] : m_incompletePhis[block])
     {
         addPhiOperands(var, m_incompletePhis[block][var]);
@@ -252,80 +293,42 @@ void SSA::sealBlock(std::shared_ptr<BasicBlock> block)
     m_sealedBlocks.insert(block);
 }
 
-// Implement method I (Naive Translation) from paper
-// Optimizing translation out of SSA using renaming constraints.
-void SSA::renameSSA()
+// Isolates the phis with copies and coalesces the copies that do not
+// interfere, see OutOfSSA
+void SSA::renameSSA() { OutOfSSA(*this).run(); }
+
+std::shared_ptr<DominatorTree> SSA::getDominatorTree()
 {
-    auto rpo = getRPONodes(getCFG());
-    //printCFG();
-    for (auto& node : rpo)
+    if (!m_domTree)
     {
-        std::shared_ptr<BasicBlock> current_bb = node;
-        auto& instructions = current_bb->getInstructions();
-        for (unsigned int inst_idx = 0; inst_idx < instructions.size();
-             ++inst_idx)
-        {
-            auto& currInst = instructions[inst_idx];
-            const auto& target = currInst->getTarget();
-            const auto& targetStr = target->getString();
-            
-            if (currInst->isPhi())
-            {
-                auto phiInst = std::dynamic_pointer_cast<PhiInst>(currInst);
-                auto& operands = phiInst->getOperands();
-                for (int i = 0; i < operands.size(); ++i)
-                {
-                    const auto& opStr = operands[i]->getString();
-                    auto predBlock = phiInst->getOperandBB(i);
-                    auto newTargetInst =
-                        std::make_shared<IdentInst>(targetStr + "'", predBlock);
-                    // predBlock->pushInst(std::make_shared<AssignInst>(
-                    //     newTargetInst, operands[i]->getTarget(), predBlock));
-                    auto& lastInst =
-                        predBlock
-                            ->getInstructions()[predBlock->getInstructions().size() - 1];
-                    if (lastInst->getInstType() == InstType::BRT ||
-                        lastInst->getInstType() == InstType::BRF)
-                    {
-                        predBlock->insertInstAtIndex(
-                            predBlock->getInstructions().size() - 2,
-                            std::make_shared<AssignInst>(newTargetInst,
-                                                        operands[i]->getTarget(),
-                                                        predBlock));
-                    }
-                    else
-                    {
-                        predBlock->insertInstAtIndex(
-                            predBlock->getInstructions().size() - 1,
-                            std::make_shared<AssignInst>(newTargetInst,
-                                                        operands[i]->getTarget(),
-                                                        predBlock));
-                    }
-                }
-
-                // Remove phi instruction and add assign instruction at the
-                // beginning of the block
-                current_bb->removeInstAtIndex(inst_idx);
-
-                // reset index to the beginning of the block since we
-                // just added a new instruction at the beginning
-                inst_idx = -1;
+        m_domTree = std::make_shared<DominatorTree>(m_cfg);
+    }
+    return m_domTree;
+}
 
-                if (operands.size() == 0)
-                {
-                    continue;
-                }
+std::shared_ptr<DominatorTree> SSA::getPostDominatorTree()
+{
+    if (!m_postDomTree)
+    {
+        m_postDomTree = std::make_shared<DominatorTree>(m_cfg, true);
+    }
+    return m_postDomTree;
+}
 
-                auto newTargetInst =
-                    std::make_shared<IdentInst>(targetStr, current_bb);
-                auto whatever =
-                    std::make_shared<IdentInst>(targetStr + "'", current_bb);
-                current_bb->pushInstBegin(std::make_shared<AssignInst>(
-                    newTargetInst, whatever, current_bb));
-            }
-        }
+std::shared_ptr<LoopForest> SSA::getLoopForest()
+{
+    if (!m_loopForest)
+    {
+        m_loopForest = std::make_shared<LoopForest>(*getDominatorTree());
     }
-    //printCFG();
+    return m_loopForest;
+}
+
+void SSA::invalidateCFGAnalyses()
+{
+    m_domTree.reset();
+    m_postDomTree.reset();
+    m_loopForest.reset();
 }
 
 }  // namespace mina
@@ -0,0 +1,431 @@
+#include "ScalarReplacement.hpp"
+#include "BasicBlock.hpp"
+#include "IRUtils.hpp"
+#include "InstIR.hpp"
+#include "SSA.hpp"
+#include "Types.hpp"
+
+#include <memory>
+#include <string>
+#include <vector>
+#include <utility>
+#include <algorithm>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace mina
+{
+
+namespace
+{
+
+// Largest array split into scalars, every phi of it becomes this many phis
+constexpr unsigned int MaxElements = 16;
+
+// Size in bytes of an array element, see CodeGen
+constexpr int ElementSize = 8;
+
+class ScalarReplacer
+{
+public:
+    ScalarReplacer(SSA& ssa);
+
+    bool run();
+
+private:
+    SSA& m_ssa;
+    std::vector<std::shared_ptr<BasicBlock>> m_blocks;
+
+    // Instructions using every value
+    std::unordered_map<std::string, std::vector<std::shared_ptr<Inst>>> m_users;
+
+    // Values of the elements of every version of the arrays being replaced
+    std::unordered_map<std::string, std::vector<std::shared_ptr<Inst>>> m_elements;
+
+    // Phis added for the elements, loads replaced by the value of their
+    // element, and the instructions to delete
+    std::vector<std::shared_ptr<PhiInst>> m_elementPhis;
+    std::unordered_map<std::string, std::shared_ptr<Inst>> m_replacements;
+    std::unordered_set<Inst*> m_removed;
+
+    std::shared_ptr<Inst> lookup(std::shared_ptr<Inst> operand) const;
+    int getElement(const std::shared_ptr<Inst>& inst, unsigned int size) const;
+    bool findVersions(const std::shared_ptr<AllocaInst>& alloca,
+                      std::unordered_set<std::string>& versions) const;
+    void replace(const std::shared_ptr<AllocaInst>& alloca,
+                 const std::unordered_set<std::string>& versions);
+    void removeTrivialPhis();
+    void rewrite();
+};
+
+ScalarReplacer::ScalarReplacer(SSA& ssa)
+    : m_ssa{ssa}, m_blocks{getRPONodes(ssa.getCFG())}
+{
+}
+
+std::shared_ptr<Inst> ScalarReplacer::lookup(std::shared_ptr<Inst> operand) const
+{
+    auto name = getValueName(operand);
+    while (!name.empty())
+    {
+        auto it = m_replacements.find(name);
+        if (it == m_replacements.end())
+        {
+            break;
+        }
+        operand = it->second;
+        name = getValueName(operand);
+    }
+    return operand;
+}
+
+// Element a load or store accesses, or -1 if its index isn't a constant
+// within size. Strength reduction leaves indices scaled to byte offsets.
+int ScalarReplacer::getElement(const std::shared_ptr<Inst>& inst,
+                               unsigned int size) const
+{
+    bool isScaled =
+        inst->getInstType() == InstType::ArrAccess
+            ? std::dynamic_pointer_cast<ArrAccessInst>(inst)->isIndexScaled()
+            : std::dynamic_pointer_cast<ArrUpdateInst>(inst)->isIndexScaled();
+    auto index = inst->getOperands()[1]->getTarget();
+    if (index->getInstType() != InstType::IntConst)
+    {
+        return -1;
+    }
+
+    auto value = std::dynamic_pointer_cast<IntConstInst>(index)->getVal();
+    if (isScaled)
+    {
+        if (value % ElementSize != 0)
+        {
+            return -1;
+        }
+        value /= ElementSize;
+    }
+    return value >= 0 && static_cast<unsigned int>(value) < size ? value : -1;
+}
+
+// Collects every version of the array. Returns false if one of them is used
+// by anything but a load or store at a constant index, a phi or a copy.
+bool ScalarReplacer::findVersions(const std::shared_ptr<AllocaInst>& alloca,
+                                  std::unordered_set<std::string>& versions) const
+{
+    auto name = getDefinedName(alloca);
+    std::vector<std::string> worklist{name};
+    versions.insert(name);
+    while (!worklist.empty())
+    {
+        auto version = worklist.back();
+        worklist.pop_back();
+
+        auto it = m_users.find(version);
+        if (it == m_users.end())
+        {
+            continue;
+        }
+        for (auto& user : it->second)
+        {
+            auto type = user->getInstType();
+            if (type == InstType::ArrAccess || type == InstType::ArrUpdate)
+            {
+                if (getValueName(user->getOperands()[0]) != version ||
+                    getElement(user, alloca->getSize()) < 0)
+                {
+                    return false;
+                }
+                if (type == InstType::ArrAccess)
+                {
+                    continue;
+                }
+            }
+            else if (type != InstType::Phi && type != InstType::Assign)
+            {
+                return false;
+            }
+
+            auto defined = getDefinedName(user);
+            if (versions.insert(defined).second)
+            {
+                worklist.push_back(defined);
+            }
+        }
+    }
+
+    // A phi merging another array with this one can't be split
+    for (auto& block : m_blocks)
+    {
+        for (auto& inst : block->getInstructions())
+        {
+            if (!inst->isPhi() || versions.count(getDefinedName(inst)) == 0)
+            {
+                continue;
+            }
+            for (auto& operand : inst->getOperands())
+            {
+                if (versions.count(getValueName(operand)) == 0)
+                {
+                    return false;
+                }
+            }
+        }
+    }
+    return true;
+}
+
+void ScalarReplacer::replace(const std::shared_ptr<AllocaInst>& alloca,
+                             const std::unordered_set<std::string>& versions)
+{
+    auto arrayName = getDefinedName(alloca);
+    auto baseName = m_ssa.getBaseName(arrayName);
+    auto size = alloca->getSize();
+
+    // The phis of the array come first, they may merge versions defined
+    // further down along back edges
+    std::vector<std::pair<std::shared_ptr<PhiInst>,
+                          std::vector<std::shared_ptr<PhiInst>>>>
+        splitPhis;
+    for (auto& block : m_blocks)
+    {
+        std::vector<std::shared_ptr<PhiInst>> added;
+        for (auto& inst : block->getInstructions())
+        {
+            auto name = getDefinedName(inst);
+            if (!inst->isPhi() || versions.count(name) == 0)
+            {
+                continue;
+            }
+
+            std::vector<std::shared_ptr<PhiInst>> phis;
+            auto& elements = m_elements[name];
+            for (unsigned int i = 0; i < size; ++i)
+            {
+                auto phi = std::make_shared<PhiInst>(
+                    m_ssa.makeFreshName(baseName + "_" + std::to_string(i)), block);
+                phis.push_back(phi);
+                elements.push_back(makeValueRef(getDefinedName(phi), block));
+            }
+            added.insert(added.end(), phis.begin(), phis.end());
+            splitPhis.push_back({std::dynamic_pointer_cast<PhiInst>(inst), phis});
+            m_removed.insert(inst.get());
+        }
+        for (auto it = added.rbegin(); it != added.rend(); ++it)
+        {
+            block->pushInstBegin(*it);
+        }
+        m_elementPhis.insert(m_elementPhis.end(), added.begin(), added.end());
+    }
+
+    for (auto& block : m_blocks)
+    {
+        for (auto& inst : block->getInstructions())
+        {
+            auto name = getDefinedName(inst);
+            if (inst->getInstType() == InstType::ArrAccess &&
+                versions.count(getValueName(inst->getOperands()[0])) != 0)
+            {
+                auto& elements = m_elements[getValueName(inst->getOperands()[0])];
+                m_replacements[name] = elements[getElement(inst, size)];
+                m_removed.insert(inst.get());
+                continue;
+            }
+            if (versions.count(name) == 0 || inst->isPhi())
+            {
+                continue;
+            }
+
+            auto& elements = m_elements[name];
+            switch (inst->getInstType())
+            {
+                case InstType::Alloca:
+                    for (unsigned int i = 0; i < size; ++i)
+                    {
+                        if (alloca->getType() == Type::BOOLEAN)
+                        {
+                            elements.push_back(
+                                std::make_shared<BoolConstInst>(false, block));
+                        }
+                        else
+                        {
+                            elements.push_back(std::make_shared<IntConstInst>(0, block));
+                        }
+                    }
+                    break;
+                case InstType::ArrUpdate:
+                {
+                    elements = m_elements[getValueName(inst->getOperands()[0])];
+                    elements[getElement(inst, size)] = inst->getOperands()[2];
+                    break;
+                }
+                default:
+                    elements = m_elements[getValueName(inst->getOperands()[0])];
+                    break;
+            }
+            m_removed.insert(inst.get());
+        }
+    }
+
+    // Each phi of an element merges that element of the incoming versions
+    for (auto& [arrayPhi, phis] : splitPhis)
+    {
+        auto& operands = arrayPhi->getOperands();
+        for (unsigned int i = 0; i < size; ++i)
+        {
+            for (unsigned int k = 0; k < operands.size(); ++k)
+            {
+                auto pred = arrayPhi->getOperandBB(k);
+                auto value = m_elements[getValueName(operands[k])][i];
+                auto valueName = getValueName(value);
+                phis[i]->appendOperand(
+                    valueName.empty() ? value : makeValueRef(valueName, pred), pred);
+            }
+        }
+    }
+}
+
+// Element phis merging a single value, often the same element flowing
+// unchanged around a loop, are replaced by that value
+void ScalarReplacer::removeTrivialPhis()
+{
+    bool changed = true;
+    while (changed)
+    {
+        changed = false;
+        for (auto& phi : m_elementPhis)
+        {
+            auto name = getDefinedName(phi);
+            if (m_removed.count(phi.get()) != 0)
+            {
+                continue;
+            }
+
+            std::shared_ptr<Inst> single;
+            bool isTrivial = true;
+            for (auto& operand : phi->getOperands())
+            {
+                auto value = lookup(operand);
+                auto valueName = getValueName(value);
+                if (valueName == name)
+                {
+                    continue;
+                }
+                if (!single)
+                {
+                    single = value;
+                }
+                else if (valueName.empty()
+                             ? !isConstant(single) ||
+                                   single->getTarget()->getString() !=
+                                       value->getTarget()->getString()
+                             : getValueName(single) != valueName)
+                {
+                    isTrivial = false;
+                    break;
+                }
+            }
+            if (!isTrivial || !single)
+            {
+                continue;
+            }
+
+            m_replacements[name] = single;
+            m_removed.insert(phi.get());
+            changed = true;
+        }
+    }
+}
+
+void ScalarReplacer::rewrite()
+{
+    for (auto& block : m_blocks)
+    {
+        auto& instructions = block->getInstructions();
+        instructions.erase(
+            std::remove_if(instructions.begin(), instructions.end(),
+                           [&](const std::shared_ptr<Inst>& inst)
+                           { return m_removed.count(inst.get()) != 0; }),
+            instructions.end());
+
+        for (auto& inst : instructions)
+        {
+            bool isPut = inst->getInstType() == InstType::Put;
+            for (auto& operand : inst->getOperands())
+            {
+                auto name = getValueName(operand);
+                if (name.empty() || m_replacements.count(name) == 0)
+                {
+                    continue;
+                }
+
+                auto replacement = lookup(operand);
+                auto target = replacement->getTarget();
+
+                // Boolean variables are printed as numbers
+                if (isPut && target->getInstType() == InstType::BoolConst)
+                {
+                    replacement = std::make_shared<IntConstInst>(
+                        std::dynamic_pointer_cast<BoolConstInst>(target)->getVal(),
+                        block);
+                }
+                else if (!isConstant(replacement))
+                {
+                    replacement = makeValueRef(getValueName(replacement), block);
+                }
+                operand = replacement;
+            }
+        }
+    }
+}
+
+bool ScalarReplacer::run()
+{
+    std::vector<std::shared_ptr<AllocaInst>> allocas;
+    for (auto& block : m_blocks)
+    {
+        for (auto& inst : block->getInstructions())
+        {
+            for (auto& operand : inst->getOperands())
+            {
+                auto name = getValueName(operand);
+                if (!name.empty())
+                {
+                    m_users[name].push_back(inst);
+                }
+            }
+            if (inst->getInstType() == InstType::Alloca)
+            {
+                allocas.push_back(std::dynamic_pointer_cast<AllocaInst>(inst));
+            }
+        }
+    }
+
+    bool changed = false;
+    for (auto& alloca : allocas)
+    {
+        std::unordered_set<std::string> versions;
+        if (alloca->getSize() > MaxElements || !findVersions(alloca, versions))
+        {
+            continue;
+        }
+        replace(alloca, versions);
+        changed = true;
+    }
+    if (changed)
+    {
+        removeTrivialPhis();
+        rewrite();
+    }
+    return changed;
+}
+
+}  // namespace
+
+std::string ScalarReplacementPass::getName() const { return "sroa"; }
+
+bool ScalarReplacementPass::run(SSA& ssa)
+{
+    ScalarReplacer replacer(ssa);
+    return replacer.run();
+}
+
+}  // namespace mina
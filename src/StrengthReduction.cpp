@@ -0,0 +1,518 @@
+#include "StrengthReduction.hpp"
+#include "BasicBlock.hpp"
+#include "IRUtils.hpp"
+#include "InductionVariables.hpp"
+#include "InstIR.hpp"
+#include "LoopInfo.hpp"
+#include "SSA.hpp"
+
+#include <limits>
+#include <memory>
+#include <string>
+#include <vector>
+#include <utility>
+#include <unordered_map>
+
+namespace mina
+{
+
+namespace
+{
+
+// Size in bytes of an array element, see CodeGen
+constexpr long long ElementSize = 8;
+
+bool fitsInt(long long value)
+{
+    return value >= std::numeric_limits<int>::min() &&
+           value <= std::numeric_limits<int>::max();
+}
+
+bool isComparison(InstType type)
+{
+    return type == InstType::CmpEq || type == InstType::CmpNE ||
+           type == InstType::CmpLT || type == InstType::CmpLTE ||
+           type == InstType::CmpGT || type == InstType::CmpGTE;
+}
+
+class LoopStrengthReducer
+{
+public:
+    LoopStrengthReducer(SSA& ssa, const Loop& loop);
+
+    bool run();
+
+private:
+    // A phi added to the loop for base * scale + offset. Other offsets with
+    // the same scale are derived from it in the header instead of getting a
+    // phi of their own.
+    struct ReducedIV
+    {
+        std::string name;
+        std::string next;
+        long long scale;
+        long long offset;
+        std::unordered_map<long long, std::string> otherOffsets;
+    };
+
+    SSA& m_ssa;
+    const Loop& m_loop;
+    InductionVariables m_ivs;
+
+    // Reduced variables of each basic induction variable
+    std::unordered_map<std::string, std::vector<ReducedIV>> m_reduced;
+
+    // Deleted multiplications mapped to the phi replacing them
+    std::unordered_map<std::string, std::string> m_replacements;
+
+    std::string getReduced(const AffineValue& value);
+    std::shared_ptr<Inst> materialize(const std::shared_ptr<Inst>& operand,
+                                      long long scale, long long offset,
+                                      const std::string& baseName);
+    std::shared_ptr<Inst> insertBinary(InstType type,
+                                       const std::string& name,
+                                       const std::shared_ptr<Inst>& lhs,
+                                       long long rhs,
+                                       const std::shared_ptr<BasicBlock>& block,
+                                       size_t index);
+    bool reduceMultiplications();
+    bool reduceArrayIndices();
+    void replaceUses();
+    void removeDeadValues();
+    bool replaceExitTest(const BasicInductionVariable& iv);
+};
+
+LoopStrengthReducer::LoopStrengthReducer(SSA& ssa, const Loop& loop)
+    : m_ssa{ssa}, m_loop{loop}, m_ivs{loop}
+{
+}
+
+std::shared_ptr<Inst> LoopStrengthReducer::insertBinary(
+    InstType type, const std::string& name, const std::shared_ptr<Inst>& lhs,
+    long long rhs, const std::shared_ptr<BasicBlock>& block, size_t index)
+{
+    auto target = std::make_shared<IdentInst>(name, block);
+    target->setup_def_use();
+    auto constant = std::make_shared<IntConstInst>(static_cast<int>(rhs), block);
+
+    std::shared_ptr<Inst> inst;
+    if (type == InstType::Mul)
+    {
+        inst = std::make_shared<MulInst>(target, lhs, constant, block);
+    }
+    else
+    {
+        inst = std::make_shared<AddInst>(target, lhs, constant, block);
+    }
+    inst->setup_def_use();
+    block->insertInstAtIndex(index, inst);
+    return makeValueRef(name, block);
+}
+
+// Computes operand * scale + offset at the end of the preheader, nullptr if
+// the operand is not an integer or the result doesn't fit
+std::shared_ptr<Inst> LoopStrengthReducer::materialize(
+    const std::shared_ptr<Inst>& operand, long long scale, long long offset,
+    const std::string& baseName)
+{
+    auto preheader = m_loop.getPreheader();
+    auto target = operand->getTarget();
+    if (target->getInstType() == InstType::IntConst)
+    {
+        long long value =
+            std::dynamic_pointer_cast<IntConstInst>(target)->getVal() * scale +
+            offset;
+        if (!fitsInt(value))
+        {
+            return nullptr;
+        }
+        return std::make_shared<IntConstInst>(static_cast<int>(value),
+                                              preheader);
+    }
+
+    auto name = getValueName(operand);
+    if (name.empty())
+    {
+        return nullptr;
+    }
+
+    auto result = makeValueRef(name, preheader);
+    if (scale != 1)
+    {
+        result = insertBinary(InstType::Mul, m_ssa.makeFreshName(baseName),
+                              result, scale, preheader,
+                              preheader->getInstructions().size() - 1);
+    }
+    if (offset != 0)
+    {
+        result = insertBinary(InstType::Add, m_ssa.makeFreshName(baseName),
+                              result, offset, preheader,
+                              preheader->getInstructions().size() - 1);
+    }
+    return result;
+}
+
+// Name of the phi holding the value in every iteration, created on first use.
+// Empty if it can't be created.
+std::string LoopStrengthReducer::getReduced(const AffineValue& value)
+{
+    auto header = m_loop.getHeader();
+    auto& reduced = m_reduced[value.base];
+    for (auto& iv : reduced)
+    {
+        if (iv.scale != value.scale)
+        {
+            continue;
+        }
+        if (iv.offset == value.offset)
+        {
+            return iv.name;
+        }
+
+        long long delta = value.offset - iv.offset;
+        if (!fitsInt(delta))
+        {
+            return "";
+        }
+        auto& name = iv.otherOffsets[delta];
+        if (name.empty())
+        {
+            size_t numPhis = 0;
+            while (header->getInstructions()[numPhis]->isPhi())
+            {
+                ++numPhis;
+            }
+            name = m_ssa.makeFreshName(value.base);
+            insertBinary(InstType::Add, name, makeValueRef(iv.name, header),
+                         delta, header, numPhis);
+        }
+        return name;
+    }
+
+    auto basic = m_ivs.getBasicIV(value.base);
+    long long step = basic->step * value.scale;
+    if (!fitsInt(step))
+    {
+        return "";
+    }
+    auto init = materialize(basic->init, value.scale, value.offset, value.base);
+    if (!init)
+    {
+        return "";
+    }
+
+    auto preheader = m_loop.getPreheader();
+    ReducedIV iv{m_ssa.makeFreshName(value.base),
+                 m_ssa.makeFreshName(value.base), value.scale, value.offset, {}};
+
+    // The next value is computed right after the one of the basic variable,
+    // so it is available wherever the old one was
+    for (auto& block : m_loop.getBlocks())
+    {
+        auto& instructions = block->getInstructions();
+        for (size_t i = 0; i < instructions.size(); ++i)
+        {
+            if (getDefinedName(instructions[i]) == basic->next)
+            {
+                insertBinary(InstType::Add, iv.next,
+                             makeValueRef(iv.name, block), step, block, i + 1);
+                break;
+            }
+        }
+    }
+
+    auto phi = std::make_shared<PhiInst>(iv.name, header);
+    for (auto& pred : header->getPredecessors())
+    {
+        if (pred == preheader)
+        {
+            phi->appendOperand(init, pred);
+        }
+        else
+        {
+            phi->appendOperand(makeValueRef(iv.next, pred), pred);
+        }
+    }
+    header->pushInstBegin(phi);
+
+    reduced.push_back(iv);
+    return iv.name;
+}
+
+bool LoopStrengthReducer::reduceMultiplications()
+{
+    bool changed = false;
+    for (auto& block : m_loop.getBlocks())
+    {
+        auto& instructions = block->getInstructions();
+        for (size_t i = 0; i < instructions.size();)
+        {
+            auto inst = instructions[i];
+            auto name = getDefinedName(inst);
+            auto value = m_ivs.getAffine(name);
+            if (inst->getInstType() != InstType::Mul || !value)
+            {
+                ++i;
+                continue;
+            }
+
+            auto reduced = getReduced(*value);
+            if (reduced.empty())
+            {
+                ++i;
+                continue;
+            }
+
+            // getReduced may have inserted before this instruction
+            auto& current = block->getInstructions();
+            for (size_t j = 0; j < current.size(); ++j)
+            {
+                if (current[j] == inst)
+                {
+                    current.erase(current.begin() + j);
+                    i = j;
+                    break;
+                }
+            }
+            m_replacements[name] = reduced;
+            changed = true;
+        }
+    }
+    return changed;
+}
+
+bool LoopStrengthReducer::reduceArrayIndices()
+{
+    bool changed = false;
+    for (auto& block : m_loop.getBlocks())
+    {
+        // Collected first since getReduced inserts into the blocks
+        std::vector<std::shared_ptr<Inst>> accesses;
+        for (auto& inst : block->getInstructions())
+        {
+            auto type = inst->getInstType();
+            if (type == InstType::ArrAccess || type == InstType::ArrUpdate)
+            {
+                accesses.push_back(inst);
+            }
+        }
+
+        for (auto& inst : accesses)
+        {
+            auto access = std::dynamic_pointer_cast<ArrAccessInst>(inst);
+            auto update = std::dynamic_pointer_cast<ArrUpdateInst>(inst);
+            bool isScaled =
+                access ? access->isIndexScaled() : update->isIndexScaled();
+            auto& index = inst->getOperands()[1];
+            auto value = m_ivs.getAffine(getValueName(index));
+            if (isScaled || !value)
+            {
+                continue;
+            }
+
+            long long scale = value->scale * ElementSize;
+            long long offset = value->offset * ElementSize;
+            if (!fitsInt(scale) || !fitsInt(offset))
+            {
+                continue;
+            }
+            auto reduced = getReduced({value->base, scale, offset});
+            if (reduced.empty())
+            {
+                continue;
+            }
+
+            index = makeValueRef(reduced, block);
+            if (access)
+            {
+                access->setIndexScaled(true);
+            }
+            else
+            {
+                update->setIndexScaled(true);
+            }
+            changed = true;
+        }
+    }
+    return changed;
+}
+
+void LoopStrengthReducer::replaceUses()
+{
+    if (m_replacements.empty())
+    {
+        return;
+    }
+    for (auto& block : getRPONodes(m_ssa.getCFG()))
+    {
+        for (auto& inst : block->getInstructions())
+        {
+            for (auto& operand : inst->getOperands())
+            {
+                auto it = m_replacements.find(getValueName(operand));
+                if (it != m_replacements.end())
+                {
+                    operand = makeValueRef(it->second, block);
+                }
+            }
+        }
+    }
+}
+
+// Index computations the reduced variables made useless would otherwise keep
+// the basic variables alive until dead code elimination
+void LoopStrengthReducer::removeDeadValues()
+{
+    bool changed = true;
+    while (changed)
+    {
+        std::unordered_map<std::string, size_t> useCounts;
+        for (auto& block : getRPONodes(m_ssa.getCFG()))
+        {
+            for (auto& inst : block->getInstructions())
+            {
+                for (auto& operand : inst->getOperands())
+                {
+                    ++useCounts[getValueName(operand)];
+                }
+            }
+        }
+
+        changed = false;
+        for (auto& block : m_loop.getBlocks())
+        {
+            auto& instructions = block->getInstructions();
+            for (size_t i = 0; i < instructions.size();)
+            {
+                auto& inst = instructions[i];
+                if (inst->isPhi() || !isRemovableIfUnused(inst) ||
+                    useCounts[getDefinedName(inst)] != 0)
+                {
+                    ++i;
+                    continue;
+                }
+                instructions.erase(instructions.begin() + i);
+                changed = true;
+            }
+        }
+    }
+}
+
+// Linear function test replacement: when the only use of the basic variable
+// left is a comparison in the loop with a constant or an invariant, compare a
+// reduced variable instead
+bool LoopStrengthReducer::replaceExitTest(const BasicInductionVariable& iv)
+{
+    auto it = m_reduced.find(iv.name);
+    if (it == m_reduced.end() || it->second.empty())
+    {
+        return false;
+    }
+    auto& reduced = it->second[0];
+
+    std::shared_ptr<Inst> user;
+    std::shared_ptr<BasicBlock> userBlock;
+    for (auto& block : getRPONodes(m_ssa.getCFG()))
+    {
+        for (auto& inst : block->getInstructions())
+        {
+            // The phi and its increment only keep each other alive
+            auto name = getDefinedName(inst);
+            if (name == iv.name || name == iv.next)
+            {
+                continue;
+            }
+            for (auto& operand : inst->getOperands())
+            {
+                auto operandName = getValueName(operand);
+                if (operandName != iv.name && operandName != iv.next)
+                {
+                    continue;
+                }
+                if (user && user != inst)
+                {
+                    return false;
+                }
+                user = inst;
+                userBlock = block;
+            }
+        }
+    }
+    if (!user || !isComparison(user->getInstType()) ||
+        !m_loop.contains(userBlock))
+    {
+        return false;
+    }
+
+    auto& operands = user->getOperands();
+    auto lhsName = getValueName(operands[0]);
+    size_t ivIndex = lhsName == iv.name || lhsName == iv.next ? 0 : 1;
+    auto other = operands[1 - ivIndex];
+    auto otherName = getValueName(other);
+    if (!otherName.empty())
+    {
+        for (auto& block : m_loop.getBlocks())
+        {
+            for (auto& inst : block->getInstructions())
+            {
+                if (getDefinedName(inst) == otherName)
+                {
+                    return false;
+                }
+            }
+        }
+    }
+
+    auto bound = materialize(other, reduced.scale, reduced.offset, iv.name);
+    if (!bound)
+    {
+        return false;
+    }
+
+    bool usesNext = getValueName(operands[ivIndex]) == iv.next;
+    operands[ivIndex] =
+        makeValueRef(usesNext ? reduced.next : reduced.name, userBlock);
+    operands[1 - ivIndex] = bound;
+
+    // Multiplying by a negative scale reverses the order
+    if (reduced.scale < 0)
+    {
+        std::swap(operands[0], operands[1]);
+    }
+    return true;
+}
+
+bool LoopStrengthReducer::run()
+{
+    if (m_ivs.getBasicIVs().empty())
+    {
+        return false;
+    }
+
+    bool changed = reduceMultiplications();
+    changed |= reduceArrayIndices();
+    replaceUses();
+    removeDeadValues();
+    for (auto& iv : m_ivs.getBasicIVs())
+    {
+        changed |= replaceExitTest(iv);
+    }
+    return changed;
+}
+
+}  // namespace
+
+std::string StrengthReductionPass::getName() const { return "strength-reduce"; }
+
+bool StrengthReductionPass::run(SSA& ssa)
+{
+    bool changed = false;
+    for (auto loop : ssa.getLoopForest()->getLoopsInnermostFirst())
+    {
+        LoopStrengthReducer reducer(ssa, *loop);
+        changed |= reducer.run();
+    }
+    return changed;
+}
+
+}  // namespace mina
@@ -0,0 +1,340 @@
+#include "TailRecursion.hpp"
+#include "BasicBlock.hpp"
+#include "IRUtils.hpp"
+#include "InstIR.hpp"
+#include "SSA.hpp"
+
+#include <memory>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace mina
+{
+
+namespace
+{
+
+using ValueMap = std::unordered_map<std::string, std::shared_ptr<Inst>>;
+
+// Operand using the value, which is either a constant or a name
+std::shared_ptr<Inst> useValue(const std::shared_ptr<Inst>& value,
+                               const std::shared_ptr<BasicBlock>& block)
+{
+    auto name = getValueName(value);
+    return name.empty() ? value : makeValueRef(name, block);
+}
+
+bool isCallTo(const std::shared_ptr<Inst>& inst, const std::string& funcName)
+{
+    if (inst->getInstType() == InstType::FuncCall)
+    {
+        return std::dynamic_pointer_cast<FuncCallInst>(inst)->getCalleeStr() ==
+               funcName;
+    }
+    if (inst->getInstType() == InstType::ProcCall)
+    {
+        return std::dynamic_pointer_cast<ProcCallInst>(inst)->getCalleeStr() ==
+               funcName;
+    }
+    return false;
+}
+
+// Index of the call to funcName followed only by copies of its result up to
+// end, -1 if there is none. The result and its copies are added to names.
+int findCallAndCopies(std::vector<std::shared_ptr<Inst>>& insts, size_t end,
+                      const std::string& funcName,
+                      std::unordered_set<std::string>& names)
+{
+    auto index = end;
+    while (index > 0 && insts[index - 1]->getInstType() == InstType::Assign)
+    {
+        --index;
+    }
+    if (index == 0 || !isCallTo(insts[index - 1], funcName))
+    {
+        return -1;
+    }
+
+    auto result = getDefinedName(insts[index - 1]);
+    if (!result.empty())
+    {
+        names.insert(result);
+    }
+    for (auto i = index; i < end; ++i)
+    {
+        auto assign = std::dynamic_pointer_cast<AssignInst>(insts[i]);
+        if (names.count(getValueName(assign->getSource())) == 0)
+        {
+            return -1;
+        }
+        names.insert(getDefinedName(assign));
+    }
+    return index - 1;
+}
+
+class TailRecursionEliminator
+{
+public:
+    TailRecursionEliminator(SSA& ssa, const std::shared_ptr<Func>& signature);
+
+    bool run();
+
+private:
+    SSA& m_ssa;
+    std::shared_ptr<Func> m_signature;
+    std::string m_funcName;
+    bool m_isFunc;
+
+    // Index of the recursive call the block ends with, before its return and
+    // the copies of its result, -1 if there is none
+    int findTailCall(const std::shared_ptr<BasicBlock>& block);
+
+    // Copies the return of a block made of phis and a return into its
+    // predecessors ending with a recursive call
+    bool duplicateReturns();
+};
+
+TailRecursionEliminator::TailRecursionEliminator(
+    SSA& ssa, const std::shared_ptr<Func>& signature)
+    : m_ssa{ssa},
+      m_signature{signature},
+      m_funcName{signature->getFuncName()},
+      m_isFunc{signature->getFType() == FType::FUNC}
+{
+}
+
+int TailRecursionEliminator::findTailCall(
+    const std::shared_ptr<BasicBlock>& block)
+{
+    auto& insts = block->getInstructions();
+    if (block->getNumSuccessors() != 0 || insts.empty())
+    {
+        return -1;
+    }
+
+    std::unordered_set<std::string> names;
+    if (!m_isFunc)
+    {
+        return findCallAndCopies(insts, insts.size(), m_funcName, names);
+    }
+
+    auto& returnInst = insts.back();
+    if (returnInst->getInstType() != InstType::Return ||
+        returnInst->getOperands().empty())
+    {
+        return -1;
+    }
+    auto callIndex =
+        findCallAndCopies(insts, insts.size() - 1, m_funcName, names);
+    if (callIndex < 0 ||
+        names.count(getValueName(returnInst->getOperands()[0])) == 0)
+    {
+        return -1;
+    }
+    return callIndex;
+}
+
+bool TailRecursionEliminator::duplicateReturns()
+{
+    bool changed = false;
+    for (auto& block : getRPONodes(m_ssa.getCFG()))
+    {
+        if (block->getNumSuccessors() != 0)
+        {
+            continue;
+        }
+
+        std::shared_ptr<Inst> returnInst;
+        bool isReturnOnly = true;
+        for (auto& inst : block->getInstructions())
+        {
+            if (inst->getInstType() == InstType::Return)
+            {
+                returnInst = inst;
+            }
+            else if (!inst->isPhi())
+            {
+                isReturnOnly = false;
+            }
+        }
+        if (!isReturnOnly || (m_isFunc && !returnInst))
+        {
+            continue;
+        }
+
+        for (auto& pred : block->getPredecessors())
+        {
+            auto& predInsts = pred->getInstructions();
+            std::unordered_set<std::string> names;
+            if (pred->getNumSuccessors() != 1 || predInsts.empty() ||
+                predInsts.back()->getInstType() != InstType::Jump ||
+                findCallAndCopies(predInsts, predInsts.size() - 1, m_funcName,
+                                  names) < 0)
+            {
+                continue;
+            }
+
+            // The value returned when coming from pred
+            std::shared_ptr<Inst> value;
+            if (m_isFunc)
+            {
+                value = returnInst->getOperands()[0];
+                for (auto& inst : block->getInstructions())
+                {
+                    if (!inst->isPhi() ||
+                        getDefinedName(inst) != getValueName(value))
+                    {
+                        continue;
+                    }
+                    auto phi = std::dynamic_pointer_cast<PhiInst>(inst);
+                    for (unsigned int i = 0; i < phi->getOperands().size(); ++i)
+                    {
+                        if (phi->getOperandBB(i) == pred)
+                        {
+                            value = phi->getOperands()[i];
+                        }
+                    }
+                }
+                if (names.count(getValueName(value)) == 0)
+                {
+                    continue;
+                }
+            }
+
+            predInsts.pop_back();
+            if (m_isFunc)
+            {
+                auto newReturn =
+                    std::make_shared<ReturnInst>(useValue(value, pred), pred);
+                newReturn->setup_def_use();
+                pred->pushInst(newReturn);
+            }
+            pred->removeSuccessor(block);
+            block->removePredecessor(pred);
+            changed = true;
+        }
+    }
+    return changed;
+}
+
+bool TailRecursionEliminator::run()
+{
+    bool changed = duplicateReturns();
+
+    auto entry = m_ssa.getCFG();
+    std::vector<std::shared_ptr<BasicBlock>> tailBlocks;
+    for (auto& block : getRPONodes(entry))
+    {
+        if (findTailCall(block) >= 0)
+        {
+            tailBlocks.push_back(block);
+        }
+    }
+    if (tailBlocks.empty())
+    {
+        return changed;
+    }
+
+    // Everything but the signature moves to the header of the loop
+    auto header = std::make_shared<BasicBlock>(m_funcName + "_tailrecurse");
+    auto& entryInsts = entry->getInstructions();
+    header->setInstructions({entryInsts.begin() + 1, entryInsts.end()});
+    entryInsts.erase(entryInsts.begin() + 1, entryInsts.end());
+    for (auto& succ : entry->getSuccessors())
+    {
+        succ->replacePredecessor(entry, header);
+    }
+    header->setSuccessors(entry->getSuccessors());
+    for (auto& block : tailBlocks)
+    {
+        if (block == entry)
+        {
+            block = header;
+        }
+    }
+
+    auto jumpInst = std::make_shared<JumpInst>(header);
+    jumpInst->setup_def_use();
+    entry->pushInst(jumpInst);
+    entry->setSuccessors({header});
+    header->pushPredecessor(entry);
+
+    // The parameters are read through phis merging the arguments of every
+    // iteration
+    ValueMap paramValues;
+    std::vector<std::shared_ptr<PhiInst>> paramPhis;
+    for (auto& param : m_signature->getParameters())
+    {
+        auto phi = std::make_shared<PhiInst>(
+            m_ssa.makeFreshName(param->getName()), header);
+        phi->appendOperand(makeValueRef(param->getName(), header), entry);
+        paramValues[param->getName()] = phi->getTarget();
+        paramPhis.push_back(phi);
+    }
+    for (auto& block : getRPONodes(entry))
+    {
+        if (block == entry)
+        {
+            continue;
+        }
+        for (auto& inst : block->getInstructions())
+        {
+            for (auto& operand : inst->getOperands())
+            {
+                auto it = paramValues.find(getValueName(operand));
+                if (it != paramValues.end())
+                {
+                    operand = useValue(it->second, block);
+                }
+            }
+        }
+    }
+
+    for (auto& block : tailBlocks)
+    {
+        auto& insts = block->getInstructions();
+        auto callIndex = findTailCall(block);
+        auto args = insts[callIndex]->getOperands();
+        insts.erase(insts.begin() + callIndex, insts.end());
+
+        for (size_t i = 0; i < paramPhis.size(); ++i)
+        {
+            paramPhis[i]->appendOperand(useValue(args[i], header), block);
+        }
+
+        auto backJump = std::make_shared<JumpInst>(header);
+        backJump->setup_def_use();
+        block->pushInst(backJump);
+        block->pushSuccessor(header);
+        header->pushPredecessor(block);
+    }
+
+    for (auto it = paramPhis.rbegin(); it != paramPhis.rend(); ++it)
+    {
+        (*it)->setup_def_use();
+        header->pushInstBegin(*it);
+    }
+    return true;
+}
+
+}  // namespace
+
+std::string TailRecursionPass::getName() const { return "tail-recursion"; }
+
+bool TailRecursionPass::run(SSA& ssa)
+{
+    auto& insts = ssa.getCFG()->getInstructions();
+    auto signature =
+        insts.empty() ? nullptr : std::dynamic_pointer_cast<Func>(insts.front());
+    if (!signature)
+    {
+        return false;
+    }
+
+    TailRecursionEliminator eliminator(ssa, signature);
+    return eliminator.run();
+}
+
+}  // namespace mina
@@ -0,0 +1,926 @@
+#include "ValueRange.hpp"
+#include "BasicBlock.hpp"
+#include "IRUtils.hpp"
+#include "InductionVariables.hpp"
+#include "InstIR.hpp"
+#include "LoopInfo.hpp"
+#include "SSA.hpp"
+
+#include <limits>
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <unordered_map>
+
+namespace mina
+{
+
+namespace
+{
+
+constexpr long long Min = std::numeric_limits<long long>::min();
+constexpr long long Max = std::numeric_limits<long long>::max();
+
+// Largest step of an induction variable assumed not to wrap around
+constexpr long long MaxInductionStep = 1024;
+
+// Times a phi may grow before it is widened
+constexpr unsigned int WideningDelay = 2;
+
+// Sweeps refining the widened ranges, and a bound on the sweeps reaching a
+// fixpoint after which every range is given up on
+constexpr unsigned int NarrowingSweeps = 2;
+constexpr unsigned int MaxSweeps = 64;
+
+// Conditions looked through below a branch, for nested ands and nots
+constexpr unsigned int MaxConditionDepth = 4;
+
+// Largest operands of a division done on 32 bits
+constexpr long long Max32 = std::numeric_limits<int>::max();
+
+bool addOverflows(long long a, long long b, long long& result)
+{
+    if ((b > 0 && a > Max - b) || (b < 0 && a < Min - b))
+    {
+        return true;
+    }
+    result = a + b;
+    return false;
+}
+
+bool subOverflows(long long a, long long b, long long& result)
+{
+    if ((b < 0 && a > Max + b) || (b > 0 && a < Min + b))
+    {
+        return true;
+    }
+    result = a - b;
+    return false;
+}
+
+bool mulOverflows(long long a, long long b, long long& result)
+{
+    bool overflows = false;
+    if (a > 0)
+    {
+        overflows = b > 0 ? a > Max / b : b < Min / a;
+    }
+    else
+    {
+        overflows = b > 0 ? a < Min / b : a != 0 && b < Max / a;
+    }
+    if (!overflows)
+    {
+        result = a * b;
+    }
+    return overflows;
+}
+
+ValueRange unite(const ValueRange& a, const ValueRange& b)
+{
+    if (a.isEmpty())
+    {
+        return b;
+    }
+    if (b.isEmpty())
+    {
+        return a;
+    }
+    return {std::min(a.lo, b.lo), std::max(a.hi, b.hi)};
+}
+
+ValueRange intersect(const ValueRange& a, const ValueRange& b)
+{
+    return {std::max(a.lo, b.lo), std::min(a.hi, b.hi)};
+}
+
+// Smallest and largest of op applied to the corners of the two ranges, the
+// full range if one of them overflows
+template <typename Op>
+ValueRange fromCorners(const ValueRange& a, const ValueRange& b, Op op)
+{
+    ValueRange result;
+    for (auto x : {a.lo, a.hi})
+    {
+        for (auto y : {b.lo, b.hi})
+        {
+            long long value = 0;
+            if (op(x, y, value))
+            {
+                return ValueRange::full();
+            }
+            result = unite(result, ValueRange::exact(value));
+        }
+    }
+    return result;
+}
+
+bool isComparison(InstType type)
+{
+    return type == InstType::CmpEq || type == InstType::CmpNE ||
+           type == InstType::CmpLT || type == InstType::CmpLTE ||
+           type == InstType::CmpGT || type == InstType::CmpGTE;
+}
+
+bool isBoolean(InstType type)
+{
+    return isComparison(type) || type == InstType::Not ||
+           type == InstType::And || type == InstType::Or;
+}
+
+// Comparison with its operands swapped, a < b being b > a
+InstType swapComparison(InstType type)
+{
+    switch (type)
+    {
+        case InstType::CmpLT:
+            return InstType::CmpGT;
+        case InstType::CmpLTE:
+            return InstType::CmpGTE;
+        case InstType::CmpGT:
+            return InstType::CmpLT;
+        case InstType::CmpGTE:
+            return InstType::CmpLTE;
+        default:
+            return type;
+    }
+}
+
+// Comparison holding when the given one doesn't
+InstType negateComparison(InstType type)
+{
+    switch (type)
+    {
+        case InstType::CmpEq:
+            return InstType::CmpNE;
+        case InstType::CmpNE:
+            return InstType::CmpEq;
+        case InstType::CmpLT:
+            return InstType::CmpGTE;
+        case InstType::CmpLTE:
+            return InstType::CmpGT;
+        case InstType::CmpGT:
+            return InstType::CmpLTE;
+        default:
+            return InstType::CmpLT;
+    }
+}
+
+// 1 if the comparison holds for all values of the ranges, 0 if it holds
+// for none, [0, 1] otherwise
+ValueRange compareRanges(InstType type, const ValueRange& a,
+                         const ValueRange& b)
+{
+    switch (type)
+    {
+        case InstType::CmpEq:
+            if (a.isExact() && b.isExact() && a.lo == b.lo)
+            {
+                return ValueRange::exact(1);
+            }
+            return intersect(a, b).isEmpty() ? ValueRange::exact(0)
+                                             : ValueRange{0, 1};
+        case InstType::CmpNE:
+        {
+            auto equal = compareRanges(InstType::CmpEq, a, b);
+            return equal.isExact() ? ValueRange::exact(1 - equal.lo) : equal;
+        }
+        case InstType::CmpLT:
+            if (a.hi < b.lo)
+            {
+                return ValueRange::exact(1);
+            }
+            return a.lo >= b.hi ? ValueRange::exact(0) : ValueRange{0, 1};
+        case InstType::CmpLTE:
+            if (a.hi <= b.lo)
+            {
+                return ValueRange::exact(1);
+            }
+            return a.lo > b.hi ? ValueRange::exact(0) : ValueRange{0, 1};
+        case InstType::CmpGT:
+            return compareRanges(InstType::CmpLT, b, a);
+        default:
+            return compareRanges(InstType::CmpLTE, b, a);
+    }
+}
+
+// Divisors are known not to be 0, so a divisor ranging from 0 up starts
+// at 1 instead
+ValueRange divideRanges(const ValueRange& a, ValueRange b)
+{
+    if (b.lo == 0)
+    {
+        b.lo = 1;
+    }
+    if (b.hi == 0)
+    {
+        b.hi = -1;
+    }
+    if (b.isEmpty())
+    {
+        return b;
+    }
+    if (b.lo < 0 && b.hi > 0)
+    {
+        return ValueRange::full();
+    }
+    return fromCorners(a, b,
+                       [](long long x, long long y, long long& result)
+                       {
+                           if (x == Min && y == -1)
+                           {
+                               return true;
+                           }
+                           result = x / y;
+                           return false;
+                       });
+}
+
+}  // namespace
+
+ValueRangeAnalysis::ValueRangeAnalysis(SSA& ssa)
+    : m_domTree{ssa.getDominatorTree()}, m_blocks{getRPONodes(ssa.getCFG())}
+{
+    for (auto& block : m_blocks)
+    {
+        for (auto& inst : block->getInstructions())
+        {
+            auto name = getDefinedName(inst);
+            if (name.empty())
+            {
+                continue;
+            }
+            m_defs[name] = inst;
+            m_defBlocks[name] = block;
+            m_ranges[name] = ValueRange();
+        }
+    }
+
+    // Loops usually stop at a constant or right next to it
+    m_thresholds = {Min, -Max32 - 1, Max32, Max};
+    for (auto& block : m_blocks)
+    {
+        for (auto& inst : block->getInstructions())
+        {
+            for (auto& operand : inst->getOperands())
+            {
+                auto target = operand->getTarget();
+                if (target->getInstType() != InstType::IntConst)
+                {
+                    continue;
+                }
+                long long value =
+                    std::dynamic_pointer_cast<IntConstInst>(target)->getVal();
+                m_thresholds.insert(m_thresholds.end(),
+                                    {value - 1, value, value + 1});
+            }
+        }
+    }
+    std::sort(m_thresholds.begin(), m_thresholds.end());
+
+    auto loops = ssa.getLoopForest()->getLoopsInnermostFirst();
+    for (auto& loop : loops)
+    {
+        InductionVariables ivs(*loop);
+        for (auto& iv : ivs.getBasicIVs())
+        {
+            if (iv.step != 0 && iv.step >= -MaxInductionStep &&
+                iv.step <= MaxInductionStep)
+            {
+                m_inductionVariables[iv.name] = {iv.init, loop->getPreheader(),
+                                                 iv.step};
+            }
+        }
+    }
+
+    // Grow the ranges to a fixpoint, then narrow the widened ones down
+    unsigned int sweeps = 0;
+    while (sweep(false))
+    {
+        if (++sweeps == MaxSweeps)
+        {
+            for (auto& [name, range] : m_ranges)
+            {
+                range = ValueRange::full();
+            }
+            return;
+        }
+    }
+    for (unsigned int i = 0; i < NarrowingSweeps; ++i)
+    {
+        sweep(true);
+    }
+}
+
+ValueRange ValueRangeAnalysis::getBaseRange(
+    const std::shared_ptr<Inst>& operand) const
+{
+    auto target = operand->getTarget();
+    if (target->getInstType() == InstType::IntConst)
+    {
+        return ValueRange::exact(
+            std::dynamic_pointer_cast<IntConstInst>(target)->getVal());
+    }
+    if (target->getInstType() == InstType::BoolConst)
+    {
+        return ValueRange::exact(
+            std::dynamic_pointer_cast<BoolConstInst>(target)->getVal());
+    }
+
+    // Parameters and values defined outside of the function can be anything
+    auto it = m_ranges.find(getValueName(operand));
+    return it == m_ranges.end() ? ValueRange::full() : it->second;
+}
+
+void ValueRangeAnalysis::refine(ValueRange& range, const std::string& name,
+                                const std::shared_ptr<Inst>& cond, bool isTrue,
+                                unsigned int depth) const
+{
+    auto condName = getValueName(cond);
+    if (condName.empty())
+    {
+        return;
+    }
+    if (condName == name)
+    {
+        range = intersect(range, ValueRange::exact(isTrue));
+        return;
+    }
+
+    auto it = m_defs.find(condName);
+    if (it == m_defs.end() || depth == MaxConditionDepth)
+    {
+        return;
+    }
+    auto& def = it->second;
+    auto type = def->getInstType();
+    auto& operands = def->getOperands();
+
+    // Both sides of a true and, or of a false or, hold as well
+    if (type == InstType::Not)
+    {
+        refine(range, name, operands[0], !isTrue, depth + 1);
+        return;
+    }
+    if ((type == InstType::And && isTrue) || (type == InstType::Or && !isTrue))
+    {
+        refine(range, name, operands[0], isTrue, depth + 1);
+        refine(range, name, operands[1], isTrue, depth + 1);
+        return;
+    }
+    if (!isComparison(type))
+    {
+        return;
+    }
+
+    std::shared_ptr<Inst> other;
+    if (getValueName(operands[0]) == name)
+    {
+        other = operands[1];
+    }
+    else if (getValueName(operands[1]) == name)
+    {
+        other = operands[0];
+        type = swapComparison(type);
+    }
+    else
+    {
+        return;
+    }
+    if (!isTrue)
+    {
+        type = negateComparison(type);
+    }
+
+    auto bound = getBaseRange(other);
+    if (bound.isEmpty())
+    {
+        return;
+    }
+    switch (type)
+    {
+        case InstType::CmpEq:
+            range = intersect(range, bound);
+            break;
+        case InstType::CmpNE:
+            if (bound.isExact() && range.lo == bound.lo)
+            {
+                range.lo = bound.lo == Max ? range.lo : range.lo + 1;
+            }
+            if (bound.isExact() && range.hi == bound.hi && !range.isEmpty())
+            {
+                range.hi = bound.hi == Min ? range.hi : range.hi - 1;
+            }
+            break;
+        case InstType::CmpLT:
+            range.hi = bound.hi == Min ? Min : std::min(range.hi, bound.hi - 1);
+            range.lo = bound.hi == Min ? Max : range.lo;
+            break;
+        case InstType::CmpLTE:
+            range.hi = std::min(range.hi, bound.hi);
+            break;
+        case InstType::CmpGT:
+            range.lo = bound.lo == Max ? Max : std::max(range.lo, bound.lo + 1);
+            range.hi = bound.lo == Max ? Min : range.hi;
+            break;
+        default:
+            range.lo = std::max(range.lo, bound.lo);
+            break;
+    }
+}
+
+void ValueRangeAnalysis::refineOnEdge(ValueRange& range,
+                                      const std::string& name,
+                                      const std::shared_ptr<BasicBlock>& from,
+                                      const std::shared_ptr<BasicBlock>& to) const
+{
+    auto terminator = from->getTerminator();
+    if (!terminator || terminator->getInstType() == InstType::Jump)
+    {
+        return;
+    }
+
+    std::shared_ptr<BasicBlock> success, failed;
+    bool isBRT = terminator->getInstType() == InstType::BRT;
+    if (isBRT)
+    {
+        auto brt = std::dynamic_pointer_cast<BRTInst>(terminator);
+        success = brt->getTargetSuccess();
+        failed = brt->getTargetFailed();
+    }
+    else if (terminator->getInstType() == InstType::BRF)
+    {
+        auto brf = std::dynamic_pointer_cast<BRFInst>(terminator);
+        success = brf->getTargetSuccess();
+        failed = brf->getTargetFailed();
+    }
+    if (success == failed || (to != success && to != failed))
+    {
+        return;
+    }
+    refine(range, name, terminator->getOperands()[0], isBRT == (to == success),
+           0);
+}
+
+ValueRange ValueRangeAnalysis::getRefinedRange(
+    const std::shared_ptr<Inst>& operand,
+    const std::shared_ptr<BasicBlock>& block) const
+{
+    auto range = getBaseRange(operand);
+    auto name = getValueName(operand);
+    if (name.empty() || range.isEmpty() || !m_domTree->contains(block))
+    {
+        return range;
+    }
+
+    // No condition above the definition can mention the value
+    auto it = m_defBlocks.find(name);
+    auto defBlock = it == m_defBlocks.end() ? nullptr : it->second;
+    for (auto current = block; current && current != defBlock;
+         current = m_domTree->getIDom(current))
+    {
+        if (current->getNumPredecessors() == 1)
+        {
+            refineOnEdge(range, name, current->getPredecessors()[0], current);
+        }
+    }
+    return range;
+}
+
+// Wherever both are available, two induction variables of a loop hold the
+// values of the same iteration k, init + k * step. The largest k another
+// one allows in the block bounds how far this one got from its init.
+ValueRange ValueRangeAnalysis::getLockstepRange(
+    const std::string& name, const std::shared_ptr<BasicBlock>& block) const
+{
+    auto result = ValueRange::full();
+    auto& iv = m_inductionVariables.at(name);
+    auto header = m_defBlocks.at(name);
+    auto init = getRange(iv.init, iv.preheader);
+    if (init.isEmpty())
+    {
+        return result;
+    }
+
+    for (auto& [otherName, other] : m_inductionVariables)
+    {
+        if (otherName == name || m_defBlocks.at(otherName) != header)
+        {
+            continue;
+        }
+        auto otherInit = getRange(other.init, other.preheader);
+        auto range = getRefinedRange(m_defs.at(otherName), block);
+        if (otherInit.isEmpty() || range.isEmpty())
+        {
+            continue;
+        }
+
+        long long distance = 0;
+        bool overflows = other.step > 0
+                             ? subOverflows(range.hi, otherInit.lo, distance)
+                             : subOverflows(otherInit.hi, range.lo, distance);
+        if (overflows || distance < 0)
+        {
+            continue;
+        }
+        long long iterations = distance / std::abs(other.step);
+
+        long long travel = 0, end = 0;
+        if (mulOverflows(iterations, iv.step, travel))
+        {
+            continue;
+        }
+        if (iv.step > 0 && !addOverflows(init.hi, travel, end))
+        {
+            result = intersect(result, {init.lo, end});
+        }
+        else if (iv.step < 0 && !addOverflows(init.lo, travel, end))
+        {
+            result = intersect(result, {end, init.hi});
+        }
+    }
+    return result;
+}
+
+ValueRange ValueRangeAnalysis::getRange(
+    const std::shared_ptr<Inst>& operand,
+    const std::shared_ptr<BasicBlock>& block) const
+{
+    auto range = getRefinedRange(operand, block);
+    auto name = getValueName(operand);
+    if (range.isEmpty() || m_inductionVariables.count(name) == 0 ||
+        !m_domTree->contains(block))
+    {
+        return range;
+    }
+    return intersect(range, getLockstepRange(name, block));
+}
+
+ValueRange ValueRangeAnalysis::evaluatePhi(
+    const std::shared_ptr<Inst>& inst,
+    const std::shared_ptr<BasicBlock>& block) const
+{
+    auto phi = std::dynamic_pointer_cast<PhiInst>(inst);
+    auto& operands = phi->getOperands();
+    ValueRange result;
+    for (unsigned int i = 0; i < operands.size(); ++i)
+    {
+        auto pred = phi->getOperandBB(i);
+        if (!m_domTree->contains(pred))
+        {
+            continue;
+        }
+        auto range = getRange(operands[i], pred);
+        auto name = getValueName(operands[i]);
+        if (!name.empty())
+        {
+            refineOnEdge(range, name, pred, block);
+        }
+        result = unite(result, range);
+    }
+
+    // An induction variable never crosses back over its initial value
+    auto it = m_inductionVariables.find(getDefinedName(phi));
+    if (it != m_inductionVariables.end() && !result.isEmpty())
+    {
+        auto& iv = it->second;
+        auto init = getRange(iv.init, iv.preheader);
+        if (iv.step > 0 && !init.isEmpty())
+        {
+            result.lo = std::max(result.lo, init.lo);
+        }
+        else if (iv.step < 0 && !init.isEmpty())
+        {
+            result.hi = std::min(result.hi, init.hi);
+        }
+    }
+    return result;
+}
+
+ValueRange ValueRangeAnalysis::evaluate(
+    const std::shared_ptr<Inst>& inst,
+    const std::shared_ptr<BasicBlock>& block) const
+{
+    auto type = inst->getInstType();
+    if (type == InstType::Phi)
+    {
+        return evaluatePhi(inst, block);
+    }
+
+    auto& operands = inst->getOperands();
+    std::vector<ValueRange> ranges;
+    for (auto& operand : operands)
+    {
+        ranges.push_back(getRange(operand, block));
+    }
+
+    // Values not known yet, or computed where control never gets
+    bool isNumeric = type == InstType::Add || type == InstType::Sub ||
+                     type == InstType::Mul || type == InstType::Div ||
+                     type == InstType::Assign ||
+                     type == InstType::Select || isBoolean(type);
+    if (isNumeric && std::any_of(ranges.begin(), ranges.end(),
+                                 [](const ValueRange& range)
+                                 { return range.isEmpty(); }))
+    {
+        return ValueRange();
+    }
+
+    switch (type)
+    {
+        case InstType::Assign:
+            return ranges[0];
+        case InstType::Select:
+            if (ranges[0].isExact())
+            {
+                return ranges[0].lo != 0 ? ranges[1] : ranges[2];
+            }
+            return unite(ranges[1], ranges[2]);
+        case InstType::Add:
+            return fromCorners(ranges[0], ranges[1], addOverflows);
+        case InstType::Sub:
+            return fromCorners(ranges[0], ranges[1], subOverflows);
+        case InstType::Mul:
+            return fromCorners(ranges[0], ranges[1], mulOverflows);
+        case InstType::Div:
+            return divideRanges(ranges[0], ranges[1]);
+        case InstType::Not:
+            return ranges[0].isExact() ? ValueRange::exact(ranges[0].lo == 0)
+                                       : ValueRange{0, 1};
+        case InstType::And:
+            if (ranges[0] == ValueRange::exact(0) ||
+                ranges[1] == ValueRange::exact(0))
+            {
+                return ValueRange::exact(0);
+            }
+            return ranges[0].isExact() && ranges[1].isExact()
+                       ? ValueRange::exact(1)
+                       : ValueRange{0, 1};
+        case InstType::Or:
+            if (ranges[0] == ValueRange::exact(1) ||
+                ranges[1] == ValueRange::exact(1))
+            {
+                return ValueRange::exact(1);
+            }
+            return ranges[0].isExact() && ranges[1].isExact()
+                       ? ValueRange::exact(0)
+                       : ValueRange{0, 1};
+        default:
+            if (isComparison(type))
+            {
+                return compareRanges(type, ranges[0], ranges[1]);
+            }
+
+            // Loads, input, calls and the like
+            return ValueRange::full();
+    }
+}
+
+// Moves the bounds that grew out to the next threshold
+ValueRange ValueRangeAnalysis::widen(const ValueRange& old,
+                                     const ValueRange& range) const
+{
+    auto result = range;
+    if (range.lo < old.lo)
+    {
+        result.lo = *(std::upper_bound(m_thresholds.begin(), m_thresholds.end(),
+                                       range.lo) -
+                      1);
+    }
+    if (range.hi > old.hi)
+    {
+        result.hi = *std::lower_bound(m_thresholds.begin(), m_thresholds.end(),
+                                      range.hi);
+    }
+    return result;
+}
+
+// Recomputes every range once. While growing, phis that keep growing are
+// widened; while narrowing, the new ranges only ever shrink the old ones.
+// Returns whether any range changed.
+bool ValueRangeAnalysis::sweep(bool isNarrowing)
+{
+    bool changed = false;
+    for (auto& block : m_blocks)
+    {
+        for (auto& inst : block->getInstructions())
+        {
+            auto name = getDefinedName(inst);
+            if (name.empty())
+            {
+                continue;
+            }
+
+            auto& old = m_ranges[name];
+            auto range = evaluate(inst, block);
+            if (isNarrowing)
+            {
+                range = old.isEmpty() ? old : intersect(old, range);
+            }
+            else
+            {
+                range = unite(old, range);
+                if (inst->isPhi() && range != old &&
+                    ++m_phiUpdates[name] > WideningDelay && !old.isEmpty())
+                {
+                    range = widen(old, range);
+                }
+            }
+            if (range != old)
+            {
+                old = range;
+                changed = true;
+            }
+        }
+    }
+    return changed;
+}
+
+namespace
+{
+
+class RangeSimplifier
+{
+public:
+    RangeSimplifier(SSA& ssa);
+
+    bool run();
+
+private:
+    SSA& m_ssa;
+    ValueRangeAnalysis m_ranges;
+    std::vector<std::shared_ptr<BasicBlock>> m_blocks;
+
+    bool foldConditions();
+    bool foldBranches();
+    bool selectDivisions();
+};
+
+RangeSimplifier::RangeSimplifier(SSA& ssa)
+    : m_ssa{ssa}, m_ranges{ssa}, m_blocks{getRPONodes(ssa.getCFG())}
+{
+}
+
+// Replaces the uses of comparisons and boolean operations whose outcome is
+// known by constants
+bool RangeSimplifier::foldConditions()
+{
+    std::unordered_map<std::string, long long> values;
+    for (auto& block : m_blocks)
+    {
+        for (auto& inst : block->getInstructions())
+        {
+            if (!isBoolean(inst->getInstType()))
+            {
+                continue;
+            }
+            auto range = m_ranges.getRange(inst->getTarget(), block);
+            if (range.isExact())
+            {
+                values[getDefinedName(inst)] = range.lo;
+            }
+        }
+    }
+    if (values.empty())
+    {
+        return false;
+    }
+
+    for (auto& block : m_blocks)
+    {
+        auto& instructions = block->getInstructions();
+        instructions.erase(
+            std::remove_if(instructions.begin(), instructions.end(),
+                           [&](const std::shared_ptr<Inst>& inst)
+                           { return values.count(getDefinedName(inst)) != 0; }),
+            instructions.end());
+
+        for (auto& inst : instructions)
+        {
+            // Boolean variables are printed as numbers
+            bool isPut = inst->getInstType() == InstType::Put;
+            for (auto& operand : inst->getOperands())
+            {
+                auto it = values.find(getValueName(operand));
+                if (it == values.end())
+                {
+                    continue;
+                }
+                if (isPut)
+                {
+                    operand = std::make_shared<IntConstInst>(
+                        static_cast<int>(it->second), block);
+                }
+                else
+                {
+                    operand = std::make_shared<BoolConstInst>(it->second != 0,
+                                                              block);
+                }
+            }
+        }
+    }
+    return true;
+}
+
+// Branches whose condition is known in their block only take one edge
+bool RangeSimplifier::foldBranches()
+{
+    bool changed = false;
+    for (auto& block : m_blocks)
+    {
+        auto terminator = block->getTerminator();
+        if (!terminator || terminator->getInstType() == InstType::Jump ||
+            (terminator->getInstType() != InstType::BRT &&
+             terminator->getInstType() != InstType::BRF))
+        {
+            continue;
+        }
+
+        auto range = m_ranges.getRange(terminator->getOperands()[0], block);
+        if (!range.isExact())
+        {
+            continue;
+        }
+
+        bool isBRT = terminator->getInstType() == InstType::BRT;
+        std::shared_ptr<BasicBlock> success, failed;
+        if (isBRT)
+        {
+            auto brt = std::dynamic_pointer_cast<BRTInst>(terminator);
+            success = brt->getTargetSuccess();
+            failed = brt->getTargetFailed();
+        }
+        else
+        {
+            auto brf = std::dynamic_pointer_cast<BRFInst>(terminator);
+            success = brf->getTargetSuccess();
+            failed = brf->getTargetFailed();
+        }
+        replaceBranchWithJump(block,
+                              (range.lo != 0) == isBRT ? success : failed);
+        changed = true;
+    }
+    if (changed)
+    {
+        detachUnreachableBlocks(m_ssa, m_blocks);
+    }
+    return changed;
+}
+
+// Marks the divisions whose operands don't need sign extension
+bool RangeSimplifier::selectDivisions()
+{
+    bool changed = false;
+    for (auto& block : m_blocks)
+    {
+        for (auto& inst : block->getInstructions())
+        {
+            if (inst->getInstType() != InstType::Div)
+            {
+                continue;
+            }
+
+            auto div = std::dynamic_pointer_cast<DivInst>(inst);
+            auto dividend = m_ranges.getRange(div->getOperands()[0], block);
+            auto divisor = m_ranges.getRange(div->getOperands()[1], block);
+            auto kind = DivKind::Signed;
+            if (!dividend.isEmpty() && !divisor.isEmpty() && dividend.lo >= 0 &&
+                divisor.lo >= 1)
+            {
+                kind = dividend.hi <= Max32 && divisor.hi <= Max32
+                           ? DivKind::Unsigned32
+                           : DivKind::Unsigned;
+            }
+            if (div->getKind() != kind)
+            {
+                div->setKind(kind);
+                changed = true;
+            }
+        }
+    }
+    return changed;
+}
+
+bool RangeSimplifier::run()
+{
+    // The ranges hold for the function as it is, so divisions are looked at
+    // before any branch is folded
+    bool changed = selectDivisions();
+    changed |= foldBranches();
+    changed |= foldConditions();
+    return changed;
+}
+
+}  // namespace
+
+std::string ValueRangePass::getName() const { return "vrp"; }
+
+bool ValueRangePass::run(SSA& ssa)
+{
+    RangeSimplifier simplifier(ssa);
+    return simplifier.run();
+}
+
+}  // namespace mina
@@ -6,8 +6,14 @@
 
 #include "Token.hpp"
 #include "Parser.hpp"
+#include "PassManager.hpp"
 
 //#include "tests/test_lexer.hpp"
+//#include "tests/test_dominators.hpp"
+//#include "tests/test_ssa.hpp"
+//#include "tests/test_passes.hpp"
+//#include "tests/test_codegen.hpp"
+//#include "tests/test_pass_manager.hpp"
 
 using namespace mina;
 
@@ -65,9 +71,66 @@ int main(int argc, char* argv[])
 {
     //tests_token();
     //tests_lexer();
+    //tests_dominators();
+    //tests_loop_forest();
+    //tests_ssa_construction();
+    //tests_sccp();
+    //tests_gvn();
+    //tests_adce();
+    //tests_licm();
+    //tests_strength_reduction();
+    //tests_loop_unroll();
+    //tests_loop_simplify();
+    //tests_tail_recursion();
+    //tests_inliner();
+    //tests_call_graph();
+    //tests_ipcp();
+    //tests_call_folding();
+    //tests_program_evaluation();
+    //tests_out_of_ssa();
+    //tests_disjoint_set_union();
+    //tests_memoize();
+    //tests_spilled_multiply();
+    //tests_dead_functions();
+    //tests_pre();
+    //tests_array_forwarding();
+    //tests_scalar_replacement();
+    //tests_value_range();
+    //tests_bounds_check();
+    //tests_if_conversion();
+    //tests_compiler_options();
+    //tests_verifier();
+    //tests_timing_report();
 
     //runAllSamples();
 
-    runFile("E:\\SourceCodes\\mina\\mina\\samples\\tes1.txt");
+    // mina [-O0|-O1|-O2] [-f<pass>|-fno-<pass>] [-time-passes]
+    //      [-print-after-all] [-verify-each] [file]
+    const char* fileName = nullptr;
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        if (arg.size() > 1 && arg[0] == '-')
+        {
+            if (!parseCompilerOption(arg))
+            {
+                std::cerr << "Unknown option: " << arg << std::endl;
+                return 1;
+            }
+        }
+        else
+        {
+            fileName = argv[i];
+        }
+    }
+
+    if (fileName)
+    {
+        runFile(fileName);
+    }
+    else
+    {
+        runFile("E:\\SourceCodes\\mina\\mina\\samples\\tes1.txt");
+    }
     return 0;
 }
@@ -0,0 +1,10 @@
+#pragma once
+
+namespace mina
+{
+
+void tests_memoize();
+void tests_spilled_multiply();
+void tests_dead_functions();
+
+}  // namespace mina
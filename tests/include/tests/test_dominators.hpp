@@ -0,0 +1,9 @@
+#pragma once
+
+namespace mina
+{
+
+void tests_dominators();
+void tests_loop_forest();
+
+}  // namespace mina
@@ -0,0 +1,10 @@
+#pragma once
+
+namespace mina
+{
+
+void tests_compiler_options();
+void tests_verifier();
+void tests_timing_report();
+
+}  // namespace mina
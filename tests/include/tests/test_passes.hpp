@@ -0,0 +1,28 @@
+#pragma once
+
+namespace mina
+{
+
+void tests_sccp();
+void tests_gvn();
+void tests_adce();
+void tests_licm();
+void tests_strength_reduction();
+void tests_loop_unroll();
+void tests_loop_simplify();
+void tests_tail_recursion();
+void tests_inliner();
+void tests_call_graph();
+void tests_ipcp();
+void tests_call_folding();
+void tests_program_evaluation();
+void tests_out_of_ssa();
+void tests_disjoint_set_union();
+void tests_pre();
+void tests_array_forwarding();
+void tests_scalar_replacement();
+void tests_value_range();
+void tests_bounds_check();
+void tests_if_conversion();
+
+}  // namespace mina
@@ -0,0 +1,8 @@
+#pragma once
+
+namespace mina
+{
+
+void tests_ssa_construction();
+
+}  // namespace mina
@@ -0,0 +1,164 @@
+#include "tests/test_codegen.hpp"
+#include "Parser.hpp"
+#include "PassManager.hpp"
+
+#include <map>
+#include <string>
+#include <sstream>
+#include <cassert>
+#include <utility>
+#include <iostream>
+
+namespace mina
+{
+
+// Compiles the program at O2 with the given -f/-fno- overrides and returns
+// the generated assembly
+static std::string compileWith(std::string source,
+                               const std::map<std::string, bool>& overrides)
+{
+    auto& options = getCompilerOptions();
+    auto savedOptions = options;
+    options.optLevel = 2;
+    options.passOverrides = overrides;
+
+    std::stringstream output;
+    auto coutBuffer = std::cout.rdbuf(output.rdbuf());
+    try
+    {
+        Parser parser(std::move(source));
+        parser.program();
+    }
+    catch (...)
+    {
+        std::cout.rdbuf(coutBuffer);
+        options = savedOptions;
+        throw;
+    }
+    std::cout.rdbuf(coutBuffer);
+    options = savedOptions;
+    return output.str();
+}
+
+static bool contains(const std::string& text, const std::string& part)
+{
+    return text.find(part) != std::string::npos;
+}
+
+void tests_memoize()
+{
+    // Call folding would evaluate the calls at compile time, and without
+    // IPRA callers don't depend on the registers the wrapper clobbers
+    std::string program = R"({
+  var n : integer
+  integer func fib(n: integer) {
+    ;
+    if n < 2 then
+      return n
+    end if
+    return fib(n - 1) + fib(n - 2)
+  }
+  integer func twice(n: integer) {
+    ;
+    return n + n
+  }
+  ;
+  get(n)
+  put(fib(n), skip)
+  put(twice(n), skip)
+})";
+    std::map<std::string, bool> overrides = {{"call-folding", false},
+                                             {"inline", false},
+                                             {"ipra", false}};
+    auto plain = compileWith(program, overrides);
+    overrides["memoize"] = true;
+    auto memoized = compileWith(program, overrides);
+
+    // Memoization is opt-in, even at O2
+    assert(!contains(plain, "_memo"));
+    assert(!contains(plain, ".section .bss"));
+
+    // fib gets a wrapper in front of its body and a zeroed table, twice
+    // isn't recursive and is left alone
+    assert(contains(memoized, "\nfib: \n"));
+    assert(contains(memoized, "\nfib_memo_miss: \n"));
+    assert(contains(memoized, "\nfib_memo_body: \n"));
+    assert(contains(memoized, "lea r10, QWORD PTR [rip + fib_memo]\n"));
+    assert(contains(memoized, ".section .bss\n"));
+    assert(contains(memoized, "fib_memo: .zero 65536\n"));
+    assert(!contains(memoized, "twice_memo"));
+
+    // Dropping the wrapper and the table and naming the body fib again
+    // gives back the unmemoized program
+    auto wrapperBegin = memoized.find("\nfib: \n") + 1;
+    auto bodyBegin = memoized.find("fib_memo_body: \n");
+    auto tableBegin = memoized.find(".section .bss\n");
+    auto tableEnd = memoized.find("\n", memoized.find("fib_memo: ")) + 1;
+    std::string stripped = memoized.substr(0, wrapperBegin) + "fib: \n" +
+                           memoized.substr(bodyBegin + 16,
+                                           tableBegin - bodyBegin - 16) +
+                           memoized.substr(tableEnd);
+    assert(stripped == plain);
+}
+
+void tests_spilled_multiply()
+{
+    // Sixteen inputs and their products stay live until they are printed,
+    // more values than there are registers, so some products are spilled
+    std::string declarations, inputs, products, outputs;
+    for (int i = 0; i < 16; ++i)
+    {
+        auto x = "x" + std::to_string(i);
+        auto p = "p" + std::to_string(i);
+        declarations += "  var " + x + " : integer\n";
+        declarations += "  var " + p + " : integer\n";
+        inputs += "  get(" + x + ")\n";
+        products += "  " + p + " := " + x + " * x" +
+                    std::to_string((i + 1) % 16) + "\n";
+        outputs += "  put(" + x + ", skip)\n  put(" + p + ", skip)\n";
+    }
+    auto assembly = compileWith("{\n" + declarations + "  ;\n" + inputs +
+                                    products + outputs + "}",
+                                {});
+
+    // imul can't write to memory, a spilled product goes through r11
+    assert(!contains(assembly, "imul QWORD PTR"));
+    assert(contains(assembly, "imul r11, "));
+}
+
+void tests_dead_functions()
+{
+    // unused is never called, and helper only from unused
+    std::string program = R"({
+  var n : integer
+  integer func helper(n: integer) {
+    ;
+    return n + 1
+  }
+  integer func unused(n: integer) {
+    ;
+    return helper(n) * 2
+  }
+  integer func used(n: integer) {
+    ;
+    return n - 1
+  }
+  ;
+  get(n)
+  put(used(n), skip)
+})";
+    std::map<std::string, bool> overrides = {{"inline", false}};
+    auto removed = compileWith(program, overrides);
+    overrides["dead-functions"] = false;
+    auto kept = compileWith(program, overrides);
+
+    // Only the routines main reaches are emitted
+    assert(contains(removed, "\nused: \n"));
+    assert(!contains(removed, "\nunused: \n"));
+    assert(!contains(removed, "\nhelper: \n"));
+    assert(contains(kept, "\nused: \n"));
+    assert(contains(kept, "\nunused: \n"));
+    assert(contains(kept, "\nhelper: \n"));
+}
+
+}  // namespace mina
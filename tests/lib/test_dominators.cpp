@@ -0,0 +1,212 @@
+#include "tests/test_dominators.hpp"
+#include "BasicBlock.hpp"
+#include "Dominators.hpp"
+#include "LoopInfo.hpp"
+#include "InstIR.hpp"
+#include "SSA.hpp"
+
+#include <memory>
+#include <string>
+#include <cassert>
+#include <algorithm>
+
+namespace mina
+{
+
+static std::shared_ptr<BasicBlock> makeBlock(const std::string& name)
+{
+    return std::make_shared<BasicBlock>(name);
+}
+
+static void addEdge(const std::shared_ptr<BasicBlock>& from,
+                    const std::shared_ptr<BasicBlock>& to)
+{
+    from->pushSuccessor(to);
+    to->pushPredecessor(from);
+}
+
+static bool frontierContains(const DominatorTree& tree,
+                             const std::shared_ptr<BasicBlock>& block,
+                             const std::shared_ptr<BasicBlock>& member)
+{
+    auto& frontier = tree.getDominanceFrontier(block);
+    return std::find(frontier.begin(), frontier.end(), member) !=
+           frontier.end();
+}
+
+void tests_dominators()
+{
+    // entry -> header -> (then | else) -> merge -> header | exit
+    auto entry = makeBlock("entry");
+    auto header = makeBlock("header");
+    auto thenBB = makeBlock("then");
+    auto elseBB = makeBlock("else");
+    auto merge = makeBlock("merge");
+    auto exit = makeBlock("exit");
+    auto dead = makeBlock("dead");
+
+    addEdge(entry, header);
+    addEdge(header, thenBB);
+    addEdge(header, elseBB);
+    addEdge(thenBB, merge);
+    addEdge(elseBB, merge);
+    addEdge(merge, header);
+    addEdge(merge, exit);
+    addEdge(dead, exit);
+
+    DominatorTree domTree(entry);
+    assert(domTree.getBlocks().size() == 6);
+    assert(!domTree.contains(dead));
+    assert(domTree.getIDom(entry) == nullptr);
+    assert(domTree.getIDom(header) == entry);
+    assert(domTree.getIDom(thenBB) == header);
+    assert(domTree.getIDom(elseBB) == header);
+    assert(domTree.getIDom(merge) == header);
+    assert(domTree.getIDom(exit) == merge);
+    assert(domTree.getLevel(entry) == 0);
+    assert(domTree.getLevel(exit) == 3);
+
+    assert(domTree.dominates(entry, exit));
+    assert(domTree.dominates(header, header));
+    assert(!domTree.strictlyDominates(header, header));
+    assert(!domTree.dominates(thenBB, merge));
+    assert(!domTree.dominates(merge, thenBB));
+    assert(!domTree.dominates(dead, exit));
+    assert(domTree.findNearestCommonDominator(thenBB, elseBB) == header);
+    assert(domTree.findNearestCommonDominator(exit, thenBB) == header);
+
+    assert(frontierContains(domTree, thenBB, merge));
+    assert(frontierContains(domTree, elseBB, merge));
+    assert(frontierContains(domTree, merge, header));
+    assert(frontierContains(domTree, header, header));
+    assert(domTree.getDominanceFrontier(entry).empty());
+    assert(domTree.getDominanceFrontier(exit).empty());
+
+    auto preOrder = domTree.getPreOrder();
+    assert(preOrder.size() == 6 && preOrder.front() == entry);
+
+    DominatorTree postDomTree(entry, true);
+    assert(postDomTree.isPostDominator());
+    assert(postDomTree.getIDom(exit) == nullptr);
+    assert(postDomTree.getIDom(merge) == exit);
+    assert(postDomTree.getIDom(thenBB) == merge);
+    assert(postDomTree.getIDom(header) == merge);
+    assert(postDomTree.getIDom(entry) == header);
+    assert(postDomTree.dominates(merge, header));
+    assert(!postDomTree.dominates(thenBB, header));
+
+    // then and else are control dependent on the branch in header
+    assert(frontierContains(postDomTree, thenBB, header));
+    assert(frontierContains(postDomTree, elseBB, header));
+    assert(frontierContains(postDomTree, header, merge));
+
+    // An infinite loop never reaches the exit but still gets post-dominators
+    auto loopEntry = makeBlock("loopEntry");
+    auto body = makeBlock("body");
+    auto latch = makeBlock("latch");
+    addEdge(loopEntry, body);
+    addEdge(body, latch);
+    addEdge(latch, body);
+
+    DominatorTree loopPostDom(loopEntry, true);
+    assert(loopPostDom.getBlocks().size() == 3);
+    assert(loopPostDom.getRoots().size() == 1);
+    assert(loopPostDom.getRoots()[0] == latch);
+    assert(loopPostDom.getIDom(body) == latch);
+    assert(loopPostDom.getIDom(loopEntry) == body);
+}
+
+void tests_loop_forest()
+{
+    // entry -> outer -> inner <-> innerLatch -> outerLatch -> outer | exit
+    auto entry = makeBlock("entry");
+    auto outer = makeBlock("outer");
+    auto inner = makeBlock("inner");
+    auto innerLatch = makeBlock("innerLatch");
+    auto outerLatch = makeBlock("outerLatch");
+    auto exit = makeBlock("exit");
+
+    addEdge(entry, outer);
+    addEdge(outer, inner);
+    addEdge(inner, innerLatch);
+    addEdge(innerLatch, inner);
+    addEdge(innerLatch, outerLatch);
+    addEdge(outerLatch, outer);
+    addEdge(outerLatch, exit);
+
+    DominatorTree domTree(entry);
+    LoopForest loops(domTree);
+    assert(loops.getTopLevelLoops().size() == 1);
+    assert(loops.getLoopsInnermostFirst().size() == 2);
+
+    auto outerLoop = loops.getTopLevelLoops()[0];
+    assert(outerLoop->getHeader() == outer);
+    assert(outerLoop->getBlocks().size() == 4);
+    assert(outerLoop->getBlocks().front() == outer);
+    assert(outerLoop->getLatches().size() == 1);
+    assert(outerLoop->getLatches()[0] == outerLatch);
+    assert(outerLoop->getExitBlocks().size() == 1);
+    assert(outerLoop->getExitBlocks()[0] == exit);
+    assert(outerLoop->getExitingBlocks()[0] == outerLatch);
+    assert(outerLoop->getPreheader() == entry);
+
+    auto innerLoop = loops.getLoopFor(innerLatch);
+    assert(innerLoop->getHeader() == inner);
+    assert(innerLoop->getParentLoop() == outerLoop);
+    assert(outerLoop->getSubLoops().size() == 1);
+    assert(outerLoop->contains(innerLoop));
+    assert(!innerLoop->contains(outerLoop));
+    assert(innerLoop->getExitBlocks()[0] == outerLatch);
+    assert(innerLoop->getPreheader() == outer);
+
+    assert(loops.getLoopDepth(entry) == 0);
+    assert(loops.getLoopDepth(outer) == 1);
+    assert(loops.getLoopDepth(outerLatch) == 1);
+    assert(loops.getLoopDepth(inner) == 2);
+    assert(loops.getLoopDepth(innerLatch) == 2);
+    assert(loops.isLoopHeader(inner) && !loops.isLoopHeader(innerLatch));
+
+    // A header entered from both arms of a branch needs a new preheader, and
+    // its phi gets a single incoming value from it
+    auto start = makeBlock("start");
+    auto left = makeBlock("left");
+    auto right = makeBlock("right");
+    auto header = makeBlock("header");
+    addEdge(start, left);
+    addEdge(start, right);
+    addEdge(left, header);
+    addEdge(right, header);
+    addEdge(header, header);
+    left->pushInst(std::make_shared<JumpInst>(header));
+    right->pushInst(std::make_shared<JumpInst>(header));
+
+    auto phi = std::make_shared<PhiInst>("x.1", header);
+    phi->appendOperand(std::make_shared<IntConstInst>(1, left), left);
+    phi->appendOperand(std::make_shared<IntConstInst>(2, right), right);
+    phi->appendOperand(phi, header);
+    header->pushInst(phi);
+
+    SSA ssa;
+    DominatorTree branchDomTree(start);
+    LoopForest branchLoops(branchDomTree);
+    auto headerLoop = branchLoops.getLoopFor(header);
+    assert(headerLoop && headerLoop->getPreheader() == nullptr);
+
+    auto preheader = insertPreheader(ssa, *headerLoop);
+    assert(preheader->getPredecessors().size() == 2);
+    assert(preheader->getSuccessors()[0] == header);
+    assert(header->getPredecessors().size() == 2);
+    assert(header->getPredecessors()[0] == preheader);
+    assert(left->getSuccessors()[0] == preheader);
+    assert(std::dynamic_pointer_cast<JumpInst>(left->getTerminator())
+               ->getJumpTarget() == preheader);
+    assert(phi->getOperands().size() == 2);
+    assert(phi->getOperandBB(1) == preheader);
+    assert(preheader->getInstructions().front()->isPhi());
+
+    DominatorTree newDomTree(start);
+    LoopForest newLoops(newDomTree);
+    assert(newLoops.getLoopFor(header)->getPreheader() == preheader);
+}
+
+}  // namespace mina
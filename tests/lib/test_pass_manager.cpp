@@ -0,0 +1,213 @@
+#include "tests/test_pass_manager.hpp"
+#include "ADCE.hpp"
+#include "BasicBlock.hpp"
+#include "IRUtils.hpp"
+#include "InstIR.hpp"
+#include "PassManager.hpp"
+#include "SCCP.hpp"
+#include "SSA.hpp"
+
+#include <memory>
+#include <string>
+#include <sstream>
+#include <cassert>
+#include <iostream>
+#include <stdexcept>
+
+namespace mina
+{
+
+static std::shared_ptr<BasicBlock> makeBlock(const std::string& name)
+{
+    return std::make_shared<BasicBlock>(name);
+}
+
+static void addEdge(const std::shared_ptr<BasicBlock>& from,
+                    const std::shared_ptr<BasicBlock>& to)
+{
+    from->pushSuccessor(to);
+    to->pushPredecessor(from);
+}
+
+static std::shared_ptr<Inst> emit(const std::shared_ptr<BasicBlock>& block,
+                                  std::shared_ptr<Inst> inst)
+{
+    inst->setup_def_use();
+    block->pushInst(inst);
+    return inst;
+}
+
+// Returns the message verifyFunction rejects the function with, or an empty
+// string if it accepts it
+static std::string verifyError(const std::shared_ptr<BasicBlock>& entry)
+{
+    SSA ssa;
+    ssa.setCFG(entry);
+    try
+    {
+        verifyFunction(ssa, "f");
+    }
+    catch (const std::runtime_error& error)
+    {
+        return error.what();
+    }
+    return "";
+}
+
+static bool contains(const std::string& text, const std::string& part)
+{
+    return text.find(part) != std::string::npos;
+}
+
+void tests_compiler_options()
+{
+    auto& options = getCompilerOptions();
+    auto savedOptions = options;
+    options = CompilerOptions();
+
+    assert(parseCompilerOption("-O2"));
+    assert(options.optLevel == 2);
+    assert(parseCompilerOption("-O0"));
+    assert(options.optLevel == 0);
+    assert(!parseCompilerOption("-O3"));
+    assert(options.optLevel == 0);
+
+    // Passes of the pipeline and options of CodeGen can both be switched
+    assert(parseCompilerOption("-fno-licm"));
+    assert(parseCompilerOption("-fmemoize"));
+    assert(parseCompilerOption("-fbounds-check"));
+    assert(options.passOverrides.size() == 3);
+    assert(!options.passOverrides.at("licm"));
+    assert(options.passOverrides.at("memoize"));
+    assert(options.passOverrides.at("bounds-check"));
+
+    // A later flag for the same pass wins
+    assert(parseCompilerOption("-flicm"));
+    assert(options.passOverrides.at("licm"));
+
+    // Unknown names are rejected without being recorded
+    assert(!parseCompilerOption("-fno-licn"));
+    assert(!parseCompilerOption("-floop-fusion"));
+    assert(!parseCompilerOption("-f"));
+    assert(!parseCompilerOption("licm"));
+    assert(options.passOverrides.size() == 3);
+
+    assert(parseCompilerOption("-time-passes"));
+    assert(parseCompilerOption("-print-after-all"));
+    assert(parseCompilerOption("-verify-each"));
+    assert(options.timePasses && options.printAfterAll && options.verifyEach);
+
+    options = savedOptions;
+}
+
+void tests_verifier()
+{
+    // entry: get x, branch on x > 0 to left | right, both joining merge
+    // where y = phi(1, 2) is printed
+    auto entry = makeBlock("entry");
+    auto left = makeBlock("left");
+    auto right = makeBlock("right");
+    auto merge = makeBlock("merge");
+    addEdge(entry, left);
+    addEdge(entry, right);
+    addEdge(left, merge);
+    addEdge(right, merge);
+
+    emit(entry, std::make_shared<GetInst>(makeValueRef("x.0", entry), entry));
+    emit(entry, std::make_shared<CmpGTInst>(makeValueRef("c.0", entry),
+                                            makeValueRef("x.0", entry),
+                                            std::make_shared<IntConstInst>(0, entry),
+                                            entry));
+    emit(entry, std::make_shared<BRTInst>(makeValueRef("c.0", entry), left,
+                                          right, entry));
+    emit(left, std::make_shared<JumpInst>(merge));
+    auto rightJump = emit(right, std::make_shared<JumpInst>(merge));
+
+    auto phi = std::make_shared<PhiInst>("y.0", merge);
+    phi->appendOperand(std::make_shared<IntConstInst>(1, merge), left);
+    phi->appendOperand(std::make_shared<IntConstInst>(2, merge), right);
+    emit(merge, phi);
+    auto put = emit(merge, std::make_shared<PutInst>(makeValueRef("y.0", merge),
+                                                     merge));
+    assert(verifyError(entry).empty());
+
+    // right falls off its end although it has a successor
+    auto& rightInsts = right->getInstructions();
+    rightInsts.pop_back();
+    assert(contains(verifyError(entry),
+                    "block right: successor merge is not a branch target"));
+    rightInsts.push_back(rightJump);
+
+    // The phi lacks the value coming from right
+    phi->removeOperand(1);
+    assert(contains(verifyError(entry),
+                    "block merge: phi operands don't match predecessors"));
+    phi->appendOperand(std::make_shared<IntConstInst>(2, merge), right);
+
+    // put reads z.0, which nothing defines
+    put->getOperands()[0] = makeValueRef("z.0", merge);
+    assert(contains(verifyError(entry), "block merge: undefined value z.0"));
+}
+
+void tests_timing_report()
+{
+    // entry: c = 1 < 2, branch on c to then | else, both ending the program
+    auto entry = makeBlock("entry");
+    auto thenBB = makeBlock("then");
+    auto elseBB = makeBlock("else");
+    addEdge(entry, thenBB);
+    addEdge(entry, elseBB);
+
+    emit(entry, std::make_shared<CmpLTInst>(makeValueRef("c.0", entry),
+                                            std::make_shared<IntConstInst>(1, entry),
+                                            std::make_shared<IntConstInst>(2, entry),
+                                            entry));
+    emit(entry, std::make_shared<BRTInst>(makeValueRef("c.0", entry), thenBB,
+                                          elseBB, entry));
+    emit(thenBB, std::make_shared<PutInst>(
+                     std::make_shared<IntConstInst>(1, thenBB), thenBB));
+    emit(elseBB, std::make_shared<PutInst>(
+                     std::make_shared<IntConstInst>(2, elseBB), elseBB));
+
+    CompilerOptions options;
+    options.optLevel = 1;
+    options.timePasses = true;
+    options.passOverrides["adce"] = false;
+    PassManager passManager(options);
+    passManager.addPass(std::make_unique<SCCPPass>(), 1);
+    passManager.addPass(std::make_unique<ADCEPass>(), 1);
+
+    SSA ssa;
+    ssa.setCFG(entry);
+    assert(passManager.run(ssa, "main"));
+    assert(!passManager.run(ssa, "main"));
+
+    std::stringstream report;
+    auto cerrBuffer = std::cerr.rdbuf(report.rdbuf());
+    passManager.printTimingReport();
+    std::cerr.rdbuf(cerrBuffer);
+
+    // SCCP ran twice and changed the function once, dropping the compare,
+    // the branch and the put of else for a jump. ADCE was switched off.
+    auto text = report.str();
+    assert(contains(text, "(-O1)"));
+    assert(!contains(text, "adce"));
+    assert(contains(text, "  Total\n"));
+
+    std::string line;
+    bool hasSCCP = false;
+    while (std::getline(report, line))
+    {
+        std::istringstream fields(line);
+        std::string milliseconds, instDelta, changed, passName;
+        fields >> milliseconds >> instDelta >> changed >> passName;
+        if (passName == "sccp")
+        {
+            hasSCCP = true;
+            assert(instDelta == "-2" && changed == "1/2");
+        }
+    }
+    assert(hasSCCP);
+}
+
+}  // namespace mina
@@ -0,0 +1,1604 @@
+#include "tests/test_passes.hpp"
+#include "ADCE.hpp"
+#include "ArrayForwarding.hpp"
+#include "Ast.hpp"
+#include "BasicBlock.hpp"
+#include "BoundsCheck.hpp"
+#include "CallFolding.hpp"
+#include "CallGraph.hpp"
+#include "DisjointSetUnion.hpp"
+#include "GVN.hpp"
+#include "IREvaluator.hpp"
+#include "IfConversion.hpp"
+#include "Inliner.hpp"
+#include "IPConstantPropagation.hpp"
+#include "IRUtils.hpp"
+#include "InstIR.hpp"
+#include "LICM.hpp"
+#include "LoopRotate.hpp"
+#include "LoopSimplify.hpp"
+#include "LoopUnroll.hpp"
+#include "MachineIR.hpp"
+#include "OutOfSSA.hpp"
+#include "PRE.hpp"
+#include "ProgramEvaluation.hpp"
+#include "SCCP.hpp"
+#include "SSA.hpp"
+#include "ScalarReplacement.hpp"
+#include "StrengthReduction.hpp"
+#include "TailRecursion.hpp"
+#include "ValueRange.hpp"
+
+#include <map>
+#include <set>
+#include <memory>
+#include <string>
+#include <vector>
+#include <cassert>
+#include <algorithm>
+
+namespace mina
+{
+
+static std::shared_ptr<BasicBlock> makeBlock(const std::string& name)
+{
+    return std::make_shared<BasicBlock>(name);
+}
+
+static void addEdge(const std::shared_ptr<BasicBlock>& from,
+                    const std::shared_ptr<BasicBlock>& to)
+{
+    from->pushSuccessor(to);
+    to->pushPredecessor(from);
+}
+
+static std::shared_ptr<Inst> ref(const std::string& name,
+                                 const std::shared_ptr<BasicBlock>& block)
+{
+    return makeValueRef(name, block);
+}
+
+static std::shared_ptr<Inst> num(int value,
+                                 const std::shared_ptr<BasicBlock>& block)
+{
+    return std::make_shared<IntConstInst>(value, block);
+}
+
+static std::shared_ptr<Inst> emit(const std::shared_ptr<BasicBlock>& block,
+                                  std::shared_ptr<Inst> inst)
+{
+    inst->setup_def_use();
+    block->pushInst(inst);
+    return inst;
+}
+
+// Entry block of a function, or procedure, taking integer parameters
+static std::shared_ptr<BasicBlock> makeFunction(
+    const std::string& name, const std::vector<std::string>& params,
+    FType fType = FType::FUNC)
+{
+    auto entry = makeBlock(name);
+    std::vector<std::shared_ptr<IdentifierAST>> parameters;
+    for (auto& param : params)
+    {
+        parameters.push_back(std::make_shared<VariableAST>(
+            param, Type::INTEGER, IdentType::VARIABLE));
+    }
+    auto retType = fType == FType::FUNC ? Type::INTEGER : Type::UNDEFINED;
+    entry->pushInst(
+        std::make_shared<Func>(name, fType, retType, parameters, entry));
+    return entry;
+}
+
+static size_t countInsts(SSA& ssa, InstType type)
+{
+    size_t count = 0;
+    for (auto& block : getRPONodes(ssa.getCFG()))
+    {
+        for (auto& inst : block->getInstructions())
+        {
+            count += inst->getInstType() == type;
+        }
+    }
+    return count;
+}
+
+static bool hasInst(const std::shared_ptr<BasicBlock>& block, InstType type)
+{
+    auto& insts = block->getInstructions();
+    return std::any_of(insts.begin(), insts.end(),
+                       [&](const std::shared_ptr<Inst>& inst)
+                       { return inst->getInstType() == type; });
+}
+
+// Output of the routine run as a whole program, which also works once it is
+// out of SSA form
+static std::string runOutput(SSA& ssa)
+{
+    std::map<std::string, SSA> functions;
+    IREvaluator evaluator(functions, 1 << 16, 16);
+    auto output = evaluator.runProgram(ssa, 1 << 16);
+    assert(output);
+    return *output;
+}
+
+void tests_sccp()
+{
+    // entry: c = 1 < 2, branch on c to then | else, both joining merge
+    auto entry = makeBlock("entry");
+    auto thenBB = makeBlock("then");
+    auto elseBB = makeBlock("else");
+    auto merge = makeBlock("merge");
+    addEdge(entry, thenBB);
+    addEdge(entry, elseBB);
+    addEdge(thenBB, merge);
+    addEdge(elseBB, merge);
+
+    emit(entry, std::make_shared<CmpLTInst>(ref("c.0", entry), num(1, entry),
+                                            num(2, entry), entry));
+    emit(entry, std::make_shared<BRTInst>(ref("c.0", entry), thenBB, elseBB,
+                                          entry));
+    emit(thenBB, std::make_shared<PutInst>(num(1, thenBB), thenBB));
+    emit(thenBB, std::make_shared<JumpInst>(merge));
+    emit(elseBB, std::make_shared<PutInst>(num(2, elseBB), elseBB));
+    emit(elseBB, std::make_shared<JumpInst>(merge));
+
+    SSA ssa;
+    ssa.setCFG(entry);
+    assert(SCCPPass().run(ssa));
+
+    // The branch becomes a jump to then and else is gone
+    auto terminator = entry->getTerminator();
+    assert(terminator->getInstType() == InstType::Jump);
+    assert(std::dynamic_pointer_cast<JumpInst>(terminator)->getJumpTarget() ==
+           thenBB);
+    assert(entry->getSuccessors().size() == 1);
+    assert(!hasInst(entry, InstType::CmpLT));
+
+    auto rpo = getRPONodes(ssa.getCFG());
+    assert(rpo.size() == 3);
+    assert(std::find(rpo.begin(), rpo.end(), elseBB) == rpo.end());
+    assert(countInsts(ssa, InstType::Put) == 1);
+}
+
+void tests_gvn()
+{
+    // entry: get a, get b, s = a + b, branch on a < b to left | right
+    // left: t = b + a, p = a * b, put t, put p
+    // right: q = a * b, put q
+    auto entry = makeBlock("entry");
+    auto left = makeBlock("left");
+    auto right = makeBlock("right");
+    addEdge(entry, left);
+    addEdge(entry, right);
+
+    emit(entry, std::make_shared<GetInst>(ref("a.0", entry), entry));
+    emit(entry, std::make_shared<GetInst>(ref("b.0", entry), entry));
+    emit(entry, std::make_shared<AddInst>(ref("s.0", entry), ref("a.0", entry),
+                                          ref("b.0", entry), entry));
+    emit(entry, std::make_shared<CmpLTInst>(ref("c.0", entry),
+                                            ref("a.0", entry),
+                                            ref("b.0", entry), entry));
+    emit(entry, std::make_shared<BRTInst>(ref("c.0", entry), left, right,
+                                          entry));
+    emit(left, std::make_shared<AddInst>(ref("t.0", left), ref("b.0", left),
+                                         ref("a.0", left), left));
+    emit(left, std::make_shared<MulInst>(ref("p.0", left), ref("a.0", left),
+                                         ref("b.0", left), left));
+    auto putT = emit(left, std::make_shared<PutInst>(ref("t.0", left), left));
+    emit(left, std::make_shared<PutInst>(ref("p.0", left), left));
+    emit(right, std::make_shared<MulInst>(ref("q.0", right), ref("a.0", right),
+                                          ref("b.0", right), right));
+    emit(right, std::make_shared<PutInst>(ref("q.0", right), right));
+
+    SSA ssa;
+    ssa.setCFG(entry);
+    assert(GVNPass().run(ssa));
+
+    // The commuted sum is dominated by s and reuses it
+    assert(!hasInst(left, InstType::Add));
+    assert(getValueName(putT->getOperands()[0]) == "s.0");
+
+    // Neither sibling dominates the other, so both products stay
+    assert(hasInst(left, InstType::Mul));
+    assert(hasInst(right, InstType::Mul));
+    assert(countInsts(ssa, InstType::Put) == 3);
+    assert(!GVNPass().run(ssa));
+}
+
+void tests_adce()
+{
+    // entry: get x, branch on x > 0 to dead | mid
+    // dead: d = x + 1, jump mid
+    // mid: r = f(x), log(x), branch on x < 10 to print | exit
+    // print: put x, jump exit
+    // exit: put 1
+    auto entry = makeBlock("entry");
+    auto dead = makeBlock("dead");
+    auto mid = makeBlock("mid");
+    auto print = makeBlock("print");
+    auto exit = makeBlock("exit");
+    addEdge(entry, dead);
+    addEdge(entry, mid);
+    addEdge(dead, mid);
+    addEdge(mid, print);
+    addEdge(mid, exit);
+    addEdge(print, exit);
+
+    emit(entry, std::make_shared<GetInst>(ref("x.0", entry), entry));
+    emit(entry, std::make_shared<CmpGTInst>(ref("c.0", entry),
+                                            ref("x.0", entry), num(0, entry),
+                                            entry));
+    emit(entry, std::make_shared<BRTInst>(ref("c.0", entry), dead, mid,
+                                          entry));
+    emit(dead, std::make_shared<AddInst>(ref("d.0", dead), ref("x.0", dead),
+                                         num(1, dead), dead));
+    emit(dead, std::make_shared<JumpInst>(mid));
+    emit(mid, std::make_shared<FuncCallInst>(
+                  "f", "r.0",
+                  std::vector<std::shared_ptr<Inst>>{ref("x.0", mid)}, mid));
+    emit(mid, std::make_shared<ProcCallInst>(
+                  "log", std::vector<std::shared_ptr<Inst>>{ref("x.0", mid)},
+                  mid));
+    emit(mid, std::make_shared<CmpLTInst>(ref("c.1", mid), ref("x.0", mid),
+                                          num(10, mid), mid));
+    emit(mid, std::make_shared<BRTInst>(ref("c.1", mid), print, exit, mid));
+    emit(print, std::make_shared<PutInst>(ref("x.0", print), print));
+    emit(print, std::make_shared<JumpInst>(exit));
+    emit(exit, std::make_shared<PutInst>(num(1, exit), exit));
+
+    SSA ssa;
+    ssa.setCFG(entry);
+    assert(ADCEPass().run(ssa));
+
+    // Nothing live is control dependent on the first branch, so it jumps
+    // straight to its post-dominator and the dead block goes with it
+    auto terminator = entry->getTerminator();
+    assert(terminator->getInstType() == InstType::Jump);
+    assert(std::dynamic_pointer_cast<JumpInst>(terminator)->getJumpTarget() ==
+           mid);
+    auto rpo = getRPONodes(ssa.getCFG());
+    assert(rpo.size() == 4);
+    assert(std::find(rpo.begin(), rpo.end(), dead) == rpo.end());
+    assert(countInsts(ssa, InstType::Add) == 0);
+    assert(countInsts(ssa, InstType::CmpGT) == 0);
+
+    // The calls may have effects even with the result unused, and the
+    // branch guarding a put stays
+    assert(countInsts(ssa, InstType::FuncCall) == 1);
+    assert(countInsts(ssa, InstType::ProcCall) == 1);
+    assert(countInsts(ssa, InstType::Put) == 2);
+    assert(mid->getTerminator()->getInstType() == InstType::BRT);
+    assert(!ADCEPass().run(ssa));
+}
+
+void tests_licm()
+{
+    // entry: get a, jump header
+    // header: i = phi(0, i'), t = a * a, put t, i' = i + 1, loop while i' < 10
+    auto entry = makeBlock("entry");
+    auto header = makeBlock("header");
+    auto exit = makeBlock("exit");
+    addEdge(entry, header);
+    addEdge(header, header);
+    addEdge(header, exit);
+
+    emit(entry, std::make_shared<GetInst>(ref("a.0", entry), entry));
+    emit(entry, std::make_shared<JumpInst>(header));
+
+    auto phi = std::make_shared<PhiInst>("i.1", header);
+    phi->appendOperand(num(0, header), entry);
+    phi->appendOperand(ref("i.2", header), header);
+    emit(header, phi);
+    emit(header, std::make_shared<MulInst>(ref("t.0", header),
+                                           ref("a.0", header),
+                                           ref("a.0", header), header));
+    emit(header, std::make_shared<PutInst>(ref("t.0", header), header));
+    emit(header, std::make_shared<AddInst>(ref("i.2", header),
+                                           ref("i.1", header), num(1, header),
+                                           header));
+    emit(header, std::make_shared<CmpLTInst>(ref("c.0", header),
+                                             ref("i.2", header),
+                                             num(10, header), header));
+    emit(header, std::make_shared<BRTInst>(ref("c.0", header), header, exit,
+                                           header));
+
+    SSA ssa;
+    ssa.setCFG(entry);
+    assert(LICMPass().run(ssa));
+
+    // The product moves to the preheader, ahead of its jump, while the
+    // induction variable stays
+    assert(hasInst(entry, InstType::Mul));
+    assert(!hasInst(header, InstType::Mul));
+    assert(entry->getTerminator()->getInstType() == InstType::Jump);
+    assert(hasInst(header, InstType::Add));
+    assert(hasInst(header, InstType::Put));
+}
+
+void tests_strength_reduction()
+{
+    // entry: jump body
+    // body: i = phi(0, i'), t = i * 3, put t, i' = i + 1, loop while i' < 5
+    auto entry = makeBlock("entry");
+    auto body = makeBlock("body");
+    auto exit = makeBlock("exit");
+    addEdge(entry, body);
+    addEdge(body, body);
+    addEdge(body, exit);
+
+    emit(entry, std::make_shared<JumpInst>(body));
+
+    auto phi = std::make_shared<PhiInst>("i.1", body);
+    phi->appendOperand(num(0, body), entry);
+    phi->appendOperand(ref("i.2", body), body);
+    emit(body, phi);
+    emit(body, std::make_shared<MulInst>(ref("t.0", body), ref("i.1", body),
+                                         num(3, body), body));
+    emit(body, std::make_shared<PutInst>(ref("t.0", body), body));
+    emit(body, std::make_shared<AddInst>(ref("i.2", body), ref("i.1", body),
+                                         num(1, body), body));
+    emit(body, std::make_shared<CmpLTInst>(ref("c.0", body), ref("i.2", body),
+                                           num(5, body), body));
+    emit(body, std::make_shared<BRTInst>(ref("c.0", body), body, exit, body));
+
+    SSA ssa;
+    ssa.setCFG(entry);
+    assert(runOutput(ssa) == "036912");
+    assert(StrengthReductionPass().run(ssa));
+
+    // t becomes a second induction variable starting at 0 and stepping by 3
+    assert(countInsts(ssa, InstType::Mul) == 0);
+    size_t numPhis = 0;
+    for (auto& inst : body->getInstructions())
+    {
+        numPhis += inst->isPhi();
+    }
+    assert(numPhis == 2);
+    assert(runOutput(ssa) == "036912");
+}
+
+// A loop printing i for i = 0, 1, ... and testing i + 1 against bound at
+// the bottom like repeat ... until. With isStrict the loop leaves once
+// i + 1 > bound, otherwise once i + 1 >= bound.
+static SSA makeCountedLoop(int bound, bool isStrict)
+{
+    auto entry = makeBlock("entry");
+    auto body = makeBlock("body");
+    auto exit = makeBlock("exit");
+    addEdge(entry, body);
+    addEdge(body, body);
+    addEdge(body, exit);
+
+    emit(entry, std::make_shared<JumpInst>(body));
+
+    auto phi = std::make_shared<PhiInst>("i.1", body);
+    phi->appendOperand(num(0, body), entry);
+    phi->appendOperand(ref("i.2", body), body);
+    emit(body, phi);
+    emit(body, std::make_shared<PutInst>(ref("i.1", body), body));
+    emit(body, std::make_shared<AddInst>(ref("i.2", body), ref("i.1", body),
+                                         num(1, body), body));
+    if (isStrict)
+    {
+        emit(body, std::make_shared<CmpGTInst>(ref("c.0", body),
+                                               ref("i.2", body),
+                                               num(bound, body), body));
+    }
+    else
+    {
+        emit(body, std::make_shared<CmpGTEInst>(ref("c.0", body),
+                                                ref("i.2", body),
+                                                num(bound, body), body));
+    }
+
+    // Back to body while the test fails
+    emit(body, std::make_shared<BRFInst>(ref("c.0", body), body, exit, body));
+
+    SSA ssa;
+    ssa.setCFG(entry);
+    return ssa;
+}
+
+void tests_loop_unroll()
+{
+    // i + 1 >= 5 leaves after printing 0 to 4, and the loop is unrolled
+    // fully into five copies of its body
+    auto fiveTrips = makeCountedLoop(5, false);
+    assert(LoopUnrollPass().run(fiveTrips));
+    fiveTrips.invalidateCFGAnalyses();
+    assert(fiveTrips.getLoopForest()->getTopLevelLoops().empty());
+    assert(countInsts(fiveTrips, InstType::Put) == 5);
+
+    // i + 1 > 5 takes one more trip
+    auto sixTrips = makeCountedLoop(5, true);
+    assert(LoopUnrollPass().run(sixTrips));
+    sixTrips.invalidateCFGAnalyses();
+    assert(sixTrips.getLoopForest()->getTopLevelLoops().empty());
+    assert(countInsts(sixTrips, InstType::Put) == 6);
+
+    // Too many trips to unroll fully: the loop stays, unrolled by a factor
+    // dividing the trip count, so no iteration is peeled
+    auto manyTrips = makeCountedLoop(1000, false);
+    assert(LoopUnrollPass().run(manyTrips));
+    manyTrips.invalidateCFGAnalyses();
+    assert(manyTrips.getLoopForest()->getTopLevelLoops().size() == 1);
+    auto puts = countInsts(manyTrips, InstType::Put);
+    assert(puts == 2 || puts == 4 || puts == 8);
+}
+
+void tests_loop_simplify()
+{
+    // entry: branch on 0 < 1 to header | side
+    // side: branch on 1 < 0 to exit | header
+    // header: i = phi(0, 1, i'), branch on i < 3 to body | exit
+    // body: put i, i' = i + 1, jump header
+    // exit: put 9
+    auto entry = makeBlock("entry");
+    auto side = makeBlock("side");
+    auto header = makeBlock("header");
+    auto body = makeBlock("body");
+    auto exit = makeBlock("exit");
+    addEdge(entry, header);
+    addEdge(entry, side);
+    addEdge(side, exit);
+    addEdge(side, header);
+    addEdge(header, body);
+    addEdge(header, exit);
+    addEdge(body, header);
+
+    emit(entry, std::make_shared<CmpLTInst>(ref("c.0", entry), num(0, entry),
+                                            num(1, entry), entry));
+    emit(entry, std::make_shared<BRTInst>(ref("c.0", entry), header, side,
+                                          entry));
+    emit(side, std::make_shared<CmpLTInst>(ref("c.1", side), num(1, side),
+                                           num(0, side), side));
+    emit(side, std::make_shared<BRTInst>(ref("c.1", side), exit, header,
+                                         side));
+    auto phi = std::make_shared<PhiInst>("i.1", header);
+    phi->appendOperand(num(0, header), entry);
+    phi->appendOperand(num(1, header), side);
+    phi->appendOperand(ref("i.2", header), body);
+    emit(header, phi);
+    emit(header, std::make_shared<CmpLTInst>(ref("c.2", header),
+                                             ref("i.1", header),
+                                             num(3, header), header));
+    emit(header, std::make_shared<BRTInst>(ref("c.2", header), body, exit,
+                                           header));
+    emit(body, std::make_shared<PutInst>(ref("i.1", body), body));
+    emit(body, std::make_shared<AddInst>(ref("i.2", body), ref("i.1", body),
+                                         num(1, body), body));
+    emit(body, std::make_shared<JumpInst>(header));
+    emit(exit, std::make_shared<PutInst>(num(9, exit), exit));
+
+    SSA ssa;
+    ssa.setCFG(entry);
+    assert(runOutput(ssa) == "0129");
+    assert(LoopSimplifyPass().run(ssa));
+
+    // Both entries into the header go through a preheader, and exit, also
+    // reached from side, gets a block of its own for the loop
+    ssa.invalidateCFGAnalyses();
+    auto& loops = ssa.getLoopForest()->getTopLevelLoops();
+    assert(loops.size() == 1);
+    auto& loop = loops[0];
+    assert(loop->getHeader() == header);
+    assert(loop->getPreheader());
+    assert(header->getPredecessors().size() == 2);
+    assert(loop->getLatches().size() == 1);
+    for (auto& exitBlock : loop->getExitBlocks())
+    {
+        assert(exitBlock != exit);
+        for (auto& pred : exitBlock->getPredecessors())
+        {
+            assert(loop->contains(pred));
+        }
+    }
+    assert(runOutput(ssa) == "0129");
+
+    assert(LoopRotatePass().run(ssa));
+    LoopSimplifyPass().run(ssa);
+
+    // The exit test now guards the loop and ends the body, which became the
+    // header and branches back to itself
+    ssa.invalidateCFGAnalyses();
+    auto& rotated = ssa.getLoopForest()->getTopLevelLoops();
+    assert(rotated.size() == 1);
+    assert(rotated[0]->getHeader() == body);
+    assert(rotated[0]->getLatches().size() == 1);
+    assert(rotated[0]->getLatches()[0]->getTerminator()->getInstType() ==
+           InstType::BRT);
+    auto preheader = rotated[0]->getPreheader();
+    assert(preheader && preheader->getPredecessors().size() == 1);
+    assert(preheader->getPredecessors()[0]->getTerminator()->getInstType() ==
+           InstType::BRT);
+    assert(runOutput(ssa) == "0129");
+}
+
+void tests_tail_recursion()
+{
+    // f(n): if n <= 0 then return 0 else return f(n - 1)
+    auto entry = makeFunction("f", {"n.0"});
+    auto base = makeBlock("base");
+    auto recurse = makeBlock("recurse");
+    addEdge(entry, base);
+    addEdge(entry, recurse);
+
+    emit(entry, std::make_shared<CmpLTEInst>(ref("c.0", entry),
+                                             ref("n.0", entry), num(0, entry),
+                                             entry));
+    emit(entry, std::make_shared<BRTInst>(ref("c.0", entry), base, recurse,
+                                          entry));
+    emit(base, std::make_shared<ReturnInst>(num(0, base), base));
+    emit(recurse, std::make_shared<SubInst>(ref("m.0", recurse),
+                                            ref("n.0", recurse),
+                                            num(1, recurse), recurse));
+    emit(recurse, std::make_shared<FuncCallInst>(
+                      "f", "r.0",
+                      std::vector<std::shared_ptr<Inst>>{ref("m.0", recurse)},
+                      recurse));
+    emit(recurse, std::make_shared<ReturnInst>(ref("r.0", recurse), recurse));
+
+    SSA ssa;
+    ssa.setCFG(entry);
+    assert(TailRecursionPass().run(ssa));
+
+    // The call becomes a jump back to a header merging n with m
+    assert(countInsts(ssa, InstType::FuncCall) == 0);
+    assert(countInsts(ssa, InstType::Return) == 1);
+    ssa.invalidateCFGAnalyses();
+    auto& loops = ssa.getLoopForest()->getTopLevelLoops();
+    assert(loops.size() == 1);
+    auto& headerInsts = loops[0]->getHeader()->getInstructions();
+    assert(!headerInsts.empty() && headerInsts.front()->isPhi());
+    assert(entry->getInstructions().front()->getInstType() == InstType::Func);
+}
+
+// depth(n): if n <= 0 then return 0 else return depth(n - 1) + 1
+static SSA makeDepthFunction()
+{
+    auto entry = makeFunction("depth", {"n.0"});
+    auto base = makeBlock("depth_base");
+    auto recurse = makeBlock("depth_recurse");
+    addEdge(entry, base);
+    addEdge(entry, recurse);
+
+    emit(entry, std::make_shared<CmpLTEInst>(ref("c.0", entry),
+                                             ref("n.0", entry), num(0, entry),
+                                             entry));
+    emit(entry, std::make_shared<BRTInst>(ref("c.0", entry), base, recurse,
+                                          entry));
+    emit(base, std::make_shared<ReturnInst>(num(0, base), base));
+    emit(recurse, std::make_shared<SubInst>(ref("m.0", recurse),
+                                            ref("n.0", recurse),
+                                            num(1, recurse), recurse));
+    emit(recurse, std::make_shared<FuncCallInst>(
+                      "depth", "r.0",
+                      std::vector<std::shared_ptr<Inst>>{ref("m.0", recurse)},
+                      recurse));
+    emit(recurse, std::make_shared<AddInst>(ref("s.0", recurse),
+                                            ref("r.0", recurse),
+                                            num(1, recurse), recurse));
+    emit(recurse, std::make_shared<ReturnInst>(ref("s.0", recurse), recurse));
+
+    SSA ssa;
+    ssa.setCFG(entry);
+    return ssa;
+}
+
+// spin(n): counts n up until it wraps around, which takes far more steps
+// than an evaluation may use
+static SSA makeSpinFunction()
+{
+    auto entry = makeFunction("spin", {"n.0"});
+    auto header = makeBlock("spin_header");
+    auto exit = makeBlock("spin_exit");
+    addEdge(entry, header);
+    addEdge(header, header);
+    addEdge(header, exit);
+
+    emit(entry, std::make_shared<JumpInst>(header));
+    auto phi = std::make_shared<PhiInst>("i.1", header);
+    phi->appendOperand(ref("n.0", header), entry);
+    phi->appendOperand(ref("i.2", header), header);
+    emit(header, phi);
+    emit(header, std::make_shared<AddInst>(ref("i.2", header),
+                                           ref("i.1", header), num(1, header),
+                                           header));
+    emit(header, std::make_shared<CmpGTInst>(ref("c.0", header),
+                                             ref("i.2", header),
+                                             num(0, header), header));
+    emit(header, std::make_shared<BRTInst>(ref("c.0", header), header, exit,
+                                           header));
+    emit(exit, std::make_shared<ReturnInst>(ref("i.2", exit), exit));
+
+    SSA ssa;
+    ssa.setCFG(entry);
+    return ssa;
+}
+
+// twice(n): return n + n
+static SSA makeTwiceFunction()
+{
+    auto entry = makeFunction("twice", {"n.0"});
+    emit(entry, std::make_shared<AddInst>(ref("s.0", entry), ref("n.0", entry),
+                                          ref("n.0", entry), entry));
+    emit(entry, std::make_shared<ReturnInst>(ref("s.0", entry), entry));
+
+    SSA ssa;
+    ssa.setCFG(entry);
+    return ssa;
+}
+
+// chain(n): adds 1 to n size - 1 times, so its body has size instructions
+static SSA makeChainFunction(size_t size)
+{
+    auto entry = makeFunction("chain", {"n.0"});
+    std::string last = "n.0";
+    for (size_t i = 1; i < size; ++i)
+    {
+        auto name = "a." + std::to_string(i);
+        emit(entry, std::make_shared<AddInst>(ref(name, entry),
+                                              ref(last, entry), num(1, entry),
+                                              entry));
+        last = name;
+    }
+    emit(entry, std::make_shared<ReturnInst>(ref(last, entry), entry));
+
+    SSA ssa;
+    ssa.setCFG(entry);
+    return ssa;
+}
+
+// Callees of the calls left in the routine, in reverse post-order
+static std::vector<std::string> getCallees(SSA& ssa)
+{
+    std::vector<std::string> callees;
+    for (auto& block : getRPONodes(ssa.getCFG()))
+    {
+        for (auto& inst : block->getInstructions())
+        {
+            auto callee = getCalleeName(inst);
+            if (!callee.empty())
+            {
+                callees.push_back(callee);
+            }
+        }
+    }
+    return callees;
+}
+
+void tests_inliner()
+{
+    std::map<std::string, SSA> functions;
+    functions.emplace("twice", makeTwiceFunction());
+    functions.emplace("depth", makeDepthFunction());
+    functions.emplace("chain", makeChainFunction(30));
+
+    // log(n): put n
+    auto logEntry = makeFunction("log", {"n.0"}, FType::PROC);
+    emit(logEntry, std::make_shared<PutInst>(ref("n.0", logEntry), logEntry));
+    SSA log;
+    log.setCFG(logEntry);
+    functions.emplace("log", std::move(log));
+
+    // main: get x, a = twice(x), log(a), b = depth(x), c = chain(x),
+    // d = chain(5), put a + b + c + d
+    auto entry = makeBlock("main");
+    emit(entry, std::make_shared<GetInst>(ref("x.0", entry), entry));
+    auto call = [&](const std::string& callee, const std::string& target,
+                    std::shared_ptr<Inst> arg)
+    {
+        emit(entry, std::make_shared<FuncCallInst>(
+                        callee, target,
+                        std::vector<std::shared_ptr<Inst>>{arg}, entry));
+    };
+    call("twice", "a.0", ref("x.0", entry));
+    emit(entry, std::make_shared<ProcCallInst>(
+                    "log", std::vector<std::shared_ptr<Inst>>{ref("a.0", entry)},
+                    entry));
+    call("depth", "b.0", ref("x.0", entry));
+    call("chain", "c.0", ref("x.0", entry));
+    call("chain", "d.0", num(5, entry));
+    emit(entry, std::make_shared<AddInst>(ref("s.0", entry), ref("a.0", entry),
+                                          ref("b.0", entry), entry));
+    emit(entry, std::make_shared<AddInst>(ref("s.1", entry), ref("s.0", entry),
+                                          ref("c.0", entry), entry));
+    emit(entry, std::make_shared<AddInst>(ref("s.2", entry), ref("s.1", entry),
+                                          ref("d.0", entry), entry));
+    emit(entry, std::make_shared<PutInst>(ref("s.2", entry), entry));
+
+    SSA ssa;
+    ssa.setCFG(entry);
+    assert(InlinerPass(functions).run(ssa));
+
+    // The small function and procedure are copied in, as is chain once its
+    // constant argument raises the threshold past its size. The recursive
+    // function and chain called with a variable stay calls.
+    assert((getCallees(ssa) == std::vector<std::string>{"depth", "chain"}));
+    assert(countInsts(ssa, InstType::Put) == 2);
+    assert(countInsts(ssa, InstType::Return) == 0);
+}
+
+void tests_call_graph()
+{
+    // even(n): return odd(n)
+    // odd(n): log(n), return even(n)
+    // log(n): put n
+    // dead(n): return twice(n)
+    // main: get x, put twice(even(x))
+    auto addFunction = [](std::map<std::string, SSA>& functions,
+                          const std::string& name, const std::string& callee,
+                          const std::string& proc)
+    {
+        auto entry = makeFunction(name, {"n.0"});
+        if (!proc.empty())
+        {
+            emit(entry, std::make_shared<ProcCallInst>(
+                            proc,
+                            std::vector<std::shared_ptr<Inst>>{
+                                ref("n.0", entry)},
+                            entry));
+        }
+        emit(entry, std::make_shared<FuncCallInst>(
+                        callee, "r.0",
+                        std::vector<std::shared_ptr<Inst>>{ref("n.0", entry)},
+                        entry));
+        emit(entry, std::make_shared<ReturnInst>(ref("r.0", entry), entry));
+        SSA ssa;
+        ssa.setCFG(entry);
+        functions.emplace(name, std::move(ssa));
+    };
+
+    std::map<std::string, SSA> functions;
+    addFunction(functions, "even", "odd", "");
+    addFunction(functions, "odd", "even", "log");
+    addFunction(functions, "dead", "twice", "");
+    functions.emplace("twice", makeTwiceFunction());
+    auto logEntry = makeFunction("log", {"n.0"}, FType::PROC);
+    emit(logEntry, std::make_shared<PutInst>(ref("n.0", logEntry), logEntry));
+    SSA log;
+    log.setCFG(logEntry);
+    functions.emplace("log", std::move(log));
+
+    auto entry = makeBlock("main");
+    emit(entry, std::make_shared<GetInst>(ref("x.0", entry), entry));
+    emit(entry, std::make_shared<FuncCallInst>(
+                    "even", "a.0",
+                    std::vector<std::shared_ptr<Inst>>{ref("x.0", entry)},
+                    entry));
+    emit(entry, std::make_shared<FuncCallInst>(
+                    "twice", "b.0",
+                    std::vector<std::shared_ptr<Inst>>{ref("a.0", entry)},
+                    entry));
+    emit(entry, std::make_shared<PutInst>(ref("b.0", entry), entry));
+    SSA mainSSA;
+    mainSSA.setCFG(entry);
+
+    CallGraph callGraph(mainSSA, functions);
+    assert((callGraph.getCallees(CallGraph::MainName) ==
+            std::vector<std::string>{"even", "twice"}));
+    assert(callGraph.getNumCallSites("twice") == 2);
+
+    // even and odd form one component, which comes after the log it calls
+    // and before main
+    auto& sccs = callGraph.getSCCs();
+    auto findSCC = [&](const std::string& name)
+    {
+        for (size_t i = 0; i < sccs.size(); ++i)
+        {
+            if (std::find(sccs[i].begin(), sccs[i].end(), name) !=
+                sccs[i].end())
+            {
+                return i;
+            }
+        }
+        assert(false);
+        return sccs.size();
+    };
+    assert(findSCC("even") == findSCC("odd"));
+    assert(sccs[findSCC("even")].size() == 2);
+    assert(findSCC("log") < findSCC("even"));
+    assert(findSCC("twice") < findSCC(CallGraph::MainName));
+    assert(findSCC("even") < findSCC(CallGraph::MainName));
+    assert(callGraph.getSummary("even").isRecursive);
+    assert(callGraph.getSummary("odd").isRecursive);
+    assert(!callGraph.getSummary("twice").isRecursive);
+    assert(!callGraph.getSummary("log").isRecursive);
+
+    // Only dead is out of reach of main, twice being called from it as well
+    assert((callGraph.getUnreachable() == std::vector<std::string>{"dead"}));
+    assert(callGraph.isReachable("twice"));
+    assert(!callGraph.isReachable("dead"));
+
+    // even prints through odd and log, twice only computes its result
+    auto& even = callGraph.getSummary("even");
+    assert(even.writesOutput && !even.readsInput && !even.isPure);
+    assert(callGraph.getSummary("twice").isPure);
+    assert(callGraph.getSummary("dead").isPure);
+    assert(callGraph.getSummary(CallGraph::MainName).readsInput);
+
+    // A call clobbers every caller-saved register until the allocated body
+    // tells which ones it writes
+    auto& twice = callGraph.getSummary("twice");
+    assert(!twice.hasClobberInfo);
+    assert(twice.clobberedRegs == getCallerSavedRegs());
+    auto regs = std::set<int>{*getCallerSavedRegs().begin()};
+    callGraph.setClobberedRegs("twice", regs);
+    assert(twice.hasClobberInfo && twice.clobberedRegs == regs);
+}
+
+// Parameters left in the signature of the routine
+static size_t getNumParams(SSA& ssa)
+{
+    auto& insts = ssa.getCFG()->getInstructions();
+    auto signature = std::dynamic_pointer_cast<Func>(insts.front());
+    assert(signature);
+    return signature->getParameters().size();
+}
+
+void tests_ipcp()
+{
+    std::map<std::string, SSA> functions;
+
+    // scale(n, k): return n * k
+    auto scaleEntry = makeFunction("scale", {"n.0", "k.0"});
+    auto product = emit(scaleEntry, std::make_shared<MulInst>(
+                                        ref("p.0", scaleEntry),
+                                        ref("n.0", scaleEntry),
+                                        ref("k.0", scaleEntry), scaleEntry));
+    emit(scaleEntry, std::make_shared<ReturnInst>(ref("p.0", scaleEntry),
+                                                  scaleEntry));
+    SSA scale;
+    scale.setCFG(scaleEntry);
+    functions.emplace("scale", std::move(scale));
+
+    // offset(n, d): if d > 0 then return n + d else return n - d
+    auto offsetEntry = makeFunction("offset", {"n.0", "d.0"});
+    auto pos = makeBlock("offset_pos");
+    auto neg = makeBlock("offset_neg");
+    addEdge(offsetEntry, pos);
+    addEdge(offsetEntry, neg);
+    emit(offsetEntry, std::make_shared<CmpGTInst>(ref("c.0", offsetEntry),
+                                                  ref("d.0", offsetEntry),
+                                                  num(0, offsetEntry),
+                                                  offsetEntry));
+    emit(offsetEntry, std::make_shared<BRTInst>(ref("c.0", offsetEntry), pos,
+                                                neg, offsetEntry));
+    emit(pos, std::make_shared<AddInst>(ref("s.0", pos), ref("n.0", pos),
+                                        ref("d.0", pos), pos));
+    emit(pos, std::make_shared<ReturnInst>(ref("s.0", pos), pos));
+    emit(neg, std::make_shared<SubInst>(ref("t.0", neg), ref("n.0", neg),
+                                        ref("d.0", neg), neg));
+    emit(neg, std::make_shared<ReturnInst>(ref("t.0", neg), neg));
+    SSA offset;
+    offset.setCFG(offsetEntry);
+    functions.emplace("offset", std::move(offset));
+
+    // main: get x, get y, put scale(x, 3), put scale(y, 3),
+    // put offset(x, 5), put offset(x, y)
+    auto entry = makeBlock("main");
+    emit(entry, std::make_shared<GetInst>(ref("x.0", entry), entry));
+    emit(entry, std::make_shared<GetInst>(ref("y.0", entry), entry));
+    auto call = [&](const std::string& callee, const std::string& target,
+                    std::vector<std::shared_ptr<Inst>> args)
+    {
+        emit(entry,
+             std::make_shared<FuncCallInst>(callee, target, args, entry));
+        emit(entry, std::make_shared<PutInst>(ref(target, entry), entry));
+    };
+    call("scale", "a.0", {ref("x.0", entry), num(3, entry)});
+    call("scale", "b.0", {ref("y.0", entry), num(3, entry)});
+    call("offset", "c.0", {ref("x.0", entry), num(5, entry)});
+    call("offset", "d.0", {ref("x.0", entry), ref("y.0", entry)});
+
+    SSA mainSSA;
+    mainSSA.setCFG(entry);
+    assert(IPConstantPropagationPass().run(mainSSA, functions));
+
+    // Every call passes 3 for k, which becomes a constant in scale and
+    // leaves the signature and the calls
+    assert(getNumParams(functions.at("scale")) == 1);
+    assert(isConstant(product->getOperands()[1]));
+    auto& insts = entry->getInstructions();
+    auto scaleCalls = std::count_if(
+        insts.begin(), insts.end(), [](const std::shared_ptr<Inst>& inst)
+        { return getCalleeName(inst) == "scale"; });
+    assert(scaleCalls == 2);
+
+    // Only one call passes a constant for d, so that call gets a copy of
+    // offset with the branch on d decided, and the other keeps the original
+    std::string clone;
+    for (auto& [name, ssa] : functions)
+    {
+        if (name.rfind("offset_spec", 0) == 0)
+        {
+            assert(clone.empty());
+            clone = name;
+        }
+    }
+    assert(!clone.empty());
+    assert(getNumParams(functions.at(clone)) == 1);
+    assert(getNumParams(functions.at("offset")) == 2);
+    std::vector<std::string> offsetCalls;
+    for (auto& inst : insts)
+    {
+        auto callee = getCalleeName(inst);
+        if (callee.rfind("offset", 0) == 0)
+        {
+            offsetCalls.push_back(callee);
+            assert(inst->getOperands().size() == (callee == clone ? 1 : 2));
+        }
+    }
+    assert((offsetCalls == std::vector<std::string>{clone, "offset"}));
+}
+
+void tests_call_folding()
+{
+    std::map<std::string, SSA> functions;
+    functions.emplace("depth", makeDepthFunction());
+    functions.emplace("spin", makeSpinFunction());
+
+    // put(depth(100)), put(depth(1000)), put(spin(1))
+    auto entry = makeBlock("entry");
+    auto call = [&](const std::string& callee, int arg,
+                    const std::string& result)
+    {
+        emit(entry, std::make_shared<FuncCallInst>(
+                        callee, result,
+                        std::vector<std::shared_ptr<Inst>>{num(arg, entry)},
+                        entry));
+        emit(entry, std::make_shared<PutInst>(ref(result, entry), entry));
+    };
+    call("depth", 100, "x.0");
+    call("depth", 1000, "y.0");
+    call("spin", 1, "z.0");
+
+    SSA mainSSA;
+    mainSSA.setCFG(entry);
+    assert(CallFoldingPass().run(mainSSA, functions));
+
+    // Only the call nesting 100 deep fits the depth limit, and spin runs
+    // out of steps
+    std::vector<std::string> callees;
+    std::vector<std::shared_ptr<Inst>> printed;
+    for (auto& inst : entry->getInstructions())
+    {
+        if (inst->getInstType() == InstType::FuncCall)
+        {
+            callees.push_back(getCalleeName(inst));
+        }
+        else if (inst->getInstType() == InstType::Put)
+        {
+            printed.push_back(inst->getOperands()[0]->getTarget());
+        }
+    }
+    assert((callees == std::vector<std::string>{"depth", "spin"}));
+    assert(printed.size() == 3);
+    assert(printed[0]->getInstType() == InstType::IntConst);
+    assert(std::dynamic_pointer_cast<IntConstInst>(printed[0])->getVal() ==
+           100);
+    assert(getValueName(printed[1]) == "y.0");
+    assert(getValueName(printed[2]) == "z.0");
+}
+
+void tests_program_evaluation()
+{
+    // The counted loop prints 0 to 4 and becomes a single put
+    std::map<std::string, SSA> functions;
+    auto counted = makeCountedLoop(5, false);
+    auto entry = counted.getCFG();
+    assert(ProgramEvaluationPass().run(counted, functions));
+    assert(counted.getCFG() == entry);
+    assert(entry->getSuccessors().empty());
+    auto& insts = entry->getInstructions();
+    assert(insts.size() == 1 && insts[0]->getInstType() == InstType::Put);
+    auto text = insts[0]->getOperands()[0]->getTarget();
+    assert(text->getInstType() == InstType::StrConst);
+    assert(text->getString() == "\"01234\"");
+
+    // Reading input leaves the program alone
+    auto reader = makeBlock("reader");
+    emit(reader, std::make_shared<PutInst>(num(1, reader), reader));
+    emit(reader, std::make_shared<GetInst>(ref("a.0", reader), reader));
+    emit(reader, std::make_shared<PutInst>(ref("a.0", reader), reader));
+    SSA readsInput;
+    readsInput.setCFG(reader);
+    assert(!ProgramEvaluationPass().run(readsInput, functions));
+    assert(reader->getInstructions().size() == 3);
+
+    // So does a loop running past the step budget
+    auto endless = makeBlock("endless");
+    addEdge(endless, endless);
+    emit(endless, std::make_shared<PutInst>(num(1, endless), endless));
+    emit(endless, std::make_shared<JumpInst>(endless));
+    SSA runsForever;
+    runsForever.setCFG(endless);
+    assert(!ProgramEvaluationPass().run(runsForever, functions));
+}
+
+void tests_out_of_ssa()
+{
+    // The induction variable, its phi and its increment share one name, so
+    // no copy is left in the loop
+    auto counted = makeCountedLoop(5, false);
+    auto body = counted.getCFG()->getSuccessors()[0];
+    counted.renameSSA();
+    assert(!hasInst(body, InstType::Assign));
+    assert(!hasInst(body, InstType::Phi));
+    assert(runOutput(counted) == "01234");
+
+    // a and b trade places on every trip, which needs a temporary
+    auto entry = makeBlock("entry");
+    auto header = makeBlock("header");
+    auto exit = makeBlock("exit");
+    addEdge(entry, header);
+    addEdge(header, header);
+    addEdge(header, exit);
+    emit(entry, std::make_shared<JumpInst>(header));
+
+    auto phiA = std::make_shared<PhiInst>("a.1", header);
+    phiA->appendOperand(num(1, header), entry);
+    phiA->appendOperand(ref("b.1", header), header);
+    auto phiB = std::make_shared<PhiInst>("b.1", header);
+    phiB->appendOperand(num(2, header), entry);
+    phiB->appendOperand(ref("a.1", header), header);
+    auto phiI = std::make_shared<PhiInst>("i.1", header);
+    phiI->appendOperand(num(0, header), entry);
+    phiI->appendOperand(ref("i.2", header), header);
+    emit(header, phiA);
+    emit(header, phiB);
+    emit(header, phiI);
+    emit(header, std::make_shared<PutInst>(ref("a.1", header), header));
+    emit(header, std::make_shared<AddInst>(ref("i.2", header),
+                                           ref("i.1", header), num(1, header),
+                                           header));
+    emit(header, std::make_shared<CmpGTEInst>(ref("c.0", header),
+                                              ref("i.2", header),
+                                              num(4, header), header));
+    emit(header, std::make_shared<BRFInst>(ref("c.0", header), header, exit,
+                                           header));
+
+    SSA swap;
+    swap.setCFG(entry);
+    assert(runOutput(swap) == "1212");
+    swap.renameSSA();
+    assert(!hasInst(header, InstType::Phi));
+    assert(runOutput(swap) == "1212");
+
+    // Both phis share names with their incoming values, leaving a swap
+    // that takes three moves through a temporary
+    auto& insts = header->getInstructions();
+    assert(std::count_if(insts.begin(), insts.end(),
+                         [](const std::shared_ptr<Inst>& inst)
+                         { return inst->getInstType() == InstType::Assign; }) ==
+           3);
+}
+
+// entry: get x, y, branch on x > 3 to then | else, both joining merge.
+// then computes x op y, merge computes y op x again.
+static SSA makePartialRedundancy(
+    InstType type, std::vector<std::shared_ptr<BasicBlock>>& blocks)
+{
+    auto entry = makeBlock("entry");
+    auto thenBB = makeBlock("then");
+    auto elseBB = makeBlock("else");
+    auto merge = makeBlock("merge");
+    addEdge(entry, thenBB);
+    addEdge(entry, elseBB);
+    addEdge(thenBB, merge);
+    addEdge(elseBB, merge);
+    blocks = {entry, thenBB, elseBB, merge};
+
+    auto compute = [&](const std::string& name, const std::string& lhs,
+                       const std::string& rhs,
+                       const std::shared_ptr<BasicBlock>& block)
+    {
+        if (type == InstType::Mul)
+        {
+            emit(block, std::make_shared<MulInst>(
+                            ref(name, block), ref(lhs, block), ref(rhs, block),
+                            block));
+        }
+        else
+        {
+            emit(block, std::make_shared<DivInst>(
+                            ref(name, block), ref(lhs, block), ref(rhs, block),
+                            block));
+        }
+    };
+
+    emit(entry, std::make_shared<GetInst>(ref("x.0", entry), entry));
+    emit(entry, std::make_shared<GetInst>(ref("y.0", entry), entry));
+    emit(entry, std::make_shared<CmpGTInst>(ref("c.0", entry), ref("x.0", entry),
+                                            num(3, entry), entry));
+    emit(entry, std::make_shared<BRTInst>(ref("c.0", entry), thenBB, elseBB,
+                                          entry));
+    compute("t.0", "x.0", "y.0", thenBB);
+    emit(thenBB, std::make_shared<PutInst>(ref("t.0", thenBB), thenBB));
+    emit(thenBB, std::make_shared<JumpInst>(merge));
+    emit(elseBB, std::make_shared<JumpInst>(merge));
+    compute("t.1", "y.0", "x.0", merge);
+    emit(merge, std::make_shared<PutInst>(ref("t.1", merge), merge));
+
+    SSA ssa;
+    ssa.setCFG(entry);
+    return ssa;
+}
+
+void tests_pre()
+{
+    std::vector<std::shared_ptr<BasicBlock>> blocks;
+    auto ssa = makePartialRedundancy(InstType::Mul, blocks);
+    auto elseBB = blocks[2];
+    auto merge = blocks[3];
+    assert(PREPass().run(ssa));
+
+    // else computes the product, then's is reused and merge joins the two
+    assert(hasInst(elseBB, InstType::Mul));
+    assert(elseBB->getTerminator()->getInstType() == InstType::Jump);
+    assert(!hasInst(merge, InstType::Mul));
+    auto phi = std::dynamic_pointer_cast<PhiInst>(merge->getInstructions()[0]);
+    assert(phi && getDefinedName(phi) == "t.1");
+    assert(getValueName(phi->getOperands()[0]) == "t.0");
+    assert(countInsts(ssa, InstType::Mul) == 2);
+    assert(!PREPass().run(ssa));
+
+    // A division could trap on the path through else
+    auto division = makePartialRedundancy(InstType::Div, blocks);
+    assert(!PREPass().run(division));
+    assert(hasInst(blocks[3], InstType::Div));
+}
+
+void tests_array_forwarding()
+{
+    auto entry = makeBlock("entry");
+    auto thenBB = makeBlock("then");
+    auto elseBB = makeBlock("else");
+    auto merge = makeBlock("merge");
+    addEdge(entry, thenBB);
+    addEdge(entry, elseBB);
+    addEdge(thenBB, merge);
+    addEdge(elseBB, merge);
+
+    auto update = [](const std::shared_ptr<BasicBlock>& block,
+                     const std::string& name, const std::string& source,
+                     std::shared_ptr<Inst> index, int value)
+    {
+        emit(block, std::make_shared<ArrUpdateInst>(
+                        ref(name, block), ref(source, block), index,
+                        num(value, block), block, Type::INTEGER));
+    };
+    auto access = [](const std::shared_ptr<BasicBlock>& block,
+                     const std::string& name, const std::string& source,
+                     std::shared_ptr<Inst> index)
+    {
+        emit(block, std::make_shared<ArrAccessInst>(ref(name, block),
+                                                    ref(source, block), index,
+                                                    block, Type::INTEGER));
+        emit(block, std::make_shared<PutInst>(ref(name, block), block));
+    };
+
+    // a[0] := 5, a[i] := 3, put a[i], a[1] := 7, put a[i],
+    // a[2] := 1, a[2] := 4, put a[1]
+    emit(entry, std::make_shared<AllocaInst>(ref("a.0", entry), Type::INTEGER,
+                                             4, entry));
+    emit(entry, std::make_shared<GetInst>(ref("i.0", entry), entry));
+    update(entry, "a.1", "a.0", num(0, entry), 5);
+    update(entry, "a.2", "a.1", ref("i.0", entry), 3);
+    access(entry, "t.0", "a.2", ref("i.0", entry));
+    update(entry, "a.3", "a.2", num(1, entry), 7);
+    access(entry, "t.1", "a.3", ref("i.0", entry));
+    update(entry, "a.4", "a.3", num(2, entry), 1);
+    update(entry, "a.5", "a.4", num(2, entry), 4);
+    access(entry, "t.2", "a.5", num(1, entry));
+
+    // a[3] is 8 or 9 depending on the branch, then read at the join
+    emit(entry, std::make_shared<CmpLTInst>(ref("c.0", entry), ref("i.0", entry),
+                                            num(2, entry), entry));
+    emit(entry, std::make_shared<BRTInst>(ref("c.0", entry), thenBB, elseBB,
+                                          entry));
+    update(thenBB, "a.6", "a.5", num(3, thenBB), 8);
+    emit(thenBB, std::make_shared<JumpInst>(merge));
+    update(elseBB, "a.7", "a.5", num(3, elseBB), 9);
+    emit(elseBB, std::make_shared<JumpInst>(merge));
+    auto phi = std::make_shared<PhiInst>("a.8", merge);
+    phi->appendOperand(ref("a.6", merge), thenBB);
+    phi->appendOperand(ref("a.7", merge), elseBB);
+    emit(merge, phi);
+    access(merge, "t.3", "a.8", num(3, merge));
+
+    SSA ssa;
+    ssa.setCFG(entry);
+    assert(ArrayForwardingPass().run(ssa));
+
+    // Only the load behind a store to an unknown index stays
+    assert(countInsts(ssa, InstType::ArrAccess) == 1);
+    std::vector<std::string> printed;
+    for (auto& inst : entry->getInstructions())
+    {
+        if (inst->getInstType() == InstType::Put)
+        {
+            printed.push_back(inst->getOperands()[0]->getTarget()->getString());
+        }
+    }
+    assert((printed == std::vector<std::string>{"3", "t.1", "7"}));
+
+    // The join merges the two stored values instead of loading
+    auto merged = std::dynamic_pointer_cast<PhiInst>(merge->getInstructions()[0]);
+    assert(merged && getDefinedName(merged) != "a.8");
+    assert(merged->getOperands()[0]->getTarget()->getString() == "8");
+    assert(merged->getOperands()[1]->getTarget()->getString() == "9");
+
+    // Nothing reads a[2] or a[3], while a[0] and a[1] may be read as a[i]
+    assert(countInsts(ssa, InstType::ArrUpdate) == 3);
+    assert(!hasInst(thenBB, InstType::ArrUpdate));
+    assert(!ArrayForwardingPass().run(ssa));
+}
+
+void tests_scalar_replacement()
+{
+    // a[0] := 0, then a[0] := a[0] + i for i = 0 .. 3 and put a[0]
+    auto entry = makeBlock("entry");
+    auto header = makeBlock("header");
+    auto exit = makeBlock("exit");
+    addEdge(entry, header);
+    addEdge(header, header);
+    addEdge(header, exit);
+
+    emit(entry, std::make_shared<AllocaInst>(ref("a.0", entry), Type::INTEGER,
+                                             2, entry));
+    emit(entry, std::make_shared<ArrUpdateInst>(ref("a.1", entry),
+                                                ref("a.0", entry), num(0, entry),
+                                                num(0, entry), entry,
+                                                Type::INTEGER));
+    emit(entry, std::make_shared<JumpInst>(header));
+
+    auto phiA = std::make_shared<PhiInst>("a.2", header);
+    phiA->appendOperand(ref("a.1", header), entry);
+    phiA->appendOperand(ref("a.3", header), header);
+    auto phiI = std::make_shared<PhiInst>("i.1", header);
+    phiI->appendOperand(num(0, header), entry);
+    phiI->appendOperand(ref("i.2", header), header);
+    emit(header, phiA);
+    emit(header, phiI);
+    emit(header, std::make_shared<ArrAccessInst>(ref("t.0", header),
+                                                 ref("a.2", header),
+                                                 num(0, header), header,
+                                                 Type::INTEGER));
+    emit(header, std::make_shared<AddInst>(ref("t.1", header),
+                                           ref("t.0", header),
+                                           ref("i.1", header), header));
+    emit(header, std::make_shared<ArrUpdateInst>(ref("a.3", header),
+                                                 ref("a.2", header),
+                                                 num(0, header),
+                                                 ref("t.1", header), header,
+                                                 Type::INTEGER));
+    emit(header, std::make_shared<AddInst>(ref("i.2", header),
+                                           ref("i.1", header), num(1, header),
+                                           header));
+    emit(header, std::make_shared<CmpLTInst>(ref("c.0", header),
+                                             ref("i.2", header),
+                                             num(4, header), header));
+    emit(header, std::make_shared<BRTInst>(ref("c.0", header), header, exit,
+                                           header));
+    emit(exit, std::make_shared<ArrAccessInst>(ref("t.2", exit), ref("a.3", exit),
+                                               num(0, exit), exit,
+                                               Type::INTEGER));
+    emit(exit, std::make_shared<PutInst>(ref("t.2", exit), exit));
+
+    SSA ssa;
+    ssa.setCFG(entry);
+    assert(runOutput(ssa) == "6");
+    assert(ScalarReplacementPass().run(ssa));
+    assert(runOutput(ssa) == "6");
+
+    // The array is gone, a[0] is carried by a phi of its own and a[1],
+    // never stored to, needs none
+    assert(countInsts(ssa, InstType::Alloca) == 0);
+    assert(countInsts(ssa, InstType::ArrAccess) == 0);
+    assert(countInsts(ssa, InstType::ArrUpdate) == 0);
+    assert(countInsts(ssa, InstType::Phi) == 2);
+
+    // An index out of bounds keeps the array in memory
+    auto block = makeBlock("block");
+    emit(block, std::make_shared<AllocaInst>(ref("b.0", block), Type::INTEGER,
+                                             2, block));
+    emit(block, std::make_shared<ArrUpdateInst>(ref("b.1", block),
+                                                ref("b.0", block), num(2, block),
+                                                num(7, block), block,
+                                                Type::INTEGER));
+    emit(block, std::make_shared<ArrAccessInst>(ref("t.0", block),
+                                                ref("b.1", block), num(2, block),
+                                                block, Type::INTEGER));
+    emit(block, std::make_shared<PutInst>(ref("t.0", block), block));
+    SSA outOfBounds;
+    outOfBounds.setCFG(block);
+    assert(!ScalarReplacementPass().run(outOfBounds));
+    assert(countInsts(outOfBounds, InstType::ArrUpdate) == 1);
+}
+
+void tests_value_range()
+{
+    // i counts from 0 and goes around while i + 1 > 5 fails
+    auto loop = makeCountedLoop(5, true);
+    auto body = getRPONodes(loop.getCFG())[1];
+    ValueRangeAnalysis loopRanges(loop);
+    auto counter = loopRanges.getRange(ref("i.1", body), body);
+    assert(counter.lo == 0 && counter.hi == 5);
+
+    // get x, if x > 3 then put x > 2, put x / 2, and if x < 100 then
+    // put x / 3, if x >= 4 then skip else put 0
+    auto entry = makeBlock("entry");
+    auto thenBB = makeBlock("then");
+    auto small = makeBlock("small");
+    auto elseBB = makeBlock("else");
+    auto exit = makeBlock("exit");
+    addEdge(entry, thenBB);
+    addEdge(entry, exit);
+    addEdge(thenBB, small);
+    addEdge(thenBB, exit);
+    addEdge(small, exit);
+    addEdge(small, elseBB);
+    addEdge(elseBB, exit);
+
+    emit(entry, std::make_shared<GetInst>(ref("x.0", entry), entry));
+    emit(entry, std::make_shared<CmpGTInst>(ref("c.0", entry), ref("x.0", entry),
+                                            num(3, entry), entry));
+    emit(entry, std::make_shared<BRTInst>(ref("c.0", entry), thenBB, exit,
+                                          entry));
+    emit(thenBB, std::make_shared<CmpGTInst>(ref("c.1", thenBB),
+                                             ref("x.0", thenBB), num(2, thenBB),
+                                             thenBB));
+    emit(thenBB, std::make_shared<PutInst>(ref("c.1", thenBB), thenBB));
+    auto half = std::make_shared<DivInst>(ref("t.0", thenBB), ref("x.0", thenBB),
+                                          num(2, thenBB), thenBB);
+    emit(thenBB, half);
+    emit(thenBB, std::make_shared<PutInst>(ref("t.0", thenBB), thenBB));
+    emit(thenBB, std::make_shared<CmpLTInst>(ref("c.2", thenBB),
+                                             ref("x.0", thenBB),
+                                             num(100, thenBB), thenBB));
+    emit(thenBB, std::make_shared<BRTInst>(ref("c.2", thenBB), small, exit,
+                                           thenBB));
+    auto third = std::make_shared<DivInst>(ref("t.1", small), ref("x.0", small),
+                                           num(3, small), small);
+    emit(small, third);
+    emit(small, std::make_shared<PutInst>(ref("t.1", small), small));
+    emit(small, std::make_shared<CmpGTEInst>(ref("c.3", small),
+                                             ref("x.0", small), num(4, small),
+                                             small));
+    emit(small, std::make_shared<BRFInst>(ref("c.3", small), elseBB, exit,
+                                          small));
+    emit(elseBB, std::make_shared<PutInst>(num(0, elseBB), elseBB));
+    emit(elseBB, std::make_shared<JumpInst>(exit));
+
+    SSA ssa;
+    ssa.setCFG(entry);
+    assert(ValueRangePass().run(ssa));
+
+    // x > 2 and x >= 4 hold below x > 3, the first is printed as a number
+    auto printed = thenBB->getInstructions()[0];
+    assert(printed->getInstType() == InstType::Put);
+    assert(printed->getOperands()[0]->getTarget()->getInstType() ==
+           InstType::IntConst);
+    assert(small->getTerminator()->getInstType() == InstType::Jump);
+    assert(getRPONodes(ssa.getCFG()).size() == 4);
+
+    // x is positive, and below 100 it fits in 32 bits as well
+    assert(half->getKind() == DivKind::Unsigned);
+    assert(third->getKind() == DivKind::Unsigned32);
+    ssa.invalidateCFGAnalyses();
+    assert(!ValueRangePass().run(ssa));
+}
+
+void tests_bounds_check()
+{
+    // a has five elements, get n and a[n] := 1, put a[n], then put a[i]
+    // for i = 0 .. 4
+    auto entry = makeBlock("entry");
+    auto body = makeBlock("body");
+    auto exit = makeBlock("exit");
+    addEdge(entry, body);
+    addEdge(body, body);
+    addEdge(body, exit);
+
+    emit(entry, std::make_shared<AllocaInst>(ref("a.0", entry), Type::INTEGER,
+                                             5, entry));
+    emit(entry, std::make_shared<GetInst>(ref("n.0", entry), entry));
+    auto store = std::make_shared<ArrUpdateInst>(ref("a.1", entry),
+                                                 ref("a.0", entry),
+                                                 ref("n.0", entry), num(1, entry),
+                                                 entry, Type::INTEGER);
+    emit(entry, store);
+    auto reload = std::make_shared<ArrAccessInst>(ref("t.0", entry),
+                                                  ref("a.1", entry),
+                                                  ref("n.0", entry), entry,
+                                                  Type::INTEGER);
+    emit(entry, reload);
+    emit(entry, std::make_shared<PutInst>(ref("t.0", entry), entry));
+    emit(entry, std::make_shared<JumpInst>(body));
+
+    auto phi = std::make_shared<PhiInst>("i.1", body);
+    phi->appendOperand(num(0, body), entry);
+    phi->appendOperand(ref("i.2", body), body);
+    emit(body, phi);
+    auto load = std::make_shared<ArrAccessInst>(ref("t.1", body),
+                                                ref("a.1", body),
+                                                ref("i.1", body), body,
+                                                Type::INTEGER);
+    emit(body, load);
+    emit(body, std::make_shared<PutInst>(ref("t.1", body), body));
+    emit(body, std::make_shared<AddInst>(ref("i.2", body), ref("i.1", body),
+                                         num(1, body), body));
+    emit(body, std::make_shared<CmpGTEInst>(ref("c.0", body), ref("i.2", body),
+                                            num(5, body), body));
+    emit(body, std::make_shared<BRFInst>(ref("c.0", body), body, exit, body));
+
+    SSA ssa;
+    ssa.setCFG(entry);
+    assert(BoundsCheckPass().run(ssa));
+
+    // n may be anything, but once checked it needn't be checked again, and
+    // i stays within 0 .. 4
+    assert(store->needsBoundsCheck());
+    assert(!reload->needsBoundsCheck());
+    assert(!load->needsBoundsCheck());
+    assert(!BoundsCheckPass().run(ssa));
+
+    // put a[i] and i for i = 0 .. 4, strength reduction turns the index into
+    // a byte offset stepping with i
+    auto scaledEntry = makeBlock("entry");
+    auto scaledBody = makeBlock("body");
+    auto scaledExit = makeBlock("exit");
+    addEdge(scaledEntry, scaledBody);
+    addEdge(scaledBody, scaledBody);
+    addEdge(scaledBody, scaledExit);
+
+    emit(scaledEntry, std::make_shared<AllocaInst>(ref("a.0", scaledEntry),
+                                                   Type::INTEGER, 5,
+                                                   scaledEntry));
+    emit(scaledEntry, std::make_shared<JumpInst>(scaledBody));
+
+    auto counter = std::make_shared<PhiInst>("i.1", scaledBody);
+    counter->appendOperand(num(0, scaledBody), scaledEntry);
+    counter->appendOperand(ref("i.2", scaledBody), scaledBody);
+    emit(scaledBody, counter);
+    auto scaledLoad = std::make_shared<ArrAccessInst>(
+        ref("t.0", scaledBody), ref("a.0", scaledBody), ref("i.1", scaledBody),
+        scaledBody, Type::INTEGER);
+    emit(scaledBody, scaledLoad);
+    emit(scaledBody, std::make_shared<PutInst>(ref("t.0", scaledBody),
+                                               scaledBody));
+    emit(scaledBody, std::make_shared<PutInst>(ref("i.1", scaledBody),
+                                               scaledBody));
+    emit(scaledBody, std::make_shared<AddInst>(ref("i.2", scaledBody),
+                                               ref("i.1", scaledBody),
+                                               num(1, scaledBody), scaledBody));
+    emit(scaledBody, std::make_shared<CmpGTEInst>(ref("c.0", scaledBody),
+                                                  ref("i.2", scaledBody),
+                                                  num(5, scaledBody),
+                                                  scaledBody));
+    emit(scaledBody, std::make_shared<BRFInst>(ref("c.0", scaledBody),
+                                               scaledBody, scaledExit,
+                                               scaledBody));
+
+    SSA scaledSSA;
+    scaledSSA.setCFG(scaledEntry);
+    assert(StrengthReductionPass().run(scaledSSA));
+    assert(scaledLoad->isIndexScaled());
+
+    // The offset is 0 .. 32 since i is 0 .. 4
+    assert(BoundsCheckPass().run(scaledSSA));
+    assert(!scaledLoad->needsBoundsCheck());
+}
+
+void tests_if_conversion()
+{
+    // get x, get y, if x > y then m := x - y else m := y - x, and
+    // if m > 5 then q := 100 / m, put m + q
+    auto entry = makeBlock("entry");
+    auto thenBB = makeBlock("then");
+    auto elseBB = makeBlock("else");
+    auto merge = makeBlock("merge");
+    auto divide = makeBlock("divide");
+    auto exit = makeBlock("exit");
+    addEdge(entry, thenBB);
+    addEdge(entry, elseBB);
+    addEdge(thenBB, merge);
+    addEdge(elseBB, merge);
+    addEdge(merge, divide);
+    addEdge(merge, exit);
+    addEdge(divide, exit);
+
+    emit(entry, std::make_shared<GetInst>(ref("x.0", entry), entry));
+    emit(entry, std::make_shared<GetInst>(ref("y.0", entry), entry));
+    emit(entry, std::make_shared<CmpGTInst>(ref("c.0", entry), ref("x.0", entry),
+                                            ref("y.0", entry), entry));
+    emit(entry, std::make_shared<BRTInst>(ref("c.0", entry), thenBB, elseBB,
+                                          entry));
+    emit(thenBB, std::make_shared<SubInst>(ref("m.0", thenBB),
+                                           ref("x.0", thenBB),
+                                           ref("y.0", thenBB), thenBB));
+    emit(thenBB, std::make_shared<JumpInst>(merge));
+    emit(elseBB, std::make_shared<SubInst>(ref("m.1", elseBB),
+                                           ref("y.0", elseBB),
+                                           ref("x.0", elseBB), elseBB));
+    emit(elseBB, std::make_shared<JumpInst>(merge));
+
+    auto phi = std::make_shared<PhiInst>("m.2", merge);
+    phi->appendOperand(ref("m.0", merge), thenBB);
+    phi->appendOperand(ref("m.1", merge), elseBB);
+    emit(merge, phi);
+    emit(merge, std::make_shared<CmpGTInst>(ref("c.1", merge), ref("m.2", merge),
+                                            num(5, merge), merge));
+    emit(merge, std::make_shared<BRTInst>(ref("c.1", merge), divide, exit,
+                                          merge));
+    emit(divide, std::make_shared<DivInst>(ref("q.0", divide), num(100, divide),
+                                           ref("m.2", divide), divide));
+    emit(divide, std::make_shared<JumpInst>(exit));
+
+    auto quotient = std::make_shared<PhiInst>("q.1", exit);
+    quotient->appendOperand(ref("q.0", exit), divide);
+    quotient->appendOperand(num(0, exit), merge);
+    emit(exit, quotient);
+    emit(exit, std::make_shared<AddInst>(ref("t.0", exit), ref("m.2", exit),
+                                         ref("q.1", exit), exit));
+    emit(exit, std::make_shared<PutInst>(ref("t.0", exit), exit));
+
+    SSA ssa;
+    ssa.setCFG(entry);
+    assert(IfConversionPass().run(ssa));
+
+    // Both subtractions run before the select, the division may fault and
+    // keeps its branch
+    assert(countInsts(ssa, InstType::Select) == 1);
+    assert(countInsts(ssa, InstType::Phi) == 1);
+    assert(hasInst(entry, InstType::Select));
+    assert(hasInst(entry, InstType::BRT));
+    assert(getRPONodes(ssa.getCFG()).size() == 3);
+    assert(!IfConversionPass().run(ssa));
+}
+
+void tests_disjoint_set_union()
+{
+    DisjointSetUnion sets(6);
+    assert(sets.size() == 6);
+    for (int v = 0; v < 6; ++v)
+    {
+        assert(sets.find(v) == v);
+    }
+
+    // {0, 1, 2} and {3, 4}, with 5 alone
+    assert(sets.unite(0, 1));
+    assert(sets.unite(2, 1));
+    assert(sets.unite(3, 4));
+    assert(!sets.unite(0, 2));
+    assert(sets.find(0) == sets.find(2));
+    assert(sets.find(3) == sets.find(4));
+    assert(sets.find(0) != sets.find(3));
+    assert(sets.find(5) == 5);
+
+    // A long chain stays shallow
+    auto id = sets.make_set();
+    assert(id == 6);
+    for (int v = 7; v < 1000; ++v)
+    {
+        assert(sets.make_set() == v);
+        assert(sets.unite(v - 1, v));
+    }
+    auto root = sets.find(999);
+    for (int v = 6; v < 1000; ++v)
+    {
+        assert(sets.find(v) == root);
+    }
+    assert(sets.unite(0, 999));
+    assert(sets.find(1) == sets.find(500));
+
+    sets.reset(3);
+    assert(sets.size() == 3);
+    assert(sets.find(2) == 2);
+    assert(sets.unite(2, 0));
+    assert(sets.find(0) == sets.find(2) && sets.find(1) == 1);
+}
+
+}  // namespace mina
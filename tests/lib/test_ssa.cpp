@@ -0,0 +1,129 @@
+#include "tests/test_ssa.hpp"
+#include "Parser.hpp"
+#include "PassManager.hpp"
+#include "SSA.hpp"
+
+#include <string>
+#include <sstream>
+#include <cassert>
+#include <utility>
+#include <iostream>
+
+namespace mina
+{
+
+// Compiles the program at the optimization level with every function
+// verified before each pass, and returns the generated assembly
+static std::string compileVerified(std::string source, int optLevel)
+{
+    auto& options = getCompilerOptions();
+    auto savedOptions = options;
+    options.optLevel = optLevel;
+    options.verifyEach = true;
+
+    std::stringstream output;
+    auto coutBuffer = std::cout.rdbuf(output.rdbuf());
+    try
+    {
+        Parser parser(std::move(source));
+        parser.program();
+    }
+    catch (...)
+    {
+        std::cout.rdbuf(coutBuffer);
+        options = savedOptions;
+        throw;
+    }
+    std::cout.rdbuf(coutBuffer);
+    options = savedOptions;
+    return output.str();
+}
+
+void tests_ssa_construction()
+{
+    // The phi of La in the repeat header becomes trivial when the loop
+    // block is sealed. The then arm of the if cached it through its single
+    // predecessor, and the exit edge leaving from there used to read the
+    // removed phi.
+    std::string exitFromIf = R"({
+  var La : integer
+  var Lb : integer
+  var x : boolean
+  ;
+  La := 1
+  repeat
+    put(La, skip)
+    Lb := 0
+    loop
+      if Lb >= 2 then exit end if
+      x := (La = 5)
+      Lb := Lb + 1
+    end loop
+    La := La + 1
+  until La >= 4
+})";
+    for (int optLevel = 0; optLevel <= 2; ++optLevel)
+    {
+        auto assembly = compileVerified(exitFromIf, optLevel);
+        assert(assembly.find("main:") != std::string::npos);
+    }
+
+    // a isn't assigned in the loop, so the phis for it in the repeat block
+    // and after the if are trivial. The one after the if uses the other and
+    // has to follow it being replaced by the value of get, which is what
+    // the put after the loop reads.
+    std::string readAfterLoop = R"({
+  var a : integer
+  var i : integer
+  ;
+  get(a)
+  i := 0
+  repeat
+    if i < 2 then
+      put(i, skip)
+    end if
+    i := i + 1
+  until i > 3
+  put(a, skip)
+})";
+    for (int optLevel = 0; optLevel <= 2; ++optLevel)
+    {
+        auto assembly = compileVerified(readAfterLoop, optLevel);
+        assert(assembly.find("main:") != std::string::npos);
+    }
+
+    // The phi of v1 in the repeat block is trivial and removed when the
+    // block is sealed. The call in the loop has to be rewritten with the
+    // other users, or it passes the removed phi instead of 7.
+    std::string callInLoop = R"({
+  var v1 : integer
+  var i2 : integer
+  proc r(x : integer)
+  {
+    ;
+    put(x, skip)
+  }
+  ;
+  get(v1)
+  v1 := 7
+  i2 := 0
+  repeat
+    r(v1)
+    i2 := i2 + 1
+  until i2 >= 2
+})";
+    for (int optLevel = 0; optLevel <= 2; ++optLevel)
+    {
+        auto assembly = compileVerified(callInLoop, optLevel);
+        assert(assembly.find("main:") != std::string::npos);
+    }
+
+    // Fresh names are counted per function, not across the program
+    SSA compiledFirst;
+    assert(compiledFirst.makeFreshName("a.2") == "a.o0");
+    assert(compiledFirst.makeFreshName("a.o0") == "a.o1");
+    SSA compiledSecond;
+    assert(compiledSecond.makeFreshName("a.2") == "a.o0");
+}
+
+}  // namespace mina